@@ -5,6 +5,7 @@
 #include "6809infc.h"
 #include "cpu.h"
 #include "../game/game.h"
+#include "memmap.h"
 
 #ifdef WIN32
 #pragma warning (disable:4244)	// disable the warning about possible loss of data
@@ -26,25 +27,25 @@ static void FetchInstr(int addr, unsigned char fetch_buffer[])
 
 static int LoadByte(int addr)
 {
-	return (g_game->cpu_mem_read(static_cast<Uint16>(addr)) & 0xff);
+	return (memmap_read16(addr) & 0xff);
 }
 
 static int LoadWord(int addr)
 {
-	unsigned char high_byte = (g_game->cpu_mem_read(static_cast<Uint16>(addr)) & 0xff);
-	unsigned char low_byte = (g_game->cpu_mem_read(static_cast<Uint16>(addr + 1)) & 0xff);
+	unsigned char high_byte = (memmap_read16(addr) & 0xff);
+	unsigned char low_byte = (memmap_read16(addr + 1) & 0xff);
 	return ((high_byte << 8) | low_byte);
 }
 
 static void StoreByte(int addr, int value)
 {
-	g_game->cpu_mem_write(static_cast<Uint16>(addr & 0xffff), (value & 0xff));
+	memmap_write16(addr, (value & 0xff));
 }
 
 static void StoreWord(int addr, int value)
 {
-	g_game->cpu_mem_write(static_cast<Uint16>(addr & 0xffff), ((value >> 8) & 0xff));
-	g_game->cpu_mem_write(static_cast<Uint16>((addr + 1) & 0xffff), (value & 0xff));
+	memmap_write16(addr, ((value >> 8) & 0xff));
+	memmap_write16(addr + 1, (value & 0xff));
 }
 
 // I don't know if we'll need this...
@@ -0,0 +1,253 @@
+/*
+ * cpu-profile.cpp
+ *
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of DAPHNE, a laserdisc arcade game emulator
+ *
+ * DAPHNE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * DAPHNE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// cpu-profile.cpp
+// Dumps the cpu scheduler statistics (replaces the old CPU_DIAG compile-time option)
+
+#ifdef WIN32
+#define strcasecmp stricmp
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "cpu-profile.h"
+#include "../timer/timer.h"
+#include "../io/conout.h"
+
+using namespace std;
+
+static FILE *g_profile_file = NULL;	// where we are dumping to (NULL if we aren't dumping)
+static string g_profile_filename;	// the file the user wants us to dump to
+static bool g_profile_json = false;	// whether we are writing JSON (true) or CSV (false)
+static bool g_profile_header_written = false;	// whether the CSV header has been written yet
+static unsigned int g_profile_interval_ms = CPU_PROFILE_DEFAULT_INTERVAL;
+
+static unsigned int g_profile_start_ms = 0;	// host time when stats were last reset
+static unsigned int g_profile_last_dump_ms = 0;	// host time when we last dumped
+static Uint64 g_profile_sleep_us = 0;	// how many us the cpu loop has slept
+static unsigned int g_profile_behind_hist[CPU_PROFILE_BEHIND_BUCKETS] = { 0 };
+
+void cpu_profile_reset(struct cpu_profile *prof)
+{
+	memset(prof, 0, sizeof(struct cpu_profile));
+}
+
+void cpu_profile_reset_globals()
+{
+	g_profile_start_ms = g_profile_last_dump_ms = GetRealTicksFunc();
+	g_profile_sleep_us = 0;
+	memset(g_profile_behind_hist, 0, sizeof(g_profile_behind_hist));
+}
+
+void cpu_profile_ms_behind(unsigned int uMsBehind)
+{
+	unsigned int uBucket = 0;
+
+	// find the highest bit set to figure out which bucket this goes in
+	while ((uMsBehind != 0) && (uBucket < (CPU_PROFILE_BEHIND_BUCKETS - 1)))
+	{
+		uMsBehind >>= 1;
+		++uBucket;
+	}
+
+	++g_profile_behind_hist[uBucket];
+}
+
+void cpu_profile_sleep(Uint64 u64Us)
+{
+	g_profile_sleep_us += u64Us;
+}
+
+void cpu_profile_set_output(const char *filename)
+{
+	size_t len = strlen(filename);
+
+	g_profile_filename = filename;
+	g_profile_json = ((len > 5) && (strcasecmp(filename + len - 5, ".json") == 0));
+}
+
+void cpu_profile_set_interval(unsigned int uIntervalMs)
+{
+	// 0 would make us dump every single ms, which is never what anyone wants
+	if (uIntervalMs > 0)
+	{
+		g_profile_interval_ms = uIntervalMs;
+	}
+	else
+	{
+		printline("cpu_profile_set_interval() : interval must be greater than 0, ignoring");
+	}
+}
+
+void cpu_profile_think(unsigned int uEmulatedMs)
+{
+	// if nobody wants to see the profile, don't waste time
+	if (g_profile_filename.empty())
+	{
+		return;
+	}
+
+	if ((GetRealTicksFunc() - g_profile_last_dump_ms) >= g_profile_interval_ms)
+	{
+		cpu_profile_dump(uEmulatedMs);
+	}
+}
+
+void cpu_profile_dump(unsigned int uEmulatedMs)
+{
+	if (g_profile_filename.empty())
+	{
+		return;
+	}
+
+	// open the file the first time we need it
+	if (!g_profile_file)
+	{
+		g_profile_file = fopen(g_profile_filename.c_str(), "w");
+		if (!g_profile_file)
+		{
+			string msg = "cpu_profile_dump() : could not open " + g_profile_filename + " for writing, profiling output disabled";
+			printline(msg.c_str());
+			g_profile_filename.clear();
+			return;
+		}
+	}
+
+	unsigned int uNowMs = GetRealTicksFunc();
+	unsigned int uWallMs = uNowMs - g_profile_start_ms;
+	unsigned int uIntervalMs = uNowMs - g_profile_last_dump_ms;
+	unsigned int uSleepMs = (unsigned int) (g_profile_sleep_us / 1000);
+	unsigned int uBusyMs = (uWallMs > uSleepMs) ? (uWallMs - uSleepMs) : 0;
+	struct cpudef *cpu = NULL;
+	int i = 0;
+
+	// CSV gets a header the first time around so it can be loaded into a spreadsheet as-is
+	if (!g_profile_json && !g_profile_header_written)
+	{
+		fprintf(g_profile_file, "wall_ms,emu_ms,sleep_ms,busy_ms,cpu,hz,mhz,cycles_requested,cycles_executed,"
+			"cycles_overshoot,cycles_idle_skipped,execute_calls,event_callbacks,nmi_count,nmi_latency_avg_ms,nmi_latency_max_ms");
+		for (i = 0; i < MAX_IRQS; i++)
+		{
+			fprintf(g_profile_file, ",irq%d_count,irq%d_latency_avg_ms,irq%d_latency_max_ms", i, i, i);
+		}
+		for (i = 0; i < CPU_PROFILE_BEHIND_BUCKETS; i++)
+		{
+			fprintf(g_profile_file, ",behind_bucket%d", i);
+		}
+		fprintf(g_profile_file, "\n");
+		g_profile_header_written = true;
+	}
+
+	if (g_profile_json)
+	{
+		fprintf(g_profile_file, "{\"wall_ms\":%u,\"emu_ms\":%u,\"sleep_ms\":%u,\"busy_ms\":%u,\"behind_hist\":[",
+			uWallMs, uEmulatedMs, uSleepMs, uBusyMs);
+		for (i = 0; i < CPU_PROFILE_BEHIND_BUCKETS; i++)
+		{
+			fprintf(g_profile_file, "%s%u", (i != 0) ? "," : "", g_profile_behind_hist[i]);
+		}
+		fprintf(g_profile_file, "],\"cpus\":[");
+	}
+
+	// go through every cpu (ids are assigned in order starting at 0)
+	for (Uint8 id = 0; (cpu = get_cpu_struct(id)) != NULL; id++)
+	{
+		struct cpu_profile *prof = &cpu->profile;
+		double dMhz = 0.0;
+
+		if (uIntervalMs != 0)
+		{
+			dMhz = (double) (prof->u64CyclesExecuted - prof->u64LastDumpCycles) / uIntervalMs * 0.001;
+		}
+		prof->u64LastDumpCycles = prof->u64CyclesExecuted;
+
+		unsigned int uNMIAvg = (prof->uNMICount != 0) ? (prof->uNMILatencyTotalMs / prof->uNMICount) : 0;
+
+		if (g_profile_json)
+		{
+			fprintf(g_profile_file, "%s{\"cpu\":%u,\"hz\":%u,\"mhz\":%.3f,\"cycles_requested\":%llu,\"cycles_executed\":%llu,"
+				"\"cycles_overshoot\":%llu,\"cycles_idle_skipped\":%llu,\"execute_calls\":%u,\"event_callbacks\":%u,"
+				"\"nmi\":{\"count\":%u,\"latency_avg_ms\":%u,\"latency_max_ms\":%u},\"irq\":[",
+				(id != 0) ? "," : "", id, cpu->hz, dMhz,
+				(unsigned long long) prof->u64CyclesRequested, (unsigned long long) prof->u64CyclesExecuted,
+				(unsigned long long) prof->u64CyclesOvershoot, (unsigned long long) prof->u64CyclesIdleSkipped,
+				prof->uExecuteCalls, prof->uEventCallbacks,
+				prof->uNMICount, uNMIAvg, prof->uNMILatencyMaxMs);
+		}
+		else
+		{
+			fprintf(g_profile_file, "%u,%u,%u,%u,%u,%u,%.3f,%llu,%llu,%llu,%llu,%u,%u,%u,%u,%u",
+				uWallMs, uEmulatedMs, uSleepMs, uBusyMs, id, cpu->hz, dMhz,
+				(unsigned long long) prof->u64CyclesRequested, (unsigned long long) prof->u64CyclesExecuted,
+				(unsigned long long) prof->u64CyclesOvershoot, (unsigned long long) prof->u64CyclesIdleSkipped,
+				prof->uExecuteCalls, prof->uEventCallbacks,
+				prof->uNMICount, uNMIAvg, prof->uNMILatencyMaxMs);
+		}
+
+		for (i = 0; i < MAX_IRQS; i++)
+		{
+			unsigned int uIRQAvg = (prof->uIRQCount[i] != 0) ? (prof->uIRQLatencyTotalMs[i] / prof->uIRQCount[i]) : 0;
+
+			if (g_profile_json)
+			{
+				fprintf(g_profile_file, "%s{\"count\":%u,\"latency_avg_ms\":%u,\"latency_max_ms\":%u}",
+					(i != 0) ? "," : "", prof->uIRQCount[i], uIRQAvg, prof->uIRQLatencyMaxMs[i]);
+			}
+			else
+			{
+				fprintf(g_profile_file, ",%u,%u,%u", prof->uIRQCount[i], uIRQAvg, prof->uIRQLatencyMaxMs[i]);
+			}
+		}
+
+		if (g_profile_json)
+		{
+			fprintf(g_profile_file, "]}");
+		}
+		else
+		{
+			for (i = 0; i < CPU_PROFILE_BEHIND_BUCKETS; i++)
+			{
+				fprintf(g_profile_file, ",%u", g_profile_behind_hist[i]);
+			}
+			fprintf(g_profile_file, "\n");
+		}
+	}
+
+	if (g_profile_json)
+	{
+		fprintf(g_profile_file, "]}\n");
+	}
+
+	fflush(g_profile_file);	// so the file is useful even if we crash
+	g_profile_last_dump_ms = uNowMs;
+}
+
+void cpu_profile_shutdown()
+{
+	if (g_profile_file)
+	{
+		fclose(g_profile_file);
+		g_profile_file = NULL;
+	}
+	g_profile_header_written = false;
+}
@@ -0,0 +1,70 @@
+/*
+ * cpu-profile.h
+ *
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of DAPHNE, a laserdisc arcade game emulator
+ *
+ * DAPHNE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * DAPHNE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// cpu-profile.h
+// Keeps track of how well the cpu scheduler is keeping up, so we can find out
+//  which game drivers are falling behind (and why) without a special build.
+// The per-cpu counters live in struct cpudef (see cpu.h) and are always updated by cpu_execute.
+// They are only written out if the user asks for it (-cpu_profile <file>).
+
+#ifndef CPU_PROFILE_H
+#define CPU_PROFILE_H
+
+#include "cpu.h"
+
+// how many buckets the g_uCPUMsBehind histogram has
+// (bucket 0 is 0 ms, bucket 1 is 1 ms, bucket 2 is 2-3 ms, bucket 3 is 4-7 ms ... last bucket is everything else)
+#define CPU_PROFILE_BEHIND_BUCKETS 8
+
+// how often (in host milliseconds) the profile gets dumped if the user doesn't specify
+#define CPU_PROFILE_DEFAULT_INTERVAL 5000
+
+// clears the statistics for one cpu
+void cpu_profile_reset(struct cpu_profile *prof);
+
+// clears the statistics that aren't specific to any cpu (sleep time, histogram)
+void cpu_profile_reset_globals();
+
+// records how far behind the cpu loop was after executing 1 ms worth of cycles
+void cpu_profile_ms_behind(unsigned int uMsBehind);
+
+// records how many microseconds the cpu loop slept to keep from running too fast
+void cpu_profile_sleep(Uint64 u64Us);
+
+// sets the file to dump statistics to.  If the filename ends with .json, the output is
+//  one JSON object per line, otherwise the output is CSV (one line per cpu per dump).
+void cpu_profile_set_output(const char *filename);
+
+// how often (in host milliseconds) to dump statistics
+void cpu_profile_set_interval(unsigned int uIntervalMs);
+
+// should be called once per emulated ms, dumps statistics if it's time to
+// uEmulatedMs is how many ms of emulated time have passed since cpu_execute started
+void cpu_profile_think(unsigned int uEmulatedMs);
+
+// writes the current statistics for every cpu to the output file (if there is one)
+void cpu_profile_dump(unsigned int uEmulatedMs);
+
+// closes the output file (if it's open)
+void cpu_profile_shutdown();
+
+#endif // CPU_PROFILE_H
@@ -34,6 +34,8 @@
 #endif
 
 #include "cpu.h"
+#include "cpu-profile.h"
+#include "memmap.h"
 #include <stdio.h>	// for stderr
 #include <string.h>	// for memcpy
 #include "../daphne.h"
@@ -42,12 +44,17 @@
 #include "../timer/timer.h"
 #include "../io/input.h"
 #include "../io/conout.h"
+#include "../io/numstr.h"
 #include "../sound/sound.h"
+#include "../game/snapshot.h"
+#include "../game/runahead.h"
+#include "../io/inputrec.h"
 #include "6809infc.h"
 #include "nes6502.h"
 #include "nes_6502.h"
 #include "mamewrap.h"
 #include "generic_z80.h"
+#include "m80_idle.h"
 #include "cop.h"
 #include "x86/i86intf.h"
 #include "../ldp-in/ldv1000.h"	// for ldv1000_reset for strobe stuff
@@ -64,39 +71,60 @@
 #endif
 
 #include <stack>	// for cpu pausing operations
+#include <vector>
+#include <string>
+#include <SDL_thread.h>
 
 using namespace std;
 
-stack <Uint32> g_cpu_paused_timer;	// the time we were at when cpu_pause_timer was called
+stack <Uint64> g_cpu_paused_timer;	// the time (in us) we were at when cpu_pause_timer was called
 bool g_cpu_paused = false;
 
 struct cpudef *g_head = NULL;	// pointer to the first cpu in our linked list of cpu's
 unsigned char g_cpu_count = 0;	// how many cpu's have been added
 bool g_cpu_initialized[CPU_COUNT] = { false };	// whether cpu core has been initialized
-Uint32 g_cpu_timer = 0;	// used to make cpu's run at the right speed
+Uint64 g_cpu_timer_us = 0;	// used to make cpu's run at the right speed (host time in microseconds)
 Uint32 g_expected_elapsed_ms = 0;	// how many ms we expect to have elapsed since last cpu execution loop
-Uint8 g_active_cpu = 0;	// which cpu is currently active
+CPU_THREAD_LOCAL Uint8 g_active_cpu = 0;	// which cpu is currently active (each cpu thread has its own)
 unsigned int g_uInterleavePerMs = 1; // number of times the cpus switch in 1 ms 
 
 // How many milliseconds the CPU emulation is lagging behind.
 // So that OpenGL mode knows when to drop frames to get back up to speed (vsync-enabled only)
 unsigned int g_uCPUMsBehind = 0;
 
-// Uncomment this if you want to test the CPUs to make sure they are running at the proper speed
-//#define CPU_DIAG 1
-
-#ifdef CPU_DIAG
-// how many cpu's cpu diag can support (this has nothing to do with how many cpu's daphne can support)
-#define CPU_DIAG_CPUCOUNT 10
-	static unsigned int cd_cycle_count[CPU_DIAG_CPUCOUNT];	// for speed test
-	static unsigned int cd_old_time[CPU_DIAG_CPUCOUNT] = { 0 }; // " " "
-	static unsigned int cd_irq_count[CPU_DIAG_CPUCOUNT][MAX_IRQS] = { { 0 } };
-	static unsigned int cd_nmi_count[CPU_DIAG_CPUCOUNT] = { 0 };
-	static double cd_avg_mhz[CPU_DIAG_CPUCOUNT] = { 0.0 };	// average MHz of current cpu
-	static int cd_report_count[CPU_DIAG_CPUCOUNT] = { 0 };	// how many reports have been given
-	
-	static unsigned int cd_extra_ms = 0;	// how many extra ms we have leftover (so we can calculate resource usage)
-#endif
+// page table that is used when no cpu is active (every page is unmapped, so everything goes to the game driver)
+static struct mem_page g_mem_pages_unmapped[MEM_PAGE_COUNT];
+
+// page table of the currently active cpu
+CPU_THREAD_LOCAL struct mem_page *g_mem_pages = g_mem_pages_unmapped;
+
+// MULTI-THREADED CPU EXECUTION
+// If the game driver puts its cpus into more than one thread group (see cpudef::uThreadGroup), each group
+//  runs on its own thread for every interleave slice, and the threads all meet up again at the end of the slice.
+// Group 0 always runs on the main thread, since that's where the video and the laserdisc player have to be driven from.
+// Anything that one group does to another group has to go through cpu_sync_point.
+
+// something that one thread group wants to do to another (see cpu_sync_point)
+struct cpu_sync
+{
+	void (*callback)(void *obj, unsigned int uValue);
+	void *obj;
+	unsigned int uValue;
+};
+
+static bool g_bCPUThreadsAllowed = true;	// cleared by -nocputhreads
+static unsigned int g_uCPUThreadGroups = 1;	// how many thread groups are running in parallel (1 means none are)
+static SDL_Thread *g_cpu_threads[MAX_CPU_THREAD_GROUPS] = { NULL };	// worker thread for each group (group 0 doesn't have one)
+static SDL_sem *g_cpu_thread_start[MAX_CPU_THREAD_GROUPS] = { NULL };	// posted to start a group's worker thread on the next slice
+static SDL_sem *g_cpu_thread_done = NULL;	// posted by each worker thread when it has finished its slice
+static volatile bool g_bCPUThreadsQuit = false;	// tells the worker threads to exit
+static unsigned int g_uCPUThreadInterleave = 0;	// which interleave slice the worker threads are running
+static bool g_bCPUThreadsParallel = false;	// true while the thread groups are running in parallel
+static bool g_bCPUSerialUntilMsEnd = false;	// true if a sync point was hit, so the rest of the ms runs on one thread
+static vector<struct cpu_sync> g_cpu_sync_queue[MAX_CPU_THREAD_GROUPS];	// sync points that each group is waiting on
+static CPU_THREAD_LOCAL unsigned int g_uCPUThreadGroup = 0;	// which thread group the current thread runs
+
+static void cpu_threads_stop();
 
 //////////////////////////////////////////////////////////////////////////////////
 
@@ -131,11 +159,16 @@ void add_cpu (struct cpudef *candidate)
 	cur->id = g_cpu_count;
 	g_cpu_count++;
 
+	// every page starts out unmapped so that the game driver handles all memory accesses until it says otherwise
+	cur->mem_pages = new struct mem_page[MEM_PAGE_COUNT];
+	memset(cur->mem_pages, 0, sizeof(struct mem_page) * MEM_PAGE_COUNT);
+
 	// DEFAULT VALUES
 	cur->ascii_info_callback = generic_ascii_info_stub;
 	cur->elapsedcycles_callback = generic_cpu_elapsedcycles_stub;
 	cur->getpc_callback = NULL;
 	cur->dasm_callback = generic_dasm_stub;
+	cur->setinstance_callback = NULL;
 	// END DEFAULT VALUES
 
 	// now we must assign the appropriate callbacks
@@ -149,6 +182,7 @@ void add_cpu (struct cpudef *candidate)
 		cur->execute_callback = m80_execute;
 		cur->getcontext_callback = m80_get_context;
 		cur->setcontext_callback = m80_set_context;
+		cur->setinstance_callback = m80_set_instance;
 		cur->getpc_callback = m80_get_pc;
 		cur->setpc_callback = m80_set_pc;
 		cur->elapsedcycles_callback = m80_get_cycles_executed;
@@ -195,6 +229,7 @@ void add_cpu (struct cpudef *candidate)
 		cur->execute_callback = nes6502_execute;
 		cur->getcontext_callback = generic_6502_getcontext;
 		cur->setcontext_callback = generic_6502_setcontext;
+		cur->setinstance_callback = generic_6502_setinstance;
 		cur->setpc_callback = NULL;
 		cur->getpc_callback = nes6502_get_pc;
 		cur->elapsedcycles_callback = nes6502_getcycles_sofar;
@@ -243,13 +278,28 @@ void del_all_cpus()
 	{
 		tmp = cur;
 		cur = cur->next_cpu;
+		delete [] tmp->mem_pages;
 		delete tmp;	// de-allocate
 	}
 	g_head = NULL;
 	g_cpu_count = 0;
+	g_mem_pages = g_mem_pages_unmapped;
 
 }
 
+// recalculates all expensive calculations for one cpu
+// (cpu_change_nmi and cpu_change_irq only recalculate their own cpu so that they don't touch cpus that may be running on another thread)
+static void cpu_recalc_one(struct cpudef *cpu)
+{
+	cpu->uCyclesPerInterleave = cpu->hz / g_uInterleavePerMs / 1000;
+	cpu->uNMIMicroPeriod = (unsigned int) ((cpu->nmi_period * 1000) + 0.5);	// convert to int for faster math on gp2x
+
+	for (int i = 0; i < MAX_IRQS; i++)
+	{
+		cpu->uIRQMicroPeriod[i] = (unsigned int) ((cpu->irq_period[i] * 1000) + 0.5);	// convert to int for faster math on gp2x
+	}
+}
+
 // recalculations all expensive calculations
 // (put in one place to make maintenance easier)
 void cpu_recalc()
@@ -259,14 +309,7 @@ void cpu_recalc()
 	// re-calculate all cycles per interleave for the new interleave value
 	while (cpu)
 	{
-		cpu->uCyclesPerInterleave = cpu->hz / g_uInterleavePerMs / 1000;
-		cpu->uNMIMicroPeriod = (unsigned int) ((cpu->nmi_period * 1000) + 0.5);	// convert to int for faster math on gp2x
-	
-		for (int i = 0; i < MAX_IRQS; i++)
-		{
-			cpu->uIRQMicroPeriod[i] = (unsigned int) ((cpu->irq_period[i] * 1000) + 0.5);	// convert to int for faster math on gp2x
-		}
-
+		cpu_recalc_one(cpu);
 		cpu = cpu->next_cpu;
 	}
 }
@@ -279,11 +322,10 @@ void cpu_init()
 	while (cur)
 	{
 		g_active_cpu = cur->id;
-#ifdef CPU_DIAG
-		cd_old_time[g_active_cpu] = refresh_ms_time();
-#endif
+		memmap_select(cur);
 
 		cpu_recalc();
+		cpu_profile_reset(&cur->profile);
 
 		cur->pending_nmi_count = 0;
 		for (int i = 0; i < MAX_IRQS; i++)
@@ -291,9 +333,9 @@ void cpu_init()
 			cur->pending_irq_count[i] = 0;
 		}
 		cur->total_cycles_executed = 0;
-		cur->uEventCyclesEnd = 0;
-		cur->uEventCyclesExecuted = 0;
-		cur->event_callback = NULL;
+		cur->bExecuting = false;
+		cur->uEventCount = 0;
+		cur->uEventSeq = 0;
 
 		// if the cpu core has not been initialized yet, then do so .. it should only be done once per cpu core
 		if (!g_cpu_initialized[cur->type])
@@ -301,13 +343,6 @@ void cpu_init()
 			(cur->init_callback)();	// initialize the cpu
 			g_cpu_initialized[cur->type] = true;
 		}
-		(cur->setmemory_callback)(cur->mem);	// set where the memory is located
-		
-		// if we have a set PC callback defined
-		if (cur->setpc_callback != NULL)
-		{
-			(cur->setpc_callback)(cur->initial_pc);	// set the initial program counter for the cpu
-		}
 
 		// if we are required to copy the cpu context, then get the info now
 		if (cur->must_copy_context)
@@ -320,6 +355,26 @@ void cpu_init()
 				fprintf(stderr, "FATAL ERROR : Increase MAX_CONTEXT_SIZE to at least %u and recompile\n", context_size);
 				set_quitflag();
 			}
+
+			// if the core can work on our copy directly, then it never has to be copied again
+			else if (cur->setinstance_callback)
+			{
+				(cur->setinstance_callback)(cur->context);
+			}
+		}
+
+		(cur->setmemory_callback)(cur->mem);	// set where the memory is located
+		
+		// if we have a set PC callback defined
+		if (cur->setpc_callback != NULL)
+		{
+			(cur->setpc_callback)(cur->initial_pc);	// set the initial program counter for the cpu
+		}
+
+		// if the core is working on someone else's copy of the context, then get the info now
+		if (cur->must_copy_context && !cur->setinstance_callback)
+		{
+			(cur->getcontext_callback)(cur->context);
 		}
 		
 		cur = cur->next_cpu;	// advance to the next cpu
@@ -344,6 +399,13 @@ void cpu_shutdown()
 	while (cur)
 	{
 		g_active_cpu = cur->id;
+
+		// the cpu's context is about to be freed, so the core mustn't be left working on it
+		if (cur->must_copy_context && cur->setinstance_callback && g_cpu_initialized[cur->type])
+		{
+			(cur->setinstance_callback)(NULL);
+		}
+
 		// if we have a shutdown callback defined
 		if (cur->shutdown_callback)
 		{
@@ -362,315 +424,740 @@ void cpu_shutdown()
 
 
 
-// executes all cpu cores "simultaneously".  this function only returns when the game exits
-void cpu_execute()
+// calls the cpu core's execute callback and keeps the profiler up to date
+static inline Uint32 cpu_execute_cycles(struct cpudef *cpu, Uint32 uCycles)
 {
-	int i = 0;
-	Uint32 last_inputcheck = 0; //time we last polled for input events
-	struct cpudef *cpu = g_head;
+	cpu->bExecuting = true;
+	Uint32 uElapsed = (cpu->execute_callback)(uCycles);
+	cpu->bExecuting = false;
 
-	// flush the cpu timers one time so we don't begin with the cpu's running too quickly
-	g_expected_elapsed_ms = 0;
-	g_cpu_timer = refresh_ms_time();	// so the cpu doesn't run too quickly when we first start
+	cpu->profile.u64CyclesRequested += uCycles;
+	cpu->profile.u64CyclesExecuted += uElapsed;
+	++cpu->profile.uExecuteCalls;
 
-	// clear each cpu
-	while (cpu)
+	// cpu cores are allowed to execute more cycles than we ask for (they can't stop in the middle of an instruction)
+	if (uElapsed > uCycles)
 	{
-		for (int i = 0; i < MAX_IRQS; i++)
+		cpu->profile.u64CyclesOvershoot += (uElapsed - uCycles);
+	}
+
+	return uElapsed;
+}
+
+// returns how many cycles 'cpu' has executed, including the execute call that it's in the middle of (if any)
+static Uint64 cpu_current_cycles(struct cpudef *cpu)
+{
+	Uint64 u64Result = cpu->total_cycles_executed;
+
+	// cores only reset their elapsed cycle count when they start executing, so it's stale in between execute calls
+	if (cpu->bExecuting)
+	{
+		u64Result += (cpu->elapsedcycles_callback)();
+	}
+
+	return u64Result;
+}
+
+// records how long an NMI or IRQ was pending before the game driver got it
+static inline void cpu_profile_latency(unsigned int uPendingSinceMs, unsigned int &uTotalMs, unsigned int &uMaxMs)
+{
+	unsigned int uLatency = g_expected_elapsed_ms - uPendingSinceMs;
+	uTotalMs += uLatency;
+	if (uLatency > uMaxMs)
+	{
+		uMaxMs = uLatency;
+	}
+}
+
+// EVENT QUEUE
+// Each cpu keeps its pending events (including the ticks of its NMI/IRQ timers) in a small min-heap sorted by the
+//  cycle they fire on, so that the cpu can be run straight up to its next event instead of checking every ms.
+
+// returns true if event 'a' has to fire before event 'b'
+static inline bool cpu_event_before(const struct cpu_event *a, const struct cpu_event *b)
+{
+	if (a->u64Cycle != b->u64Cycle)
+	{
+		return (a->u64Cycle < b->u64Cycle);
+	}
+
+	// events on the same cycle fire in the order they were set (the subtraction takes care of uSeq wrapping around)
+	return (((Sint32) (a->uSeq - b->uSeq)) < 0);
+}
+
+static void cpu_event_sift_up(struct cpudef *cpu, unsigned int uIdx)
+{
+	while (uIdx > 0)
+	{
+		unsigned int uParent = (uIdx - 1) >> 1;
+		if (!cpu_event_before(&cpu->events[uIdx], &cpu->events[uParent]))
 		{
-			cpu->uIRQTickCount[i] = 0;
-			cpu->uIRQTickBoundaryMs[i] = cpu->uIRQMicroPeriod[i] / 1000;	// when the 1st IRQ will tick
-		//	cpu->irq_cycle_count[i] = 0;
+			break;
 		}
-		cpu->uNMITickCount = 0;
-		cpu->uNMITickBoundaryMs = cpu->uNMIMicroPeriod / 1000;	// when the 1st NMI will tick
-		//cpu->nmi_cycle_count = 0;
-		cpu->total_cycles_executed = 0;		
-		cpu = cpu->next_cpu;
+		struct cpu_event tmp = cpu->events[uIdx];
+		cpu->events[uIdx] = cpu->events[uParent];
+		cpu->events[uParent] = tmp;
+		uIdx = uParent;
 	}
-	// end flushing the cpu timers
+}
 
-	// loop until the quit flag is set which means the user wants to quit the program
-	while (!get_quitflag())
+static void cpu_event_sift_down(struct cpudef *cpu, unsigned int uIdx)
+{
+	for (;;)
 	{
-		unsigned int actual_elapsed_ms = 0;
-		bool nmi_asserted = false;
-		Uint32 elapsed_cycles = 0;
-		Uint32 cycles_to_execute = 0;	// how many cycles to execute this time around
+		unsigned int uChild = (uIdx << 1) + 1;
+		if (uChild >= cpu->uEventCount)
+		{
+			break;
+		}
 
-		// we want to execute enough cycles to reach our expectation for # of elapsed ms
-		g_expected_elapsed_ms++;
+		// pick whichever child fires first
+		if (((uChild + 1) < cpu->uEventCount) && cpu_event_before(&cpu->events[uChild + 1], &cpu->events[uChild]))
+		{
+			uChild++;
+		}
 
-		// run all cpu's for 1 ms's worth of cycles, interleaving them according to
-		//  the value of g_uInterlavePerMs.
-		for (unsigned int uInterleaveCount = 1; uInterleaveCount <= g_uInterleavePerMs; uInterleaveCount++)
+		if (!cpu_event_before(&cpu->events[uChild], &cpu->events[uIdx]))
 		{
-			cpu = g_head;
-			// go through each cpu and execute 1 ms worth of cycles
-			while (cpu)
-			{
-				// if we are required to copy the cpu context, then set the context for the current cpu
-				if (cpu->must_copy_context)
-				{
-					(cpu->setcontext_callback)(cpu->context);	// restore registers
-					(cpu->setmemory_callback)(cpu->mem);	// restore memory we're working with
-				}
-				g_active_cpu = cpu->id;
+			break;
+		}
+		struct cpu_event tmp = cpu->events[uIdx];
+		cpu->events[uIdx] = cpu->events[uChild];
+		cpu->events[uChild] = tmp;
+		uIdx = uChild;
+	}
+}
 
-				nmi_asserted = false;
+// adds an event that fires when 'cpu' reaches 'u64Cycle'
+static void cpu_event_insert(struct cpudef *cpu, Uint64 u64Cycle, void (*callback)(void *data), void *data)
+{
+	// make programmer fix this problem :)
+	if (cpu->uEventCount >= MAX_CPU_EVENTS)
+	{
+		printline("cpu.cpp : too many cpu events are pending, increase MAX_CPU_EVENTS and recompile");
+		set_quitflag();
+		return;
+	}
 
-				// NOTE: if g_uInterleavePerMs is 1, then this calculation is the same as
-				//  (g_expected_elapsed_ms * cpu->hz) / 1000
-				Uint64 u64ExpectedCycles = (( ((Uint64) (g_expected_elapsed_ms - 1)) * cpu->hz) / 1000) +
-					(cpu->uCyclesPerInterleave * uInterleaveCount);
+	struct cpu_event *event = &cpu->events[cpu->uEventCount];
+	event->u64Cycle = u64Cycle;
+	event->uSeq = cpu->uEventSeq++;
+	event->callback = callback;
+	event->data = data;
+	cpu->uEventCount++;
+	cpu_event_sift_up(cpu, cpu->uEventCount - 1);
+}
 
-				if (u64ExpectedCycles > cpu->total_cycles_executed)
-				{
+// removes every pending event that calls 'callback' (and, if bMatchData is true, that passes it 'data')
+static void cpu_event_remove(struct cpudef *cpu, void (*callback)(void *data), bool bMatchData, void *data)
+{
+	bool bRemoved = false;
+	unsigned int u = 0;
+
+	while (u < cpu->uEventCount)
+	{
+		if ((cpu->events[u].callback == callback) && (!bMatchData || (cpu->events[u].data == data)))
+		{
+			cpu->events[u] = cpu->events[--cpu->uEventCount];
+			bRemoved = true;
+		}
+		else
+		{
+			u++;
+		}
+	}
+
+	// the heap is tiny, so it's simplest to just rebuild it
+	if (bRemoved)
+	{
+		for (u = cpu->uEventCount >> 1; u-- > 0; )
+		{
+			cpu_event_sift_down(cpu, u);
+		}
+	}
+}
+
+// removes the event that fires first
+static void cpu_event_pop(struct cpudef *cpu)
+{
+	cpu->events[0] = cpu->events[--cpu->uEventCount];
+	cpu_event_sift_down(cpu, 0);
+}
+
+static void cpu_nmi_timer_event(void *unused);
+static void cpu_irq_timer_event(void *which_irq);
+
+// schedules the next tick of the NMI timer (if the NMI timer is on)
+// (every tick is computed from when the timer was started so that rounding errors don't add up)
+static void cpu_schedule_nmi_tick(struct cpudef *cpu)
+{
+	if (cpu->uNMIMicroPeriod)
+	{
+		Uint64 u64Cycle = cpu->u64NMITimerStart +
+			((((Uint64) (cpu->uNMITickCount + 1)) * cpu->uNMIMicroPeriod * cpu->hz) / 1000000);
+		cpu_event_insert(cpu, u64Cycle, cpu_nmi_timer_event, NULL);
+	}
+}
+
+// same as cpu_schedule_nmi_tick
+static void cpu_schedule_irq_tick(struct cpudef *cpu, unsigned int which_irq)
+{
+	if (cpu->uIRQMicroPeriod[which_irq])
+	{
+		Uint64 u64Cycle = cpu->u64IRQTimerStart[which_irq] +
+			((((Uint64) (cpu->uIRQTickCount[which_irq] + 1)) * cpu->uIRQMicroPeriod[which_irq] * cpu->hz) / 1000000);
+		cpu_event_insert(cpu, u64Cycle, cpu_irq_timer_event, (void *) (size_t) which_irq);
+	}
+}
+
+// (re)starts the NMI timer so that it first ticks one period after 'u64StartCycle'
+static void cpu_start_nmi_timer(struct cpudef *cpu, Uint64 u64StartCycle)
+{
+	cpu_event_remove(cpu, cpu_nmi_timer_event, false, NULL);
+	cpu->uNMITickCount = 0;
+	cpu->u64NMITimerStart = u64StartCycle;
+	cpu_schedule_nmi_tick(cpu);
+}
+
+// same as cpu_start_nmi_timer
+static void cpu_start_irq_timer(struct cpudef *cpu, unsigned int which_irq, Uint64 u64StartCycle)
+{
+	cpu_event_remove(cpu, cpu_irq_timer_event, true, (void *) (size_t) which_irq);
+	cpu->uIRQTickCount[which_irq] = 0;
+	cpu->u64IRQTimerStart[which_irq] = u64StartCycle;
+	cpu_schedule_irq_tick(cpu, which_irq);
+}
+
+// the NMI timer has ticked (events only fire for the active cpu)
+static void cpu_nmi_timer_event(void *unused)
+{
+	struct cpudef *cpu = get_cpu_struct(g_active_cpu);
+
+	// if this is the only pending NMI, then its latency is measured from now
+	if (cpu->pending_nmi_count == 0)
+	{
+		cpu->profile.uNMIPendingSinceMs = g_expected_elapsed_ms;
+	}
+	++cpu->pending_nmi_count;
+	++cpu->uNMITickCount;
+	cpu_schedule_nmi_tick(cpu);
+}
+
+// same as cpu_nmi_timer_event
+static void cpu_irq_timer_event(void *which_irq)
+{
+	struct cpudef *cpu = get_cpu_struct(g_active_cpu);
+	unsigned int i = (unsigned int) (size_t) which_irq;
+
+	if (cpu->pending_irq_count[i] == 0)
+	{
+		cpu->profile.uIRQPendingSinceMs[i] = g_expected_elapsed_ms;
+	}
+	++cpu->pending_irq_count[i];
+	++cpu->uIRQTickCount[i];
+	cpu_schedule_irq_tick(cpu, i);
+}
+
+// gives the game driver any NMI or IRQ that is pending for 'cpu' (which must be the active cpu)
+static void cpu_check_interrupts(struct cpudef *cpu)
+{
+	bool nmi_asserted = false;
+
+	// if we have an NMI waiting
+	// (this can be created either by a timer, or by calling cpu_generate_nmi)
+	if (cpu->pending_nmi_count != 0)
+	{
+		cpu_profile_latency(cpu->profile.uNMIPendingSinceMs, cpu->profile.uNMILatencyTotalMs, cpu->profile.uNMILatencyMaxMs);
+		++cpu->profile.uNMICount;
+		cpu->profile.uNMIPendingSinceMs = g_expected_elapsed_ms;	// in case more NMI's are queued up
+
+		g_game->do_nmi();
+		nmi_asserted = true;
+		--cpu->pending_nmi_count;
+	}
+
+	// go through each IRQ
+	for (int i = 0; i < MAX_IRQS; i++)
+	{
+		// if we have an IRQ waiting
+		// (this can be created either by a timer or by calling cpu_generate_irq)
+		if (cpu->pending_irq_count[i] != 0)
+		{
+			// we don't want to do IRQ's and NMI's at the same time
+			if (!nmi_asserted)
+			{
+				cpu_profile_latency(cpu->profile.uIRQPendingSinceMs[i], cpu->profile.uIRQLatencyTotalMs[i],
+					cpu->profile.uIRQLatencyMaxMs[i]);
+				++cpu->profile.uIRQCount[i];
+				cpu->profile.uIRQPendingSinceMs[i] = g_expected_elapsed_ms;	// in case more IRQ's are queued up
+
+				g_game->do_irq(i);
 #ifdef DEBUG
-					// make sure this will fit in a 32-bit number
-					assert((u64ExpectedCycles - cpu->total_cycles_executed) < (unsigned int) (1 << 31));
+				assert(cpu->pending_irq_count[i] > 0);
 #endif
-					// calculate # of cycles to execute
-					cycles_to_execute = (Uint32) (u64ExpectedCycles - cpu->total_cycles_executed);
-
-					// if we have no upcoming event
-					if (cpu->uEventCyclesEnd == 0)
-					{
-						// get us up to our expected elapsed MS
-						elapsed_cycles = (cpu->execute_callback)((Uint32) cycles_to_execute);
-
-						cpu->total_cycles_executed += elapsed_cycles;	// always track how many cycles have elapsed
-					}
-					// else we have an active event going on, check to see if we need to execute less cycles in order to fire event
-					else
-					{
-						// loop while we have the possibility of an event looming near in our future
-						while (cpu->uEventCyclesEnd != 0)
-						{
-							unsigned int uCyclesTilEvent = 0;
-	
-							// if we haven't yet reached our event
-							if (cpu->uEventCyclesEnd > cpu->uEventCyclesExecuted)
-							{
-								uCyclesTilEvent = cpu->uEventCyclesEnd - cpu->uEventCyclesExecuted;
-							}
-							// else we overshot our event so just leave uCyclesTilEvent at 0
-							// (this can happen because the cpu emulator can execute more cycles than we request)
-	
-							// if we need to execute less cycles than we planned in order to do our event
-							if (cycles_to_execute > uCyclesTilEvent)
-							{
-								elapsed_cycles = (cpu->execute_callback)(uCyclesTilEvent);
-								cpu->total_cycles_executed += elapsed_cycles;	// always track how many cycles have elapsed
-	
-#ifdef CPU_DIAG
-								cd_cycle_count[g_active_cpu] += elapsed_cycles;
-#endif // CPU_DIAG
-	
+				--cpu->pending_irq_count[i];
+				break;	// break out of for loop because we only want to assert 1 IRQ per loop
+			}
 #ifdef DEBUG
-								assert(cycles_to_execute >= uCyclesTilEvent);
-#endif // DEBUG
-								cycles_to_execute -= uCyclesTilEvent;	// NOTE : we can't subtract elapsed_cycles because it may be greater than cycles_to_execute
-								cpu->uEventCyclesEnd = 0;	// event has been fired, we're done ...
-	
-								// This callback should be called after uEventcycles is set to 0 because the callback may immediately
-								//  setup another event.
-								(cpu->event_callback)(cpu->event_data);	// call event callback
-							}
-							// else the event isn't in our near future, so proceed as normal
-							else
-							{
-								break;
-							}
-						}
-
-						// get us up to our expected elapsed MS
-						elapsed_cycles = (cpu->execute_callback)((Uint32) cycles_to_execute);
-
-						cpu->total_cycles_executed += elapsed_cycles;	// always track how many cycles have elapsed
-						cpu->uEventCyclesExecuted += elapsed_cycles;
-					}
-				}
-				// else if we executed too many cycles last time, then we have to just kill time
-				else
-				{
-					elapsed_cycles = 0;
-				}
-
-#ifdef CPU_DIAG
-				cd_cycle_count[g_active_cpu] += elapsed_cycles;
-				cd_avg_mhz[g_active_cpu] = (cpu->total_cycles_executed * 0.001) / elapsed_ms_time(g_cpu_timer);
+			// make sure NMI's aren't smothering IRQ's
+			else if (cpu->pending_irq_count[i] > 5)
+			{
+				printline("cpu.cpp WARNING : IRQ's are piling up and not having a chance to get used");
+			}
+			// else nothing ...
 #endif
+		}
+	} // end for loop
+}
 
-				// NOW WE CHECK TO SEE IF IT'S TIME TO DO AN NMI
+// fires every event that 'cpu' (which must be the active cpu) has reached
+static void cpu_run_events(struct cpudef *cpu)
+{
+	bool bFired = false;
 
-				// if NMI's are enabled
-				if (cpu->uNMIMicroPeriod)
-				{
-					if (g_expected_elapsed_ms > cpu->uNMITickBoundaryMs)
-					{
-						++cpu->pending_nmi_count;
-						++cpu->uNMITickCount;
-						cpu->uNMITickBoundaryMs = (Uint32) (( ((Uint64) (cpu->uNMITickCount + 1)) * cpu->uNMIMicroPeriod) / 1000);
-#ifdef CPU_DIAG
-						++cd_nmi_count[cpu->id];
-#endif
-					}
-				}
+	while ((cpu->uEventCount != 0) && (cpu->events[0].u64Cycle <= cpu->total_cycles_executed))
+	{
+		struct cpu_event event = cpu->events[0];
 
-				// if we have an NMI waiting
-				// (this can be created either by a timer, or by calling cpu_generate_nmi)
-				if (cpu->pending_nmi_count != 0)
-				{
-					g_game->do_nmi();
-					nmi_asserted = true;
-					--cpu->pending_nmi_count;
-				}
+		// The event has to be removed before its callback is called because the callback may immediately
+		//  set up another event.
+		cpu_event_pop(cpu);
 
-				// NOW WE CHECK TO SEE IF IT'S TIME TO DO AN IRQ
+		// timer ticks aren't counted as event callbacks since they have their own statistics
+		if ((event.callback != cpu_nmi_timer_event) && (event.callback != cpu_irq_timer_event))
+		{
+			++cpu->profile.uEventCallbacks;
+		}
+		(event.callback)(event.data);
+		bFired = true;
+	}
 
-				// go through each IRQ
-				for (i = 0; i < MAX_IRQS; i++)
-				{
-					// if IRQ exists
-					if (cpu->uIRQMicroPeriod[i])
-					{
-						// if it's time to do an IRQ
-						if (g_expected_elapsed_ms > cpu->uIRQTickBoundaryMs[i])
-						{
-							++cpu->pending_irq_count[i];
-							++cpu->uIRQTickCount[i];
-							cpu->uIRQTickBoundaryMs[i] = (Uint32) (( ((Uint64) (cpu->uIRQTickCount[i] + 1)) *
-								cpu->uIRQMicroPeriod[i]) / 1000);
-#ifdef CPU_DIAG
-							++cd_irq_count[cpu->id][i];
-#endif
-						}
-					} // end if there is an IRQ timer
-
-					// if we have an IRQ waiting
-					// (this can be created either by a timer or by calling cpu_generate_irq)
-					if (cpu->pending_irq_count[i] != 0)
-					{
-						// we don't want to do IRQ's and NMI's at the same time
-						if (!nmi_asserted)
-						{
-							g_game->do_irq(i);
+	// a timer tick is supposed to reach the game on the cycle it happened on, not at the end of the slice
+	if (bFired)
+	{
+		cpu_check_interrupts(cpu);
+	}
+}
+
+// gives the core the context of a cpu that must_copy_context
+static inline void cpu_select_context(struct cpudef *cpu)
+{
+	// if the core can work on the cpu's context where it is, then pointing the core at it is all it takes
+	if (cpu->setinstance_callback)
+	{
+		(cpu->setinstance_callback)(cpu->context);
+	}
+	else
+	{
+		(cpu->setcontext_callback)(cpu->context);	// restore registers
+		(cpu->setmemory_callback)(cpu->mem);	// restore memory we're working with
+	}
+}
+
+// executes one interleave slice (1/g_uInterleavePerMs of a ms) for one cpu, then gives it any NMI/IRQ that is due
+static void cpu_execute_slice(struct cpudef *cpu, unsigned int uInterleaveCount)
+{
+	// if we are required to copy the cpu context, then set the context for the current cpu
+	if (cpu->must_copy_context)
+	{
+		cpu_select_context(cpu);
+	}
+	g_active_cpu = cpu->id;
+	memmap_select(cpu);
+
+	// NOTE: if g_uInterleavePerMs is 1, then this calculation is the same as
+	//  (g_expected_elapsed_ms * cpu->hz) / 1000
+	Uint64 u64ExpectedCycles = (( ((Uint64) (g_expected_elapsed_ms - 1)) * cpu->hz) / 1000) +
+		(cpu->uCyclesPerInterleave * uInterleaveCount);
+
+	// run the cpu straight up to each event that comes due during this slice
+	// (if we executed too many cycles last time, then we just kill time)
+	while (u64ExpectedCycles > cpu->total_cycles_executed)
+	{
+		Uint64 u64StopCycle = u64ExpectedCycles;
+
+		if ((cpu->uEventCount != 0) && (cpu->events[0].u64Cycle < u64StopCycle))
+		{
+			u64StopCycle = cpu->events[0].u64Cycle;
+		}
+
+		if (u64StopCycle > cpu->total_cycles_executed)
+		{
 #ifdef DEBUG
-							assert(cpu->pending_irq_count[i] > 0);
+			// make sure this will fit in a 32-bit number
+			assert((u64StopCycle - cpu->total_cycles_executed) < (unsigned int) (1 << 31));
 #endif
-							--cpu->pending_irq_count[i];
-							break;	// break out of for loop because we only want to assert 1 IRQ per loop
-						}
-#ifdef DEBUG
-						// make sure NMI's aren't smothering IRQ's
-						else if (cpu->pending_irq_count[i] > 5)
-						{
-							printline("cpu.cpp WARNING : IRQ's are piling up and not having a chance to get used");
-						}
-						// else nothing ...
+			cpu->total_cycles_executed += cpu_execute_cycles(cpu, (Uint32) (u64StopCycle - cpu->total_cycles_executed));
+		}
+
+		cpu_run_events(cpu);
+	}
+
+	// events can still be due if the cpu overshot, and cpu_generate_nmi/cpu_generate_irq may have been called
+	cpu_run_events(cpu);
+	cpu_check_interrupts(cpu);
+
+	// if we are required to copy the cpu context, then preserve the context for the next time around
+	if (cpu->must_copy_context && !cpu->setinstance_callback)
+	{
+		(cpu->getcontext_callback)(cpu->context);	// preserve registers
+	}
+}
+
+// runs one interleave slice for every cpu in thread group 'uGroup' (in the order that they were added)
+static void cpu_execute_group(unsigned int uGroup, unsigned int uInterleaveCount)
+{
+	for (struct cpudef *cpu = g_head; cpu; cpu = cpu->next_cpu)
+	{
+		if (cpu->uThreadGroup == uGroup)
+		{
+			cpu_execute_slice(cpu, uInterleaveCount);
+		}
+	}
+}
+
+// worker thread for one thread group (groups 1 and up, group 0 always runs on the main thread)
+static int cpu_thread_proc(void *pGroup)
+{
+	g_uCPUThreadGroup = (unsigned int) (size_t) pGroup;
+
+	for (;;)
+	{
+		// wait for cpu_execute_slice_threaded to tell us to go
+		SDL_SemWait(g_cpu_thread_start[g_uCPUThreadGroup]);
+
+		if (g_bCPUThreadsQuit)
+		{
+			break;
+		}
+
+		cpu_execute_group(g_uCPUThreadGroup, g_uCPUThreadInterleave);
+		SDL_SemPost(g_cpu_thread_done);
+	}
+
+	return 0;
+}
+
+// runs one interleave slice with every thread group running on its own thread
+static void cpu_execute_slice_threaded(unsigned int uInterleaveCount)
+{
+	unsigned int uGroup = 0;
+
+	g_uCPUThreadInterleave = uInterleaveCount;
+	g_bCPUThreadsParallel = true;
+
+	for (uGroup = 1; uGroup < g_uCPUThreadGroups; uGroup++)
+	{
+		SDL_SemPost(g_cpu_thread_start[uGroup]);
+	}
+
+	// the main thread takes care of group 0 while it's waiting
+	cpu_execute_group(0, uInterleaveCount);
+
+	// the barrier: no group may start the next slice until every group has finished this one
+	for (uGroup = 1; uGroup < g_uCPUThreadGroups; uGroup++)
+	{
+		SDL_SemWait(g_cpu_thread_done);
+	}
+
+	g_bCPUThreadsParallel = false;
+
+	// Now that nothing else is running, we can let the groups talk to each other.
+	// The sync points are run in group order (instead of in the order they happened) so that the result
+	//  doesn't depend on which thread got there first.
+	for (uGroup = 0; uGroup < g_uCPUThreadGroups; uGroup++)
+	{
+		vector<struct cpu_sync> &syncs = g_cpu_sync_queue[uGroup];
+
+		if (!syncs.empty())
+		{
+			for (vector<struct cpu_sync>::iterator it = syncs.begin(); it != syncs.end(); it++)
+			{
+				(it->callback)(it->obj, it->uValue);
+			}
+			syncs.clear();
+
+			// the groups are talking to each other, so run the rest of this ms serially so that they don't have to
+			//  wait a whole slice for each reply
+			g_bCPUSerialUntilMsEnd = true;
+		}
+	}
+}
+
+// starts a worker thread for each thread group that the game driver has set up (if there is more than one)
+static void cpu_threads_start()
+{
+	int iGroupOfType[CPU_COUNT];	// which thread group each cpu core is used by (-1 if it isn't used yet)
+	unsigned int uGroups = 0;
+	unsigned int uGroup = 0;
+
+	g_uCPUThreadGroups = 1;
+	g_bCPUSerialUntilMsEnd = false;
+
+	for (int i = 0; i < CPU_COUNT; i++)
+	{
+		iGroupOfType[i] = -1;
+	}
+
+	for (struct cpudef *cpu = g_head; cpu; cpu = cpu->next_cpu)
+	{
+		if (cpu->uThreadGroup >= MAX_CPU_THREAD_GROUPS)
+		{
+			printline("cpu.cpp : cpu thread group is out of range, running every cpu on one thread");
+			return;
+		}
+
+		// each cpu core keeps its registers in global variables, so every cpu that uses the same core
+		//  has to be in the same group
+		if ((iGroupOfType[cpu->type] != -1) && (iGroupOfType[cpu->type] != (int) cpu->uThreadGroup))
+		{
+			printline("cpu.cpp : cpus of the same type are in different thread groups, running every cpu on one thread");
+			return;
+		}
+		iGroupOfType[cpu->type] = cpu->uThreadGroup;
+
+		if (cpu->uThreadGroup >= uGroups)
+		{
+			uGroups = cpu->uThreadGroup + 1;
+		}
+	}
+
+	// if the game driver hasn't split its cpus up, then there is nothing to do
+	if (uGroups < 2)
+	{
+		return;
+	}
+
+	if (!g_bCPUThreadsAllowed)
+	{
+		printline("CPU threads have been disabled, running every cpu on one thread");
+		return;
+	}
+
+#ifdef CPU_DEBUG
+	// the debugger stops the cpu that hit a breakpoint, which it can't do if the other cpus are on other threads
+	printline("CPU threads aren't supported by the cpu debugger, running every cpu on one thread");
+	return;
 #endif
-					}
-				} // end for loop
-				// END CHECK FOR IRQ
 
-				// this chunk of code tests to make sure the CPU is running
-				// at the proper speed.  It should be undef'd unless we are debugging cpu stuff
+	g_bCPUThreadsQuit = false;
+	g_cpu_thread_done = SDL_CreateSemaphore(0);
 
-#ifdef CPU_DIAG
-				char s[160] = { 0 };
+	for (uGroup = 1; uGroup < uGroups; uGroup++)
+	{
+		g_cpu_thread_start[uGroup] = SDL_CreateSemaphore(0);
+		g_cpu_threads[uGroup] = SDL_CreateThread(cpu_thread_proc, (void *) (size_t) uGroup);
 
-#define CPU_DIAG_ACCURACY 24000000
-				// the bigger the #, the more accurate the result
+		if (!g_cpu_threads[uGroup])
+		{
+			printline("cpu.cpp : could not create cpu thread, running every cpu on one thread");
+			cpu_threads_stop();
+			return;
+		}
+	}
 
-				// if it's time to print some statistics
-				if (cd_cycle_count[g_active_cpu] >= CPU_DIAG_ACCURACY)
-				{
-					Uint32 elapsed_ms = elapsed_ms_time(cd_old_time[g_active_cpu]);
-					double cur_mhz = ((double) cd_cycle_count[g_active_cpu] / (double) elapsed_ms) * 0.001;
-					cd_report_count[g_active_cpu]++;
-
-					sprintf(s,"CPU #%d : cycles = %d, time = %d ms, MHz = %f, avg MHz = %f",
-						g_active_cpu,
-						cd_cycle_count[g_active_cpu], elapsed_ms,
-						cur_mhz, cd_avg_mhz[g_active_cpu]);
-					printline(s);
-					sprintf(s, "         NMI's = %d ", cd_nmi_count[g_active_cpu]);
-					cd_nmi_count[g_active_cpu] = 0;
-					outstr(s);
-					for (int irqi = 0; irqi < MAX_IRQS; irqi++)
-					{
-						sprintf(s, "IRQ%d's = %d ", irqi, cd_irq_count[g_active_cpu][irqi]);
-						outstr(s);
-						cd_irq_count[g_active_cpu][irqi] = 0;
-					}
-					newline();
-					cd_old_time[g_active_cpu] += elapsed_ms;
-					cd_cycle_count[g_active_cpu] -= CPU_DIAG_ACCURACY;
-					
-					sprintf(s, "Resource Usage: %u percent", 100 - ((cd_extra_ms * 100) / elapsed_ms));
-					printline(s);
-					cd_extra_ms = 0;	// reset
-				}
+	g_uCPUThreadGroups = uGroups;
+	string msg = "Running cpus on " + numstr::ToStr(uGroups) + " threads";
+	printline(msg.c_str());
+}
+
+// stops the worker threads started by cpu_threads_start
+static void cpu_threads_stop()
+{
+	g_bCPUThreadsQuit = true;
+
+	for (unsigned int uGroup = 1; uGroup < MAX_CPU_THREAD_GROUPS; uGroup++)
+	{
+		if (g_cpu_threads[uGroup])
+		{
+			SDL_SemPost(g_cpu_thread_start[uGroup]);
+			SDL_WaitThread(g_cpu_threads[uGroup], NULL);
+			g_cpu_threads[uGroup] = NULL;
+		}
+		if (g_cpu_thread_start[uGroup])
+		{
+			SDL_DestroySemaphore(g_cpu_thread_start[uGroup]);
+			g_cpu_thread_start[uGroup] = NULL;
+		}
+	}
+
+	if (g_cpu_thread_done)
+	{
+		SDL_DestroySemaphore(g_cpu_thread_done);
+		g_cpu_thread_done = NULL;
+	}
+
+	g_uCPUThreadGroups = 1;
+}
+
+void cpu_set_threads_allowed(bool bAllowed)
+{
+	g_bCPUThreadsAllowed = bAllowed;
+}
+
+void cpu_set_idle_skip(bool bEnabled)
+{
+#ifdef USE_M80
+	m80_set_idle_skip(bEnabled);
 #endif
+}
+
+void cpu_idle_skipped(Uint32 uCycles)
+{
+	get_cpu_struct(g_active_cpu)->profile.u64CyclesIdleSkipped += uCycles;
+}
 
+void cpu_sync_point(void (*callback)(void *obj, unsigned int uValue), void *obj, unsigned int uValue)
+{
+	// if the thread groups are running in parallel, this has to wait until they have all stopped
+	if (g_bCPUThreadsParallel)
+	{
+		struct cpu_sync sync = { callback, obj, uValue };
+		g_cpu_sync_queue[g_uCPUThreadGroup].push_back(sync);
+	}
+	// otherwise nothing else is running so it can be done right away
+	else
+	{
+		(callback)(obj, uValue);
+	}
+}
 
+void cpu_execute_ms()
+{
+	struct cpudef *cpu = NULL;
 
+	// we want to execute enough cycles to reach our expectation for # of elapsed ms
+	g_expected_elapsed_ms++;
 
-				// if we are required to copy the cpu context, then preserve the context for the next time around
-				if (cpu->must_copy_context)
-				{
-					(cpu->getcontext_callback)(cpu->context);	// preserve registers
-				}
+	// run all cpu's for 1 ms's worth of cycles, interleaving them according to
+	//  the value of g_uInterlavePerMs.
+	for (unsigned int uInterleaveCount = 1; uInterleaveCount <= g_uInterleavePerMs; uInterleaveCount++)
+	{
+		// if the cpus are split up into thread groups and no group has touched another one during this ms
+		if ((g_uCPUThreadGroups > 1) && (!g_bCPUSerialUntilMsEnd))
+		{
+			cpu_execute_slice_threaded(uInterleaveCount);
+			continue;
+		}
 
-				cpu = cpu->next_cpu; // go to the next cpu
+		cpu = g_head;
+		// go through each cpu and execute 1 ms worth of cycles
+		while (cpu)
+		{
+			cpu_execute_slice(cpu, uInterleaveCount);
+			cpu = cpu->next_cpu; // go to the next cpu
+		} // end while looping through each cpu
+	} // end for loop
+
+	// the thread groups get another chance to run in parallel next ms
+	g_bCPUSerialUntilMsEnd = false;
+
+	// 1 ms has elapsed, so notify the LDP to keep it in sync (we must do this after every ms)
+	g_ldp->pre_think();
+}
+
+// executes all cpu cores "simultaneously".  this function only returns when the game exits
+void cpu_execute()
+{
+	Uint32 last_inputcheck = 0; //time we last polled for input events
+	struct cpudef *cpu = g_head;
+
+	// flush the cpu timers one time so we don't begin with the cpu's running too quickly
+	g_expected_elapsed_ms = 0;
+	g_cpu_timer_us = timer_get_real_us();	// so the cpu doesn't run too quickly when we first start
+	cpu_profile_reset_globals();
+
+	// clear each cpu
+	while (cpu)
+	{
+		cpu->total_cycles_executed = 0;
 
-			} // end while looping through each cpu
-		} // end for loop
+		// the NMI/IRQ timers start counting from the beginning
+		cpu_start_nmi_timer(cpu, 0);
+		for (int i = 0; i < MAX_IRQS; i++)
+		{
+			cpu_start_irq_timer(cpu, i, 0);
+		}
+
+		cpu = cpu->next_cpu;
+	}
+	// end flushing the cpu timers
+
+	// if we're fast booting, this is where the machine jumps to the end of its boot sequence
+	if (snapshot_boot_restore())
+	{
+		// pretend that the cpus have been running all along so that they don't try to catch up
+		g_cpu_timer_us = timer_get_real_us() - (((Uint64) g_expected_elapsed_ms) * 1000);
+		cpu_profile_reset_globals();
+	}
+
+	runahead_start();
+
+	cpu_threads_start();
+
+	// loop until the quit flag is set which means the user wants to quit the program
+	while (!get_quitflag())
+	{
+		unsigned int actual_elapsed_ms = 0;
+
+		cpu_execute_ms();
 
-		// 1 ms has elapsed, so notify the LDP to keep it in sync (we must do this after every ms)
-		g_ldp->pre_think();
- 
 		// Update the sound buffers for the sound chips
 		update_soundbuffer();
 
-		// BEGIN FORCING EMULATOR TO RUN AT PROPER SPEED
-
-		// we have executed 1 ms worth of cpu cycles before this point, so slow down if 1 ms has not passed
-		actual_elapsed_ms = elapsed_ms_time(g_cpu_timer);
+		// this is the only point where every cpu is in between instructions, so snapshots have to be taken here
+		snapshot_think(g_expected_elapsed_ms);
 
-#ifdef CPU_DIAG
-		unsigned int uStartMs = actual_elapsed_ms;
-#endif
+		// recorded/replayed input has to reach the game at a point that doesn't depend on the host
+		inputrec_think();
 
-		// if we're behind, then compute how far behind we are ...
-		if (actual_elapsed_ms > g_expected_elapsed_ms)
+		// if we're in turbo mode, then time only moves as fast as we emulate it
+		if (timer_is_virtual())
 		{
-			g_uCPUMsBehind = actual_elapsed_ms - g_expected_elapsed_ms;
+			timer_advance_virtual(1);
+			g_uCPUMsBehind = 0;
+			cpu_profile_ms_behind(0);
+			cpu_turbo_report(false);
 		}
-		// else we're caught up or ahead
 		else
 		{
-			g_uCPUMsBehind = 0;
+			// BEGIN FORCING EMULATOR TO RUN AT PROPER SPEED
+
+			// we have executed 1 ms worth of cpu cycles before this point, so slow down if 1 ms has not passed
+			// (this is done in microseconds so that each ms ends on time instead of whenever SDL_Delay(1) wakes up)
+			Uint64 u64ExpectedUs = g_cpu_timer_us + (((Uint64) g_expected_elapsed_ms) * 1000);
+			Uint64 u64NowUs = timer_get_real_us();
 
-			// if not enough time has elapsed, slow down
-			while (g_expected_elapsed_ms > actual_elapsed_ms)
+			// if we're behind, then compute how far behind we are ...
+			if (u64NowUs > u64ExpectedUs)
+			{
+				g_uCPUMsBehind = (unsigned int) ((u64NowUs - u64ExpectedUs) / 1000);
+			}
+			// else we're caught up or ahead
+			else
 			{
+				g_uCPUMsBehind = 0;
+
+				// if not enough time has elapsed, slow down
 #ifndef _XBOX
-				SDL_Delay(1);
+				timer_sleep_until_us(u64ExpectedUs);
 #else
-				XBOX_Delay(1);
+				while (timer_get_real_us() < u64ExpectedUs)
+				{
+					XBOX_Delay(1);
+				}
 #endif
-				actual_elapsed_ms = elapsed_ms_time(g_cpu_timer);
+
+				// track how long we slept
+				cpu_profile_sleep(timer_get_real_us() - u64NowUs);
 			}
-		}
 
-#ifdef CPU_DIAG
-		// track ms that we slept
-		cd_extra_ms += (actual_elapsed_ms - uStartMs);
-#endif
+			cpu_profile_ms_behind(g_uCPUMsBehind);
 		
-		// END FORCING CPU TO RUN AT PROPER SPEED
+			// END FORCING CPU TO RUN AT PROPER SPEED
+		} // end if not in turbo mode
+
+		cpu_profile_think(g_expected_elapsed_ms);
 
 #ifdef DEBUG
 		// the cpu should ideally not be paused at this point because if it is, it will
@@ -717,7 +1204,68 @@ void cpu_execute()
 			}
 
 		} while (g_cpu_paused && !get_quitflag());	// the only time this should loop is if the user pauses the game
+
+		// this comes after the input check so that running ahead uses the newest input
+		runahead_think();
 	} // end while quitflag is not true
+
+	cpu_threads_stop();
+
+	// write out the final statistics so that nothing since the last dump is lost
+	cpu_profile_dump(g_expected_elapsed_ms);
+	cpu_profile_shutdown();
+
+	inputrec_shutdown();
+
+	// give a final report so that automated runs know how long they took
+	if (timer_is_virtual())
+	{
+		cpu_turbo_report(true);
+	}
+}
+
+// how often (in host milliseconds) turbo mode prints its speed
+#define TURBO_REPORT_MS 5000
+
+// prints how many emulated ms we are getting per host ms (only used in turbo mode)
+// If bFinal is false, this only prints something if TURBO_REPORT_MS has passed since the last report.
+void cpu_turbo_report(bool bFinal)
+{
+	static unsigned int uStartWallMs = 0, uStartEmuMs = 0;	// when turbo mode started
+	static unsigned int uLastWallMs = 0, uLastEmuMs = 0;	// when we last reported
+	static bool bStarted = false;
+	unsigned int uWallMs = GetRealTicksFunc();
+
+	if (!bStarted)
+	{
+		uStartWallMs = uLastWallMs = uWallMs;
+		uStartEmuMs = uLastEmuMs = g_expected_elapsed_ms;
+		bStarted = true;
+		return;
+	}
+
+	if (bFinal)
+	{
+		unsigned int uWallDiff = uWallMs - uStartWallMs;
+		unsigned int uEmuDiff = g_expected_elapsed_ms - uStartEmuMs;
+		char s[160];
+		sprintf(s, "Turbo total: %u emulated ms in %u wall ms (%.2f emulated ms per wall ms)",
+			uEmuDiff, uWallDiff, (uWallDiff != 0) ? ((double) uEmuDiff / uWallDiff) : 0.0);
+		printline(s);
+	}
+	// else if it's time to give a progress report
+	else if ((uWallMs - uLastWallMs) >= TURBO_REPORT_MS)
+	{
+		unsigned int uWallDiff = uWallMs - uLastWallMs;
+		unsigned int uEmuDiff = g_expected_elapsed_ms - uLastEmuMs;
+		char s[160];
+		sprintf(s, "Turbo: %u emulated ms in %u wall ms (%.2f emulated ms per wall ms)",
+			uEmuDiff, uWallDiff, (double) uEmuDiff / uWallDiff);
+		printline(s);
+		uLastWallMs = uWallMs;
+		uLastEmuMs = g_expected_elapsed_ms;
+	}
+	// else nothing to report yet
 }
 
 // sets the PC on all cpu's to their initial PC values.
@@ -733,8 +1281,7 @@ void cpu_reset()
 		// set the context if we need to
 		if (cpu->must_copy_context)
 		{
-			(cpu->setcontext_callback)(cpu->context);	// restore registers
-			(cpu->setmemory_callback)(cpu->mem);	// restore memory we're working with
+			cpu_select_context(cpu);
 		}
 		
 		(cpu->reset_callback)();
@@ -746,7 +1293,7 @@ void cpu_reset()
 		}
 		
 		// save the context if we need to
-		if (cpu->must_copy_context)
+		if (cpu->must_copy_context && !cpu->setinstance_callback)
 		{
 			(cpu->getcontext_callback)(cpu->context);	// preserve registers
 		}
@@ -761,11 +1308,9 @@ void cpu_set_event(unsigned int uCpuID, unsigned int uCyclesTilEvent, void (*eve
 
 	if (cpu)
 	{
-		// reset event stuff
-		cpu->event_callback = event_callback;
-		cpu->uEventCyclesEnd = uCyclesTilEvent;
-		cpu->uEventCyclesExecuted = 0;
-		cpu->event_data = event_data;
+		// only one event per callback can be pending
+		cpu_event_remove(cpu, event_callback, false, NULL);
+		cpu_event_insert(cpu, cpu_current_cycles(cpu) + uCyclesTilEvent, event_callback, event_data);
 	}
 
 	// make programmer fix this problem :)
@@ -776,6 +1321,189 @@ void cpu_set_event(unsigned int uCpuID, unsigned int uCyclesTilEvent, void (*eve
 	}
 }
 
+// bump this whenever the layout of what cpu_save_state saves changes
+#define CPU_STATE_VERSION	2
+
+bool cpu_save_state(struct snapshot *snap)
+{
+	struct cpudef *cpu = NULL;
+	Uint32 uCount = g_cpu_count;
+	unsigned int uSection = 0;
+
+	// make sure every cpu can be saved before we save anything
+	for (cpu = g_head; cpu; cpu = cpu->next_cpu)
+	{
+		if (!cpu->getcontext_callback || !cpu->setcontext_callback)
+		{
+			printline("cpu_save_state() : one of this game's cpus does not support saving its context");
+			return false;
+		}
+	}
+
+	uSection = snapshot_begin_section(snap, "CPU ", CPU_STATE_VERSION);
+	snapshot_put(snap, &uCount, sizeof(uCount));
+	snapshot_put(snap, &g_expected_elapsed_ms, sizeof(g_expected_elapsed_ms));
+
+	for (cpu = g_head; cpu; cpu = cpu->next_cpu)
+	{
+		Uint8 context[MAX_CONTEXT_SIZE];
+		Uint32 uContextSize = 0;
+
+		// this gets the size (not every core accepts a NULL buffer, so we always pass one)
+		uContextSize = (cpu->getcontext_callback)(context);
+
+		// If we have to copy the context, then the cpu core may currently hold some other cpu's context,
+		//  so our copy is the one that counts.
+		if (cpu->must_copy_context)
+		{
+			memcpy(context, cpu->context, uContextSize);
+		}
+
+		Sint32 iType = cpu->type;
+		snapshot_put(snap, &iType, sizeof(iType));
+		snapshot_put(snap, &cpu->hz, sizeof(cpu->hz));
+		snapshot_put(snap, &uContextSize, sizeof(uContextSize));
+		snapshot_put(snap, context, uContextSize);
+
+		// timers, pending interrupts and cycle counts
+		snapshot_put(snap, &cpu->uNMITickCount, sizeof(cpu->uNMITickCount));
+		snapshot_put(snap, &cpu->u64NMITimerStart, sizeof(cpu->u64NMITimerStart));
+		snapshot_put(snap, cpu->uIRQTickCount, sizeof(cpu->uIRQTickCount));
+		snapshot_put(snap, cpu->u64IRQTimerStart, sizeof(cpu->u64IRQTimerStart));
+		snapshot_put(snap, &cpu->pending_nmi_count, sizeof(cpu->pending_nmi_count));
+		snapshot_put(snap, cpu->pending_irq_count, sizeof(cpu->pending_irq_count));
+		snapshot_put(snap, &cpu->total_cycles_executed, sizeof(cpu->total_cycles_executed));
+
+		// pending events (in heap order, so they can be restored as-is)
+		snapshot_put(snap, &cpu->uEventSeq, sizeof(cpu->uEventSeq));
+		snapshot_put(snap, &cpu->uEventCount, sizeof(cpu->uEventCount));
+		for (unsigned int u = 0; u < cpu->uEventCount; u++)
+		{
+			const struct cpu_event *event = &cpu->events[u];
+
+			// Event callbacks are saved relative to cpu_set_event so that they are still correct if the
+			//  executable gets loaded at a different address next time.
+			// The data is saved as-is, which is fine because every event user passes a value rather than a pointer.
+			Sint64 i64EventCallback = (Sint64) ((size_t) event->callback - (size_t) cpu_set_event);
+			Uint64 u64EventData = (Uint64) (size_t) event->data;
+
+			snapshot_put(snap, &event->u64Cycle, sizeof(event->u64Cycle));
+			snapshot_put(snap, &event->uSeq, sizeof(event->uSeq));
+			snapshot_put(snap, &i64EventCallback, sizeof(i64EventCallback));
+			snapshot_put(snap, &u64EventData, sizeof(u64EventData));
+		}
+	}
+
+	snapshot_end_section(snap, uSection);
+	return true;
+}
+
+bool cpu_load_state(struct snapshot *snap)
+{
+	struct cpudef *cpu = NULL;
+	Uint32 uCount = 0;
+
+	if (!snapshot_open_section(snap, "CPU ", CPU_STATE_VERSION))
+	{
+		return false;
+	}
+
+	snapshot_get(snap, &uCount, sizeof(uCount));
+	if (uCount != (Uint32) g_cpu_count)
+	{
+		printline("cpu_load_state() : snapshot has a different number of cpus");
+		return false;
+	}
+
+	snapshot_get(snap, &g_expected_elapsed_ms, sizeof(g_expected_elapsed_ms));
+
+	for (cpu = g_head; cpu; cpu = cpu->next_cpu)
+	{
+		Uint8 context[MAX_CONTEXT_SIZE];
+		Sint32 iType = 0;
+		Uint32 uHz = 0, uContextSize = 0;
+
+		snapshot_get(snap, &iType, sizeof(iType));
+		snapshot_get(snap, &uHz, sizeof(uHz));
+		snapshot_get(snap, &uContextSize, sizeof(uContextSize));
+
+		// the context is saved as-is, so it has to be for the exact same kind of cpu
+		if (snap->bError || (iType != cpu->type) || (uHz != cpu->hz) ||
+			!cpu->getcontext_callback || (uContextSize != (cpu->getcontext_callback)(context)))
+		{
+			printline("cpu_load_state() : snapshot has a different cpu setup");
+			return false;
+		}
+
+		snapshot_get(snap, context, uContextSize);
+
+		snapshot_get(snap, &cpu->uNMITickCount, sizeof(cpu->uNMITickCount));
+		snapshot_get(snap, &cpu->u64NMITimerStart, sizeof(cpu->u64NMITimerStart));
+		snapshot_get(snap, cpu->uIRQTickCount, sizeof(cpu->uIRQTickCount));
+		snapshot_get(snap, cpu->u64IRQTimerStart, sizeof(cpu->u64IRQTimerStart));
+		snapshot_get(snap, &cpu->pending_nmi_count, sizeof(cpu->pending_nmi_count));
+		snapshot_get(snap, cpu->pending_irq_count, sizeof(cpu->pending_irq_count));
+		snapshot_get(snap, &cpu->total_cycles_executed, sizeof(cpu->total_cycles_executed));
+
+		unsigned int uEventCount = 0;
+		snapshot_get(snap, &cpu->uEventSeq, sizeof(cpu->uEventSeq));
+		snapshot_get(snap, &uEventCount, sizeof(uEventCount));
+		if (uEventCount > MAX_CPU_EVENTS)
+		{
+			printline("cpu_load_state() : snapshot has too many cpu events");
+			return false;
+		}
+
+		cpu->uEventCount = uEventCount;
+		for (unsigned int u = 0; u < uEventCount; u++)
+		{
+			struct cpu_event *event = &cpu->events[u];
+			Sint64 i64EventCallback = 0;
+			Uint64 u64EventData = 0;
+
+			snapshot_get(snap, &event->u64Cycle, sizeof(event->u64Cycle));
+			snapshot_get(snap, &event->uSeq, sizeof(event->uSeq));
+			snapshot_get(snap, &i64EventCallback, sizeof(i64EventCallback));
+			snapshot_get(snap, &u64EventData, sizeof(u64EventData));
+			event->callback = (void (*)(void *)) ((size_t) cpu_set_event + (size_t) i64EventCallback);
+			event->data = (void *) (size_t) u64EventData;
+		}
+
+		if (snap->bError)
+		{
+			return false;
+		}
+
+		// cpu_execute will give the context to the core the next time this cpu runs
+		if (cpu->must_copy_context && !cpu->setinstance_callback)
+		{
+			memcpy(cpu->context, context, uContextSize);
+		}
+
+		// the core may be working on this cpu's context right now, so it has to be told about the new one
+		//  (and, as below, the context's pointers to this cpu's memory have to be fixed up)
+		else if (cpu->must_copy_context)
+		{
+			memcpy(cpu->context, context, uContextSize);
+			g_active_cpu = cpu->id;
+			memmap_select(cpu);
+			cpu_select_context(cpu);
+			(cpu->setmemory_callback)(cpu->mem);
+		}
+		else
+		{
+			g_active_cpu = cpu->id;
+			memmap_select(cpu);
+			(cpu->setcontext_callback)(context);
+
+			// the context can hold pointers to this cpu's memory, which may not be where it was when the snapshot was made
+			(cpu->setmemory_callback)(cpu->mem);
+		}
+	}
+
+	return snapshot_close_section(snap);
+}
+
 // Recursively pauses cpu execution
 //  call this right before you do a function that may take a long time to return from (such as spinning up a laserdisc player)
 // Why is this recursive? Because ldp, cpu-debug and thayer's quest can all call cpu_pause,
@@ -786,7 +1514,7 @@ void cpu_set_event(unsigned int uCpuID, unsigned int uCyclesTilEvent, void (*eve
 //  paused by 1 function at a time, but that is on the future TODO ...
 void cpu_pause()
 {
-	g_cpu_paused_timer.push(refresh_ms_time());
+	g_cpu_paused_timer.push(timer_get_real_us());
 	g_cpu_paused = true;
 #ifdef DEBUG
 //	printline("CPU paused...");
@@ -801,7 +1529,7 @@ void cpu_unpause()
 	// safety check
 	if (g_cpu_paused_timer.size() > 0)
 	{
-		g_cpu_timer = refresh_ms_time() - (g_cpu_paused_timer.top() - g_cpu_timer);
+		g_cpu_timer_us = timer_get_real_us() - (g_cpu_paused_timer.top() - g_cpu_timer_us);
 		g_cpu_paused_timer.pop();
 
 		// if our pause stack is empty, then we can finally, safely, unpause
@@ -825,7 +1553,7 @@ void cpu_unpause()
 // WARNING: this timer is reset by flush_cpu_timers
 Uint32 get_cpu_timer()
 {
-	return g_cpu_timer;
+	return (Uint32) (g_cpu_timer_us / 1000);
 }
 
 // returns the total # of cycles that have elapsed 
@@ -910,8 +1638,16 @@ void cpu_change_nmi(Uint8 id, double new_period)
 	
 	if (cpu)
 	{
+		unsigned int uOldMicroPeriod = cpu->uNMIMicroPeriod;
+
 		cpu->nmi_period = new_period;
-		cpu_recalc();
+		cpu_recalc_one(cpu);
+
+		// if the period has changed, the timer starts over from right now
+		if (cpu->uNMIMicroPeriod != uOldMicroPeriod)
+		{
+			cpu_start_nmi_timer(cpu, cpu_current_cycles(cpu));
+		}
 	}
 	else
 	{
@@ -927,6 +1663,10 @@ void cpu_generate_nmi(Uint8 cpu_id)
 	assert(cpu);
 #endif
 
+	if (cpu->pending_nmi_count == 0)
+	{
+		cpu->profile.uNMIPendingSinceMs = g_expected_elapsed_ms;
+	}
 	cpu->pending_nmi_count++;
 }
 
@@ -942,8 +1682,16 @@ void cpu_change_irq(Uint8 id, unsigned int which_irq, double new_period)
 	assert(cpu);
 #endif
 
+	unsigned int uOldMicroPeriod = cpu->uIRQMicroPeriod[which_irq];
+
 	cpu->irq_period[which_irq] = new_period;
-	cpu_recalc();
+	cpu_recalc_one(cpu);
+
+	// same as cpu_change_nmi
+	if (cpu->uIRQMicroPeriod[which_irq] != uOldMicroPeriod)
+	{
+		cpu_start_irq_timer(cpu, which_irq, cpu_current_cycles(cpu));
+	}
 //	cpu->cycles_per_irq[which_irq] = (Uint32) (cpu->cycles_per_ms * cpu->irq_period[which_irq]);
 //	cpu->irq_cycle_count[which_irq] = 0;
 
@@ -961,6 +1709,10 @@ void cpu_generate_irq(Uint8 cpu_id, unsigned int which_irq)
 	assert (cpu);
 #endif
 
+	if (cpu->pending_irq_count[which_irq] == 0)
+	{
+		cpu->profile.uIRQPendingSinceMs[which_irq] = g_expected_elapsed_ms;
+	}
 	cpu->pending_irq_count[which_irq]++;
 }
 
@@ -1020,6 +1772,11 @@ void generic_6502_setcontext(void *context_buf)
 	g_6502->SetContext( (NES_6502::Context *) context_buf);
 }
 
+void generic_6502_setinstance(void *context_buf)
+{
+	g_6502->SetInstance( (NES_6502::Context *) context_buf);
+}
+
 // returns an ASCII string giving info about registers and other stuff ...
 const char *generic_6502_info(void *unused, int regnum)
 {
@@ -1096,6 +1853,12 @@ void reset_cpu_globals()
 		g_cpu_initialized[i] = false;
 	g_expected_elapsed_ms = 0;
 	g_active_cpu = 0;
+	g_mem_pages = g_mem_pages_unmapped;
+}
+
+void memmap_select(struct cpudef *cpu)
+{
+	g_mem_pages = cpu->mem_pages;
 }
 
 void cpu_change_interleave(unsigned int uInterleave)
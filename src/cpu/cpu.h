@@ -30,8 +30,48 @@ enum { CPU_UNDEFINED, CPU_Z80, CPU_X86, CPU_M6809, CPU_M6502, CPU_COP421, CPU_I8
 #define CPU_MEM_SIZE	0x100000	// 1 meg for I86
 #define MAX_CONTEXT_SIZE	100	/* max # of bytes that a cpu context can have */
 #define MAX_IRQS	4	/* how many IRQs we will support per CPU */
+#define MAX_CPU_THREAD_GROUPS	4	/* how many threads the cpus can be split up into (see cpudef::uThreadGroup) */
+#define MAX_CPU_EVENTS	16	/* how many timed events each cpu can have pending at once (see cpu_set_event) */
+
+// for variables that each cpu thread needs its own copy of (such as which cpu is active)
+#ifdef WIN32
+#define CPU_THREAD_LOCAL __declspec(thread)
+#else
+#define CPU_THREAD_LOCAL __thread
+#endif
 
 struct cpudef;
+struct mem_page;
+struct snapshot;
+
+// a timed event that is waiting for a cpu to reach a certain cycle (see cpu_set_event)
+struct cpu_event
+{
+	Uint64 u64Cycle;	// fires once the cpu's total_cycles_executed reaches this
+	Uint32 uSeq;	// when the event was set, so that events on the same cycle fire in the order they were set
+	void (*callback)(void *data);	// what to call when the event fires
+	void *data;	// whatever data we are supposed to pass back to the callback
+};
+
+// runtime statistics for each cpu (always collected, see cpu-profile.h for how to dump them)
+struct cpu_profile
+{
+	Uint64 u64CyclesRequested;	// how many cycles we've asked the core to execute
+	Uint64 u64CyclesExecuted;	// how many cycles the core says it executed
+	Uint64 u64CyclesOvershoot;	// how many cycles the core executed beyond what we asked for
+	Uint64 u64CyclesIdleSkipped;	// how many of the executed cycles the core skipped because the cpu was in an idle loop
+	unsigned int uExecuteCalls;	// how many times the core's execute callback has been called
+	unsigned int uEventCallbacks;	// how many cpu events have fired
+	unsigned int uNMICount;	// how many NMI's have been given to the game driver
+	unsigned int uNMIPendingSinceMs;	// when the oldest pending NMI became pending
+	unsigned int uNMILatencyTotalMs;	// sum of all ms between NMI becoming pending and do_nmi being called
+	unsigned int uNMILatencyMaxMs;	// worst NMI latency so far
+	unsigned int uIRQCount[MAX_IRQS];	// same as NMI
+	unsigned int uIRQPendingSinceMs[MAX_IRQS];	// same as NMI
+	unsigned int uIRQLatencyTotalMs[MAX_IRQS];	// same as NMI
+	unsigned int uIRQLatencyMaxMs[MAX_IRQS];	// same as NMI
+	Uint64 u64LastDumpCycles;	// value of u64CyclesExecuted when the profile was last dumped (to compute MHz)
+};
 
 // structure that defines parameters for each cpu daphne uses
 struct cpudef
@@ -45,6 +85,11 @@ struct cpudef
 	double irq_period[MAX_IRQS];	// how often the IRQs tick (in milliseconds, not seconds)
 	Uint8 *mem;	// where the cpu's memory begins
 
+	// Which thread this cpu runs on (0 is the main thread).  If a game driver puts its cpus into more than one group,
+	//  the groups run in parallel (see cpu_sync_point for the rules they must follow).
+	// Every cpu that uses the same core must be in the same group.  Leave at 0 to run every cpu on the main thread.
+	unsigned int uThreadGroup;
+
 	// these should not be modified externally
 	Uint8 id;	// which we are adding
 	void (*init_callback)();	// callback to initialize the cpu
@@ -53,6 +98,10 @@ struct cpudef
 	Uint32 (*execute_callback)(Uint32);	// callback to execute cycles for this particular cpu
 	Uint32 (*getcontext_callback)(void *);	// callback to get a cpu's context
 	void (*setcontext_callback)(void *);	// callback to set a cpu's context
+	// Optional callback that makes the core execute directly on a context that was filled in by getcontext_callback
+	//  (NULL goes back to the core's own context).  If the core has this, cpus that must_copy_context keep their
+	//  context in 'context' below and switching between them doesn't copy anything.
+	void (*setinstance_callback)(void *);
 	Uint32 (*getpc_callback)();	// callback to get the program counter
 	void (*setpc_callback)(Uint32);	// callback to set the program counter
 	Uint32 (*elapsedcycles_callback)();	// callback to get the # of elapsed cycles
@@ -63,19 +112,25 @@ struct cpudef
 	// how many cycles per interleave (Hz / g_uInterleavePerMs / 1000), rough calculation, pre-calculated for speed
 	unsigned int uCyclesPerInterleave;
 	unsigned int uNMIMicroPeriod;	// NMI ticks every 'this many' micro seconds (to avoid using floats for gp2x's sake)
-	unsigned int uNMITickCount;	// how many NMI's have ticked from the timer (so we know when the next one will take place)
-	unsigned int uNMITickBoundaryMs;	// how many ms need to elapse before the next NMI will tick
+	unsigned int uNMITickCount;	// how many NMI's have ticked since the NMI timer was started (so we know when the next one will take place)
+	Uint64 u64NMITimerStart;	// the cycle that the NMI timer was started on
 	unsigned int uIRQMicroPeriod[MAX_IRQS];	// IRQ ticks every 'this many' micro seconds (to avoid using floats for gp2x's sake)
 	unsigned int uIRQTickCount[MAX_IRQS];	// same as NMI
-	unsigned int uIRQTickBoundaryMs[MAX_IRQS];	// same as NMI
+	Uint64 u64IRQTimerStart[MAX_IRQS];	// same as NMI
 	unsigned pending_nmi_count;	// how many NMI's we have queued up to do
 	unsigned int pending_irq_count[MAX_IRQS];	// how many IRQ's we have queued up to do
 	Uint64 total_cycles_executed;	// any cycles we've tracked so far
-	unsigned int uEventCyclesExecuted;	// how many cycles we've executed since the optional event tracking started
-	unsigned int uEventCyclesEnd;	// when event tracking ends and optional event fires (0 if no event)
-	void (*event_callback)(void *data);	// callback we call when optional event fires
-	void *event_data;	// whatever data we are supposed to pass back to the event callback
-	Uint8 context[MAX_CONTEXT_SIZE];	// the cpu's context (in case we were forced to copy it out)
+	bool bExecuting;	// true while the cpu core is executing this cpu (so we know whether elapsedcycles_callback can be trusted)
+	struct cpu_event events[MAX_CPU_EVENTS];	// pending timed events, as a min-heap sorted by cycle (NMI/IRQ timer ticks are events too)
+	unsigned int uEventCount;	// how many events are pending
+	Uint32 uEventSeq;	// incremented every time an event is set
+	struct mem_page *mem_pages;	// this cpu's page table for direct memory access (see memmap.h)
+	struct cpu_profile profile;	// statistics about how this cpu is being scheduled
+	union
+	{
+		Uint8 context[MAX_CONTEXT_SIZE];	// the cpu's context (in case we were forced to copy it out)
+		void *context_align;	// (contexts hold pointers, and cores that have setinstance_callback use them in place)
+	};
 	struct cpudef *next_cpu;	// pointer to the next cpu in this linked list
 };
 
@@ -84,12 +139,25 @@ void del_all_cpus();	// delete all cpus that have been added (for shutting down
 void cpu_init();	// initialize one cpu
 void cpu_shutdown();	// shutdown all cpus
 void cpu_execute();
+
+// Runs every cpu for 1 ms worth of cycles and then lets the laserdisc player know that 1 ms has passed.
+// This is the part of cpu_execute's loop that emulates the machine (cpu_execute also does pacing, sound, input, etc),
+//  so that the machine can be run ahead without any of that (see game/runahead.h).
+void cpu_execute_ms();
+void cpu_turbo_report(bool bFinal);
 void cpu_reset();
 
 // Creates an precisely timed 'event'. After 'uCyclesTilEvent' elapses, event_callback will be called.
 // Each even is just a one-shot deal, it doesn't loop.
+// A cpu can have several events pending, but only one per callback: if 'event_callback' is already pending for this cpu,
+//  it gets moved to the new time (so a chain of events can be restarted by setting its first event again).
 void cpu_set_event(unsigned int uCpuID, unsigned int uCyclesTilEvent, void (*event_callback)(void *data), void *event_data);
 
+// Saves/restores every cpu's context, interrupt timers and cycle counts (see game/snapshot.h).
+// Only cpus whose cores support getting/setting their context can be saved.
+bool cpu_save_state(struct snapshot *snap);
+bool cpu_load_state(struct snapshot *snap);
+
 void cpu_pause();
 void cpu_unpause();
 Uint32 get_cpu_timer();
@@ -112,12 +180,32 @@ void cpu_change_irq(Uint8 cpu_id, unsigned int which_irq, double new_period);
 void cpu_generate_irq(Uint8 cpu_id, unsigned int which_irq);
 void cpu_change_interleave(Uint32);
 
+// Whether cpu thread groups are allowed to run in parallel (-nocputhreads turns this off).
+void cpu_set_threads_allowed(bool bAllowed);
+
+// Whether cpu cores may skip over idle loops (-noidleskip turns this off).
+// A core that supports it (only m80 so far) recognizes short loops that just wait for something to change
+//  (an interrupt, or memory that the game driver says can only change when an event fires) and jumps straight
+//  to the end of the cycles it was asked to execute, which always stops at the next cpu event.
+void cpu_set_idle_skip(bool bEnabled);
+
+// called by cpu cores when they skip over an idle loop (for the profiler)
+void cpu_idle_skipped(Uint32 uCycles);
+
+// Anything that a cpu does to a cpu in another thread group (such as writing to a latch that the other cpu reads,
+//  or generating an IRQ for it) must be done by calling 'callback' through this function.
+// While the groups are running in parallel, 'callback' gets called on the main thread once every group has finished
+//  its interleave slice, and the rest of that ms is run on one thread so that the cpus can respond to each other quickly.
+// Otherwise 'callback' is called right away.
+void cpu_sync_point(void (*callback)(void *obj, unsigned int uValue), void *obj, unsigned int uValue);
+
 void generic_6502_init();
 void generic_6502_shutdown();
 void generic_6502_reset();
 void generic_6502_setmemory(Uint8 *buf);
 Uint32 generic_6502_getcontext(void *context_buf);
 void generic_6502_setcontext(void *context_buf);
+void generic_6502_setinstance(void *context_buf);
 const char *generic_6502_info(void *context, int regnum);
 Uint32 generic_cpu_elapsedcycles_stub();
 const char *generic_ascii_info_stub(void *, int);
@@ -48,7 +48,15 @@
 #pragma warning (disable:4244)	// disable the warning about possible loss of data
 #endif
 
-struct m80_context g_context;	/* full context for the cpu */
+// gcc can jump through a table of labels ("computed goto"), which lets m80_execute use threaded dispatch.
+// Everything else (and the cpu debugger, which needs to see every instruction) uses the plain switch.
+// Define M80_NO_THREADED_DISPATCH to force the switch (for comparing the two).
+#if defined(__GNUC__) && !defined(CPU_DEBUG) && !defined(M80_NO_THREADED_DISPATCH)
+#define M80_THREADED_DISPATCH
+#endif
+
+static struct m80_context g_own_context;	/* the context that gets used until a cpu instance is set */
+struct m80_context *g_pContext = &g_own_context;	/* full context for the cpu */
 Uint32	g_cycles_executed = 0;	/* how many cycles we've executed this time around */
 Uint32	g_cycles_to_execute = 0;	/* how many cycles we're supposed to execute */
 Sint32 (*g_irq_callback)(int nothing) = 0;	/* function that gets called when we activate our IRQ */
@@ -169,6 +177,7 @@ const Uint8 ddfd_cb_cycles[256] =
 void m80_set_opcode_base(Uint8 *address)
 {
 	opcode_base = address;
+	g_pContext->opcode_base = address;
 
 #ifdef USE_MAME_Z80_DEBUGGER
 	OP_ROM = OP_RAM = address;
@@ -185,7 +194,7 @@ void m80_reset()
 	/* clear all registers */
 	for (i = M80_PC; i < M80_REG_COUNT; i++)
 	{
-		g_context.m80_regs[i].w = 0;
+		g_pContext->m80_regs[i].w = 0;
 	}
 
 	/* after some testing using Dragon's Lair, we've observed that most registers tend to start near 0xFFFF */
@@ -198,9 +207,9 @@ void m80_reset()
 	DE = 0xFFFF;
 	SP = 0xFFFF;
 
-	g_context.IFF1 = 0;
-	g_context.IFF2 = 0;
-	g_context.interrupt_mode = 0;
+	g_pContext->IFF1 = 0;
+	g_pContext->IFF2 = 0;
+	g_pContext->interrupt_mode = 0;
 	M80_CHANGE_PC(0);
 }
 
@@ -249,14 +258,14 @@ void m80_reset()
 	case 0x6D:	\
 	case 0x75:	\
 	case 0x7D:	\
-		g_context.IFF1 = g_context.IFF2;	\
+		g_pContext->IFF1 = g_pContext->IFF2;	\
 		M80_RET;	\
 		break;	\
 	case 0x46:	/* IM 0 , go into interrupt mode 0 */	\
 	case 0x4E:	\
 	case 0x66:	\
 	case 0x6E:	\
-		g_context.interrupt_mode = 0;	\
+		g_pContext->interrupt_mode = 0;	\
 		break;	\
 	case 0x47:	/* LD I, A */	\
 		I = A;	\
@@ -299,13 +308,13 @@ void m80_reset()
 	/* case 0x55, see 0x45 */	\
 	case 0x56:	/* IM 1 */	\
 	case 0x76:	\
-		g_context.interrupt_mode = 1;	\
+		g_pContext->interrupt_mode = 1;	\
 		break;	\
 	case 0x57:	/* LD A, I */	\
 		A = I;	\
 		FLAGS &= C_FLAG;	/* preserve C, clear H and N */	\
 		FLAGS |= m80_sz53_flags[A];	/* set S, Z, 5, 3 flags */	\
-		FLAGS |= (g_context.IFF2 << 2);	/* put IFF2 in the V/P flag slot */	\
+		FLAGS |= (g_pContext->IFF2 << 2);	/* put IFF2 in the V/P flag slot */	\
 		break;	\
 	case 0x58:	/* IN E, (C) */	\
 		M80_IN16(BC, E);	\
@@ -325,13 +334,13 @@ void m80_reset()
 	/* case 0x5D, see 0x45 */	\
 	case 0x5E:	/* IM 2 */	\
 	case 0x7E:	\
-		g_context.interrupt_mode = 2;	\
+		g_pContext->interrupt_mode = 2;	\
 		break;	\
 	case 0x5F:	/* LD A, R */	\
 		A = R;	\
 		FLAGS &= C_FLAG;	/* preserve C, clear H and N */	\
 		FLAGS |= m80_sz53_flags[A];	/* set S, Z, 5, 3 flags */	\
-		FLAGS |= (g_context.IFF2 << 2);	/* put IFF2 in the V/P flag slot */	\
+		FLAGS |= (g_pContext->IFF2 << 2);	/* put IFF2 in the V/P flag slot */	\
 		break;	\
 	case 0x60:	/* IN H, (C) */	\
 		M80_IN16(BC, H);	\
@@ -2154,815 +2163,824 @@ void m80_reset()
 
 
 
-/* executes ONE instruction, incrementing PC and g_cycles_executed variable appropriately */
-#define M80_EXEC_CUR_INSTR	\
-{	\
-	Uint8 opcode = M80_GET_ARG;	/* get opcode and increment PC */	\
-	Uint16 temp_word;	\
-	g_cycles_executed += op_cycles[opcode];	\
-	M80_INC_R;	/* for each instruction, increase R at least once */ \
-	switch(opcode)	\
-	{	\
-	case 0:	/* NOP */	\
-		break;	\
-	case 1:	/* LD BC, NN */	\
+/* the body of every main (unprefixed) instruction */
+/* OP(n) starts instruction n and NEXT finishes it, so that the same list can be dispatched either through a switch */
+/*  (see M80_EXEC_CUR_INSTR) or through a table of labels (see m80_exec_threaded) */
+#define M80_MAIN_OPCODES(OP, NEXT)	\
+	OP(0x00)	/* NOP */	\
+		NEXT	\
+	OP(0x01)	/* LD BC, NN */	\
 		BC = M80_GET_WORD;	\
-		break;	\
-	case 2:	/* LD (BC), A */	\
+		NEXT	\
+	OP(0x02)	/* LD (BC), A */	\
 		M80_WRITE_BYTE(BC, A);	\
-		break;	\
-	case 3:	/* INC BC */	\
+		NEXT	\
+	OP(0x03)	/* INC BC */	\
 		BC++;	\
-		break;	\
-	case 4: /* INC B */	\
+		NEXT	\
+	OP(0x04) /* INC B */	\
 		M80_INC_REG8(B);	\
-		break;	\
-	case 5:	/* DEC B */	\
+		NEXT	\
+	OP(0x05)	/* DEC B */	\
 		M80_DEC_REG8(B);	\
-		break;	\
-	case 6:	/* LD B, N */	\
+		NEXT	\
+	OP(0x06)	/* LD B, N */	\
 		B = M80_GET_ARG;	\
-		break;	\
-	case 7:	/* RLCA */	\
+		NEXT	\
+	OP(0x07)	/* RLCA */	\
 		M80_RLCA;	\
-		break;	\
-	case 8:	/* EX AF, AF' */	\
+		NEXT	\
+	OP(0x08)	/* EX AF, AF' */	\
 		M80_EX_AFS;	\
-		break;	\
-	case 9:	/* ADD HL, BC */	\
+		NEXT	\
+	OP(0x09)	/* ADD HL, BC */	\
 		M80_ADD_REGS16(HL, BC);	\
-		break;	\
-	case 0xA:	/* LD A, (BC) */	\
+		NEXT	\
+	OP(0x0A)	/* LD A, (BC) */	\
 		A = M80_READ_BYTE(BC);	\
-		break;	\
-	case 0xB:	/* DEC BC */	\
+		NEXT	\
+	OP(0x0B)	/* DEC BC */	\
 		BC--;	\
-		break;	\
-	case 0xC:	/* INC C */	\
+		NEXT	\
+	OP(0x0C)	/* INC C */	\
 		M80_INC_REG8(C);	\
-		break;	\
-	case 0xD:	/* DEC C */	\
+		NEXT	\
+	OP(0x0D)	/* DEC C */	\
 		M80_DEC_REG8(C);	\
-		break;	\
-	case 0xE:	/* LD C, N */	\
+		NEXT	\
+	OP(0x0E)	/* LD C, N */	\
 		C = M80_GET_ARG;	\
-		break;	\
-	case 0xF:	/* RRCA */	\
+		NEXT	\
+	OP(0x0F)	/* RRCA */	\
 		M80_RRCA;	\
-		break;	\
-	case 0x10:	/* DJNZ $+2 */	\
+		NEXT	\
+	OP(0x10)	/* DJNZ $+2 */	\
 		B--;	\
 		M80_BRANCH_COND (B != 0);	\
-		break;	\
-	case 0x11:	/* LD DE,NN */	\
+		NEXT	\
+	OP(0x11)	/* LD DE,NN */	\
 		DE = M80_GET_WORD;	\
-		break;	\
-	case 0x12:	/* LD (DE), A */	\
+		NEXT	\
+	OP(0x12)	/* LD (DE), A */	\
 		M80_WRITE_BYTE(DE, A);	\
-		break;	\
-	case 0x13:	/* INC DE */	\
+		NEXT	\
+	OP(0x13)	/* INC DE */	\
 		DE++;	\
-		break;	\
-	case 0x14:	/* INC D */	\
+		NEXT	\
+	OP(0x14)	/* INC D */	\
 		M80_INC_REG8(D);	\
-		break;	\
-	case 0x15:	/* DEC D */	\
+		NEXT	\
+	OP(0x15)	/* DEC D */	\
 		M80_DEC_REG8(D);	\
-		break;	\
-	case 0x16:	/* LD D, N */	\
+		NEXT	\
+	OP(0x16)	/* LD D, N */	\
 		D = M80_GET_ARG;	\
-		break;	\
-	case 0x17:	/* RLA */	\
+		NEXT	\
+	OP(0x17)	/* RLA */	\
 		M80_RLA;	\
-		break;	\
-	case 0x18:	/* JR $N+2 */	\
+		NEXT	\
+	OP(0x18)	/* JR $N+2 */	\
 		M80_BRANCH;	\
-		break;	\
-	case 0x19:	/* ADD HL, DE */	\
+		NEXT	\
+	OP(0x19)	/* ADD HL, DE */	\
 		M80_ADD_REGS16(HL, DE);	\
-		break;	\
-	case 0x1A:	/* LD A, (DE) */	\
+		NEXT	\
+	OP(0x1A)	/* LD A, (DE) */	\
 		A = M80_READ_BYTE(DE);	\
-		break;	\
-	case 0x1B:	/* DEC DE */	\
+		NEXT	\
+	OP(0x1B)	/* DEC DE */	\
 		DE--;	\
-		break;	\
-	case 0x1C:	/* INC E */	\
+		NEXT	\
+	OP(0x1C)	/* INC E */	\
 		M80_INC_REG8(E);	\
-		break;	\
-	case 0x1D:	/* DEC E */	\
+		NEXT	\
+	OP(0x1D)	/* DEC E */	\
 		M80_DEC_REG8(E);	\
-		break;	\
-	case 0x1E:	/* LD E, N */	\
+		NEXT	\
+	OP(0x1E)	/* LD E, N */	\
 		E = M80_GET_ARG;	\
-		break;	\
-	case 0x1F:	/* RRA */	\
+		NEXT	\
+	OP(0x1F)	/* RRA */	\
 		M80_RRA;	\
-		break;	\
-	case 0x20:	/* JR NZ,$+2 */	\
+		NEXT	\
+	OP(0x20)	/* JR NZ,$+2 */	\
 		M80_BRANCH_COND ((FLAGS & Z_FLAG) == 0);	\
-		break;	\
-	case 0x21:	/* LD HL, NN */	\
+		NEXT	\
+	OP(0x21)	/* LD HL, NN */	\
 		HL = M80_GET_WORD;	\
-		break;	\
-	case 0x22:	/* LD (NN), HL */	\
+		NEXT	\
+	OP(0x22)	/* LD (NN), HL */	\
 		temp_word = M80_PEEK_WORD;	\
 		PC += 2;	\
 		M80_WRITE_WORD(temp_word, M80_HL);	\
-		break;	\
-	case 0x23:	/* INC HL */	\
+		NEXT	\
+	OP(0x23)	/* INC HL */	\
 		HL++;	\
-		break;	\
-	case 0x24:	/* INC H */	\
+		NEXT	\
+	OP(0x24)	/* INC H */	\
 		M80_INC_REG8(H);	\
-		break;	\
-	case 0x25:	/* DEC H */	\
+		NEXT	\
+	OP(0x25)	/* DEC H */	\
 		M80_DEC_REG8(H);	\
-		break;	\
-	case 0x26:	/* LD H, N */	\
+		NEXT	\
+	OP(0x26)	/* LD H, N */	\
 		H = M80_GET_ARG;	\
-		break;	\
-	case 0x27:	/* DAA */	\
+		NEXT	\
+	OP(0x27)	/* DAA */	\
 		M80_DAA;	\
-		break;	\
-	case 0x28:	/* JR Z, $+2 */	\
+		NEXT	\
+	OP(0x28)	/* JR Z, $+2 */	\
 		M80_BRANCH_COND (FLAGS & Z_FLAG);	\
-		break;	\
-	case 0x29:	/* ADD HL, HL */	\
+		NEXT	\
+	OP(0x29)	/* ADD HL, HL */	\
 		M80_ADD_REGS16(HL, HL);	\
-		break;	\
-	case 0x2A:	/* LD HL, (NN) */	\
+		NEXT	\
+	OP(0x2A)	/* LD HL, (NN) */	\
 		temp_word = M80_PEEK_WORD;	\
 		PC += 2;	\
 		M80_READ_WORD(temp_word, M80_HL);	\
-		break;	\
-	case 0x2B:	/* DEC HL */	\
+		NEXT	\
+	OP(0x2B)	/* DEC HL */	\
 		HL--;	\
-		break;	\
-	case 0x2C:	/* INC L */	\
+		NEXT	\
+	OP(0x2C)	/* INC L */	\
 		M80_INC_REG8(L);	\
-		break;	\
-	case 0x2D:	/* DEC L */	\
+		NEXT	\
+	OP(0x2D)	/* DEC L */	\
 		M80_DEC_REG8(L);	\
-		break;	\
-	case 0x2E:	/* LD L, N */	\
+		NEXT	\
+	OP(0x2E)	/* LD L, N */	\
 		L = M80_GET_ARG;	\
-		break;	\
-	case 0x2F:	/* CPL, XOR's accumulator by 0xFF */	\
+		NEXT	\
+	OP(0x2F)	/* CPL, XOR's accumulator by 0xFF */	\
 		M80_CPL;	\
-		break;	\
-	case 0x30:	/* JR NC, $+2 */	\
+		NEXT	\
+	OP(0x30)	/* JR NC, $+2 */	\
 		M80_BRANCH_COND (!(FLAGS & C_FLAG));	/* if Carry flag is clear, branch */	\
-		break;	\
-	case 0x31:	/* LD SP, NN */	\
+		NEXT	\
+	OP(0x31)	/* LD SP, NN */	\
 		SP = M80_GET_WORD;	\
-		break;	\
-	case 0x32:	/* LD (NN), A */	\
+		NEXT	\
+	OP(0x32)	/* LD (NN), A */	\
 		temp_word = M80_PEEK_WORD;	\
 		PC += 2;	\
 		M80_WRITE_BYTE(temp_word, A);	\
-		break;	\
-	case 0x33:	/* INC SP */	\
+		NEXT	\
+	OP(0x33)	/* INC SP */	\
 		SP++;	\
-		break;	\
-	case 0x34:	/* INC (HL) */	\
+		NEXT	\
+	OP(0x34)	/* INC (HL) */	\
 		{	\
 			Uint8 temp = M80_READ_BYTE(HL);	\
 			M80_INC_REG8(temp);	\
 			M80_WRITE_BYTE(HL, temp);	\
 		}	\
-		break;	\
-	case 0x35:	/* DEC (HL) */	\
+		NEXT	\
+	OP(0x35)	/* DEC (HL) */	\
 		{	\
 			Uint8 temp = M80_READ_BYTE(HL);	\
 			M80_DEC_REG8(temp);	\
 			M80_WRITE_BYTE(HL, temp);	\
 		}	\
-		break;	\
-	case 0x36:	/* LD (HL), N */	\
+		NEXT	\
+	OP(0x36)	/* LD (HL), N */	\
 		M80_WRITE_BYTE(HL, M80_GET_ARG);	\
-		break;	\
-	case 0x37:	/* SCF (Set Carry Flag) */	\
+		NEXT	\
+	OP(0x37)	/* SCF (Set Carry Flag) */	\
 		M80_SCF;	\
-		break;	\
-	case 0x38:	/* JR C, $+2 */	\
+		NEXT	\
+	OP(0x38)	/* JR C, $+2 */	\
 		M80_BRANCH_COND (FLAGS & C_FLAG);	\
-		break;	\
-	case 0x39:	/* ADD HL, SP */	\
+		NEXT	\
+	OP(0x39)	/* ADD HL, SP */	\
 		M80_ADD_REGS16(HL, SP);	\
-		break;	\
-	case 0x3A:	/* LD A, (NN) */	\
+		NEXT	\
+	OP(0x3A)	/* LD A, (NN) */	\
 		temp_word = M80_PEEK_WORD;	\
 		PC += 2;	\
 		A = M80_READ_BYTE(temp_word);	\
-		break;	\
-	case 0x3B:	/* DEC SP */	\
+		NEXT	\
+	OP(0x3B)	/* DEC SP */	\
 		SP--;	\
-		break;	\
-	case 0x3C:	/* INC A */	\
+		NEXT	\
+	OP(0x3C)	/* INC A */	\
 		M80_INC_REG8(A);	\
-		break;	\
-	case 0x3D:	/* DEC A */	\
+		NEXT	\
+	OP(0x3D)	/* DEC A */	\
 		M80_DEC_REG8(A);	\
-		break;	\
-	case 0x3E:	/* LD A, N */	\
+		NEXT	\
+	OP(0x3E)	/* LD A, N */	\
 		A = M80_GET_ARG;	\
-		break;	\
-	case 0x3F:	/* CCF	complement carry flag */	\
+		NEXT	\
+	OP(0x3F)	/* CCF	complement carry flag */	\
 		M80_CCF;	\
-		break;	\
-	case 0x40:	/*LD B,B	(nop) */	\
-		break;	\
-	case 0x41:	/* LD B,C */	\
+		NEXT	\
+	OP(0x40)	/*LD B,B	(nop) */	\
+		NEXT	\
+	OP(0x41)	/* LD B,C */	\
 		B = C;	\
-		break;	\
-	case 0x42:	/* LD B,D */	\
+		NEXT	\
+	OP(0x42)	/* LD B,D */	\
 		B = D;	\
-		break;	\
-	case 0x43:	/* LD B,E */	\
+		NEXT	\
+	OP(0x43)	/* LD B,E */	\
 		B = E;	\
-		break;	\
-	case 0x44:	/* LD B,H */	\
+		NEXT	\
+	OP(0x44)	/* LD B,H */	\
 		B = H;	\
-		break;	\
-	case 0x45:	/* LD B,L */	\
+		NEXT	\
+	OP(0x45)	/* LD B,L */	\
 		B = L;	\
-		break;	\
-	case 0x46:	/* LD B,(HL) */	\
+		NEXT	\
+	OP(0x46)	/* LD B,(HL) */	\
 		B = M80_READ_BYTE(HL);	\
-		break;	\
-	case 0x47:	/* LD B,A */	\
+		NEXT	\
+	OP(0x47)	/* LD B,A */	\
 		B = A;	\
-		break;	\
-	case 0x48:	/* LD C,B */	\
+		NEXT	\
+	OP(0x48)	/* LD C,B */	\
 		C = B;	\
-		break;	\
-	case 0x49:	/* LD C,C (NOP) */	\
-		break;	\
-	case 0x4A:	/* LD C,D */	\
+		NEXT	\
+	OP(0x49)	/* LD C,C (NOP) */	\
+		NEXT	\
+	OP(0x4A)	/* LD C,D */	\
 		C = D;	\
-		break;	\
-	case 0x4B:	/* LD C,E */	\
+		NEXT	\
+	OP(0x4B)	/* LD C,E */	\
 		C = E;	\
-		break;	\
-	case 0x4C:	/* LD C,H */	\
+		NEXT	\
+	OP(0x4C)	/* LD C,H */	\
 		C = H;	\
-		break;	\
-	case 0x4D:	/* LD C,L */	\
+		NEXT	\
+	OP(0x4D)	/* LD C,L */	\
 		C = L;	\
-		break;	\
-	case 0x4E:	/* LD C,(HL) */	\
+		NEXT	\
+	OP(0x4E)	/* LD C,(HL) */	\
 		C = M80_READ_BYTE(HL);	\
-		break;	\
-	case 0x4F:	/* LD C,A */	\
+		NEXT	\
+	OP(0x4F)	/* LD C,A */	\
 		C = A;	\
-		break;	\
-	case 0x50:	/* LD D,B */	\
+		NEXT	\
+	OP(0x50)	/* LD D,B */	\
 		D = B;	\
-		break;	\
-	case 0x51:	/* LD D,C */	\
+		NEXT	\
+	OP(0x51)	/* LD D,C */	\
 		D = C;	\
-		break;	\
-	case 0x52:	/* LD D,D */	\
-		break;	\
-	case 0x53:	/* LD D,E */	\
+		NEXT	\
+	OP(0x52)	/* LD D,D */	\
+		NEXT	\
+	OP(0x53)	/* LD D,E */	\
 		D = E;	\
-		break;	\
-	case 0x54:	/* LD D,H */	\
+		NEXT	\
+	OP(0x54)	/* LD D,H */	\
 		D = H;	\
-		break;	\
-	case 0x55:	/* LD D,L */	\
+		NEXT	\
+	OP(0x55)	/* LD D,L */	\
 		D = L;	\
-		break;	\
-	case 0x56:	/* LD D,(HL) */	\
+		NEXT	\
+	OP(0x56)	/* LD D,(HL) */	\
 		D = M80_READ_BYTE(HL);	\
-		break;	\
-	case 0x57:	/* LD D,A */	\
+		NEXT	\
+	OP(0x57)	/* LD D,A */	\
 		D = A;	\
-		break;	\
-	case 0x58:	/* LD E,B */	\
+		NEXT	\
+	OP(0x58)	/* LD E,B */	\
 		E = B;	\
-		break;	\
-	case 0x59:	/* LD E,C */	\
+		NEXT	\
+	OP(0x59)	/* LD E,C */	\
 		E = C;	\
-		break;	\
-	case 0x5A:	/* LD E,D */	\
+		NEXT	\
+	OP(0x5A)	/* LD E,D */	\
 		E = D;	\
-		break;	\
-	case 0x5B:	/* LD E,E */	\
+		NEXT	\
+	OP(0x5B)	/* LD E,E */	\
 		/* nop */	\
-		break;	\
-	case 0x5C:	/* LD E, H */	\
+		NEXT	\
+	OP(0x5C)	/* LD E, H */	\
 		E = H;	\
-		break;	\
-	case 0x5D:	/* LD E, L */	\
+		NEXT	\
+	OP(0x5D)	/* LD E, L */	\
 		E = L;	\
-		break;	\
-	case 0x5E:	/* LD E, (HL) */	\
+		NEXT	\
+	OP(0x5E)	/* LD E, (HL) */	\
 		E = M80_READ_BYTE(HL);	\
-		break;	\
-	case 0x5F:	/* LD E,A */	\
+		NEXT	\
+	OP(0x5F)	/* LD E,A */	\
 		E = A;	\
-		break;	\
-	case 0x60:	/* LD H,B */	\
+		NEXT	\
+	OP(0x60)	/* LD H,B */	\
 		H = B;	\
-		break;	\
-	case 0x61:	/* LD H,C */	\
+		NEXT	\
+	OP(0x61)	/* LD H,C */	\
 		H = C;	\
-		break;	\
-	case 0x62:	/* LD H,D */	\
+		NEXT	\
+	OP(0x62)	/* LD H,D */	\
 		H = D;	\
-		break;	\
-	case 0x63:	/* LD H,E */	\
+		NEXT	\
+	OP(0x63)	/* LD H,E */	\
 		H = E;	\
-		break;	\
-	case 0x64:	/* LD H, H */	\
+		NEXT	\
+	OP(0x64)	/* LD H, H */	\
 		/* nop */	\
-		break;	\
-	case 0x65:	/* LD H, L */	\
+		NEXT	\
+	OP(0x65)	/* LD H, L */	\
 		H = L;	\
-		break;	\
-	case 0x66:	/* LD H, (HL) */	\
+		NEXT	\
+	OP(0x66)	/* LD H, (HL) */	\
 		H = M80_READ_BYTE(HL);	\
-		break;	\
-	case 0x67:	/* LD H, A */	\
+		NEXT	\
+	OP(0x67)	/* LD H, A */	\
 		H = A;	\
-		break;	\
-	case 0x68:	/* LD L, B */	\
+		NEXT	\
+	OP(0x68)	/* LD L, B */	\
 		L = B;	\
-		break;	\
-	case 0x69:	/* LD L, C */	\
+		NEXT	\
+	OP(0x69)	/* LD L, C */	\
 		L = C;	\
-		break;	\
-	case 0x6A:	/* LD L, D */	\
+		NEXT	\
+	OP(0x6A)	/* LD L, D */	\
 		L = D;	\
-		break;	\
-	case 0x6B:	/* LD L, E */	\
+		NEXT	\
+	OP(0x6B)	/* LD L, E */	\
 		L = E;	\
-		break;	\
-	case 0x6C:	/* LD L, H */	\
+		NEXT	\
+	OP(0x6C)	/* LD L, H */	\
 		L = H;	\
-		break;	\
-	case 0x6D:	/* LD L, L */	\
+		NEXT	\
+	OP(0x6D)	/* LD L, L */	\
 		/* nop */	\
-		break;	\
-	case 0x6E:	/* LD L, (HL) */	\
+		NEXT	\
+	OP(0x6E)	/* LD L, (HL) */	\
 		L = M80_READ_BYTE(HL);	\
-		break;	\
-	case 0x6F:	/* LD L, A */	\
+		NEXT	\
+	OP(0x6F)	/* LD L, A */	\
 		L = A;	\
-		break;	\
-	case 0x70:	/* LD (HL), B */	\
+		NEXT	\
+	OP(0x70)	/* LD (HL), B */	\
 		M80_WRITE_BYTE(HL, B);	\
-		break;	\
-	case 0x71:	/* LD (HL), C */	\
+		NEXT	\
+	OP(0x71)	/* LD (HL), C */	\
 		M80_WRITE_BYTE(HL, C);	\
-		break;	\
-	case 0x72:	/* LD (HL), D */	\
+		NEXT	\
+	OP(0x72)	/* LD (HL), D */	\
 		M80_WRITE_BYTE(HL, D);	\
-		break;	\
-	case 0x73:	/* LD (HL), E */	\
+		NEXT	\
+	OP(0x73)	/* LD (HL), E */	\
 		M80_WRITE_BYTE(HL, E);	\
-		break;	\
-	case 0x74:	/* LD (HL), H */	\
+		NEXT	\
+	OP(0x74)	/* LD (HL), H */	\
 		M80_WRITE_BYTE(HL, H);	\
-		break;	\
-	case 0x75:	/* LD (HL), L */	\
+		NEXT	\
+	OP(0x75)	/* LD (HL), L */	\
 		M80_WRITE_BYTE(HL, L);	\
-		break;	\
-	case 0x76:	/* HALT (waits for an interrupt) */	\
+		NEXT	\
+	OP(0x76)	/* HALT (waits for an interrupt) */	\
 		M80_START_HALT;	\
-		break;	\
-	case 0x77:	/* LD (HL), A */	\
+		NEXT	\
+	OP(0x77)	/* LD (HL), A */	\
 		M80_WRITE_BYTE(HL, A);	\
-		break;	\
-	case 0x78:	/* LD A,B */	\
+		NEXT	\
+	OP(0x78)	/* LD A,B */	\
 		A = B;	\
-		break;	\
-	case 0x79:	/* LD A,C */	\
+		NEXT	\
+	OP(0x79)	/* LD A,C */	\
 		A = C;	\
-		break;	\
-	case 0x7A:	/* LD A,D */	\
+		NEXT	\
+	OP(0x7A)	/* LD A,D */	\
 		A = D;	\
-		break;	\
-	case 0x7B:	/* LD A,E */	\
+		NEXT	\
+	OP(0x7B)	/* LD A,E */	\
 		A = E;	\
-		break;	\
-	case 0x7C:	/* LD A,H */	\
+		NEXT	\
+	OP(0x7C)	/* LD A,H */	\
 		A = H;	\
-		break;	\
-	case 0x7D:	/* LD A,L */	\
+		NEXT	\
+	OP(0x7D)	/* LD A,L */	\
 		A = L;	\
-		break;	\
-	case 0x7E:	/* LD A, (HL) */	\
+		NEXT	\
+	OP(0x7E)	/* LD A, (HL) */	\
 		A = M80_READ_BYTE(HL);	\
-		break;	\
-	case 0x7F:	/* LD A,A */	\
+		NEXT	\
+	OP(0x7F)	/* LD A,A */	\
 		/* nop */	\
-		break;	\
-	case 0x80:	/* ADD A,B */	\
+		NEXT	\
+	OP(0x80)	/* ADD A,B */	\
 		M80_ADD_TO_A(B);	\
-		break;	\
-	case 0x81:	/* ADD A,C */	\
+		NEXT	\
+	OP(0x81)	/* ADD A,C */	\
 		M80_ADD_TO_A(C);	\
-		break;	\
-	case 0x82:	/* ADD A,D */	\
+		NEXT	\
+	OP(0x82)	/* ADD A,D */	\
 		M80_ADD_TO_A(D);	\
-		break;	\
-	case 0x83:	/* ADD A,E */	\
+		NEXT	\
+	OP(0x83)	/* ADD A,E */	\
 		M80_ADD_TO_A(E);	\
-		break;	\
-	case 0x84:	/* ADD A,H */	\
+		NEXT	\
+	OP(0x84)	/* ADD A,H */	\
 		M80_ADD_TO_A(H);	\
-		break;	\
-	case 0x85:	/* ADD A,L */	\
+		NEXT	\
+	OP(0x85)	/* ADD A,L */	\
 		M80_ADD_TO_A(L);	\
-		break;	\
-	case 0x86:	/* ADD A,(HL) */	\
+		NEXT	\
+	OP(0x86)	/* ADD A,(HL) */	\
 		M80_ADD_TO_A(M80_READ_BYTE(HL));	\
-		break;	\
-	case 0x87:	/* ADD A,A */	\
+		NEXT	\
+	OP(0x87)	/* ADD A,A */	\
 		M80_ADD_TO_A(A);	\
-		break;	\
-	case 0x88:	/* ADC A,B */	\
+		NEXT	\
+	OP(0x88)	/* ADC A,B */	\
 		M80_ADC_TO_A(B);	\
-		break;	\
-	case 0x89:	/* ADC A,C */	\
+		NEXT	\
+	OP(0x89)	/* ADC A,C */	\
 		M80_ADC_TO_A(C);	\
-		break;	\
-	case 0x8A:	/* ADC A,D */	\
+		NEXT	\
+	OP(0x8A)	/* ADC A,D */	\
 		M80_ADC_TO_A(D);	\
-		break;	\
-	case 0x8B:	/* ADC A,E */	\
+		NEXT	\
+	OP(0x8B)	/* ADC A,E */	\
 		M80_ADC_TO_A(E);	\
-		break;	\
-	case 0x8C:	/* ADC A,H */	\
+		NEXT	\
+	OP(0x8C)	/* ADC A,H */	\
 		M80_ADC_TO_A(H);	\
-		break;	\
-	case 0x8D:	/* ADC A,L */	\
+		NEXT	\
+	OP(0x8D)	/* ADC A,L */	\
 		M80_ADC_TO_A(L);	\
-		break;	\
-	case 0x8E:	/* ADC A,(HL) */	\
+		NEXT	\
+	OP(0x8E)	/* ADC A,(HL) */	\
 		M80_ADC_TO_A(M80_READ_BYTE(HL));	\
-		break;	\
-	case 0x8F:	/* ADC A,A */	\
+		NEXT	\
+	OP(0x8F)	/* ADC A,A */	\
 		M80_ADC_TO_A(A);	\
-		break;	\
-	case 0x90:	/* SUB B */	\
+		NEXT	\
+	OP(0x90)	/* SUB B */	\
 		M80_SUB_FROM_A(B);	\
-		break;	\
-	case 0x91:	/* SUB C */	\
+		NEXT	\
+	OP(0x91)	/* SUB C */	\
 		M80_SUB_FROM_A(C);	\
-		break;	\
-	case 0x92:	/* SUB D */	\
+		NEXT	\
+	OP(0x92)	/* SUB D */	\
 		M80_SUB_FROM_A(D);	\
-		break;	\
-	case 0x93:	/* SUB E */	\
+		NEXT	\
+	OP(0x93)	/* SUB E */	\
 		M80_SUB_FROM_A(E);	\
-		break;	\
-	case 0x94:	/* SUB H */	\
+		NEXT	\
+	OP(0x94)	/* SUB H */	\
 		M80_SUB_FROM_A(H);	\
-		break;	\
-	case 0x95:	/* SUB L */	\
+		NEXT	\
+	OP(0x95)	/* SUB L */	\
 		M80_SUB_FROM_A(L);	\
-		break;	\
-	case 0x96:	/* SUB (HL) */	\
+		NEXT	\
+	OP(0x96)	/* SUB (HL) */	\
 		M80_SUB_FROM_A(M80_READ_BYTE(HL));	\
-		break;	\
-	case 0x97:	/* SUB A */	\
+		NEXT	\
+	OP(0x97)	/* SUB A */	\
 		M80_SUB_FROM_A(A);	\
-		break;	\
-	case 0x98:	/* SBC A,B */	\
+		NEXT	\
+	OP(0x98)	/* SBC A,B */	\
 		M80_SBC_FROM_A(B);	\
-		break;	\
-	case 0x99:	/* SBC A,C */	\
+		NEXT	\
+	OP(0x99)	/* SBC A,C */	\
 		M80_SBC_FROM_A(C);	\
-		break;	\
-	case 0x9A:	/* SBC A,D */	\
+		NEXT	\
+	OP(0x9A)	/* SBC A,D */	\
 		M80_SBC_FROM_A(D);	\
-		break;	\
-	case 0x9B:	/* SBC A,E */	\
+		NEXT	\
+	OP(0x9B)	/* SBC A,E */	\
 		M80_SBC_FROM_A(E);	\
-		break;	\
-	case 0x9C:	/* SBC A,H */	\
+		NEXT	\
+	OP(0x9C)	/* SBC A,H */	\
 		M80_SBC_FROM_A(H);	\
-		break;	\
-	case 0x9D:	/* SBC A,L */	\
+		NEXT	\
+	OP(0x9D)	/* SBC A,L */	\
 		M80_SBC_FROM_A(L);	\
-		break;	\
-	case 0x9E:	/* SBC A, (HL) */	\
+		NEXT	\
+	OP(0x9E)	/* SBC A, (HL) */	\
 		M80_SBC_FROM_A(M80_READ_BYTE(HL));	\
-		break;	\
-	case 0x9F:	/* SBC A,A */	\
+		NEXT	\
+	OP(0x9F)	/* SBC A,A */	\
 		M80_SBC_FROM_A(A);	\
-		break;	\
-	case 0xA0:	/* AND B */	\
+		NEXT	\
+	OP(0xA0)	/* AND B */	\
 		M80_AND_WITH_A(B);	\
-		break;	\
-	case 0xA1:	/* AND C */	\
+		NEXT	\
+	OP(0xA1)	/* AND C */	\
 		M80_AND_WITH_A(C);	\
-		break;	\
-	case 0xA2:	/* AND D */	\
+		NEXT	\
+	OP(0xA2)	/* AND D */	\
 		M80_AND_WITH_A(D);	\
-		break;	\
-	case 0xA3:	/* AND E */	\
+		NEXT	\
+	OP(0xA3)	/* AND E */	\
 		M80_AND_WITH_A(E);	\
-		break;	\
-	case 0xA4:	/* AND H */	\
+		NEXT	\
+	OP(0xA4)	/* AND H */	\
 		M80_AND_WITH_A(H);	\
-		break;	\
-	case 0xA5:	/* AND L */	\
+		NEXT	\
+	OP(0xA5)	/* AND L */	\
 		M80_AND_WITH_A(L);	\
-		break;	\
-	case 0xA6:	/* AND (HL) */	\
+		NEXT	\
+	OP(0xA6)	/* AND (HL) */	\
 		M80_AND_WITH_A(M80_READ_BYTE(HL));	\
-		break;	\
-	case 0xA7:	/* AND A */	\
+		NEXT	\
+	OP(0xA7)	/* AND A */	\
 		M80_AND_WITH_A(A);	\
-		break;	\
-	case 0xA8:	/* XOR B */	\
+		NEXT	\
+	OP(0xA8)	/* XOR B */	\
 		M80_XOR_WITH_A(B);	\
-		break;	\
-	case 0xA9:	/* XOR C */	\
+		NEXT	\
+	OP(0xA9)	/* XOR C */	\
 		M80_XOR_WITH_A(C);	\
-		break;	\
-	case 0xAA:	/* XOR D */	\
+		NEXT	\
+	OP(0xAA)	/* XOR D */	\
 		M80_XOR_WITH_A(D);	\
-		break;	\
-	case 0xAB:	/* XOR E */	\
+		NEXT	\
+	OP(0xAB)	/* XOR E */	\
 		M80_XOR_WITH_A(E);	\
-		break;	\
-	case 0xAC:	/* XOR H */	\
+		NEXT	\
+	OP(0xAC)	/* XOR H */	\
 		M80_XOR_WITH_A(H);	\
-		break;	\
-	case 0xAD:	/* XOR L */	\
+		NEXT	\
+	OP(0xAD)	/* XOR L */	\
 		M80_XOR_WITH_A(L);	\
-		break;	\
-	case 0xAE:	/* XOR (HL) */	\
+		NEXT	\
+	OP(0xAE)	/* XOR (HL) */	\
 		M80_XOR_WITH_A(M80_READ_BYTE(HL));	\
-		break;	\
-	case 0xAF:	/* XOR A */	\
+		NEXT	\
+	OP(0xAF)	/* XOR A */	\
 		A = 0;	/* XOR'ing a register with itself produces 0 */	\
 		FLAGS = Z_FLAG | P_FLAG; /* signed=clear, Zero=set, HC=clear, parity is even, N=clear, C=clear */	\
-		break;	\
-	case 0xB0:	/* OR B */	\
+		NEXT	\
+	OP(0xB0)	/* OR B */	\
 		M80_OR_WITH_A(B);	\
-		break;	\
-	case 0xB1:	/* OR C */	\
+		NEXT	\
+	OP(0xB1)	/* OR C */	\
 		M80_OR_WITH_A(C);	\
-		break;	\
-	case 0xB2:	/* OR D */	\
+		NEXT	\
+	OP(0xB2)	/* OR D */	\
 		M80_OR_WITH_A(D);	\
-		break;	\
-	case 0xB3:	/* OR E */	\
+		NEXT	\
+	OP(0xB3)	/* OR E */	\
 		M80_OR_WITH_A(E);	\
-		break;	\
-	case 0xB4:	/* OR H */	\
+		NEXT	\
+	OP(0xB4)	/* OR H */	\
 		M80_OR_WITH_A(H);	\
-		break;	\
-	case 0xB5:	/* OR L */	\
+		NEXT	\
+	OP(0xB5)	/* OR L */	\
 		M80_OR_WITH_A(L);	\
-		break;	\
-	case 0xB6:	/* OR (HL) */	\
+		NEXT	\
+	OP(0xB6)	/* OR (HL) */	\
 		M80_OR_WITH_A(M80_READ_BYTE(HL));	\
-		break;	\
-	case 0xB7:	/* OR A */	\
+		NEXT	\
+	OP(0xB7)	/* OR A */	\
 		M80_OR_WITH_A(A);	\
-		break;	\
-	case 0xB8:	/* Compare B */	\
+		NEXT	\
+	OP(0xB8)	/* Compare B */	\
 		M80_COMPARE_WITH_A(B);	\
-		break;	\
-	case 0xB9:	/* CP C */	\
+		NEXT	\
+	OP(0xB9)	/* CP C */	\
 		M80_COMPARE_WITH_A(C);	\
-		break;	\
-	case 0xBA:	/* CP D */	\
+		NEXT	\
+	OP(0xBA)	/* CP D */	\
 		M80_COMPARE_WITH_A(D);	\
-		break;	\
-	case 0xBB:	/* CP E */	\
+		NEXT	\
+	OP(0xBB)	/* CP E */	\
 		M80_COMPARE_WITH_A(E);	\
-		break;	\
-	case 0xBC:	/* CP H */	\
+		NEXT	\
+	OP(0xBC)	/* CP H */	\
 		M80_COMPARE_WITH_A(H);	\
-		break;	\
-	case 0xBD:	/* CP L */	\
+		NEXT	\
+	OP(0xBD)	/* CP L */	\
 		M80_COMPARE_WITH_A(L);	\
-		break;	\
-	case 0xBE:	/* CP (HL) */	\
+		NEXT	\
+	OP(0xBE)	/* CP (HL) */	\
 		M80_COMPARE_WITH_A(M80_READ_BYTE(HL));	\
-		break;	\
-	case 0xBF:	/* CP A */	\
+		NEXT	\
+	OP(0xBF)	/* CP A */	\
 		M80_COMPARE_WITH_A(A);	\
-		break;	\
-	case 0xC0:	/* Return if Z_FLAG is not set */	\
+		NEXT	\
+	OP(0xC0)	/* Return if Z_FLAG is not set */	\
 		M80_RET_COND((FLAGS & Z_FLAG) == 0);	\
-		break;	\
-	case 0xC1:	/* POP top of stack into BC  */	\
+		NEXT	\
+	OP(0xC1)	/* POP top of stack into BC  */	\
 		M80_POP16(M80_BC);	\
-		break;	\
-	case 0xC2:	/* Jump if Not Z_FLAG to nnnn */	\
+		NEXT	\
+	OP(0xC2)	/* Jump if Not Z_FLAG to nnnn */	\
 		M80_JUMP_COND((FLAGS & Z_FLAG) == 0);	\
-		break;	\
-	case 0xC3:	/* unconditional Jump to nnnn */	\
+		NEXT	\
+	OP(0xC3)	/* unconditional Jump to nnnn */	\
 		M80_JUMP;	\
-		break;	\
-	case 0xC4:	/* Call nnnn if not Z_FLAG */	\
+		NEXT	\
+	OP(0xC4)	/* Call nnnn if not Z_FLAG */	\
 		M80_CALL_COND((FLAGS & Z_FLAG) == 0);	\
-		break;	\
-	case 0xC5:	/* PUSH BC */	\
+		NEXT	\
+	OP(0xC5)	/* PUSH BC */	\
 		M80_PUSH16(M80_BC);	\
-		break;	\
-	case 0xC6:	/* ADD A, nn */	\
+		NEXT	\
+	OP(0xC6)	/* ADD A, nn */	\
 		M80_ADD_TO_A(M80_PEEK_ARG);	\
 		PC++;	\
-		break;	\
-	case 0xC7:	/* RST 0  (Reset 0) */	\
+		NEXT	\
+	OP(0xC7)	/* RST 0  (Reset 0) */	\
 		M80_RST(0);	\
-		break;	\
-	case 0xC8:	/* RET Z (Return if Z_Flag is set) */	\
+		NEXT	\
+	OP(0xC8)	/* RET Z (Return if Z_Flag is set) */	\
 		M80_RET_COND (FLAGS & Z_FLAG);	\
-		break;	\
-	case 0xC9:	/* unconditional RET */	\
+		NEXT	\
+	OP(0xC9)	/* unconditional RET */	\
 		M80_RET;	\
-		break;	\
-	case 0xCA:	/* JP Z, nnnn  (Jump if Z_FLAG is set) */	\
+		NEXT	\
+	OP(0xCA)	/* JP Z, nnnn  (Jump if Z_FLAG is set) */	\
 		M80_JUMP_COND (FLAGS & Z_FLAG);	\
-		break;	\
-	case 0xCB:	/* there are a ton of "CB" instructions */	\
+		NEXT	\
+	OP(0xCB)	/* there are a ton of "CB" instructions */	\
 		m80_exec_cb();	\
-		break;	\
-	case 0xCC:	/* CALL Z, nnnn (Call function if Z_FLAG is set) */	\
+		NEXT	\
+	OP(0xCC)	/* CALL Z, nnnn (Call function if Z_FLAG is set) */	\
 		M80_CALL_COND (FLAGS & Z_FLAG);	\
-		break;	\
-	case 0xCD:	/*  unconditional CALL */	\
+		NEXT	\
+	OP(0xCD)	/*  unconditional CALL */	\
 		M80_CALL;	\
-		break;	\
-	case 0xCE:	/* ADC A, nn */	\
+		NEXT	\
+	OP(0xCE)	/* ADC A, nn */	\
 		M80_ADC_TO_A(M80_PEEK_ARG);	\
 		PC++;	\
-		break;	\
-	case 0xCF:	/* RST 8 */	\
+		NEXT	\
+	OP(0xCF)	/* RST 8 */	\
 		M80_RST(8);	\
-		break;	\
-	case 0xD0:	/* RET NC (return if carry flag is clear) */	\
+		NEXT	\
+	OP(0xD0)	/* RET NC (return if carry flag is clear) */	\
 		M80_RET_COND ((FLAGS & C_FLAG) == 0);	\
-		break;	\
-	case 0xD1:	/* POP DE */	\
+		NEXT	\
+	OP(0xD1)	/* POP DE */	\
 		M80_POP16(M80_DE);	\
-		break;	\
-	case 0xD2:	/* JP NC, nnnn (absolute jump if C_FLAG is clear) */	\
+		NEXT	\
+	OP(0xD2)	/* JP NC, nnnn (absolute jump if C_FLAG is clear) */	\
 		M80_JUMP_COND ((FLAGS & C_FLAG) == 0);	\
-		break;	\
-	case 0xD3:	/* OUT (nn), A	Send A to the specified port */	\
+		NEXT	\
+	OP(0xD3)	/* OUT (nn), A	Send A to the specified port */	\
 		M80_OUT_A(M80_GET_ARG);	\
-		break;	\
-	case 0xD4:	/* CALL NC, nnnn	(call if C_FLAG is clear) */	\
+		NEXT	\
+	OP(0xD4)	/* CALL NC, nnnn	(call if C_FLAG is clear) */	\
 		M80_CALL_COND ((FLAGS & C_FLAG) == 0);	\
-		break;	\
-	case 0xD5:	/* PUSH DE */	\
+		NEXT	\
+	OP(0xD5)	/* PUSH DE */	\
 		M80_PUSH16(M80_DE);	\
-		break;	\
-	case 0xD6:	/* SUB nn */	\
+		NEXT	\
+	OP(0xD6)	/* SUB nn */	\
 		M80_SUB_FROM_A(M80_PEEK_ARG);	\
 		PC++;	\
-		break;	\
-	case 0xD7:	/* RST 0x10 */	\
+		NEXT	\
+	OP(0xD7)	/* RST 0x10 */	\
 		M80_RST(0x10);	\
-		break;	\
-	case 0xD8:	/* RET C (return if C_FLAG is set) */	\
+		NEXT	\
+	OP(0xD8)	/* RET C (return if C_FLAG is set) */	\
 		M80_RET_COND (FLAGS & C_FLAG);	\
-		break;	\
-	case 0xD9:	/* EXX (Exchange all registers with their counterparts, except AF) */	\
+		NEXT	\
+	OP(0xD9)	/* EXX (Exchange all registers with their counterparts, except AF) */	\
 		M80_EXX;	\
-		break;	\
-	case 0xDA:	/* JP C, nnnn	Absolute jump if Carry is set */	\
+		NEXT	\
+	OP(0xDA)	/* JP C, nnnn	Absolute jump if Carry is set */	\
 		M80_JUMP_COND (FLAGS & C_FLAG);	\
-		break;	\
-	case 0xDB:	/* IN A, (nn) */	\
+		NEXT	\
+	OP(0xDB)	/* IN A, (nn) */	\
 		M80_IN_A(M80_GET_ARG);	\
-		break;	\
-	case 0xDC:	/* CALL C, nnnn	Call if carry is set */	\
+		NEXT	\
+	OP(0xDC)	/* CALL C, nnnn	Call if carry is set */	\
 		M80_CALL_COND (FLAGS & C_FLAG);	\
-		break;	\
-	case 0xDD:	/* extended instructions */	\
+		NEXT	\
+	OP(0xDD)	/* extended instructions */	\
 		M80_EAT_EXTRA_DD_FD;	\
 		M80_EXEC_DDFD(IX);	\
-		break;	\
-	case 0xDE:	/*	SBC A, nn */	\
+		NEXT	\
+	OP(0xDE)	/*	SBC A, nn */	\
 		M80_SBC_FROM_A(M80_PEEK_ARG);	\
 		PC++;	\
-		break;	\
-	case 0xDF:	/* RST 0x18 */	\
+		NEXT	\
+	OP(0xDF)	/* RST 0x18 */	\
 		M80_RST(0x18);	\
-		break;	\
-	case 0xE0:	/* RET PO	Return of Parity is Odd (parity flag cleared) */	\
+		NEXT	\
+	OP(0xE0)	/* RET PO	Return of Parity is Odd (parity flag cleared) */	\
 		M80_RET_COND ((FLAGS & P_FLAG) == 0);	\
-		break;	\
-	case 0xE1:	/* POP HL */	\
+		NEXT	\
+	OP(0xE1)	/* POP HL */	\
 		M80_POP16(M80_HL);	\
-		break;	\
-	case 0xE2:	/* JP PO, nnnn	(absolute jump of parity is odd, P_FLAG cleared) */	\
+		NEXT	\
+	OP(0xE2)	/* JP PO, nnnn	(absolute jump of parity is odd, P_FLAG cleared) */	\
 		M80_JUMP_COND ((FLAGS & P_FLAG) == 0);	\
-		break;	\
-	case 0xE3:	/* EX (SP), HL	Exchange HL with what's stored in memory at SP */	\
+		NEXT	\
+	OP(0xE3)	/* EX (SP), HL	Exchange HL with what's stored in memory at SP */	\
 		{	\
 			m80_pair temp;	\
 			temp.w = HL;	\
-			g_context.m80_regs[M80_HL].b.l = M80_READ_BYTE(SP);	\
-			g_context.m80_regs[M80_HL].b.h = M80_READ_BYTE(SP+1);	\
+			g_pContext->m80_regs[M80_HL].b.l = M80_READ_BYTE(SP);	\
+			g_pContext->m80_regs[M80_HL].b.h = M80_READ_BYTE(SP+1);	\
 			M80_WRITE_BYTE(SP, temp.b.l);	\
 			M80_WRITE_BYTE(SP+1, temp.b.h);	\
 		}	\
-		break;	\
-	case 0xE4:	/* CALL PO, nnnn	Call if P_FLAG is cleared */	\
+		NEXT	\
+	OP(0xE4)	/* CALL PO, nnnn	Call if P_FLAG is cleared */	\
 		M80_CALL_COND ((FLAGS & P_FLAG) == 0);	\
-		break;	\
-	case 0xE5:	/* PUSH HL */	\
+		NEXT	\
+	OP(0xE5)	/* PUSH HL */	\
 		M80_PUSH16(M80_HL);	\
-		break;	\
-	case 0xE6:	/* AND nn */	\
+		NEXT	\
+	OP(0xE6)	/* AND nn */	\
 		M80_AND_WITH_A(M80_PEEK_ARG);	\
 		PC++;	\
-		break;	\
-	case 0xE7:	/* RST 0x20 */	\
+		NEXT	\
+	OP(0xE7)	/* RST 0x20 */	\
 		M80_RST(0x20);	\
-		break;	\
-	case 0xE8:	/* RET PE (return if parity is even/P_FLAG is set) */	\
+		NEXT	\
+	OP(0xE8)	/* RET PE (return if parity is even/P_FLAG is set) */	\
 		M80_RET_COND (FLAGS & P_FLAG);	\
-		break;	\
-	case 0xE9:	/* JP HL	jump to the address contained in HL */	\
+		NEXT	\
+	OP(0xE9)	/* JP HL	jump to the address contained in HL */	\
 		PC = HL;	\
 		M80_CHANGE_PC(PC);	\
-		break;	\
-	case 0xEA:	/*	JP PE, nnnn	(absolute jump if parity is even) */	\
+		NEXT	\
+	OP(0xEA)	/*	JP PE, nnnn	(absolute jump if parity is even) */	\
 		M80_JUMP_COND (FLAGS & P_FLAG);	\
-		break;	\
-	case 0xEB:	/* EX DE, HL	(swap DE and HL) */	\
+		NEXT	\
+	OP(0xEB)	/* EX DE, HL	(swap DE and HL) */	\
 		M80_EX_DEHL;	\
-		break;	\
-	case 0xEC:	/* CALL PE, nnnn	(call if parity is even) */	\
+		NEXT	\
+	OP(0xEC)	/* CALL PE, nnnn	(call if parity is even) */	\
 		M80_CALL_COND (FLAGS & P_FLAG);	\
-		break;	\
-	case 0xED:	/* a whole new block of ED instructions */	\
+		NEXT	\
+	OP(0xED)	/* a whole new block of ED instructions */	\
 		M80_EXEC_ED;	\
-		break;	\
-	case 0xEE:	/* XOR nn */	\
+		NEXT	\
+	OP(0xEE)	/* XOR nn */	\
 		M80_XOR_WITH_A(M80_PEEK_ARG);	\
 		PC++;	\
-		break;	\
-	case 0xEF:	/* RST 0x28 */	\
+		NEXT	\
+	OP(0xEF)	/* RST 0x28 */	\
 		M80_RST(0x28);	\
-		break;	\
-	case 0xF0:	/* RET P	return if positive (S_FLAG is cleared) */	\
+		NEXT	\
+	OP(0xF0)	/* RET P	return if positive (S_FLAG is cleared) */	\
 		M80_RET_COND ((FLAGS & S_FLAG) == 0);	\
-		break;	\
-	case 0xF1:	/* POP AF */	\
+		NEXT	\
+	OP(0xF1)	/* POP AF */	\
 		M80_POP16(M80_AF);	\
-		break;	\
-	case 0xF2:	/* JP P, nnnn	Jump if positive */	\
+		NEXT	\
+	OP(0xF2)	/* JP P, nnnn	Jump if positive */	\
 		M80_JUMP_COND ((FLAGS & S_FLAG) == 0);	\
-		break;	\
-	case 0xF3:	/* DI (Disable Interrupts) */	\
+		NEXT	\
+	OP(0xF3)	/* DI (Disable Interrupts) */	\
 		M80_DI;	\
-		break;	\
-	case 0xF4:	/* CALL P, nnnn	Call if positive (S_FLAG cleared) */	\
+		NEXT	\
+	OP(0xF4)	/* CALL P, nnnn	Call if positive (S_FLAG cleared) */	\
 		M80_CALL_COND ((FLAGS & S_FLAG) == 0);	\
-		break;	\
-	case 0xF5:	/* PUSH AF */	\
+		NEXT	\
+	OP(0xF5)	/* PUSH AF */	\
 		M80_PUSH16(M80_AF);	\
-		break;	\
-	case 0xF6:	/* OR nn */	\
+		NEXT	\
+	OP(0xF6)	/* OR nn */	\
 		M80_OR_WITH_A(M80_PEEK_ARG);	\
 		PC++;	\
-		break;	\
-	case 0xF7:	/* RST 0x30 */	\
+		NEXT	\
+	OP(0xF7)	/* RST 0x30 */	\
 		M80_RST(0x30);	\
-		break;	\
-	case 0xF8:	/* RET M	Return if negative (S_FLAG set) */	\
+		NEXT	\
+	OP(0xF8)	/* RET M	Return if negative (S_FLAG set) */	\
 		M80_RET_COND(FLAGS & S_FLAG);	\
-		break;	\
-	case 0xF9:	/* LD SP, HL	transfer HL to SP */	\
+		NEXT	\
+	OP(0xF9)	/* LD SP, HL	transfer HL to SP */	\
 		SP = HL;	\
-		break;	\
-	case 0xFA:	/* JP M, nnnn	Jump if Minus sign */	\
+		NEXT	\
+	OP(0xFA)	/* JP M, nnnn	Jump if Minus sign */	\
 		M80_JUMP_COND (FLAGS & S_FLAG);	\
-		break;	\
-	case 0xFB:	/* EI (enable interrupts) */	\
+		NEXT	\
+	OP(0xFB)	/* EI (enable interrupts) */	\
 		M80_EI;	\
-		break;	\
-	case 0xFC:	/* CALL M, nnnn */	\
+		NEXT	\
+	OP(0xFC)	/* CALL M, nnnn */	\
 		M80_CALL_COND (FLAGS & S_FLAG);	\
-		break;	\
-	case 0xFD:	/* extended instructions */	\
+		NEXT	\
+	OP(0xFD)	/* extended instructions */	\
 		M80_EAT_EXTRA_DD_FD;	\
 		M80_EXEC_DDFD(IY);	\
-		break;	\
-	case 0xFE:	/* CP n */	\
+		NEXT	\
+	OP(0xFE)	/* CP n */	\
 		M80_COMPARE_WITH_A(M80_PEEK_ARG);	\
 		PC++;	\
-		break;	\
-	case 0xFF:	/* RST 0x38 */	\
+		NEXT	\
+	OP(0xFF)	/* RST 0x38 */	\
 		M80_RST(0x38);	\
-		break;	\
+		NEXT
+
+#define M80_SWITCH_CASE(n)	case n:
+#define M80_SWITCH_BREAK	break;
+
+/* executes ONE instruction, incrementing PC and g_cycles_executed variable appropriately */
+#define M80_EXEC_CUR_INSTR	\
+{	\
+	Uint8 opcode = M80_GET_ARG;	/* get opcode and increment PC */	\
+	Uint16 temp_word;	\
+	g_cycles_executed += op_cycles[opcode];	\
+	M80_INC_R;	/* for each instruction, increase R at least once */ \
+	switch(opcode)	\
+	{	\
+	M80_MAIN_OPCODES(M80_SWITCH_CASE, M80_SWITCH_BREAK)	\
 	} /* end switch */	\
 } /* end macro */
 
@@ -2970,6 +2988,79 @@ void m80_reset()
 
 
 
+#ifdef M80_THREADED_DISPATCH
+
+#define M80_THREADED_LABEL(n)	m80_op_##n:
+
+/* fetches the next instruction and jumps straight to its code */
+#define M80_THREADED_FETCH	\
+	opcode = M80_GET_ARG;	/* get opcode and increment PC */	\
+	g_cycles_executed += op_cycles[opcode];	\
+	M80_INC_R;	/* for each instruction, increase R at least once */	\
+	goto *op_labels[opcode];
+
+/* finishes an instruction, and goes on to the next one unless it's time to stop */
+#define M80_THREADED_NEXT	\
+	if (bSingleStep || (g_cycles_executed >= cycles_to_execute) || g_pContext->got_EI)	\
+	{	\
+		return;	\
+	}	\
+	M80_THREADED_FETCH
+
+/* Executes instructions until we've exceeded our quota or hit an EI (same as the fast loop in m80_execute). */
+/* If bSingleStep is true, only one instruction is executed. */
+/* Every instruction ends with its own copy of the dispatch code instead of going back through one shared switch, */
+/*  which saves the switch's range check and gives the host cpu's branch predictor one entry per instruction */
+/*  (so it can learn which instruction usually follows which). */
+static void m80_exec_threaded(Uint32 cycles_to_execute, bool bSingleStep)
+{
+	static const void * const op_labels[256] =
+	{
+		&&m80_op_0x00, &&m80_op_0x01, &&m80_op_0x02, &&m80_op_0x03, &&m80_op_0x04, &&m80_op_0x05, &&m80_op_0x06, &&m80_op_0x07, &&m80_op_0x08, &&m80_op_0x09, &&m80_op_0x0A, &&m80_op_0x0B, &&m80_op_0x0C, &&m80_op_0x0D, &&m80_op_0x0E, &&m80_op_0x0F,
+		&&m80_op_0x10, &&m80_op_0x11, &&m80_op_0x12, &&m80_op_0x13, &&m80_op_0x14, &&m80_op_0x15, &&m80_op_0x16, &&m80_op_0x17, &&m80_op_0x18, &&m80_op_0x19, &&m80_op_0x1A, &&m80_op_0x1B, &&m80_op_0x1C, &&m80_op_0x1D, &&m80_op_0x1E, &&m80_op_0x1F,
+		&&m80_op_0x20, &&m80_op_0x21, &&m80_op_0x22, &&m80_op_0x23, &&m80_op_0x24, &&m80_op_0x25, &&m80_op_0x26, &&m80_op_0x27, &&m80_op_0x28, &&m80_op_0x29, &&m80_op_0x2A, &&m80_op_0x2B, &&m80_op_0x2C, &&m80_op_0x2D, &&m80_op_0x2E, &&m80_op_0x2F,
+		&&m80_op_0x30, &&m80_op_0x31, &&m80_op_0x32, &&m80_op_0x33, &&m80_op_0x34, &&m80_op_0x35, &&m80_op_0x36, &&m80_op_0x37, &&m80_op_0x38, &&m80_op_0x39, &&m80_op_0x3A, &&m80_op_0x3B, &&m80_op_0x3C, &&m80_op_0x3D, &&m80_op_0x3E, &&m80_op_0x3F,
+		&&m80_op_0x40, &&m80_op_0x41, &&m80_op_0x42, &&m80_op_0x43, &&m80_op_0x44, &&m80_op_0x45, &&m80_op_0x46, &&m80_op_0x47, &&m80_op_0x48, &&m80_op_0x49, &&m80_op_0x4A, &&m80_op_0x4B, &&m80_op_0x4C, &&m80_op_0x4D, &&m80_op_0x4E, &&m80_op_0x4F,
+		&&m80_op_0x50, &&m80_op_0x51, &&m80_op_0x52, &&m80_op_0x53, &&m80_op_0x54, &&m80_op_0x55, &&m80_op_0x56, &&m80_op_0x57, &&m80_op_0x58, &&m80_op_0x59, &&m80_op_0x5A, &&m80_op_0x5B, &&m80_op_0x5C, &&m80_op_0x5D, &&m80_op_0x5E, &&m80_op_0x5F,
+		&&m80_op_0x60, &&m80_op_0x61, &&m80_op_0x62, &&m80_op_0x63, &&m80_op_0x64, &&m80_op_0x65, &&m80_op_0x66, &&m80_op_0x67, &&m80_op_0x68, &&m80_op_0x69, &&m80_op_0x6A, &&m80_op_0x6B, &&m80_op_0x6C, &&m80_op_0x6D, &&m80_op_0x6E, &&m80_op_0x6F,
+		&&m80_op_0x70, &&m80_op_0x71, &&m80_op_0x72, &&m80_op_0x73, &&m80_op_0x74, &&m80_op_0x75, &&m80_op_0x76, &&m80_op_0x77, &&m80_op_0x78, &&m80_op_0x79, &&m80_op_0x7A, &&m80_op_0x7B, &&m80_op_0x7C, &&m80_op_0x7D, &&m80_op_0x7E, &&m80_op_0x7F,
+		&&m80_op_0x80, &&m80_op_0x81, &&m80_op_0x82, &&m80_op_0x83, &&m80_op_0x84, &&m80_op_0x85, &&m80_op_0x86, &&m80_op_0x87, &&m80_op_0x88, &&m80_op_0x89, &&m80_op_0x8A, &&m80_op_0x8B, &&m80_op_0x8C, &&m80_op_0x8D, &&m80_op_0x8E, &&m80_op_0x8F,
+		&&m80_op_0x90, &&m80_op_0x91, &&m80_op_0x92, &&m80_op_0x93, &&m80_op_0x94, &&m80_op_0x95, &&m80_op_0x96, &&m80_op_0x97, &&m80_op_0x98, &&m80_op_0x99, &&m80_op_0x9A, &&m80_op_0x9B, &&m80_op_0x9C, &&m80_op_0x9D, &&m80_op_0x9E, &&m80_op_0x9F,
+		&&m80_op_0xA0, &&m80_op_0xA1, &&m80_op_0xA2, &&m80_op_0xA3, &&m80_op_0xA4, &&m80_op_0xA5, &&m80_op_0xA6, &&m80_op_0xA7, &&m80_op_0xA8, &&m80_op_0xA9, &&m80_op_0xAA, &&m80_op_0xAB, &&m80_op_0xAC, &&m80_op_0xAD, &&m80_op_0xAE, &&m80_op_0xAF,
+		&&m80_op_0xB0, &&m80_op_0xB1, &&m80_op_0xB2, &&m80_op_0xB3, &&m80_op_0xB4, &&m80_op_0xB5, &&m80_op_0xB6, &&m80_op_0xB7, &&m80_op_0xB8, &&m80_op_0xB9, &&m80_op_0xBA, &&m80_op_0xBB, &&m80_op_0xBC, &&m80_op_0xBD, &&m80_op_0xBE, &&m80_op_0xBF,
+		&&m80_op_0xC0, &&m80_op_0xC1, &&m80_op_0xC2, &&m80_op_0xC3, &&m80_op_0xC4, &&m80_op_0xC5, &&m80_op_0xC6, &&m80_op_0xC7, &&m80_op_0xC8, &&m80_op_0xC9, &&m80_op_0xCA, &&m80_op_0xCB, &&m80_op_0xCC, &&m80_op_0xCD, &&m80_op_0xCE, &&m80_op_0xCF,
+		&&m80_op_0xD0, &&m80_op_0xD1, &&m80_op_0xD2, &&m80_op_0xD3, &&m80_op_0xD4, &&m80_op_0xD5, &&m80_op_0xD6, &&m80_op_0xD7, &&m80_op_0xD8, &&m80_op_0xD9, &&m80_op_0xDA, &&m80_op_0xDB, &&m80_op_0xDC, &&m80_op_0xDD, &&m80_op_0xDE, &&m80_op_0xDF,
+		&&m80_op_0xE0, &&m80_op_0xE1, &&m80_op_0xE2, &&m80_op_0xE3, &&m80_op_0xE4, &&m80_op_0xE5, &&m80_op_0xE6, &&m80_op_0xE7, &&m80_op_0xE8, &&m80_op_0xE9, &&m80_op_0xEA, &&m80_op_0xEB, &&m80_op_0xEC, &&m80_op_0xED, &&m80_op_0xEE, &&m80_op_0xEF,
+		&&m80_op_0xF0, &&m80_op_0xF1, &&m80_op_0xF2, &&m80_op_0xF3, &&m80_op_0xF4, &&m80_op_0xF5, &&m80_op_0xF6, &&m80_op_0xF7, &&m80_op_0xF8, &&m80_op_0xF9, &&m80_op_0xFA, &&m80_op_0xFB, &&m80_op_0xFC, &&m80_op_0xFD, &&m80_op_0xFE, &&m80_op_0xFF
+	};
+	Uint8 opcode;
+	Uint16 temp_word;
+
+	M80_THREADED_FETCH;
+	M80_MAIN_OPCODES(M80_THREADED_LABEL, M80_THREADED_NEXT)
+}
+
+#ifdef M80_DYNAREC
+
+/* executes the instruction at PC (the recompiler calls this for instructions it doesn't translate) */
+void m80_exec_one()
+{
+	m80_exec_threaded(0, true);
+}
+
+/* the fast loop, for code that the recompiler can't translate */
+void m80_exec_until(Uint32 cycles_to_execute)
+{
+	if ((g_cycles_executed < cycles_to_execute) && !g_pContext->got_EI)
+	{
+		m80_exec_threaded(cycles_to_execute, false);
+	}
+}
+
+#endif // M80_DYNAREC
+
+#endif // M80_THREADED_DISPATCH
+
 /* attempts to the number of cycles specified.  Returns the number of cycles actually executed. */
 Uint32 m80_execute(Uint32 cycles_to_execute)
 {
@@ -2980,10 +3071,39 @@ Uint32 m80_execute(Uint32 cycles_to_execute)
 	while (g_cycles_executed < cycles_to_execute)
 	{
 		CHECK_INTERRUPT;	/* it's ok to check the interrupt at this stage */
+		M80_IDLE_RESET;	/* (an interrupt may have changed what the loops we've seen so far are waiting for) */
 
+#ifdef M80_THREADED_DISPATCH
 		/* HERE IS WHERE THE FAST LOOP IS.  WE SHOULD STAY IN THIS LOOP MOST OF THE TIME */
 		/* NOTE: interrupts can't occur within this loop at all */
-		while ((g_cycles_executed < cycles_to_execute) && !g_context.got_EI)
+		if ((g_cycles_executed < cycles_to_execute) && !g_pContext->got_EI)
+		{
+#ifdef M80_DYNAREC
+			/* the recompiler runs the same loop, but uses translated code wherever it can */
+			if (m80_dynarec_is_enabled())
+			{
+				m80_dynarec_exec(cycles_to_execute);
+			}
+			else
+#endif // M80_DYNAREC
+			{
+				m80_exec_threaded(cycles_to_execute, false);
+			}
+		}
+
+		/* after we get an EI, we have to execute the next instruction before checking */
+		/* for interrupts.  In case we have a string of EI's, we use a while loop here. */
+		/* (that instruction may be a branch, but it mustn't skip an idle loop because an interrupt is due) */
+		M80_IDLE_RESET;
+		while (g_pContext->got_EI)
+		{
+			g_pContext->got_EI = 0;	/* clear this flag (it can be set in the next instruction) */
+			m80_exec_threaded(cycles_to_execute, true);
+		}
+#else
+		/* HERE IS WHERE THE FAST LOOP IS.  WE SHOULD STAY IN THIS LOOP MOST OF THE TIME */
+		/* NOTE: interrupts can't occur within this loop at all */
+		while ((g_cycles_executed < cycles_to_execute) && !g_pContext->got_EI)
 		{
 #ifdef INTEGRATE
 #ifdef CPU_DEBUG
@@ -2995,16 +3115,19 @@ Uint32 m80_execute(Uint32 cycles_to_execute)
 
 		/* after we get an EI, we have to execute the next instruction before checking */
 		/* for interrupts.  In case we have a string of EI's, we use a while loop here. */
-		while (g_context.got_EI)
+		/* (that instruction may be a branch, but it mustn't skip an idle loop because an interrupt is due) */
+		M80_IDLE_RESET;
+		while (g_pContext->got_EI)
 		{
 #ifdef INTEGRATE
 #ifdef CPU_DEBUG
 			MAME_Debug();
 #endif
 #endif
-			g_context.got_EI = 0;	/* clear this flag (it can be set in the next instruction) */
+			g_pContext->got_EI = 0;	/* clear this flag (it can be set in the next instruction) */
 			M80_EXEC_CUR_INSTR;
 		}
+#endif // M80_THREADED_DISPATCH
 
 	} /* end while */
 
@@ -3896,7 +4019,7 @@ Uint32 m80_execute(Uint32 cycles_to_execute)
 /* If you want to clear the NMI, use CLEAR_LINE */
 void m80_set_nmi_line(Uint8 new_nmi_state)
 {
-	g_context.nmi_state = new_nmi_state;
+	g_pContext->nmi_state = new_nmi_state;
 }
 
 /* call this when you want to change the state of the IRQ line */
@@ -3905,7 +4028,7 @@ void m80_set_nmi_line(Uint8 new_nmi_state)
 /* You need to have an IRQ callback defined before asserting the IRQ line */
 void m80_set_irq_line(Uint8 irq_state)
 {
-	g_context.irq_state = irq_state;
+	g_pContext->irq_state = irq_state;
 }
 
 /* calls the nmi service routine at 0x66 */
@@ -3916,12 +4039,12 @@ void m80_activate_nmi()
 	M80_INC_R;	/* increment R when activating nmi */
 	M80_STOP_HALT;	/* get out of halt mode if we were in it */
 
-	g_context.IFF1 = 0;	/* as soon as the NMI is asserted, it clears flipflop1 */
+	g_pContext->IFF1 = 0;	/* as soon as the NMI is asserted, it clears flipflop1 */
 	M80_PUSH16(M80_PC);	/* now Call 0x66, which is where the nmi service routine always is */
 	PC = 0x66;
 	M80_CHANGE_PC(PC);
 	g_cycles_executed += 11;	/* Sean Young says this is how many cycles it takes to do an NMI */
-	g_context.nmi_state = CLEAR_LINE;	// so that our code can assert the NMI without having to call m80_execute (so it can leave the NMI asserted)
+	g_pContext->nmi_state = CLEAR_LINE;	// so that our code can assert the NMI without having to call m80_execute (so it can leave the NMI asserted)
 }
 
 /* calls the interrupt service routine */
@@ -3934,11 +4057,11 @@ void m80_activate_irq()
 	M80_INC_R;	/* increase R register by 1 */
 	M80_STOP_HALT;	/* get out of halt mode, if we were in it */
 
-	g_context.IFF1 = 0;
-	g_context.IFF2 = 0;	/* disable interrupts once the IRQ is activated */
+	g_pContext->IFF1 = 0;
+	g_pContext->IFF2 = 0;	/* disable interrupts once the IRQ is activated */
 
 	/* the interrupt mode determines how we handle the IRQ */
-	switch (g_context.interrupt_mode)
+	switch (g_pContext->interrupt_mode)
 	{
 	case 0:	/* mode 0 (the instruction on the bus is executed) */
 #ifdef CPU_DEBUG
@@ -3995,12 +4118,12 @@ Uint16 m80_get_sp()
 
 Uint16 m80_get_reg(int index)
 {
-	return g_context.m80_regs[index].w;
+	return g_pContext->m80_regs[index].w;
 }
 
 void m80_set_reg(int index, Uint16 value)
 {
-	g_context.m80_regs[index].w = value;
+	g_pContext->m80_regs[index].w = value;
 }
 
 void m80_set_pc(Uint32 value)
@@ -4032,14 +4155,23 @@ Uint32 m80_get_cycles_executed()
 // copies m80's context into 'context' and returns size (in bytes) of the context
 Uint32 m80_get_context(void *context)
 {
-	memcpy(context, &g_context, sizeof(struct m80_context));
-	return sizeof(g_context);
+	memcpy(context, g_pContext, sizeof(struct m80_context));
+	return sizeof(struct m80_context);
 }
 
 // replaces m80's context with 'context'
 void m80_set_context(void *context)
 {
-	memcpy(&g_context, context, sizeof(struct m80_context));
+	memcpy(g_pContext, context, sizeof(struct m80_context));
+	m80_set_opcode_base(g_pContext->opcode_base);
+}
+
+// makes m80 work directly on 'context' (which must have come from m80_get_context) instead of copying it in and out
+// NULL goes back to m80's own context
+void m80_set_instance(void *context)
+{
+	g_pContext = context ? (struct m80_context *) context : &g_own_context;
+	m80_set_opcode_base(g_pContext->opcode_base);
 }
 
 // what gets called by the cpu debugger to disassemble a section of code ...
@@ -4086,7 +4218,7 @@ const char *m80_info(void *context, int regnum)
 		case CPU_INFO_REG+M80_DEPRIME: sprintf(buffer[which], "DE'%04X", DEPRIME); break;
 		case CPU_INFO_REG+M80_HLPRIME: sprintf(buffer[which], "HL'%04X", HLPRIME); break;
 		case CPU_INFO_REG+M80_RI+1: sprintf(buffer[which], "IFF1: %02X IFF2: %02X",
-										g_context.IFF1, g_context.IFF2); break;
+										g_pContext->IFF1, g_pContext->IFF2); break;
 
 		case CPU_INFO_FLAGS:
 			sprintf(buffer[which], "%c%c%c%c%c%c%c%c",
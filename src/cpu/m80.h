@@ -45,6 +45,7 @@ void m80_set_nmi_callback(Sint32 (*callback)());
 Uint32 m80_get_cycles_executed();
 Uint32 m80_get_context(void *context);
 void m80_set_context(void *context);
+void m80_set_instance(void *context);
 unsigned int m80_dasm( char *buffer, unsigned pc );
 const char *m80_info(void *context, int regnum);
 
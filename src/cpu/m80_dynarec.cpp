@@ -0,0 +1,1575 @@
+/*
+ * m80_dynarec.cpp
+ *
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of DAPHNE, a laserdisc arcade game emulator
+ *
+ * DAPHNE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * DAPHNE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// m80_dynarec.cpp
+// Dynamic recompiler for the m80 Z80 core (see m80_dynarec.h)
+
+// HOW IT WORKS
+// A block is a run of Z80 instructions that ends with a branch (or after DR_MAX_BLOCK_INSNS instructions).
+// Only blocks that lie entirely in rom pages get translated, so the Z80 can't normally modify translated code.
+//  (if it writes to a page that has translated code anyway, all translations are thrown away and that page
+//   is left to the interpreter from then on)
+// Common instructions are translated into x86-64 code that works directly on m80's context (*g_pContext).
+//  Everything else is translated into a call to m80_exec_one, which runs the instruction through the interpreter.
+// The end of a block jumps straight into the next block (through g_dr_blocks) if it has been translated.
+//
+// The interpreter starts an instruction whenever g_cycles_executed is below the quota and stops after an EI.
+//  Translated code keeps this exact behavior.  Before each run of translated instructions, it checks that the
+//  quota will still be available when the last of them starts, and if not, it hands the rest of the quota
+//  back to the interpreter.  After each instruction that went through the interpreter, it checks the quota,
+//  EI and whether PC ended up where expected (the instruction may have branched).
+// This means that cpu_execute's timing, and the state of the Z80 between m80_execute calls, are exactly the
+//  same as without the recompiler.
+//
+// Flags are computed lazily: an instruction's flags are only computed if something can see them before
+//  another instruction overwrites them (anything that leaves translated code, including memory writes
+//  which can end the block early, counts as seeing all of them).
+//
+// A block that branches back to its own start might be an idle loop (see m80_idle.cpp).  If it is, the branch
+//  calls m80_idle_skip_loop before going around again.
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>	// for offsetof
+#include "m80_dynarec.h"
+#include "../io/conout.h"
+
+#ifdef M80_DYNAREC
+
+#include <sys/mman.h>
+#include <cpuid.h>
+#include "m80.h"
+#include "m80_internal.h"
+#include "memmap.h"
+
+#define DR_CODE_SIZE	(4 << 20)	// how much room we have for translated code
+#define DR_MAX_BLOCK_INSNS	32	// the most instructions we'll put in one block
+#define DR_MAX_BLOCK_CODE	8192	// the most x86 code one block can need (no instruction needs more than 256 bytes)
+#define DR_INTERP_CYCLES	64	// how many cycles the interpreter runs before we see if we've reached translated code
+#define DR_TRAMPOLINE_SIZE	128	// room for g_dr_enter and the exit stubs at the start of the code buffer
+#define DR_MAX_IDLE_LOOPS	256	// how many idle loops we keep track of
+
+// these live in m80tables.h (which only m80.cpp includes)
+extern Uint8 m80_inc_flags[256];
+extern Uint8 m80_dec_flags[256];
+
+// offsets into *g_pContext
+#define DR_REG_LO(reg)	((Uint8) (offsetof(struct m80_context, m80_regs) + ((reg) * 2)))
+#define DR_REG_HI(reg)	((Uint8) (DR_REG_LO(reg) + 1))
+#define DR_OFS_A	DR_REG_HI(M80_AF)
+#define DR_OFS_F	DR_REG_LO(M80_AF)
+#define DR_OFS_PC	DR_REG_LO(M80_PC)
+#define DR_OFS_SP	DR_REG_LO(M80_SP)
+#define DR_OFS_R	DR_REG_HI(M80_RI)
+
+// the 8-bit registers in the order that Z80 opcodes number them (6 is (HL), which isn't a register)
+static const Uint8 g_dr_reg8[8] =
+{
+	DR_REG_HI(M80_BC), DR_REG_LO(M80_BC), DR_REG_HI(M80_DE), DR_REG_LO(M80_DE),
+	DR_REG_HI(M80_HL), DR_REG_LO(M80_HL), 0, DR_REG_HI(M80_AF)
+};
+
+// the register pairs in the order that most Z80 opcodes number them
+static const Uint8 g_dr_reg16[4] = { DR_REG_LO(M80_BC), DR_REG_LO(M80_DE), DR_REG_LO(M80_HL), DR_REG_LO(M80_SP) };
+
+// the register pairs in the order that PUSH and POP number them
+static const Uint8 g_dr_reg16_af[4] = { DR_REG_LO(M80_BC), DR_REG_LO(M80_DE), DR_REG_LO(M80_HL), DR_REG_LO(M80_AF) };
+
+// the flag that each condition (NZ, Z, NC, C, PO, PE, P, M) tests
+static const Uint8 g_dr_cond_flag[4] = { Z_FLAG, C_FLAG, P_FLAG, S_FLAG };
+
+// x86 registers (AH can only be used where the instruction doesn't need a REX prefix)
+enum { DR_EAX = 0, DR_ECX = 1, DR_EDX = 2, DR_AH = 4, DR_ESI = 6, DR_EDI = 7 };
+
+// x86 condition codes
+enum { DR_CC_B = 2, DR_CC_AE = 3, DR_CC_E = 4, DR_CC_NE = 5 };
+
+// how an instruction gets translated
+enum { DR_NATIVE, DR_INTERP };
+
+// why translated code went back to m80_dynarec_exec
+enum { DR_EXIT_LOOKUP, DR_EXIT_INTERPRET };
+
+// what translated code needs to get at while it runs (rbp points here)
+struct dr_state
+{
+	Uint32 uQuota;	// an instruction may only start while g_cycles_executed is below this
+	Uint8 bInvalidated;	// set by m80_dynarec_invalidate (translated code must stop as soon as it sees this)
+	Uint8 uExitReason;	// DR_EXIT_LOOKUP means PC needs to be looked up again, DR_EXIT_INTERPRET means the quota is nearly used up
+};
+
+// one decoded instruction
+struct dr_insn
+{
+	Uint16 uPC;	// where it is
+	Uint8 uLen;	// how many bytes long it is
+	Uint8 uKind;	// DR_NATIVE or DR_INTERP
+	Uint8 op[4];	// its bytes
+	Uint8 uCycles;	// the cycles it costs (not counting conditional extras)
+	Uint8 uFlagsUsed;	// flags it needs from earlier instructions
+	Uint8 uFlagsSet;	// flags it overwrites without looking at them
+	Uint8 uFlagsLive;	// flags that something after it needs
+	bool bEndsBlock;	// whether nothing after it can be part of the same block
+};
+
+Uint8 g_m80_dynarec_code_page[256] = { 0 };
+
+static bool g_dr_enabled = false;
+static struct dr_state g_dr;
+static Uint8 *g_dr_code = NULL;	// where translated code goes (executable)
+static Uint32 g_dr_code_used = 0;	// how much of g_dr_code has been used
+static void *g_dr_blocks[0x10000];	// the translated code for each Z80 address (NULL if it hasn't been translated)
+static Uint8 g_dr_untranslatable[0x10000];	// set for Z80 addresses where we couldn't start a block
+static Uint8 g_dr_written_page[256];	// pages that the Z80 has changed (which we won't translate anymore)
+static Uint8 *g_dr_opcode_base = NULL;	// the memory that our translations were made from
+static struct mem_page *g_dr_mem_pages = NULL;	// the page table that our translations were made from
+static bool g_dr_any_rom = false;	// whether g_dr_mem_pages has any rom pages in it (if not, there's nothing for us to do)
+static bool g_dr_reset_pending = false;	// whether the translations need to be thrown away as soon as nothing is running them
+
+static void (*g_dr_enter)(void *entry) = NULL;	// sets up the x86 registers and jumps to translated code
+static Uint8 *g_dr_exit = NULL;	// where translated code jumps to in order to return from g_dr_enter
+static Uint8 *g_dr_exit_interpret = NULL;	// same, but sets DR_EXIT_INTERPRET first
+
+#ifdef M80_IDLE_SKIP
+static struct m80_idle_loop g_dr_idle_loops[DR_MAX_IDLE_LOOPS];	// the idle loops that translated code knows about
+static Uint32 g_dr_idle_loop_count = 0;	// how many entries of g_dr_idle_loops are used
+static const struct m80_idle_loop *g_pIdleLoop = NULL;	// the idle loop that the block being translated is (if any)
+static Uint16 g_uBlockPC = 0;	// where the block being translated starts
+#endif // M80_IDLE_SKIP
+
+static Uint8 *g_pEmit = NULL;	// where the next byte of x86 code goes
+static Uint32 g_uPendingCycles = 0;	// cycles that translated code hasn't added to g_cycles_executed yet
+static Uint32 g_uPendingR = 0;	// increments that translated code hasn't applied to R yet
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+// called from translated code
+
+static Uint32 dr_read(Uint32 addr)
+{
+	return M80_READ_BYTE(addr);
+}
+
+static Uint32 dr_read_word(Uint32 addr)
+{
+	Uint32 lo = M80_READ_BYTE(addr);
+	return lo | (M80_READ_BYTE(addr + 1) << 8);
+}
+
+static void dr_write(Uint32 addr, Uint32 value)
+{
+	M80_WRITE_BYTE(addr, (Uint8) value);
+}
+
+static void dr_write_word(Uint32 addr, Uint32 value)
+{
+	M80_WRITE_BYTE(addr, (Uint8) value);
+	M80_WRITE_BYTE(addr + 1, (Uint8) (value >> 8));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+// x86-64 code emitters
+// While translated code runs: rbx points to *g_pContext, rbp points to g_dr, r13 points to g_dr_blocks
+//  and r15 points to g_cycles_executed.  rax, rcx, rdx, rsi and rdi are free to use.
+
+static void e8(Uint8 u)
+{
+	*g_pEmit++ = u;
+}
+
+static void e16(Uint16 u)
+{
+	memcpy(g_pEmit, &u, sizeof(u));
+	g_pEmit += sizeof(u);
+}
+
+static void e32(Uint32 u)
+{
+	memcpy(g_pEmit, &u, sizeof(u));
+	g_pEmit += sizeof(u);
+}
+
+static void e64(Uint64 u)
+{
+	memcpy(g_pEmit, &u, sizeof(u));
+	g_pEmit += sizeof(u);
+}
+
+// modrm for [rbx + uOfs]
+static void e_ctx(Uint8 uReg, Uint8 uOfs)
+{
+	e8(0x43 | (uReg << 3));
+	e8(uOfs);
+}
+
+// modrm for [rbp + uOfs]
+static void e_state(Uint8 uReg, Uint8 uOfs)
+{
+	e8(0x45 | (uReg << 3));
+	e8(uOfs);
+}
+
+// movzx reg32, byte [rbx + uOfs]
+static void e_ld8(Uint8 uReg, Uint8 uOfs)
+{
+	e8(0x0F); e8(0xB6); e_ctx(uReg, uOfs);
+}
+
+// movzx reg32, word [rbx + uOfs]
+static void e_ld16(Uint8 uReg, Uint8 uOfs)
+{
+	e8(0x0F); e8(0xB7); e_ctx(uReg, uOfs);
+}
+
+// mov byte [rbx + uOfs], reg8
+static void e_st8(Uint8 uReg, Uint8 uOfs)
+{
+	e8(0x88); e_ctx(uReg, uOfs);
+}
+
+// mov word [rbx + uOfs], reg16
+static void e_st16(Uint8 uReg, Uint8 uOfs)
+{
+	e8(0x66); e8(0x89); e_ctx(uReg, uOfs);
+}
+
+// mov byte [rbx + uOfs], imm8
+static void e_st8_imm(Uint8 uOfs, Uint8 uVal)
+{
+	e8(0xC6); e_ctx(0, uOfs); e8(uVal);
+}
+
+// mov word [rbx + uOfs], imm16
+static void e_st16_imm(Uint8 uOfs, Uint16 uVal)
+{
+	e8(0x66); e8(0xC7); e_ctx(0, uOfs); e16(uVal);
+}
+
+// add word [rbx + uOfs], imm8 (iVal can be negative)
+static void e_add16_imm(Uint8 uOfs, int iVal)
+{
+	e8(0x66); e8(0x83); e_ctx(0, uOfs); e8((Uint8) iVal);
+}
+
+// mov reg32, imm32
+static void e_mov_imm(Uint8 uReg, Uint32 uVal)
+{
+	e8(0xB8 + uReg); e32(uVal);
+}
+
+// and reg32, imm32
+static void e_and_imm(Uint8 uReg, Uint32 uVal)
+{
+	e8(0x81); e8(0xE0 | uReg); e32(uVal);
+}
+
+// or reg32, imm8
+static void e_or_imm8(Uint8 uReg, Uint8 uVal)
+{
+	e8(0x83); e8(0xC8 | uReg); e8(uVal);
+}
+
+// or dst32, src32
+static void e_or(Uint8 uDst, Uint8 uSrc)
+{
+	e8(0x09); e8(0xC0 | (uSrc << 3) | uDst);
+}
+
+// add dword [r15], imm (adds to g_cycles_executed)
+static void e_add_cycles(Uint32 uCycles)
+{
+	if (uCycles < 0x80)
+	{
+		e8(0x41); e8(0x83); e8(0x07); e8((Uint8) uCycles);
+	}
+	else
+	{
+		e8(0x41); e8(0x81); e8(0x07); e32(uCycles);
+	}
+}
+
+// mov rax, func; call rax
+static void e_call(const void *func)
+{
+	e8(0x48); e8(0xB8); e64((Uint64) func);
+	e8(0xFF); e8(0xD0);
+}
+
+// jcc rel32 to a known address
+static void e_jcc_to(Uint8 uCC, const Uint8 *target)
+{
+	e8(0x0F); e8(0x80 | uCC);
+	e32((Uint32) (target - (g_pEmit + 4)));
+}
+
+// jmp rel32 to a known address
+static void e_jmp_to(const Uint8 *target)
+{
+	e8(0xE9);
+	e32((Uint32) (target - (g_pEmit + 4)));
+}
+
+// jcc rel32 to an address that isn't known yet (returns what e_patch needs)
+static Uint8 *e_jcc_fwd(Uint8 uCC)
+{
+	e8(0x0F); e8(0x80 | uCC); e32(0);
+	return g_pEmit;
+}
+
+// points a forward jump at the current position
+static void e_patch(Uint8 *pAfterJump)
+{
+	Uint32 uRel = (Uint32) (g_pEmit - pAfterJump);
+	memcpy(pAfterJump - 4, &uRel, sizeof(uRel));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+// brings g_cycles_executed up to date (the game driver might look at it)
+static void dr_flush_cycles()
+{
+	if (g_uPendingCycles)
+	{
+		e_add_cycles(g_uPendingCycles);
+		g_uPendingCycles = 0;
+	}
+}
+
+// applies uCount increments to R (bit 7 of R never changes)
+static void dr_emit_r(Uint32 uCount)
+{
+	if (uCount)
+	{
+		e_ld8(DR_EAX, DR_OFS_R);
+		e8(0x8D); e8(0x48); e8((Uint8) uCount);	// lea ecx, [rax + uCount]
+		e8(0x83); e8(0xE1); e8(0x7F);	// and ecx, 0x7F
+		e_and_imm(DR_EAX, 0x80);
+		e_or(DR_EAX, DR_ECX);
+		e_st8(DR_EAX, DR_OFS_R);
+	}
+}
+
+// brings everything up to date (before leaving translated code or calling the interpreter)
+static void dr_flush_all()
+{
+	dr_flush_cycles();
+	dr_emit_r(g_uPendingR);
+	g_uPendingR = 0;
+}
+
+// makes sure that g_cycles_executed + uCycles is below the quota, otherwise the interpreter takes over
+// (PC must already be right)
+static void dr_emit_quota_check(Uint32 uCycles)
+{
+	e8(0x41); e8(0x8B); e8(0x07);	// mov eax, [r15]
+	if (uCycles)
+	{
+		e8(0x05); e32(uCycles);	// add eax, uCycles
+	}
+	e8(0x3B); e_state(DR_EAX, offsetof(struct dr_state, uQuota));	// cmp eax, [rbp + uQuota]
+	e_jcc_to(DR_CC_AE, g_dr_exit_interpret);
+}
+
+// jumps to the translation for the Z80 address in eax (or goes back to m80_dynarec_exec if there isn't one)
+static void dr_emit_lookup_eax()
+{
+	e8(0x49); e8(0x8B); e8(0x44); e8(0xC5); e8(0x00);	// mov rax, [r13 + rax*8]
+	e8(0x48); e8(0x85); e8(0xC0);	// test rax, rax
+	e_jcc_to(DR_CC_E, g_dr_exit);
+	e8(0xFF); e8(0xE0);	// jmp rax
+}
+
+// leaves the block for a known address
+static void dr_emit_exit(Uint16 uPC)
+{
+	e_st16_imm(DR_OFS_PC, uPC);
+	e8(0x49); e8(0x8B); e8(0x85); e32(uPC * 8);	// mov rax, [r13 + uPC*8]
+	e8(0x48); e8(0x85); e8(0xC0);	// test rax, rax
+	e_jcc_to(DR_CC_E, g_dr_exit);
+	e8(0xFF); e8(0xE0);	// jmp rax
+}
+
+// before a branch to uPC: if the block is an idle loop and uPC is its start, skip the loop if we can
+static void dr_emit_idle_skip(Uint16 uPC)
+{
+#ifdef M80_IDLE_SKIP
+	if (g_pIdleLoop && (uPC == g_uBlockPC))
+	{
+		e8(0x48); e8(0xBF); e64((Uint64) g_pIdleLoop);	// mov rdi, g_pIdleLoop
+		e_call((const void *) m80_idle_skip_loop);
+	}
+#endif // M80_IDLE_SKIP
+}
+
+// after a write: if translated code got thrown away, leave the block (at the next instruction)
+static void dr_emit_invalidated_check(Uint16 uNextPC)
+{
+	e8(0x80); e_state(7, offsetof(struct dr_state, bInvalidated)); e8(0);	// cmp byte [rbp + bInvalidated], 0
+	Uint8 *pSkip = e_jcc_fwd(DR_CC_E);
+	dr_emit_r(g_uPendingR);	// (only on this path, the block keeps counting if it carries on)
+	e_st16_imm(DR_OFS_PC, uNextPC);
+	e_jmp_to(g_dr_exit);
+	e_patch(pSkip);
+}
+
+// puts the byte at the address in edi into eax (the address is a register pair, or uAddr if uReg16Ofs is 0xFF)
+static void dr_emit_read(Uint8 uReg16Ofs, Uint16 uAddr)
+{
+	dr_flush_cycles();
+	if (uReg16Ofs != 0xFF)
+	{
+		e_ld16(DR_EDI, uReg16Ofs);
+	}
+	else
+	{
+		e_mov_imm(DR_EDI, uAddr);
+	}
+	e_call((const void *) dr_read);
+}
+
+// writes esi to the address in the register pair (or uAddr if uReg16Ofs is 0xFF)
+static void dr_emit_write(Uint8 uReg16Ofs, Uint16 uAddr, bool bWord, Uint16 uNextPC)
+{
+	dr_flush_cycles();
+	if (uReg16Ofs != 0xFF)
+	{
+		e_ld16(DR_EDI, uReg16Ofs);
+	}
+	else
+	{
+		e_mov_imm(DR_EDI, uAddr);
+	}
+	e_call(bWord ? (const void *) dr_write_word : (const void *) dr_write);
+	dr_emit_invalidated_check(uNextPC);
+}
+
+// SP -= 2, then writes esi to the stack
+static void dr_emit_push_esi()
+{
+	e_add16_imm(DR_OFS_SP, -2);
+	e_ld16(DR_EDI, DR_OFS_SP);
+	e_call((const void *) dr_write_word);
+}
+
+// pops a word off the stack into eax
+static void dr_emit_pop_eax()
+{
+	e_ld16(DR_EDI, DR_OFS_SP);
+	e_call((const void *) dr_read_word);
+	e_add16_imm(DR_OFS_SP, 2);
+}
+
+// test byte [F], flag and jumps past the 'taken' code if condition 'uCond' (0-7) is false
+static Uint8 *dr_emit_cond(Uint8 uCond)
+{
+	e8(0xF6); e_ctx(0, DR_OFS_F); e8(g_dr_cond_flag[uCond >> 1]);	// test byte [F], flag
+	// odd conditions are true when the flag is set
+	return e_jcc_fwd((uCond & 1) ? DR_CC_E : DR_CC_NE);
+}
+
+// A = A <op> dl, with flags if bFlags is set (iOp is the Z80's numbering: ADD ADC SUB SBC AND XOR OR CP)
+// The x86 flags are almost the same as the Z80's, so this does the same as M80_ADD_TO_A and friends do with GCC_X86_ASM.
+static void dr_emit_alu(int iOp, bool bFlags)
+{
+	static const Uint8 x86_op[8] = { 0x00, 0x10, 0x28, 0x18, 0x20, 0x30, 0x08, 0x38 };
+
+	// CP only changes flags
+	if ((iOp == 7) && !bFlags)
+	{
+		return;
+	}
+
+	e_ld8(DR_EAX, DR_OFS_A);
+
+	// ADC and SBC need the carry flag in the x86 carry flag
+	if ((iOp == 1) || (iOp == 3))
+	{
+		e_ld8(DR_ECX, DR_OFS_F);
+		e8(0xD1); e8(0xE9);	// shr ecx, 1
+	}
+	e8(x86_op[iOp]); e8(0xD0);	// <op> al, dl
+	if (bFlags)
+	{
+		e8(0x9F);	// lahf
+	}
+	if (iOp != 7)
+	{
+		e_st8(DR_EAX, DR_OFS_A);
+	}
+
+	if (bFlags)
+	{
+		// arithmetic
+		if ((iOp < 4) || (iOp == 7))
+		{
+			e8(0x0F); e8(0x90); e8(0xC1);	// seto cl
+			e8(0x80); e8(0xE4); e8(0xD1);	// and ah, 0xD1 (S, Z, H and C)
+			e8(0xC0); e8(0xE1); e8(0x02);	// shl cl, 2 (V)
+			e8(0x08); e8(0xCC);	// or ah, cl
+			// subtraction sets N
+			if (iOp >= 2)
+			{
+				e8(0x80); e8(0xCC); e8(N_FLAG);	// or ah, N_FLAG
+			}
+			// CP gets flags 5 and 3 from the operand instead of the result
+			if (iOp == 7)
+			{
+				e8(0x88); e8(0xD0);	// mov al, dl
+			}
+		}
+		// logical (P is parity, which the x86 computes the same way)
+		else
+		{
+			e8(0x80); e8(0xE4); e8(0xC4);	// and ah, 0xC4 (S, Z and P)
+			if (iOp == 4)
+			{
+				e8(0x80); e8(0xCC); e8(H_FLAG);	// or ah, H_FLAG
+			}
+		}
+		e8(0x24); e8(U5_FLAG | U3_FLAG);	// and al, 0x28
+		e8(0x08); e8(0xC4);	// or ah, al
+		e_st8(DR_AH, DR_OFS_F);
+	}
+}
+
+// F = (F & uKeep) | eax (eax must already only have bits that aren't in uKeep)
+static void dr_emit_merge_flags(Uint8 uKeep)
+{
+	e_ld8(DR_ECX, DR_OFS_F);
+	e_and_imm(DR_ECX, uKeep);
+	e_or(DR_EAX, DR_ECX);
+	e_st8(DR_EAX, DR_OFS_F);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+// returns true if every byte from uAddr to uAddr + uLen - 1 is in a rom page that we're allowed to translate
+static bool dr_is_rom(Uint32 uAddr, Uint32 uLen)
+{
+	for (Uint32 u = uAddr; u < uAddr + uLen; u++)
+	{
+		Uint32 uPage = u >> 8;
+		const struct mem_page *page = &g_dr_mem_pages[uPage];
+
+		// (the opcodes that the interpreter sees have to be the same as the memory that reads see)
+		if ((u > 0xFFFF) || (page->read != g_dr_opcode_base + (uPage << 8)) || (page->write != NULL) ||
+			g_dr_written_page[uPage])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// returns the length of an instruction that goes to the interpreter (or 0 if we'd rather not guess)
+static Uint8 dr_interp_len(const Uint8 *op)
+{
+	Uint8 uLen = 0;
+
+	switch (op[0])
+	{
+	case 0xCB:
+		uLen = 2;
+		break;
+	case 0xED:
+		// LD (nn), rr and LD rr, (nn)
+		if ((op[1] & 0xC7) == 0x43)
+		{
+			uLen = 4;
+		}
+		else
+		{
+			uLen = 2;
+		}
+		break;
+	case 0xDD:
+	case 0xFD:
+		switch (op[1])
+		{
+		// extra prefixes get eaten by the same instruction (rare, so we leave them to the interpreter)
+		case 0xDD:
+		case 0xFD:
+		case 0xED:
+			uLen = 0;
+			break;
+		case 0xCB:
+			uLen = 4;
+			break;
+		// (IX/IY + d), n
+		case 0x36:
+			uLen = 4;
+			break;
+		// (IX/IY + d)
+		case 0x34: case 0x35: case 0x46: case 0x4E: case 0x56: case 0x5E: case 0x66: case 0x6E:
+		case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x77: case 0x7E:
+		case 0x86: case 0x8E: case 0x96: case 0x9E: case 0xA6: case 0xAE: case 0xB6: case 0xBE:
+			uLen = 3;
+			break;
+		// everything else is the same as without the prefix
+		default:
+			uLen = dr_interp_len(op + 1);
+			if (uLen != 0)
+			{
+				uLen++;
+			}
+			break;
+		}
+		break;
+	// (the prefixes are handled above, these are the unprefixed instructions that can end up here)
+	case 0x01: case 0x11: case 0x21: case 0x31: case 0x22: case 0x2A: case 0x32: case 0x3A:
+	case 0xC2: case 0xC3: case 0xC4: case 0xCA: case 0xCC: case 0xCD:
+	case 0xD2: case 0xD4: case 0xDA: case 0xDC: case 0xE2: case 0xE4: case 0xEA: case 0xEC:
+	case 0xF2: case 0xF4: case 0xFA: case 0xFC:
+		uLen = 3;
+		break;
+	case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x36: case 0x3E:
+	case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+	case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+	case 0xD3: case 0xDB:
+		uLen = 2;
+		break;
+	default:
+		uLen = 1;
+		break;
+	}
+
+	return uLen;
+}
+
+// Decodes the instruction at insn->uPC (which must be in rom).
+// Returns false if it can't be part of a block.
+static bool dr_decode(struct dr_insn *insn)
+{
+	const Uint8 *op = g_dr_opcode_base + insn->uPC;
+
+	// (so that we never look past the end of memory for the rest of an instruction)
+	if (insn->uPC > 0xFFFC)
+	{
+		return false;
+	}
+
+	Uint8 uOp = op[0];
+
+	insn->uKind = DR_NATIVE;
+	insn->uLen = 1;
+	insn->uCycles = op_cycles[uOp];
+	insn->uFlagsUsed = 0;
+	insn->uFlagsSet = 0;
+	insn->bEndsBlock = false;
+
+	switch (uOp)
+	{
+	// 8-bit loads (LD r, r' and LD r, (HL))
+	case 0x40: case 0x41: case 0x42: case 0x43: case 0x44: case 0x45: case 0x46: case 0x47:
+	case 0x48: case 0x49: case 0x4A: case 0x4B: case 0x4C: case 0x4D: case 0x4E: case 0x4F:
+	case 0x50: case 0x51: case 0x52: case 0x53: case 0x54: case 0x55: case 0x56: case 0x57:
+	case 0x58: case 0x59: case 0x5A: case 0x5B: case 0x5C: case 0x5D: case 0x5E: case 0x5F:
+	case 0x60: case 0x61: case 0x62: case 0x63: case 0x64: case 0x65: case 0x66: case 0x67:
+	case 0x68: case 0x69: case 0x6A: case 0x6B: case 0x6C: case 0x6D: case 0x6E: case 0x6F:
+	case 0x78: case 0x79: case 0x7A: case 0x7B: case 0x7C: case 0x7D: case 0x7E: case 0x7F:
+	case 0x00:	// NOP
+	case 0x03: case 0x13: case 0x23: case 0x33:	// INC rr
+	case 0x0B: case 0x1B: case 0x2B: case 0x3B:	// DEC rr
+	case 0x0A: case 0x1A:	// LD A, (BC/DE)
+	case 0xD9:	// EXX
+	case 0xEB:	// EX DE, HL
+	case 0xF3:	// DI
+	case 0xF9:	// LD SP, HL
+		break;
+
+	// LD rr, nn and LD HL, (nn) and LD A, (nn)
+	case 0x01: case 0x11: case 0x21: case 0x31: case 0x2A: case 0x3A:
+		insn->uLen = 3;
+		break;
+
+	// LD r, n
+	case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x3E:
+		insn->uLen = 2;
+		break;
+
+	// INC r and DEC r
+	case 0x04: case 0x0C: case 0x14: case 0x1C: case 0x24: case 0x2C: case 0x3C:
+	case 0x05: case 0x0D: case 0x15: case 0x1D: case 0x25: case 0x2D: case 0x3D:
+		insn->uFlagsSet = 0xFF & ~C_FLAG;
+		break;
+
+	// ADD HL, rr
+	case 0x09: case 0x19: case 0x29: case 0x39:
+	// RLCA and RRCA and SCF
+	case 0x07: case 0x0F: case 0x37:
+		insn->uFlagsSet = H_FLAG | N_FLAG | C_FLAG | U5_FLAG | U3_FLAG;
+		break;
+
+	// RLA and RRA and CCF
+	case 0x17: case 0x1F: case 0x3F:
+		insn->uFlagsUsed = C_FLAG;
+		insn->uFlagsSet = H_FLAG | N_FLAG | C_FLAG | U5_FLAG | U3_FLAG;
+		break;
+
+	// CPL
+	case 0x2F:
+		insn->uFlagsSet = H_FLAG | N_FLAG | U5_FLAG | U3_FLAG;
+		break;
+
+	// EX AF, AF'
+	case 0x08:
+		insn->uFlagsUsed = 0xFF;
+		insn->uFlagsSet = 0xFF;
+		break;
+
+	// ALU A, r and ALU A, (HL)
+	case 0x80: case 0x81: case 0x82: case 0x83: case 0x84: case 0x85: case 0x86: case 0x87:
+	case 0x88: case 0x89: case 0x8A: case 0x8B: case 0x8C: case 0x8D: case 0x8E: case 0x8F:
+	case 0x90: case 0x91: case 0x92: case 0x93: case 0x94: case 0x95: case 0x96: case 0x97:
+	case 0x98: case 0x99: case 0x9A: case 0x9B: case 0x9C: case 0x9D: case 0x9E: case 0x9F:
+	case 0xA0: case 0xA1: case 0xA2: case 0xA3: case 0xA4: case 0xA5: case 0xA6: case 0xA7:
+	case 0xA8: case 0xA9: case 0xAA: case 0xAB: case 0xAC: case 0xAD: case 0xAE: case 0xAF:
+	case 0xB0: case 0xB1: case 0xB2: case 0xB3: case 0xB4: case 0xB5: case 0xB6: case 0xB7:
+	case 0xB8: case 0xB9: case 0xBA: case 0xBB: case 0xBC: case 0xBD: case 0xBE: case 0xBF:
+		insn->uFlagsUsed = ((uOp & 0x38) == 0x08) || ((uOp & 0x38) == 0x18) ? C_FLAG : 0;
+		insn->uFlagsSet = 0xFF;
+		break;
+
+	// ALU A, n
+	case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+		insn->uLen = 2;
+		insn->uFlagsUsed = ((uOp & 0x38) == 0x08) || ((uOp & 0x38) == 0x18) ? C_FLAG : 0;
+		insn->uFlagsSet = 0xFF;
+		break;
+
+	// POP rr
+	case 0xC1: case 0xD1: case 0xE1:
+		break;
+	case 0xF1:
+		insn->uFlagsSet = 0xFF;
+		break;
+
+	// writes to memory (which can end the block early, so all flags have to be up to date)
+	case 0x02: case 0x12:	// LD (BC/DE), A
+	case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x77:	// LD (HL), r
+	case 0xC5: case 0xD5: case 0xE5: case 0xF5:	// PUSH rr
+		insn->uFlagsUsed = 0xFF;
+		break;
+	case 0x36:	// LD (HL), n
+		insn->uLen = 2;
+		insn->uFlagsUsed = 0xFF;
+		break;
+	case 0x22: case 0x32:	// LD (nn), HL and LD (nn), A
+		insn->uLen = 3;
+		insn->uFlagsUsed = 0xFF;
+		break;
+
+	// branches
+	case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:	// DJNZ and JR
+		insn->uLen = 2;
+		insn->uFlagsUsed = 0xFF;
+		insn->bEndsBlock = true;
+		break;
+	case 0xC2: case 0xC3: case 0xC4: case 0xCA: case 0xCC: case 0xCD:	// JP and CALL
+	case 0xD2: case 0xD4: case 0xDA: case 0xDC:
+	case 0xE2: case 0xE4: case 0xEA: case 0xEC:
+	case 0xF2: case 0xF4: case 0xFA: case 0xFC:
+		insn->uLen = 3;
+		insn->uFlagsUsed = 0xFF;
+		insn->bEndsBlock = true;
+		break;
+	case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xE0: case 0xE8: case 0xF0: case 0xF8:	// RET
+	case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:	// RST
+	case 0xE9:	// JP (HL)
+		insn->uFlagsUsed = 0xFF;
+		insn->bEndsBlock = true;
+		break;
+
+	// everything else goes through the interpreter
+	default:
+		insn->uKind = DR_INTERP;
+		insn->uLen = dr_interp_len(op);
+		insn->uFlagsUsed = 0xFF;
+		// HALT and EI always stop us anyway
+		insn->bEndsBlock = (uOp == 0x76) || (uOp == 0xFB);
+		break;
+	}
+
+	if ((insn->uLen == 0) || !dr_is_rom(insn->uPC, insn->uLen))
+	{
+		return false;
+	}
+
+	memcpy(insn->op, op, insn->uLen);
+	return true;
+}
+
+// emits the code for one translated instruction
+static void dr_emit_native(const struct dr_insn *insn)
+{
+	const Uint8 *op = insn->op;
+	Uint8 uOp = op[0];
+	Uint16 uNextPC = (Uint16) (insn->uPC + insn->uLen);
+	Uint16 uImm16 = (Uint16) (op[1] | (op[2] << 8));
+	Uint16 uRelTarget = (Uint16) (uNextPC + (Sint8) op[1]);
+	bool bFlags = (insn->uFlagsSet & insn->uFlagsLive) != 0;
+
+	g_uPendingCycles += insn->uCycles;
+	g_uPendingR++;
+
+	// LD r, r' and LD r, (HL) and LD (HL), r
+	if ((uOp >= 0x40) && (uOp <= 0x7F))
+	{
+		Uint8 uDst = (uOp >> 3) & 7;
+		Uint8 uSrc = uOp & 7;
+
+		if (uSrc == 6)
+		{
+			dr_emit_read(DR_REG_LO(M80_HL), 0);
+			e_st8(DR_EAX, g_dr_reg8[uDst]);
+		}
+		else if (uDst == 6)
+		{
+			e_ld8(DR_ESI, g_dr_reg8[uSrc]);
+			dr_emit_write(DR_REG_LO(M80_HL), 0, false, uNextPC);
+		}
+		else if (uDst != uSrc)
+		{
+			e_ld8(DR_EAX, g_dr_reg8[uSrc]);
+			e_st8(DR_EAX, g_dr_reg8[uDst]);
+		}
+		return;
+	}
+
+	// ALU A, r and ALU A, (HL) and ALU A, n
+	if (((uOp >= 0x80) && (uOp <= 0xBF)) || ((uOp & 0xC7) == 0xC6))
+	{
+		int iOp = (uOp >> 3) & 7;
+
+		if (uOp >= 0xC0)
+		{
+			e_mov_imm(DR_EDX, op[1]);
+		}
+		else if ((uOp & 7) == 6)
+		{
+			dr_emit_read(DR_REG_LO(M80_HL), 0);
+			e8(0x89); e8(0xC2);	// mov edx, eax
+		}
+		else
+		{
+			e_ld8(DR_EDX, g_dr_reg8[uOp & 7]);
+		}
+		dr_emit_alu(iOp, bFlags);
+		return;
+	}
+
+	switch (uOp)
+	{
+	case 0x00:	// NOP
+		break;
+
+	case 0x01: case 0x11: case 0x21: case 0x31:	// LD rr, nn
+		e_st16_imm(g_dr_reg16[uOp >> 4], uImm16);
+		break;
+
+	case 0x03: case 0x13: case 0x23: case 0x33:	// INC rr
+		e8(0x66); e8(0xFF); e_ctx(0, g_dr_reg16[uOp >> 4]);
+		break;
+
+	case 0x0B: case 0x1B: case 0x2B: case 0x3B:	// DEC rr
+		e8(0x66); e8(0xFF); e_ctx(1, g_dr_reg16[uOp >> 4]);
+		break;
+
+	case 0x04: case 0x0C: case 0x14: case 0x1C: case 0x24: case 0x2C: case 0x3C:	// INC r
+	case 0x05: case 0x0D: case 0x15: case 0x1D: case 0x25: case 0x2D: case 0x3D:	// DEC r
+		{
+			Uint8 uReg = g_dr_reg8[(uOp >> 3) & 7];
+			bool bInc = (uOp & 1) == 0;
+
+			e_ld8(DR_EAX, uReg);
+			e8(0xFE); e8(bInc ? 0xC0 : 0xC8);	// inc al / dec al
+			e_st8(DR_EAX, uReg);
+			if (bFlags)
+			{
+				e8(0x0F); e8(0xB6); e8(0xC0);	// movzx eax, al
+				e8(0x48); e8(0xB9); e64((Uint64) (bInc ? m80_inc_flags : m80_dec_flags));	// mov rcx, table
+				e8(0x0F); e8(0xB6); e8(0x0C); e8(0x01);	// movzx ecx, byte [rcx + rax]
+				e_ld8(DR_EDX, DR_OFS_F);
+				e8(0x83); e8(0xE2); e8(C_FLAG);	// and edx, C_FLAG
+				e_or(DR_ECX, DR_EDX);
+				e_st8(DR_ECX, DR_OFS_F);
+			}
+		}
+		break;
+
+	case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x3E:	// LD r, n
+		e_st8_imm(g_dr_reg8[(uOp >> 3) & 7], op[1]);
+		break;
+
+	case 0x36:	// LD (HL), n
+		e_mov_imm(DR_ESI, op[1]);
+		dr_emit_write(DR_REG_LO(M80_HL), 0, false, uNextPC);
+		break;
+
+	case 0x02: case 0x12:	// LD (BC/DE), A
+		e_ld8(DR_ESI, DR_OFS_A);
+		dr_emit_write(g_dr_reg16[uOp >> 4], 0, false, uNextPC);
+		break;
+
+	case 0x0A: case 0x1A:	// LD A, (BC/DE)
+		dr_emit_read(g_dr_reg16[uOp >> 4], 0);
+		e_st8(DR_EAX, DR_OFS_A);
+		break;
+
+	case 0x22:	// LD (nn), HL
+		e_ld16(DR_ESI, DR_REG_LO(M80_HL));
+		dr_emit_write(0xFF, uImm16, true, uNextPC);
+		break;
+
+	case 0x2A:	// LD HL, (nn)
+		dr_flush_cycles();
+		e_mov_imm(DR_EDI, uImm16);
+		e_call((const void *) dr_read_word);
+		e_st16(DR_EAX, DR_REG_LO(M80_HL));
+		break;
+
+	case 0x32:	// LD (nn), A
+		e_ld8(DR_ESI, DR_OFS_A);
+		dr_emit_write(0xFF, uImm16, false, uNextPC);
+		break;
+
+	case 0x3A:	// LD A, (nn)
+		dr_emit_read(0xFF, uImm16);
+		e_st8(DR_EAX, DR_OFS_A);
+		break;
+
+	case 0x07:	// RLCA
+		e_ld8(DR_EAX, DR_OFS_A);
+		e8(0xD0); e8(0xC0);	// rol al, 1
+		e_st8(DR_EAX, DR_OFS_A);
+		if (bFlags)
+		{
+			e_and_imm(DR_EAX, U5_FLAG | U3_FLAG | C_FLAG);
+			dr_emit_merge_flags(S_FLAG | Z_FLAG | P_FLAG);
+		}
+		break;
+
+	case 0x0F:	// RRCA
+		e_ld8(DR_EAX, DR_OFS_A);
+		e8(0xD0); e8(0xC8);	// ror al, 1
+		e_st8(DR_EAX, DR_OFS_A);
+		if (bFlags)
+		{
+			e8(0x89); e8(0xC2);	// mov edx, eax
+			e8(0xC1); e8(0xEA); e8(7);	// shr edx, 7 (the old bit 0 is the new carry)
+			e_and_imm(DR_EAX, U5_FLAG | U3_FLAG);
+			e_or(DR_EAX, DR_EDX);
+			dr_emit_merge_flags(S_FLAG | Z_FLAG | P_FLAG);
+		}
+		break;
+
+	case 0x17:	// RLA
+		e_ld8(DR_EAX, DR_OFS_A);
+		e_ld8(DR_EDX, DR_OFS_F);
+		e8(0x83); e8(0xE2); e8(C_FLAG);	// and edx, C_FLAG
+		e8(0x8D); e8(0x04); e8(0x42);	// lea eax, [rdx + rax*2]
+		e_st8(DR_EAX, DR_OFS_A);
+		if (bFlags)
+		{
+			e8(0x89); e8(0xC2);	// mov edx, eax
+			e8(0xC1); e8(0xEA); e8(8);	// shr edx, 8 (the old bit 7 is the new carry)
+			e_and_imm(DR_EAX, U5_FLAG | U3_FLAG);
+			e_or(DR_EAX, DR_EDX);
+			dr_emit_merge_flags(S_FLAG | Z_FLAG | P_FLAG);
+		}
+		break;
+
+	case 0x1F:	// RRA
+		e_ld8(DR_EAX, DR_OFS_A);
+		e_ld8(DR_EDX, DR_OFS_F);
+		e8(0xC1); e8(0xE2); e8(7);	// shl edx, 7 (the old carry becomes bit 7)
+		e8(0x89); e8(0xC6);	// mov esi, eax
+		e8(0x83); e8(0xE6); e8(C_FLAG);	// and esi, C_FLAG (the old bit 0 is the new carry)
+		e8(0xD1); e8(0xE8);	// shr eax, 1
+		e_or(DR_EAX, DR_EDX);
+		e_st8(DR_EAX, DR_OFS_A);
+		if (bFlags)
+		{
+			e_and_imm(DR_EAX, U5_FLAG | U3_FLAG);
+			e_or(DR_EAX, DR_ESI);
+			dr_emit_merge_flags(S_FLAG | Z_FLAG | P_FLAG);
+		}
+		break;
+
+	case 0x2F:	// CPL
+		e_ld8(DR_EAX, DR_OFS_A);
+		e8(0x35); e32(0xFF);	// xor eax, 0xFF
+		e_st8(DR_EAX, DR_OFS_A);
+		if (bFlags)
+		{
+			e_and_imm(DR_EAX, U5_FLAG | U3_FLAG);
+			e_or_imm8(DR_EAX, H_FLAG | N_FLAG);
+			dr_emit_merge_flags(S_FLAG | Z_FLAG | P_FLAG | C_FLAG);
+		}
+		break;
+
+	case 0x37:	// SCF
+		if (bFlags)
+		{
+			e_ld8(DR_EAX, DR_OFS_A);
+			e_and_imm(DR_EAX, U5_FLAG | U3_FLAG);
+			e_or_imm8(DR_EAX, C_FLAG);
+			dr_emit_merge_flags(S_FLAG | Z_FLAG | P_FLAG);
+		}
+		break;
+
+	case 0x3F:	// CCF
+		if (bFlags)
+		{
+			e_ld8(DR_ECX, DR_OFS_F);
+			e_and_imm(DR_ECX, S_FLAG | Z_FLAG | P_FLAG | C_FLAG);
+			e8(0x89); e8(0xCA);	// mov edx, ecx
+			e8(0xC1); e8(0xE2); e8(4);	// shl edx, 4
+			e8(0x83); e8(0xE2); e8(H_FLAG);	// and edx, H_FLAG (H gets the old carry)
+			e8(0x83); e8(0xF1); e8(C_FLAG);	// xor ecx, C_FLAG
+			e_or(DR_ECX, DR_EDX);
+			e_ld8(DR_EAX, DR_OFS_A);
+			e_and_imm(DR_EAX, U5_FLAG | U3_FLAG);
+			e_or(DR_EAX, DR_ECX);
+			e_st8(DR_EAX, DR_OFS_F);
+		}
+		break;
+
+	case 0x08:	// EX AF, AF'
+		e_ld16(DR_EAX, DR_REG_LO(M80_AF));
+		e_ld16(DR_ECX, DR_REG_LO(M80_AFPRIME));
+		e_st16(DR_ECX, DR_REG_LO(M80_AF));
+		e_st16(DR_EAX, DR_REG_LO(M80_AFPRIME));
+		break;
+
+	case 0xD9:	// EXX
+		{
+			static const Uint8 regs[3][2] =
+			{
+				{ DR_REG_LO(M80_BC), DR_REG_LO(M80_BCPRIME) },
+				{ DR_REG_LO(M80_DE), DR_REG_LO(M80_DEPRIME) },
+				{ DR_REG_LO(M80_HL), DR_REG_LO(M80_HLPRIME) }
+			};
+			for (int i = 0; i < 3; i++)
+			{
+				e_ld16(DR_EAX, regs[i][0]);
+				e_ld16(DR_ECX, regs[i][1]);
+				e_st16(DR_ECX, regs[i][0]);
+				e_st16(DR_EAX, regs[i][1]);
+			}
+		}
+		break;
+
+	case 0xEB:	// EX DE, HL
+		e_ld16(DR_EAX, DR_REG_LO(M80_DE));
+		e_ld16(DR_ECX, DR_REG_LO(M80_HL));
+		e_st16(DR_ECX, DR_REG_LO(M80_DE));
+		e_st16(DR_EAX, DR_REG_LO(M80_HL));
+		break;
+
+	case 0x09: case 0x19: case 0x29: case 0x39:	// ADD HL, rr (same as M80_ADD_REGS16)
+		e_ld16(DR_EAX, DR_REG_LO(M80_HL));
+		e_ld16(DR_ECX, g_dr_reg16[uOp >> 4]);
+		e8(0x8D); e8(0x14); e8(0x08);	// lea edx, [rax + rcx]
+		e_st16(DR_EDX, DR_REG_LO(M80_HL));
+		if (bFlags)
+		{
+			e8(0x31); e8(0xC8);	// xor eax, ecx
+			e8(0x31); e8(0xD0);	// xor eax, edx
+			e8(0xC1); e8(0xE8); e8(8);	// shr eax, 8 (eax is now the carries out of each bit of the high byte)
+			e8(0x89); e8(0xC1);	// mov ecx, eax
+			e_and_imm(DR_EAX, H_FLAG);
+			e8(0xC1); e8(0xE9); e8(8);	// shr ecx, 8
+			e_or(DR_EAX, DR_ECX);	// (ecx can only be 0 or 1)
+			e8(0xC1); e8(0xEA); e8(8);	// shr edx, 8
+			e_and_imm(DR_EDX, U5_FLAG | U3_FLAG);
+			e_or(DR_EAX, DR_EDX);
+			dr_emit_merge_flags(S_FLAG | Z_FLAG | V_FLAG);
+		}
+		break;
+
+	case 0xF3:	// DI
+		e_st8_imm(offsetof(struct m80_context, IFF1), 0);
+		e_st8_imm(offsetof(struct m80_context, IFF2), 0);
+		break;
+
+	case 0xF9:	// LD SP, HL
+		e_ld16(DR_EAX, DR_REG_LO(M80_HL));
+		e_st16(DR_EAX, DR_OFS_SP);
+		break;
+
+	case 0xC1: case 0xD1: case 0xE1: case 0xF1:	// POP rr
+		dr_flush_cycles();
+		dr_emit_pop_eax();
+		e_st16(DR_EAX, g_dr_reg16_af[(uOp >> 4) & 3]);
+		break;
+
+	case 0xC5: case 0xD5: case 0xE5: case 0xF5:	// PUSH rr
+		dr_flush_cycles();
+		e_ld16(DR_ESI, g_dr_reg16_af[(uOp >> 4) & 3]);
+		dr_emit_push_esi();
+		dr_emit_invalidated_check(uNextPC);
+		break;
+
+	case 0x18:	// JR
+		dr_flush_all();
+		dr_emit_idle_skip(uRelTarget);
+		dr_emit_exit(uRelTarget);
+		break;
+
+	case 0x10:	// DJNZ
+		{
+			dr_flush_all();
+			e8(0xFE); e_ctx(1, g_dr_reg8[0]);	// dec byte [B]
+			Uint8 *pNotTaken = e_jcc_fwd(DR_CC_E);
+			e_add_cycles(5);
+			dr_emit_exit(uRelTarget);
+			e_patch(pNotTaken);
+			dr_emit_exit(uNextPC);
+		}
+		break;
+
+	case 0x20: case 0x28: case 0x30: case 0x38:	// JR cc
+		{
+			dr_flush_all();
+			Uint8 *pNotTaken = dr_emit_cond((uOp >> 3) & 3);
+			e_add_cycles(5);
+			dr_emit_idle_skip(uRelTarget);
+			dr_emit_exit(uRelTarget);
+			e_patch(pNotTaken);
+			dr_emit_exit(uNextPC);
+		}
+		break;
+
+	case 0xC3:	// JP
+		dr_flush_all();
+		dr_emit_idle_skip(uImm16);
+		dr_emit_exit(uImm16);
+		break;
+
+	case 0xC2: case 0xCA: case 0xD2: case 0xDA: case 0xE2: case 0xEA: case 0xF2: case 0xFA:	// JP cc
+		{
+			dr_flush_all();
+			Uint8 *pNotTaken = dr_emit_cond((uOp >> 3) & 7);
+			dr_emit_idle_skip(uImm16);
+			dr_emit_exit(uImm16);
+			e_patch(pNotTaken);
+			dr_emit_exit(uNextPC);
+		}
+		break;
+
+	case 0xCD:	// CALL
+		dr_flush_all();
+		e_mov_imm(DR_ESI, uNextPC);
+		dr_emit_push_esi();
+		dr_emit_exit(uImm16);
+		break;
+
+	case 0xC4: case 0xCC: case 0xD4: case 0xDC: case 0xE4: case 0xEC: case 0xF4: case 0xFC:	// CALL cc
+		{
+			dr_flush_all();
+			Uint8 *pNotTaken = dr_emit_cond((uOp >> 3) & 7);
+			e_add_cycles(7);
+			e_mov_imm(DR_ESI, uNextPC);
+			dr_emit_push_esi();
+			dr_emit_exit(uImm16);
+			e_patch(pNotTaken);
+			dr_emit_exit(uNextPC);
+		}
+		break;
+
+	case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:	// RST
+		dr_flush_all();
+		e_mov_imm(DR_ESI, uNextPC);
+		dr_emit_push_esi();
+		dr_emit_exit(uOp & 0x38);
+		break;
+
+	case 0xC9:	// RET
+		dr_flush_all();
+		dr_emit_pop_eax();
+		e_st16(DR_EAX, DR_OFS_PC);
+		dr_emit_lookup_eax();
+		break;
+
+	case 0xC0: case 0xC8: case 0xD0: case 0xD8: case 0xE0: case 0xE8: case 0xF0: case 0xF8:	// RET cc
+		{
+			dr_flush_all();
+			Uint8 *pNotTaken = dr_emit_cond((uOp >> 3) & 7);
+			e_add_cycles(6);
+			dr_emit_pop_eax();
+			e_st16(DR_EAX, DR_OFS_PC);
+			dr_emit_lookup_eax();
+			e_patch(pNotTaken);
+			dr_emit_exit(uNextPC);
+		}
+		break;
+
+	case 0xE9:	// JP (HL)
+		dr_flush_all();
+		e_ld16(DR_EAX, DR_REG_LO(M80_HL));
+		e_st16(DR_EAX, DR_OFS_PC);
+		dr_emit_lookup_eax();
+		break;
+	}
+}
+
+// emits a call to the interpreter for one instruction
+static void dr_emit_interp(const struct dr_insn *insn, Uint32 uQuotaCycles)
+{
+	Uint16 uNextPC = (Uint16) (insn->uPC + insn->uLen);
+
+	dr_flush_all();
+	e_st16_imm(DR_OFS_PC, insn->uPC);
+	e_call((const void *) m80_exec_one);
+
+	// HALT and EI
+	if (insn->bEndsBlock)
+	{
+		e_jmp_to(g_dr_exit);
+		return;
+	}
+
+	// the instruction may have branched
+	e8(0x66); e8(0x81); e_ctx(7, DR_OFS_PC); e16(uNextPC);	// cmp word [PC], uNextPC
+	e_jcc_to(DR_CC_NE, g_dr_exit);
+
+	// the instruction may have written to translated code
+	e8(0x80); e_state(7, offsetof(struct dr_state, bInvalidated)); e8(0);	// cmp byte [rbp + bInvalidated], 0
+	e_jcc_to(DR_CC_NE, g_dr_exit);
+
+	// (an EI can be hidden behind DD/FD prefixes)
+	e8(0x80); e_ctx(7, offsetof(struct m80_context, got_EI)); e8(0);	// cmp byte [got_EI], 0
+	e_jcc_to(DR_CC_NE, g_dr_exit);
+
+	// it may have used more cycles than we'd expect
+	dr_emit_quota_check(uQuotaCycles);
+}
+
+// adds up the cycles of the instructions from iFirst that run before the last one that we can predict
+//  (the next one that goes through the interpreter, or the last one in the block)
+static Uint32 dr_quota_cycles(const struct dr_insn *insns, int iFirst, int iCount)
+{
+	Uint32 uCycles = 0;
+	for (int i = iFirst; i < iCount - 1; i++)
+	{
+		if (insns[i].uKind == DR_INTERP)
+		{
+			break;
+		}
+		uCycles += insns[i].uCycles;
+	}
+	return uCycles;
+}
+
+// throws away all translations
+static void dr_reset()
+{
+	memset(g_dr_blocks, 0, sizeof(g_dr_blocks));
+	memset(g_dr_untranslatable, 0, sizeof(g_dr_untranslatable));
+	memset(g_m80_dynarec_code_page, 0, sizeof(g_m80_dynarec_code_page));
+	g_dr_code_used = DR_TRAMPOLINE_SIZE;
+	g_dr_reset_pending = false;
+	g_dr.bInvalidated = 0;
+#ifdef M80_IDLE_SKIP
+	g_dr_idle_loop_count = 0;
+#endif // M80_IDLE_SKIP
+}
+
+// translates the block that starts at uPC, returns NULL if it can't be translated
+static void *dr_translate(Uint16 uPC)
+{
+	struct dr_insn insns[DR_MAX_BLOCK_INSNS];
+	int iCount = 0;
+	Uint16 uCurPC = uPC;
+
+	// find out what's in the block
+	while (iCount < DR_MAX_BLOCK_INSNS)
+	{
+		struct dr_insn *insn = &insns[iCount];
+		insn->uPC = uCurPC;
+		if (!dr_decode(insn))
+		{
+			break;
+		}
+		iCount++;
+		uCurPC = (Uint16) (uCurPC + insn->uLen);
+		if (insn->bEndsBlock)
+		{
+			break;
+		}
+	}
+
+	if (iCount == 0)
+	{
+		g_dr_untranslatable[uPC] = 1;
+		return NULL;
+	}
+
+	// work out which flags each instruction needs to compute
+	Uint8 uLive = 0xFF;	// whatever comes after the block can see all of them
+	for (int i = iCount - 1; i >= 0; i--)
+	{
+		insns[i].uFlagsLive = uLive;
+		uLive = insns[i].uFlagsUsed | (uLive & ~insns[i].uFlagsSet);
+	}
+
+	if (g_dr_code_used + DR_MAX_BLOCK_CODE > DR_CODE_SIZE)
+	{
+		dr_reset();
+	}
+
+#ifdef M80_IDLE_SKIP
+	// a block that ends by branching back to its start might be an idle loop
+	g_pIdleLoop = NULL;
+	g_uBlockPC = uPC;
+	if (insns[iCount - 1].bEndsBlock && (g_dr_idle_loop_count < DR_MAX_IDLE_LOOPS) &&
+		m80_idle_analyze(uPC, insns[iCount - 1].uPC, &g_dr_idle_loops[g_dr_idle_loop_count]))
+	{
+		g_pIdleLoop = &g_dr_idle_loops[g_dr_idle_loop_count++];
+	}
+#endif // M80_IDLE_SKIP
+
+	g_pEmit = g_dr_code + g_dr_code_used;
+	g_uPendingCycles = 0;
+	g_uPendingR = 0;
+	void *entry = g_pEmit;
+
+	dr_emit_quota_check(dr_quota_cycles(insns, 0, iCount));
+	for (int i = 0; i < iCount; i++)
+	{
+		if (insns[i].uKind == DR_NATIVE)
+		{
+			dr_emit_native(&insns[i]);
+		}
+		else
+		{
+			dr_emit_interp(&insns[i], dr_quota_cycles(insns, i + 1, iCount));
+		}
+	}
+
+	// if the block didn't end with a branch, carry on with whatever comes next
+	if (!insns[iCount - 1].bEndsBlock)
+	{
+		dr_flush_all();
+		dr_emit_exit(uCurPC);
+	}
+
+	g_dr_code_used = (Uint32) (g_pEmit - g_dr_code);
+	g_dr_blocks[uPC] = entry;
+	for (Uint32 u = uPC; u < (Uint32) uPC + (Uint16) (uCurPC - uPC); u += 0x100)
+	{
+		g_m80_dynarec_code_page[u >> 8] = 1;
+	}
+	g_m80_dynarec_code_page[(Uint16) (uCurPC - 1) >> 8] = 1;
+
+	return entry;
+}
+
+// emits g_dr_enter and the exit stubs at the start of the code buffer
+static void dr_emit_trampoline()
+{
+	g_pEmit = g_dr_code;
+
+	g_dr_enter = (void (*)(void *)) g_pEmit;
+	e8(0x53);	// push rbx
+	e8(0x55);	// push rbp
+	e8(0x41); e8(0x55);	// push r13
+	e8(0x41); e8(0x57);	// push r15
+	e8(0x48); e8(0x83); e8(0xEC); e8(0x08);	// sub rsp, 8 (so that calls see an aligned stack)
+	e8(0x48); e8(0xBB); e64((Uint64) &g_pContext);	// mov rbx, &g_pContext
+	e8(0x48); e8(0x8B); e8(0x1B);	// mov rbx, [rbx] (whichever cpu instance is current)
+	e8(0x48); e8(0xBD); e64((Uint64) &g_dr);	// mov rbp, &g_dr
+	e8(0x49); e8(0xBD); e64((Uint64) g_dr_blocks);	// mov r13, g_dr_blocks
+	e8(0x49); e8(0xBF); e64((Uint64) &g_cycles_executed);	// mov r15, &g_cycles_executed
+	e8(0xFF); e8(0xE7);	// jmp rdi
+
+	g_dr_exit_interpret = g_pEmit;
+	e8(0xC6); e_state(0, offsetof(struct dr_state, uExitReason)); e8(DR_EXIT_INTERPRET);
+
+	g_dr_exit = g_pEmit;
+	e8(0x48); e8(0x83); e8(0xC4); e8(0x08);	// add rsp, 8
+	e8(0x41); e8(0x5F);	// pop r15
+	e8(0x41); e8(0x5D);	// pop r13
+	e8(0x5D);	// pop rbp
+	e8(0x5B);	// pop rbx
+	e8(0xC3);	// ret
+
+	// blocks go after this
+	g_dr_code_used = DR_TRAMPOLINE_SIZE;
+}
+
+// returns true if we can run on this host
+static bool dr_init()
+{
+	bool bResult = false;
+
+	// we need LAHF in 64-bit mode (which a few early x86-64 cpus don't have)
+	unsigned int a = 0, b = 0, c = 0, d = 0;
+	if (__get_cpuid(0x80000001, &a, &b, &c, &d) && (c & 1))
+	{
+		void *p = mmap(NULL, DR_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p != MAP_FAILED)
+		{
+			g_dr_code = (Uint8 *) p;
+			dr_emit_trampoline();
+			bResult = true;
+		}
+		else
+		{
+			printline("Z80 dynarec : couldn't allocate executable memory");
+		}
+	}
+	else
+	{
+		printline("Z80 dynarec : this cpu doesn't support LAHF in 64-bit mode");
+	}
+
+	return bResult;
+}
+
+bool m80_dynarec_is_enabled()
+{
+	return g_dr_enabled;
+}
+
+void m80_dynarec_exec(Uint32 cycles_to_execute)
+{
+	// translations are only good for the memory they were made from
+	if ((opcode_base != g_dr_opcode_base) || (g_mem_pages != g_dr_mem_pages))
+	{
+		dr_reset();
+		g_dr_opcode_base = opcode_base;
+		g_dr_mem_pages = g_mem_pages;
+		memset(g_dr_written_page, 0, sizeof(g_dr_written_page));
+		g_dr_any_rom = false;
+		for (Uint32 u = 0; u < 0x10000; u += 0x100)
+		{
+			if (dr_is_rom(u, 1))
+			{
+				g_dr_any_rom = true;
+			}
+		}
+	}
+
+	// if there's no rom, there's nothing to translate
+	if (!g_dr_any_rom)
+	{
+		m80_exec_until(cycles_to_execute);
+		return;
+	}
+
+	g_dr.uQuota = cycles_to_execute;
+
+	while ((g_cycles_executed < cycles_to_execute) && !g_pContext->got_EI)
+	{
+		if (g_dr_reset_pending)
+		{
+			dr_reset();
+		}
+
+		void *entry = g_dr_blocks[PC];
+		if ((entry == NULL) && !g_dr_untranslatable[PC])
+		{
+			entry = dr_translate(PC);
+		}
+
+		if (entry != NULL)
+		{
+			g_dr.uExitReason = DR_EXIT_LOOKUP;
+			g_dr_enter(entry);
+
+			// the next instruction would go past the quota, so let the interpreter finish
+			if (g_dr.uExitReason == DR_EXIT_INTERPRET)
+			{
+				m80_exec_until(cycles_to_execute);
+			}
+		}
+		// run some code we can't translate, then see if we've got to something we can
+		else
+		{
+			Uint32 uLimit = g_cycles_executed + DR_INTERP_CYCLES;
+			if ((uLimit > cycles_to_execute) || (uLimit < g_cycles_executed))
+			{
+				uLimit = cycles_to_execute;
+			}
+			m80_exec_until(uLimit);
+		}
+	}
+}
+
+void m80_dynarec_invalidate(Uint32 addr)
+{
+	// we won't translate this page anymore
+	g_dr_written_page[(addr >> 8) & 0xFF] = 1;
+
+	// Nothing will jump into the old translations, but the code buffer can't be reused until we're back
+	//  in m80_dynarec_exec (the block that did the write might still be running).
+	memset(g_dr_blocks, 0, sizeof(g_dr_blocks));
+	memset(g_m80_dynarec_code_page, 0, sizeof(g_m80_dynarec_code_page));
+	g_dr.bInvalidated = 1;
+	g_dr_reset_pending = true;
+}
+
+#endif // M80_DYNAREC
+
+bool m80_dynarec_enable(bool bEnabled)
+{
+	bool bResult = false;
+
+#ifdef M80_DYNAREC
+	if (bEnabled && (g_dr_code == NULL))
+	{
+		bResult = dr_init();
+	}
+	else
+	{
+		bResult = true;
+	}
+
+	if (bResult)
+	{
+		g_dr_enabled = bEnabled;
+		g_dr_opcode_base = NULL;	// (so that m80_dynarec_exec starts from scratch)
+	}
+#else
+	if (!bEnabled)
+	{
+		bResult = true;
+	}
+	else
+	{
+		printline("Z80 dynarec : not supported by this build");
+	}
+#endif // M80_DYNAREC
+
+	return bResult;
+}
+
+void m80_dynarec_flush()
+{
+#ifdef M80_DYNAREC
+	// (the rom pages get looked at again too)
+	g_dr_opcode_base = NULL;
+#endif // M80_DYNAREC
+}
@@ -0,0 +1,75 @@
+/*
+ * m80_dynarec.h
+ *
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of DAPHNE, a laserdisc arcade game emulator
+ *
+ * DAPHNE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * DAPHNE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// m80_dynarec.h
+// Optional dynamic recompiler for the m80 Z80 core (enable it with -z80_dynarec).
+// Blocks of Z80 code that live in rom (pages mapped with game::map_cpu_rom) get translated into x86-64 code.
+// Everything else (code in ram, and any instruction the recompiler doesn't know how to translate) still
+//  goes through the interpreter, so the recompiler only ever changes how fast the Z80 runs, never what it does.
+
+#ifndef M80_DYNAREC_H
+#define M80_DYNAREC_H
+
+// for Uint32, Uint8, etc definitions
+#include <SDL.h>
+
+// The recompiler emits x86-64 code and is only built with gcc (it calls into m80's threaded interpreter).
+// The cpu debugger needs to see every instruction, so it can't be used with CPU_DEBUG.
+// Define M80_NO_DYNAREC to leave it out.
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(WIN32) && !defined(CPU_DEBUG) && !defined(M80_NO_DYNAREC) && !defined(M80_NO_THREADED_DISPATCH)
+#define M80_DYNAREC
+#endif
+
+// Turns the recompiler on or off (it's off by default).
+// Returns false if it can't be turned on (because this build or this host doesn't support it).
+bool m80_dynarec_enable(bool bEnabled);
+
+// Throws away every translation.
+// The recompiler notices when the Z80 itself writes to translated code, but a game driver that changes
+//  rom contents (or remaps pages) behind the Z80's back needs to call this.
+void m80_dynarec_flush();
+
+#ifdef M80_DYNAREC
+
+// which 256 byte pages of Z80 memory have translated code in them (checked by m80 on every memory write)
+extern Uint8 g_m80_dynarec_code_page[256];
+
+// returns true if the recompiler has been turned on
+bool m80_dynarec_is_enabled();
+
+// Same as m80's fast loop: executes until g_cycles_executed reaches 'cycles_to_execute' or an EI is executed.
+void m80_dynarec_exec(Uint32 cycles_to_execute);
+
+// called by m80 when the Z80 changes memory that has translated code in it
+void m80_dynarec_invalidate(Uint32 addr);
+
+// m80.cpp provides these for the recompiler
+
+// executes the instruction at PC
+void m80_exec_one();
+
+// executes instructions until g_cycles_executed reaches 'cycles_to_execute' or an EI is executed
+void m80_exec_until(Uint32 cycles_to_execute);
+
+#endif // M80_DYNAREC
+
+#endif // M80_DYNAREC_H
@@ -0,0 +1,490 @@
+/*
+ * m80_idle.cpp
+ *
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of DAPHNE, a laserdisc arcade game emulator
+ *
+ * DAPHNE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * DAPHNE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// m80_idle.cpp
+// Idle loop skipping for the m80 Z80 core (see m80_idle.h)
+
+// HOW IT WORKS
+// An idle loop is a short run of straight-line code that ends with a branch back to its start, doesn't write
+//  to memory or talk to the hardware, and doesn't carry anything over from one trip around the loop to the next
+//  (for example: LD A,(nn) / AND A / JR Z,loop).  Once the Z80 has been around a loop like that, the registers
+//  it ends up with are the same every time, so going around it again can only change the cycle count and R.
+// The loop keeps going until the memory it reads changes.  Rom and ram (pages in the page table) can only change
+//  if a cpu writes to them, and the idle loop doesn't.  Anything else is up to the game driver (see
+//  game::is_idle_read).  Nothing else can change that memory before the next cpu event, and nothing can interrupt
+//  m80's fast loop, so all that the Z80 would do until m80_execute's quota runs out is go around the loop.
+// So we add as many trips around the loop as will fit into the quota to the cycle count and R, and let the
+//  interpreter finish the last trip as usual.  The Z80 ends up in exactly the state it would have been in.
+
+// (game.h and memmap.h have to come before m80_internal.h, which defines A, B, PC etc)
+#include "../game/game.h"
+#include "cpu.h"
+#include "memmap.h"
+#include "m80.h"
+#include "m80_internal.h"
+#include "m80_idle.h"
+
+#ifdef M80_IDLE_SKIP
+
+#define IDLE_MAX_LENGTH	32	// the most bytes an idle loop can have before its branch
+#define IDLE_MAX_INSNS	IDLE_MAX_LENGTH	// (every instruction is at least one byte)
+
+// registers that instructions can use (flags are kept track of separately)
+enum
+{
+	IDLE_A = 0x01, IDLE_B = 0x02, IDLE_C = 0x04, IDLE_D = 0x08,
+	IDLE_E = 0x10, IDLE_H = 0x20, IDLE_L = 0x40, IDLE_SP = 0x80
+};
+
+// the 8-bit registers in the order that Z80 opcodes number them (6 is (HL), which isn't a register)
+static const Uint8 g_idle_reg8[8] = { IDLE_B, IDLE_C, IDLE_D, IDLE_E, IDLE_H, IDLE_L, 0, IDLE_A };
+
+// the register pairs in the order that most Z80 opcodes number them
+static const Uint8 g_idle_reg16[4] = { IDLE_B | IDLE_C, IDLE_D | IDLE_E, IDLE_H | IDLE_L, IDLE_SP };
+
+// the pairs that LD A,(BC) and LD A,(DE) read through
+static const Uint8 g_idle_pair[2] = { M80_BC, M80_DE };
+
+// the flag that each condition (NZ, Z, NC, C, PO, PE, P, M) tests
+static const Uint8 g_idle_cond_flag[4] = { Z_FLAG, C_FLAG, P_FLAG, S_FLAG };
+
+// one decoded instruction
+struct idle_insn
+{
+	Uint8 uLen;	// how many bytes long it is
+	Uint8 uUses;	// registers it looks at
+	Uint8 uDefs;	// registers it changes
+	Uint8 uFlagsUsed;	// flags it looks at
+	Uint8 uFlagsSet;	// flags it changes (the rest are left alone)
+	Uint32 uCycles;	// the cycles it costs
+	Uint32 uRIncs;	// how many times it increments R
+	Uint32 uReads;	// how many entries of 'reads' are used
+	struct m80_idle_read reads[2];	// the memory it reads
+};
+
+Uint32 g_m80_idle_target = M80_IDLE_NONE;
+Uint32 g_m80_idle_rejected = M80_IDLE_NONE;
+
+static bool g_idle_enabled = true;
+
+// returns the bits of g_idle_reg16 that a pair from g_idle_pair (or M80_HL) lives in
+static Uint8 idle_pair_regs(Uint8 uPair)
+{
+	Uint8 uResult = 0;
+	switch (uPair)
+	{
+	case M80_BC:
+		uResult = IDLE_B | IDLE_C;
+		break;
+	case M80_DE:
+		uResult = IDLE_D | IDLE_E;
+		break;
+	case M80_HL:
+		uResult = IDLE_H | IDLE_L;
+		break;
+	default:
+		break;
+	}
+	return uResult;
+}
+
+static void idle_add_read(struct idle_insn *insn, Uint8 uPair, Uint16 uAddr)
+{
+	insn->reads[insn->uReads].uPair = uPair;
+	insn->reads[insn->uReads].uAddr = uAddr;
+	insn->uReads++;
+	insn->uUses |= idle_pair_regs(uPair);
+}
+
+// Decodes the instruction at uPC.
+// Returns false if it isn't something that an idle loop can do (anything that writes to memory, talks to
+//  the hardware, branches, or changes the interrupt state).
+static bool idle_decode(Uint16 uPC, struct idle_insn *insn)
+{
+	const Uint8 *op = opcode_base + uPC;
+	Uint8 uOp = op[0];
+	bool bResult = true;
+
+	insn->uLen = 1;
+	insn->uUses = 0;
+	insn->uDefs = 0;
+	insn->uFlagsUsed = 0;
+	insn->uFlagsSet = 0;
+	insn->uCycles = op_cycles[uOp];
+	insn->uRIncs = 1;
+	insn->uReads = 0;
+
+	// LD r, r' and LD r, (HL) (but not HALT or LD (HL), r)
+	if ((uOp >= 0x40) && (uOp <= 0x7F))
+	{
+		Uint8 uDst = (uOp >> 3) & 7;
+		Uint8 uSrc = uOp & 7;
+
+		if (uDst == 6)
+		{
+			bResult = false;
+		}
+		else
+		{
+			if (uSrc == 6)
+			{
+				idle_add_read(insn, M80_HL, 0);
+			}
+			else
+			{
+				insn->uUses = g_idle_reg8[uSrc];
+			}
+			insn->uDefs = g_idle_reg8[uDst];
+		}
+	}
+
+	// ALU A, r and ALU A, (HL)
+	else if ((uOp >= 0x80) && (uOp <= 0xBF))
+	{
+		Uint8 uSrc = uOp & 7;
+
+		if (uSrc == 6)
+		{
+			idle_add_read(insn, M80_HL, 0);
+		}
+		else
+		{
+			insn->uUses = g_idle_reg8[uSrc];
+		}
+		insn->uUses |= IDLE_A;
+		insn->uDefs = ((uOp & 0x38) == 0x38) ? 0 : IDLE_A;	// CP only changes the flags
+		insn->uFlagsUsed = ((uOp & 0x38) == 0x08) || ((uOp & 0x38) == 0x18) ? C_FLAG : 0;	// ADC and SBC
+		insn->uFlagsSet = 0xFF;
+	}
+
+	else switch (uOp)
+	{
+	case 0x00:	// NOP
+		break;
+
+	// LD rr, nn
+	case 0x01: case 0x11: case 0x21: case 0x31:
+		insn->uLen = 3;
+		insn->uDefs = g_idle_reg16[uOp >> 4];
+		break;
+
+	// INC rr and DEC rr
+	case 0x03: case 0x13: case 0x23: case 0x33:
+	case 0x0B: case 0x1B: case 0x2B: case 0x3B:
+		insn->uUses = insn->uDefs = g_idle_reg16[uOp >> 4];
+		break;
+
+	// LD r, n
+	case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x3E:
+		insn->uLen = 2;
+		insn->uDefs = g_idle_reg8[uOp >> 3];
+		break;
+
+	// INC r and DEC r
+	case 0x04: case 0x0C: case 0x14: case 0x1C: case 0x24: case 0x2C: case 0x3C:
+	case 0x05: case 0x0D: case 0x15: case 0x1D: case 0x25: case 0x2D: case 0x3D:
+		insn->uUses = insn->uDefs = g_idle_reg8[uOp >> 3];
+		insn->uFlagsSet = 0xFF & ~C_FLAG;
+		break;
+
+	// LD A, (BC) and LD A, (DE)
+	case 0x0A: case 0x1A:
+		idle_add_read(insn, g_idle_pair[uOp >> 4], 0);
+		insn->uDefs = IDLE_A;
+		break;
+
+	// LD HL, (nn)
+	case 0x2A:
+		insn->uLen = 3;
+		idle_add_read(insn, 0xFF, (Uint16) (op[1] | (op[2] << 8)));
+		idle_add_read(insn, 0xFF, (Uint16) ((op[1] | (op[2] << 8)) + 1));
+		insn->uDefs = IDLE_H | IDLE_L;
+		break;
+
+	// LD A, (nn)
+	case 0x3A:
+		insn->uLen = 3;
+		idle_add_read(insn, 0xFF, (Uint16) (op[1] | (op[2] << 8)));
+		insn->uDefs = IDLE_A;
+		break;
+
+	// RLCA and RRCA and SCF
+	case 0x07: case 0x0F: case 0x37:
+		insn->uUses = IDLE_A;
+		insn->uDefs = (uOp == 0x37) ? 0 : IDLE_A;
+		insn->uFlagsSet = H_FLAG | N_FLAG | C_FLAG | U5_FLAG | U3_FLAG;
+		break;
+
+	// RLA and RRA and CCF
+	case 0x17: case 0x1F: case 0x3F:
+		insn->uUses = IDLE_A;
+		insn->uDefs = (uOp == 0x3F) ? 0 : IDLE_A;
+		insn->uFlagsUsed = C_FLAG;
+		insn->uFlagsSet = H_FLAG | N_FLAG | C_FLAG | U5_FLAG | U3_FLAG;
+		break;
+
+	// CPL
+	case 0x2F:
+		insn->uUses = insn->uDefs = IDLE_A;
+		insn->uFlagsSet = H_FLAG | N_FLAG | U5_FLAG | U3_FLAG;
+		break;
+
+	// ALU A, n
+	case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+		insn->uLen = 2;
+		insn->uUses = IDLE_A;
+		insn->uDefs = ((uOp & 0x38) == 0x38) ? 0 : IDLE_A;
+		insn->uFlagsUsed = ((uOp & 0x38) == 0x08) || ((uOp & 0x38) == 0x18) ? C_FLAG : 0;
+		insn->uFlagsSet = 0xFF;
+		break;
+
+	// BIT n, r and BIT n, (HL) (which leave the carry flag alone)
+	case 0xCB:
+		{
+			Uint8 uOp2 = op[1];
+			Uint8 uSrc = uOp2 & 7;
+
+			if ((uOp2 >= 0x40) && (uOp2 <= 0x7F))
+			{
+				insn->uLen = 2;
+				insn->uCycles += cb_cycles[uOp2];
+				insn->uRIncs = 2;
+				if (uSrc == 6)
+				{
+					idle_add_read(insn, M80_HL, 0);
+				}
+				else
+				{
+					insn->uUses = g_idle_reg8[uSrc];
+				}
+				insn->uFlagsSet = 0xFF & ~C_FLAG;
+			}
+			else
+			{
+				bResult = false;
+			}
+		}
+		break;
+
+	default:
+		bResult = false;
+		break;
+	}
+
+	return bResult;
+}
+
+// Decodes the branch at uPC, returns false if it isn't a JR, JR cc, JP or JP cc that goes to uTarget.
+static bool idle_decode_branch(Uint16 uPC, Uint16 uTarget, struct idle_insn *insn)
+{
+	const Uint8 *op = opcode_base + uPC;
+	Uint8 uOp = op[0];
+	Uint16 uDest = 0;
+	bool bResult = true;
+
+	insn->uUses = 0;
+	insn->uDefs = 0;
+	insn->uFlagsUsed = 0;
+	insn->uFlagsSet = 0;
+	insn->uCycles = op_cycles[uOp];
+	insn->uRIncs = 1;
+	insn->uReads = 0;
+
+	switch (uOp)
+	{
+	case 0x18:	// JR
+		insn->uLen = 2;
+		break;
+	case 0x20: case 0x28: case 0x30: case 0x38:	// JR cc
+		insn->uLen = 2;
+		insn->uFlagsUsed = g_idle_cond_flag[(uOp >> 4) & 1];
+		insn->uCycles += 5;	// (the loop only keeps going if the branch is taken)
+		break;
+	case 0xC3:	// JP
+		insn->uLen = 3;
+		break;
+	case 0xC2: case 0xCA: case 0xD2: case 0xDA: case 0xE2: case 0xEA: case 0xF2: case 0xFA:	// JP cc
+		insn->uLen = 3;
+		insn->uFlagsUsed = g_idle_cond_flag[(uOp >> 4) & 3];
+		break;
+	default:
+		bResult = false;
+		break;
+	}
+
+	if (bResult)
+	{
+		if (insn->uLen == 2)
+		{
+			uDest = (Uint16) (uPC + 2 + (Sint8) op[1]);
+		}
+		else
+		{
+			uDest = (Uint16) (op[1] | (op[2] << 8));
+		}
+		bResult = (uDest == uTarget);
+	}
+
+	return bResult;
+}
+
+bool m80_idle_analyze(Uint32 uTarget, Uint32 uBranchPC, struct m80_idle_loop *loop)
+{
+	struct idle_insn insns[IDLE_MAX_INSNS + 1];
+	int iCount = 0;
+	Uint32 uPC = uTarget;
+	Uint8 uAllDefs = 0, uAllFlagsSet = 0;
+	Uint8 uDefined = 0, uFlagsDefined = 0;
+	int i = 0;
+
+	// (so that we never look past the end of memory for the rest of an instruction)
+	if ((uTarget > uBranchPC) || (uBranchPC - uTarget > IDLE_MAX_LENGTH) || (uBranchPC > 0xFFFC))
+	{
+		return false;
+	}
+
+	// the loop has to be straight-line code that leads right up to the branch
+	while (uPC < uBranchPC)
+	{
+		if (!idle_decode((Uint16) uPC, &insns[iCount]))
+		{
+			return false;
+		}
+		uPC += insns[iCount].uLen;
+		iCount++;
+	}
+	if ((uPC != uBranchPC) || !idle_decode_branch((Uint16) uBranchPC, (Uint16) uTarget, &insns[iCount]))
+	{
+		return false;
+	}
+	iCount++;
+
+	for (i = 0; i < iCount; i++)
+	{
+		uAllDefs |= insns[i].uDefs;
+		uAllFlagsSet |= insns[i].uFlagsSet;
+	}
+
+	// Nothing that the loop changes can be looked at before the loop changes it (otherwise each trip around
+	//  the loop could be different from the last one).
+	for (i = 0; i < iCount; i++)
+	{
+		if ((insns[i].uUses & ~uDefined & uAllDefs) || (insns[i].uFlagsUsed & ~uFlagsDefined & uAllFlagsSet))
+		{
+			return false;
+		}
+		uDefined |= insns[i].uDefs;
+		uFlagsDefined |= insns[i].uFlagsSet;
+	}
+
+	// A register pair that the loop reads through can't change after the read, so that when we check the
+	//  memory it reads (at the end of a trip around the loop), the pair still holds the address.
+	Uint8 uDefsAfter = 0;
+	loop->uReads = 0;
+	for (i = iCount - 1; i >= 0; i--)
+	{
+		uDefsAfter |= insns[i].uDefs;
+		for (Uint32 u = 0; u < insns[i].uReads; u++)
+		{
+			if (idle_pair_regs(insns[i].reads[u].uPair) & uDefsAfter)
+			{
+				return false;
+			}
+			loop->reads[loop->uReads++] = insns[i].reads[u];
+		}
+	}
+
+	loop->uCycles = 0;
+	loop->uRIncs = 0;
+	for (i = 0; i < iCount; i++)
+	{
+		loop->uCycles += insns[i].uCycles;
+		loop->uRIncs += insns[i].uRIncs;
+	}
+
+	return true;
+}
+
+bool m80_idle_skip_loop(const struct m80_idle_loop *loop)
+{
+	if (!g_idle_enabled)
+	{
+		return false;
+	}
+
+	// the memory the loop reads must not be able to change before the next cpu event
+	for (Uint32 u = 0; u < loop->uReads; u++)
+	{
+		Uint16 uAddr = loop->reads[u].uAddr;
+		if (loop->reads[u].uPair != 0xFF)
+		{
+			uAddr = g_pContext->m80_regs[loop->reads[u].uPair].w;
+		}
+		if ((g_mem_pages[uAddr >> MEM_PAGE_SHIFT].read == NULL) && !g_game->is_idle_read(uAddr))
+		{
+			return false;
+		}
+	}
+
+	// The interpreter would start every instruction of every trip around the loop that begins before
+	//  the quota runs out, so we can skip as many whole trips as will fit.
+	if (g_cycles_executed >= g_cycles_to_execute)
+	{
+		return false;
+	}
+	Uint32 uTrips = (g_cycles_to_execute - g_cycles_executed) / loop->uCycles;
+	if (uTrips == 0)
+	{
+		return false;
+	}
+
+	Uint32 uSkipped = uTrips * loop->uCycles;
+	g_cycles_executed += uSkipped;
+	R = (Uint8) (((R + uTrips * loop->uRIncs) & 0x7F) | (R & 0x80));	// (bit 7 of R never changes)
+	cpu_idle_skipped(uSkipped);
+
+	return true;
+}
+
+void m80_idle_check(Uint32 uBranchPC)
+{
+	if (g_idle_enabled)
+	{
+		struct m80_idle_loop loop;
+		if (m80_idle_analyze(PC, uBranchPC, &loop) && m80_idle_skip_loop(&loop))
+		{
+			return;
+		}
+	}
+
+	// don't look at this loop again until interrupts have had a chance to change things
+	g_m80_idle_rejected = PC;
+}
+
+#endif // M80_IDLE_SKIP
+
+void m80_set_idle_skip(bool bEnabled)
+{
+#ifdef M80_IDLE_SKIP
+	g_idle_enabled = bEnabled;
+#endif // M80_IDLE_SKIP
+}
@@ -0,0 +1,90 @@
+/*
+ * m80_idle.h
+ *
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of DAPHNE, a laserdisc arcade game emulator
+ *
+ * DAPHNE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * DAPHNE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// m80_idle.h
+// Idle loop skipping for the m80 Z80 core (turn it off with -noidleskip).
+// Most Z80 games spend a lot of their time in a short loop that polls memory until an interrupt
+//  (or the hardware) changes something.  When m80 sees the Z80 going around a loop like that, it skips
+//  straight to the end of the cycles it was asked to execute (which cpu_execute always stops at the next
+//  cpu event) instead of going around the loop thousands of times.
+
+#ifndef M80_IDLE_H
+#define M80_IDLE_H
+
+// for Uint32, Uint8, etc definitions
+#include <SDL.h>
+
+// The cpu debugger needs to see every instruction, so idle loops aren't skipped with CPU_DEBUG.
+// Define M80_NO_IDLE_SKIP to leave it out.
+#if !defined(CPU_DEBUG) && !defined(M80_NO_IDLE_SKIP)
+#define M80_IDLE_SKIP
+#endif
+
+// Turns idle loop skipping on or off (it's on by default).
+void m80_set_idle_skip(bool bEnabled);
+
+#ifdef M80_IDLE_SKIP
+
+// most memory reads that an idle loop makes
+#define M80_IDLE_MAX_READS	32
+
+// what g_m80_idle_target and g_m80_idle_rejected hold when they don't hold an address
+#define M80_IDLE_NONE	0x10000
+
+// one memory read that an idle loop makes
+struct m80_idle_read
+{
+	Uint8 uPair;	// the register pair (M80_BC, M80_DE or M80_HL) that holds the address, or 0xFF if the address is uAddr
+	Uint16 uAddr;	// the address (if uPair is 0xFF)
+};
+
+// a loop that can be skipped
+struct m80_idle_loop
+{
+	Uint32 uCycles;	// how many cycles it takes to go around the loop once
+	Uint32 uRIncs;	// how many times R gets incremented on the way around
+	Uint32 uReads;	// how many entries of 'reads' are used
+	struct m80_idle_read reads[M80_IDLE_MAX_READS];	// the memory that the loop polls
+};
+
+// The last address that a backward branch went to, and the last address that turned out not to be an idle loop.
+// m80_execute resets these to M80_IDLE_NONE whenever interrupts get a chance to happen.
+extern Uint32 g_m80_idle_target;
+extern Uint32 g_m80_idle_rejected;
+
+// Called by m80 when the branch at uBranchPC has gone back to the same address (PC) twice in a row.
+// If the Z80 is in an idle loop, this uses up the rest of the cycles that it was asked to execute.
+void m80_idle_check(Uint32 uBranchPC);
+
+// Looks at the code from uTarget to the branch at uBranchPC (which goes back to uTarget).
+// Returns true (and fills in 'loop') if going around it again can't change anything but the cycle count and R,
+//  as long as the memory it reads doesn't change.
+bool m80_idle_analyze(Uint32 uTarget, Uint32 uBranchPC, struct m80_idle_loop *loop);
+
+// Called when the Z80 has just gone back to the top of 'loop'.
+// If the memory that 'loop' reads can't change until the next cpu event, this skips as many trips around
+//  the loop as will fit into the cycles that the Z80 has left to execute, and returns true.
+bool m80_idle_skip_loop(const struct m80_idle_loop *loop);
+
+#endif // M80_IDLE_SKIP
+
+#endif // M80_IDLE_H
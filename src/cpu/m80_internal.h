@@ -25,13 +25,16 @@
 #define M80_INTERNAL_H
 
 // m80_internal.h
-// NOTE : This should not be #included by any other file than m80.cpp
+// NOTE : This should not be #included by any other file than m80.cpp (and m80_dynarec.cpp and m80_idle.cpp)
 
 #include <SDL.h>
 // SDL.h is used to determine endianness and define some variable types
 // No actual SDL functions are used, so you can redefine your own variables
 // if you choose.
 
+#include "m80_dynarec.h"
+#include "m80_idle.h"
+
 /* if we are integrating with daphne, define this */
 #define INTEGRATE 1
 
@@ -80,8 +83,17 @@ struct m80_context
 	/* if this flag is true, no interrupts will be issued until after the next instruction */
 	/* EI masks all interrupts for the proceeding instruction */
 	/* (see Sean Young's undocumented z80 document for explanation of this behavior) */
+	Uint8 *opcode_base;	/* where this cpu's memory begins (kept here so that m80_set_instance can switch memory too) */
 };
 
+// these live in m80.cpp (declared here so that the recompiler and the idle loop skipper can get at them too)
+extern struct m80_context *g_pContext;	// the context of the cpu being emulated (see m80_set_instance)
+extern Uint32 g_cycles_executed;
+extern Uint32 g_cycles_to_execute;
+extern Uint8 *opcode_base;
+extern const Uint8 op_cycles[256];
+extern const Uint8 cb_cycles[256];
+
 #define C_FLAG	1
 #define N_FLAG	2
 #define P_FLAG	4
@@ -93,32 +105,32 @@ struct m80_context
 #define S_FLAG	128
 
 // I _hate_ macros but these just plain make the code look better =)
-#define FLAGS	g_context.m80_regs[M80_AF].b.l
-#define A		g_context.m80_regs[M80_AF].b.h
-#define AF		g_context.m80_regs[M80_AF].w
-#define AFPRIME	g_context.m80_regs[M80_AFPRIME].w
-#define B		g_context.m80_regs[M80_BC].b.h
-#define C		g_context.m80_regs[M80_BC].b.l
-#define BC		g_context.m80_regs[M80_BC].w
-#define BCPRIME	g_context.m80_regs[M80_BCPRIME].w
-#define D		g_context.m80_regs[M80_DE].b.h
-#define E		g_context.m80_regs[M80_DE].b.l
-#define DE		g_context.m80_regs[M80_DE].w
-#define DEPRIME	g_context.m80_regs[M80_DEPRIME].w
-#define H		g_context.m80_regs[M80_HL].b.h
-#define L		g_context.m80_regs[M80_HL].b.l
-#define HL		g_context.m80_regs[M80_HL].w
-#define HLPRIME	g_context.m80_regs[M80_HLPRIME].w
-#define PC		g_context.m80_regs[M80_PC].w
-#define SP		g_context.m80_regs[M80_SP].w
-#define R		g_context.m80_regs[M80_RI].b.h
-#define I		g_context.m80_regs[M80_RI].b.l
-#define IXh	g_context.m80_regs[M80_IX].b.h
-#define IXl	g_context.m80_regs[M80_IX].b.l
-#define IX	g_context.m80_regs[M80_IX].w
-#define IYh	g_context.m80_regs[M80_IY].b.h
-#define IYl	g_context.m80_regs[M80_IY].b.l
-#define IY	g_context.m80_regs[M80_IY].w
+#define FLAGS	g_pContext->m80_regs[M80_AF].b.l
+#define A		g_pContext->m80_regs[M80_AF].b.h
+#define AF		g_pContext->m80_regs[M80_AF].w
+#define AFPRIME	g_pContext->m80_regs[M80_AFPRIME].w
+#define B		g_pContext->m80_regs[M80_BC].b.h
+#define C		g_pContext->m80_regs[M80_BC].b.l
+#define BC		g_pContext->m80_regs[M80_BC].w
+#define BCPRIME	g_pContext->m80_regs[M80_BCPRIME].w
+#define D		g_pContext->m80_regs[M80_DE].b.h
+#define E		g_pContext->m80_regs[M80_DE].b.l
+#define DE		g_pContext->m80_regs[M80_DE].w
+#define DEPRIME	g_pContext->m80_regs[M80_DEPRIME].w
+#define H		g_pContext->m80_regs[M80_HL].b.h
+#define L		g_pContext->m80_regs[M80_HL].b.l
+#define HL		g_pContext->m80_regs[M80_HL].w
+#define HLPRIME	g_pContext->m80_regs[M80_HLPRIME].w
+#define PC		g_pContext->m80_regs[M80_PC].w
+#define SP		g_pContext->m80_regs[M80_SP].w
+#define R		g_pContext->m80_regs[M80_RI].b.h
+#define I		g_pContext->m80_regs[M80_RI].b.l
+#define IXh	g_pContext->m80_regs[M80_IX].b.h
+#define IXl	g_pContext->m80_regs[M80_IX].b.l
+#define IX	g_pContext->m80_regs[M80_IX].w
+#define IYh	g_pContext->m80_regs[M80_IY].b.h
+#define IYl	g_pContext->m80_regs[M80_IY].b.l
+#define IY	g_pContext->m80_regs[M80_IY].w
 
 #ifdef CPU_DEBUG
 #define M80_ERROR(MESSAGE)	printf(MESSAGE); printf("Opcode %x at PC %x\n", opcode_base[PC-1], PC-1)
@@ -142,19 +154,43 @@ struct m80_context
 
 // read Z80 memory into 16-bit z80 register
 #define M80_READ_WORD(addr, reg_index)	\
-	g_context.m80_regs[reg_index].b.l = M80_READ_BYTE(addr);	\
-	g_context.m80_regs[reg_index].b.h = M80_READ_BYTE(addr+1)
+	g_pContext->m80_regs[reg_index].b.l = M80_READ_BYTE(addr);	\
+	g_pContext->m80_regs[reg_index].b.h = M80_READ_BYTE(addr+1)
+
+#ifdef M80_DYNAREC
+// writes an 8-bit byte into z80 memory, throwing away translated code if the write changes it
+// (writes to rom normally get thrown away by the game driver, so this only costs anything on pages with translated code)
+static inline void m80_write_byte(Uint32 addr, Uint8 val)
+{
+	if (g_m80_dynarec_code_page[(addr >> 8) & 0xFF])
+	{
+		Uint8 old_val = opcode_base[addr & 0xFFFF];
+		cpu_writemem16(addr, val);
+		if (opcode_base[addr & 0xFFFF] != old_val)
+		{
+			m80_dynarec_invalidate(addr);
+		}
+	}
+	else
+	{
+		cpu_writemem16(addr, val);
+	}
+}
 
+#define M80_WRITE_BYTE(addr, val)	\
+	m80_write_byte(addr, val)
+#else
 // writes an 8-bit byte into z80 memory
 // addr is where to write, val is which value to write
 #define M80_WRITE_BYTE(addr, val)	\
 	cpu_writemem16(addr, val)	\
 /*	opcode_base[addr] = val */
+#endif // M80_DYNAREC
 
 // write 16-bit z80 reg into Z80 memory
 #define M80_WRITE_WORD(addr, reg_index)	\
-	M80_WRITE_BYTE(addr, g_context.m80_regs[reg_index].b.l);	\
-	M80_WRITE_BYTE(addr+1, g_context.m80_regs[reg_index].b.h)
+	M80_WRITE_BYTE(addr, g_pContext->m80_regs[reg_index].b.l);	\
+	M80_WRITE_BYTE(addr+1, g_pContext->m80_regs[reg_index].b.h)
 
 #define M80_GET_ARG opcode_base[PC++]
 #define M80_PEEK_ARG opcode_base[PC]
@@ -172,14 +208,14 @@ struct m80_context
 
 // Interrupt check macro
 #define CHECK_INTERRUPT	\
-	if (g_context.nmi_state == ASSERT_LINE) /* NMI takes priority over IRQ so check it first */	\
+	if (g_pContext->nmi_state == ASSERT_LINE) /* NMI takes priority over IRQ so check it first */	\
 	{	\
 		m80_activate_nmi();	\
 	}	\
-	else if (g_context.irq_state == ASSERT_LINE)	\
+	else if (g_pContext->irq_state == ASSERT_LINE)	\
 	{	\
 		/* we can only do an IRQ if IFF1 flipflop is set */	\
-		if (g_context.IFF1)	\
+		if (g_pContext->IFF1)	\
 		{	\
 			m80_activate_irq();	\
 		}	\
@@ -199,23 +235,23 @@ struct m80_context
 // Enable Maskable Interrupt macro
 #define M80_EI	\
 	/* IFF1 and IFF2 are simultaneously set by EI */	\
-	g_context.IFF1 = 1;	\
-	g_context.IFF2 = 1;	\
-	g_context.got_EI = 1;	/* the next instruction must not be interrupted */
+	g_pContext->IFF1 = 1;	\
+	g_pContext->IFF2 = 1;	\
+	g_pContext->got_EI = 1;	/* the next instruction must not be interrupted */
 
 // Disable Maskable Interrupt macro
 #define M80_DI	\
-	g_context.IFF1 = 0;	\
-	g_context.IFF2 = 0;	\
-/*	g_context.got_EI = 1; */	/* it's DI, but we still need the same action */
+	g_pContext->IFF1 = 0;	\
+	g_pContext->IFF2 = 0;	\
+/*	g_pContext->got_EI = 1; */	/* it's DI, but we still need the same action */
 
-// FIXME: I removed the above g_context.got_EI in order to compare exactly with mame's core
-// but I believe mame has a bug in this regard and that the g_context.got_EI should be uncommencted
+// FIXME: I removed the above g_pContext->got_EI in order to compare exactly with mame's core
+// but I believe mame has a bug in this regard and that the g_pContext->got_EI should be uncommencted
 // once we're done debugging
 
 // Macro to go into HALT mode
 #define M80_START_HALT	\
-	g_context.halted = 1;	\
+	g_pContext->halted = 1;	\
 	PC--;	\
 	/* move PC so it's pointing back to this HALT statement, so next time instruction executes, */	\
 	/* it comes to this HALT again */	\
@@ -223,7 +259,7 @@ struct m80_context
 	/* If we didn't just barely get an EI */	\
 	/* instruction, then interrupts won't be set this time around and we */	\
 	/* can safely use up the rest of the cycles quickly. */	\
-	if (!g_context.got_EI)	\
+	if (!g_pContext->got_EI)	\
 	{	\
 		int remaining = g_cycles_to_execute - g_cycles_executed;	\
 		/* if we still have cycles that need to be used up */	\
@@ -237,18 +273,44 @@ struct m80_context
 
 // macro to check to see if we're halted and if so, fix the PC and unhalt us
 #define M80_STOP_HALT	\
-	if (g_context.halted)	\
+	if (g_pContext->halted)	\
 	{	\
-		g_context.halted = 0;	\
+		g_pContext->halted = 0;	\
 		PC++;	\
 	}
 
+// Checks for an idle loop after a branch (branch_pc is where the branch instruction is).
+// A backward branch that goes to the same place twice in a row (with nothing in between that could have
+//  taken an interrupt) might be an idle loop, see m80_idle.cpp
+#ifdef M80_IDLE_SKIP
+#define M80_IDLE_BRANCH(branch_pc)	\
+	if (PC <= (branch_pc))	\
+	{	\
+		if (PC != g_m80_idle_target)	\
+		{	\
+			g_m80_idle_target = PC;	\
+		}	\
+		else if (PC != g_m80_idle_rejected)	\
+		{	\
+			m80_idle_check(branch_pc);	\
+		}	\
+	}
+
+// forgets about the last backward branch (called whenever an interrupt could happen)
+#define M80_IDLE_RESET	\
+	g_m80_idle_target = M80_IDLE_NONE;	\
+	g_m80_idle_rejected = M80_IDLE_NONE
+#else
+#define M80_IDLE_BRANCH(branch_pc)
+#define M80_IDLE_RESET
+#endif // M80_IDLE_SKIP
+
 // Branch macro
 #define M80_BRANCH_UNCOND(pc_offset) PC = PC + ((Sint8) pc_offset); M80_CHANGE_PC(PC)
 // Conditional branch macro that adds the extra cycles
 
 // workaround gcc4 bug (get the offset in a separate instruction before branching)
-#define M80_BRANCH { int iOffset = M80_GET_ARG; M80_BRANCH_UNCOND(iOffset); }
+#define M80_BRANCH { Uint16 uBranchPC = PC - 1; int iOffset = M80_GET_ARG; M80_BRANCH_UNCOND(iOffset); M80_IDLE_BRANCH(uBranchPC); }
 
 #define M80_BRANCH_COND(condition)	\
 	if (condition)	\
@@ -261,7 +323,7 @@ struct m80_context
 
 // Jump macro
 #define M80_JUMP \
-	PC = M80_PEEK_WORD; M80_CHANGE_PC(PC)
+	{ Uint16 uBranchPC = PC - 1; PC = M80_PEEK_WORD; M80_CHANGE_PC(PC); M80_IDLE_BRANCH(uBranchPC); }
 
 // Conditional jump macro that adds the extra cycles
 #define M80_JUMP_COND(condition)	\
@@ -274,13 +274,15 @@ void mw_i86_set_mem(Uint8 *mem);
 /////////////////////////////
 
 #include "../game/game.h"
-// included to make sure that g_game is defined, for the following macros
+#include "memmap.h"
+// included to make sure that g_game and the page table are defined, for the following macros
 
 // MPO : changed all of these to macros to eliminate (possible) function call overhead in case compiler doesn't inline functions
-#define cpu_readmem16(addr) g_game->cpu_mem_read(static_cast<Uint16>(addr))
-#define cpu_readmem20(addr) g_game->cpu_mem_read(static_cast<Uint32>(addr))
-#define cpu_writemem16(addr,value) g_game->cpu_mem_write(static_cast<Uint16>(addr), value)
-#define cpu_writemem20(addr,value) g_game->cpu_mem_write(static_cast<Uint32>(addr), value)
+// Memory accesses go through the page table first and only call the game driver for unmapped pages.
+#define cpu_readmem16(addr) memmap_read16(addr)
+#define cpu_readmem20(addr) memmap_read20(addr)
+#define cpu_writemem16(addr,value) memmap_write16(addr, value)
+#define cpu_writemem20(addr,value) memmap_write20(addr, value)
 #define cpu_readport16(port) g_game->port_read(port)
 #define cpu_writeport16(port,value) g_game->port_write(port, value)
 #define change_pc16(new_pc) g_game->update_pc(new_pc)
@@ -0,0 +1,110 @@
+/*
+ * memmap.h
+ *
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of DAPHNE, a laserdisc arcade game emulator
+ *
+ * DAPHNE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * DAPHNE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// memmap.h
+// Page table memory dispatch for the cpu cores.
+// Each cpu's address space is split up into pages of MEM_PAGE_SIZE bytes.  A page can point
+//  directly to memory (for reading, writing or both) or it can be left unmapped, in which case
+//  the game driver's cpu_mem_read/cpu_mem_write gets called like it always has.
+// By default every page is unmapped, so drivers that don't register any pages behave exactly as before.
+// Drivers register pages using game::map_cpu_ram, game::map_cpu_rom, etc.
+
+#ifndef MEMMAP_H
+#define MEMMAP_H
+
+#include "cpu.h"	// for CPU_MEM_SIZE
+#include "../game/game.h"	// for g_game
+
+#define MEM_PAGE_SHIFT	8	/* 256 byte pages */
+#define MEM_PAGE_SIZE	(1 << MEM_PAGE_SHIFT)
+#define MEM_PAGE_MASK	(MEM_PAGE_SIZE - 1)
+#define MEM_PAGE_COUNT	(CPU_MEM_SIZE >> MEM_PAGE_SHIFT)	/* enough pages to cover the largest (20-bit) address space */
+
+struct mem_page
+{
+	Uint8 *read;	// where reads from this page come from (NULL means call the game driver)
+	Uint8 *write;	// where writes to this page go (NULL means call the game driver)
+};
+
+// the page table of the currently active cpu (never NULL, each cpu thread has its own)
+extern CPU_THREAD_LOCAL struct mem_page *g_mem_pages;
+
+// points g_mem_pages to the page table of the indicated cpu (only the cpu scheduler should need to call this)
+void memmap_select(struct cpudef *cpu);
+
+// MPO : these are inline (instead of functions in memmap.cpp) because they get called for nearly every instruction
+
+static inline Uint8 memmap_read16(Uint32 addr)
+{
+	addr &= 0xFFFF;
+	const struct mem_page *page = &g_mem_pages[addr >> MEM_PAGE_SHIFT];
+	if (page->read)
+	{
+		return page->read[addr & MEM_PAGE_MASK];
+	}
+	return g_game->cpu_mem_read(static_cast<Uint16>(addr));
+}
+
+static inline Uint8 memmap_read20(Uint32 addr)
+{
+	// the page table only covers CPU_MEM_SIZE, anything beyond that goes to the game driver untouched
+	if (addr < CPU_MEM_SIZE)
+	{
+		const struct mem_page *page = &g_mem_pages[addr >> MEM_PAGE_SHIFT];
+		if (page->read)
+		{
+			return page->read[addr & MEM_PAGE_MASK];
+		}
+	}
+	return g_game->cpu_mem_read(static_cast<Uint32>(addr));
+}
+
+static inline void memmap_write16(Uint32 addr, Uint8 value)
+{
+	addr &= 0xFFFF;
+	const struct mem_page *page = &g_mem_pages[addr >> MEM_PAGE_SHIFT];
+	if (page->write)
+	{
+		page->write[addr & MEM_PAGE_MASK] = value;
+	}
+	else
+	{
+		g_game->cpu_mem_write(static_cast<Uint16>(addr), value);
+	}
+}
+
+static inline void memmap_write20(Uint32 addr, Uint8 value)
+{
+	// same as memmap_read20
+	if (addr < CPU_MEM_SIZE)
+	{
+		const struct mem_page *page = &g_mem_pages[addr >> MEM_PAGE_SHIFT];
+		if (page->write)
+		{
+			page->write[addr & MEM_PAGE_MASK] = value;
+			return;
+		}
+	}
+	g_game->cpu_mem_write(static_cast<Uint32>(addr), value);
+}
+
+#endif // MEMMAP_H
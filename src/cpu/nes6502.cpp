@@ -77,7 +77,7 @@
 #define  ADD_CYCLES(x) \
 { \
    remaining_cycles -= (x); \
-   cpu.total_cycles += (x); \
+   cpu->total_cycles += (x); \
 }
 
 /*
@@ -574,10 +574,10 @@
 { \
    i_flag = 0; \
    ADD_CYCLES(2); \
-   if (cpu.int_pending && (remaining_cycles > 0)) \
+   if (cpu->int_pending && (remaining_cycles > 0)) \
    { \
       IRQ(); \
-      cpu.int_pending = 0; \
+      cpu->int_pending = 0; \
    } \
 }
 
@@ -704,8 +704,8 @@
 #define JAM() \
 { \
    PC--; \
-   cpu.jammed = TRUE; \
-   cpu.int_pending = 0; \
+   cpu->jammed = TRUE; \
+   cpu->int_pending = 0; \
    ADD_CYCLES(2); \
 }
 #endif /* !NES6502_TESTOPS */
@@ -956,9 +956,9 @@
    PC = PULL(); \
    PC |= PULL() << 8; \
    ADD_CYCLES(6); \
-   if (0 == i_flag && cpu.int_pending && (remaining_cycles > 0)) \
+   if (0 == i_flag && cpu->int_pending && (remaining_cycles > 0)) \
    { \
-      cpu.int_pending = 0; \
+      cpu->int_pending = 0; \
       IRQ(); \
    } \
 }
@@ -1186,7 +1186,10 @@
 
 
 /* internal CPU context */
-static nes6502_context cpu;
+static nes6502_context own_cpu;
+
+/* the context being executed (own_cpu unless nes6502_setinstance has been called) */
+static nes6502_context *cpu = &own_cpu;
 
 /* memory region pointers */
 static uint8 *ram = NULL, *stack = NULL;
@@ -1218,7 +1221,7 @@ INLINE uint32 zp_readword(register uint8 address)
 
 INLINE uint8 bank_readbyte(register uint32 address)
 {
-   return cpu.mem_page[address >> NES6502_BANKSHIFT][address & NES6502_BANKMASK];
+   return cpu->mem_page[address >> NES6502_BANKSHIFT][address & NES6502_BANKMASK];
 }
 
 INLINE uint32 bank_readword(register uint32 address)
@@ -1226,12 +1229,12 @@ INLINE uint32 bank_readword(register uint32 address)
 #ifdef HOST_LITTLE_ENDIAN
    /* TODO: this fails if src address is $xFFF */
    /* TODO: this fails if host architecture doesn't support byte alignment */
-   return (uint32) (*(uint16 *)(cpu.mem_page[address >> NES6502_BANKSHIFT] + (address & NES6502_BANKMASK)));
+   return (uint32) (*(uint16 *)(cpu->mem_page[address >> NES6502_BANKSHIFT] + (address & NES6502_BANKMASK)));
 #else
 #ifdef TARGET_CPU_PPC
-   return __lhbrx(cpu.mem_page[address >> NES6502_BANKSHIFT], address & NES6502_BANKMASK);
+   return __lhbrx(cpu->mem_page[address >> NES6502_BANKSHIFT], address & NES6502_BANKMASK);
 #else
-   uint32 x = (uint32) *(uint16 *)(cpu.mem_page[address >> NES6502_BANKSHIFT] + (address & NES6502_BANKMASK));
+   uint32 x = (uint32) *(uint16 *)(cpu->mem_page[address >> NES6502_BANKSHIFT] + (address & NES6502_BANKMASK));
    return (x << 8) | (x >> 8);
 #endif /* TARGET_CPU_PPC */
 #endif /* HOST_LITTLE_ENDIAN */
@@ -1239,7 +1242,7 @@ INLINE uint32 bank_readword(register uint32 address)
 
 INLINE void bank_writebyte(register uint32 address, register uint8 value)
 {
-   cpu.mem_page[address >> NES6502_BANKSHIFT][address & NES6502_BANKMASK] = value;
+   cpu->mem_page[address >> NES6502_BANKSHIFT][address & NES6502_BANKMASK] = value;
 }
 
 /* read a byte of 6502 memory */
@@ -1257,7 +1260,7 @@ static uint8 mem_readbyte(uint32 address)
    /* check memory range handlers */
 //   else
    {
-      for (mr = cpu.read_handler; mr->min_range != 0xFFFFFFFF; mr++)
+      for (mr = cpu->read_handler; mr->min_range != 0xFFFFFFFF; mr++)
       {
          if (address >= mr->min_range && address <= mr->max_range)
             return mr->read_func(address);
@@ -1282,7 +1285,7 @@ static void mem_writebyte(uint32 address, uint8 value)
    /* check memory range handlers */
 //   else
    {
-      for (mw = cpu.write_handler; mw->min_range != 0xFFFFFFFF; mw++)
+      for (mw = cpu->write_handler; mw->min_range != 0xFFFFFFFF; mw++)
       {
          if (address >= mw->min_range && address <= mw->max_range)
          {
@@ -1303,18 +1306,35 @@ void nes6502_setcontext(nes6502_context *context)
 
    ASSERT(context);
 
-   memcpy(&cpu, context, sizeof(nes6502_context));
+   memcpy(cpu, context, sizeof(nes6502_context));
 
    for (loop = 0; loop < NES6502_NUMBANKS; loop++)
    {
-      if (NULL == cpu.mem_page[loop])
-         cpu.mem_page[loop] = dead_page;
+      if (NULL == cpu->mem_page[loop])
+         cpu->mem_page[loop] = dead_page;
    }
 
-   ram = cpu.mem_page[0];  /* quick zero-page/RAM references */
+   ram = cpu->mem_page[0];  /* quick zero-page/RAM references */
    stack = ram + STACK_OFFSET;
 
-   cpu.jammed = FALSE;
+   cpu->jammed = FALSE;
+}
+
+/* execute directly on 'context' from now on instead of copying it in (NULL goes back to the internal context) */
+void nes6502_setinstance(nes6502_context *context)
+{
+   int loop;
+
+   cpu = context ? context : &own_cpu;
+
+   for (loop = 0; loop < NES6502_NUMBANKS; loop++)
+   {
+      if (NULL == cpu->mem_page[loop])
+         cpu->mem_page[loop] = dead_page;
+   }
+
+   ram = cpu->mem_page[0];  /* quick zero-page/RAM references */
+   stack = ram + STACK_OFFSET;
 }
 
 /* get the current context */
@@ -1324,7 +1344,7 @@ void nes6502_getcontext(nes6502_context *context)
 
    ASSERT(context);
 
-   memcpy(context, &cpu, sizeof(nes6502_context));
+   memcpy(context, cpu, sizeof(nes6502_context));
 
    for (loop = 0; loop < NES6502_NUMBANKS; loop++)
    {
@@ -1342,32 +1362,32 @@ uint8 nes6502_getbyte(uint32 address)
 /* get number of elapsed cycles */
 uint32 nes6502_getcycles(boolean reset_flag)
 {
-   uint32 cycles = cpu.total_cycles;
+   uint32 cycles = cpu->total_cycles;
 
    if (reset_flag)
-      cpu.total_cycles = 0;
+      cpu->total_cycles = 0;
 
    return cycles;
 }
 
 #define  GET_GLOBAL_REGS() \
 { \
-   PC = cpu.pc_reg; \
-   A = cpu.a_reg; \
-   X = cpu.x_reg; \
-   Y = cpu.y_reg; \
-   SCATTER_FLAGS(cpu.p_reg); \
-   S = cpu.s_reg; \
+   PC = cpu->pc_reg; \
+   A = cpu->a_reg; \
+   X = cpu->x_reg; \
+   Y = cpu->y_reg; \
+   SCATTER_FLAGS(cpu->p_reg); \
+   S = cpu->s_reg; \
 }
 
 #define  STORE_LOCAL_REGS() \
 { \
-   cpu.pc_reg = PC; \
-   cpu.a_reg = A; \
-   cpu.x_reg = X; \
-   cpu.y_reg = Y; \
-   cpu.p_reg = COMBINE_FLAGS(); \
-   cpu.s_reg = S; \
+   cpu->pc_reg = PC; \
+   cpu->a_reg = A; \
+   cpu->x_reg = X; \
+   cpu->y_reg = Y; \
+   cpu->p_reg = COMBINE_FLAGS(); \
+   cpu->s_reg = S; \
 }
 
 #define  MIN(a,b)    (((a) < (b)) ? (a) : (b))
@@ -1384,8 +1404,8 @@ uint32 g_old_cycles = 0;	// MPO : moved this here so other functions could acces
 // MATT : changed this to match callback prototype
 unsigned int nes6502_execute(unsigned int cycles_to_execute)
 {
-//   int old_cycles = cpu.total_cycles;
-	g_old_cycles = cpu.total_cycles;	// MPO
+//   int old_cycles = cpu->total_cycles;
+	g_old_cycles = cpu->total_cycles;	// MPO
    int remaining_cycles = cycles_to_execute;
    uint32 temp, addr; /* for macros */
    uint8 btemp, baddr; /* for macros */
@@ -1450,23 +1470,23 @@ unsigned int nes6502_execute(unsigned int cycles_to_execute)
 
    GET_GLOBAL_REGS();
 
-   if (cpu.int_pending && remaining_cycles)
+   if (cpu->int_pending && remaining_cycles)
    {
       if (0 == i_flag)
       {
-         cpu.int_pending = 0;
+         cpu->int_pending = 0;
          IRQ();
       }
    }
 
    /* check for DMA cycle burning */
-   if (cpu.burn_cycles && remaining_cycles)
+   if (cpu->burn_cycles && remaining_cycles)
    {
       int burn_for;
       
-      burn_for = MIN(remaining_cycles, cpu.burn_cycles);
+      burn_for = MIN(remaining_cycles, cpu->burn_cycles);
       ADD_CYCLES(burn_for);
-      cpu.burn_cycles -= burn_for;
+      cpu->burn_cycles -= burn_for;
    }
       
 #ifdef NES6502_JUMPTABLE
@@ -2434,26 +2454,26 @@ end_execute:
    STORE_LOCAL_REGS();
 
    /* Return our actual amount of executed cycles */
-   return (cpu.total_cycles - g_old_cycles);	// MPO : changed old_cycles to g_old_cycles
+   return (cpu->total_cycles - g_old_cycles);	// MPO : changed old_cycles to g_old_cycles
 }
 
 #if 0
 void nes6502_init(void)
 {
-   cpu.a_reg = cpu.x_reg = cpu.y_reg = 0;
-   cpu.s_reg = 0xFF;                         /* Stack grows down */
-   cpu.burn_cycles = 0;
+   cpu->a_reg = cpu->x_reg = cpu->y_reg = 0;
+   cpu->s_reg = 0xFF;                         /* Stack grows down */
+   cpu->burn_cycles = 0;
 }
 #endif
 
 /* Issue a CPU Reset */
 void nes6502_reset(void)
 {
-   cpu.p_reg = Z_FLAG6502 | R_FLAG6502 | I_FLAG6502;     /* Reserved bit always 1 */
-   cpu.int_pending = 0;                      /* No pending interrupts */
-   cpu.pc_reg = bank_readword(RESET_VECTOR); /* Fetch reset vector */
-   cpu.burn_cycles = RESET_CYCLES;
-   cpu.jammed = FALSE;
+   cpu->p_reg = Z_FLAG6502 | R_FLAG6502 | I_FLAG6502;     /* Reserved bit always 1 */
+   cpu->int_pending = 0;                      /* No pending interrupts */
+   cpu->pc_reg = bank_readword(RESET_VECTOR); /* Fetch reset vector */
+   cpu->burn_cycles = RESET_CYCLES;
+   cpu->jammed = FALSE;
 }
 
 /* Non-maskable interrupt */
@@ -2467,11 +2487,11 @@ void nes6502_nmi(void)
    uint8 n_flag, v_flag, b_flag;
    uint8 d_flag, i_flag, z_flag, c_flag;
 
-   if (FALSE == cpu.jammed)
+   if (FALSE == cpu->jammed)
    {
       GET_GLOBAL_REGS();
       NMI_PROC();
-      cpu.burn_cycles += INT_CYCLES;
+      cpu->burn_cycles += INT_CYCLES;
       STORE_LOCAL_REGS();
    }
 }
@@ -2487,16 +2507,16 @@ void nes6502_irq(void)
    uint8 n_flag, v_flag, b_flag;
    uint8 d_flag, i_flag, z_flag, c_flag;
 
-   if (FALSE == cpu.jammed)
+   if (FALSE == cpu->jammed)
    {
       GET_GLOBAL_REGS();
       if (0 == i_flag)
       {
          IRQ_PROC();
-         cpu.burn_cycles += INT_CYCLES;
+         cpu->burn_cycles += INT_CYCLES;
       }
       else
-         cpu.int_pending = 1;
+         cpu->int_pending = 1;
       STORE_LOCAL_REGS();
    }
 }
@@ -2504,7 +2524,7 @@ void nes6502_irq(void)
 /* Set dead cycle period */
 void nes6502_burn(int cycles)
 {
-   cpu.burn_cycles += cycles;
+   cpu->burn_cycles += cycles;
 }
 
 // start MPO
@@ -2513,13 +2533,13 @@ void nes6502_burn(int cycles)
 // Make sure you understand this or you may be in for some very frustrating debug sessions!
 uint32 nes6502_get_pc()
 {
-	return cpu.pc_reg;
+	return cpu->pc_reg;
 }
 
 // returns how many cycles have elapsed relative to the beginning of nes6502_execute
 uint32 nes6502_getcycles_sofar()
 {
-	return (cpu.total_cycles - g_old_cycles);
+	return (cpu->total_cycles - g_old_cycles);
 }
 
 // end MPO
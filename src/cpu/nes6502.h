@@ -123,6 +123,7 @@ extern void nes6502_burn(int cycles);
 /* Context get/set */
 extern void nes6502_setcontext(nes6502_context *cpu);
 extern void nes6502_getcontext(nes6502_context *cpu);
+extern void nes6502_setinstance(nes6502_context *cpu);
 
 uint32 nes6502_get_pc();	// MPO
 uint32 nes6502_getcycles_sofar();	// MPO
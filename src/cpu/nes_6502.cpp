@@ -24,6 +24,7 @@
 #include <stdio.h>
 //#include "debug.h"
 #include "../game/game.h"
+#include "memmap.h"
 
 // NOT SAFE FOR MULTIPLE NES_6502'S
 static NES_6502 *NES_6502_nes = NULL;
@@ -87,6 +88,16 @@ void NES_6502::GetContext(Context *cpu)
   cpu->read_handler = NESReadHandler;
   cpu->write_handler = NESWriteHandler;
 }
+
+void NES_6502::SetInstance(Context *cpu)
+{
+  if (cpu)
+  {
+    cpu->read_handler = NESReadHandler;
+    cpu->write_handler = NESWriteHandler;
+  }
+  nes6502_setinstance(cpu);
+}
 /*
 uint8 NES_6502::MemoryRead(uint32 addr)
 {
@@ -100,10 +111,10 @@ void NES_6502::MemoryWrite(uint32 addr, uint8 data)
 */
 uint8 NES_6502::MemoryRead(uint32 addr)
 {
-  return g_game->cpu_mem_read(static_cast<uint16>(addr & 0xffff));
+  return memmap_read16(addr);
 }
 
 void NES_6502::MemoryWrite(uint32 addr, uint8 data)
 {
-  g_game->cpu_mem_write(static_cast<uint16>(addr & 0xffff), data);
+  memmap_write16(addr, data);
 }
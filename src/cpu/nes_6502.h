@@ -53,6 +53,7 @@ public:
   // Context get/set
   void SetContext(Context *cpu);
   void GetContext(Context *cpu);
+  void SetInstance(Context *cpu);	// executes directly on 'cpu' instead of copying it in and out
 
 protected:
 
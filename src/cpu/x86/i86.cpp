@@ -197,7 +197,9 @@ void i86_set_context(void *src)
 {
 	if (src)
 	{
+		int (*tmp)(int irqline) = I.irq_callback;	// MPO : our design calls for this callback to be preserved
 		I = *(i86_Regs *)src;
+		I.irq_callback = tmp;	// (the context may have come from a snapshot made by another run)
 		I.base[CS] = SegBase(CS);
 		I.base[DS] = SegBase(DS);
 		I.base[ES] = SegBase(ES);
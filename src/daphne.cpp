@@ -73,12 +73,14 @@ using namespace std;
 #include "io/network.h"
 #include "video/video.h"
 #include "video/led.h"
+#include "video/blend.h"	// for compose_get_name
 #include "ldp-out/ldp.h"
 #include "video/SDL_Console.h"
 #include "io/error.h"
 #include "cpu/cpu-debug.h"
 #include "cpu/cpu.h"
 #include "game/game.h"
+#include "game/snapshot.h"
 
 #include "globals.h"
 // some global data is stored in this file
@@ -208,9 +210,10 @@ int main(int argc, char **argv)
 								printnowookin(g_game->get_issues());
 							}
 
-							SDL_Delay(1000);
 							// delay for a bit before the LDP is intialized to make sure
 							// all video is done getting drawn before VLDP is initialized
+							// (the point of -snapshot_boot is to start quickly, so it only gets a short delay)
+							SDL_Delay(snapshot_boot_is_enabled() ? 100 : 1000);
 
 							// if the laserdisc player was initialized properly
 							if (g_ldp->pre_init())
@@ -399,6 +402,9 @@ void reset_logfile(int argc, char **argv)
 	printline("C");
 #endif // blend MMX
 
+	outstr("--Overlay Compose Function: ");
+	printline(compose_get_name());
+
 	outstr("--Audio Mixing Function: ");
 #ifdef USE_MMX
 	printline("MMX");
@@ -45,6 +45,8 @@
 #include "../io/numstr.h"
 #include "../ldp-out/ldp.h"
 #include "../cpu/cpu-debug.h"	// for set_cpu_trace
+#include "../cpu/memmap.h"	// for page table mapping
+#include "../cpu/m80_dynarec.h"	// so the recompiler notices mapping changes
 #include "../timer/timer.h"
 #include "../io/input.h"
 #include "../io/sram.h"
@@ -52,6 +54,8 @@
 #include "../video/video.h"	// for get_screen
 #include "../video/palette.h"
 #include "game.h"
+#include "snapshot.h"
+#include "runahead.h"
 
 #ifdef USE_OPENGL
 #ifdef MAC_OSX
@@ -118,9 +122,20 @@ game::game() :
 	m_video_overlay_height(0),	// " " "
 	m_video_overlay_needs_update(true),	// it always needs to be updated the first time
 	m_uVideoOverlayVisibleLines(240),	// (480/2) for almost all games with overlay
-	m_bMouseEnabled(false)	// mouse is disabled for most games
+	m_bMouseEnabled(false),	// mouse is disabled for most games
+	m_bDirtyRects(false),	// most games repaint everything every time
+	m_bSnapshotSupported(false),	// games must opt in
+	m_uBlitPaletteVersion(0)
 {
 	memset(m_video_overlay, 0, sizeof(m_video_overlay));	// clear this structure so we can easily detect whether we are using video overlay or not
+
+	// every buffer needs to be painted from scratch the first time
+	for (int i = 0; i < MAX_VIDEO_OVERLAY_BUFFERS; i++)
+	{
+		m_dirty_rects[i].uCount = 0;
+		m_dirty_rects[i].bAll = true;
+	}
+
 	m_uDiscFPKS = 0;
 	m_disc_fps = 0.0;
 //	m_disc_ms_per_frame = 0.0;
@@ -266,6 +281,12 @@ Uint8 game::cpu_mem_read(Uint32 addr)
 	return m_cpumem[addr];
 }
 
+// the game driver has to tell us which of its reads are safe to skip idle loops over
+bool game::is_idle_read(Uint16 addr)
+{
+	return false;
+}
+
 // writes a byte to a 16-bit addresss space
 void game::cpu_mem_write(Uint16 addr, Uint8 value)
 {
@@ -278,6 +299,52 @@ void game::cpu_mem_write(Uint32 addr, Uint8 value)
 	m_cpumem[addr] = value;
 }
 
+bool game::map_cpu_ram(Uint8 cpu_id, Uint32 start, Uint32 end)
+{
+	Uint8 *mem = get_cpu_mem(cpu_id);
+	return (mem != NULL) && map_cpu_mem(cpu_id, start, end, mem + start, mem + start);
+}
+
+bool game::map_cpu_rom(Uint8 cpu_id, Uint32 start, Uint32 end)
+{
+	Uint8 *mem = get_cpu_mem(cpu_id);
+	return (mem != NULL) && map_cpu_mem(cpu_id, start, end, mem + start, NULL);
+}
+
+bool game::map_cpu_handler(Uint8 cpu_id, Uint32 start, Uint32 end)
+{
+	return map_cpu_mem(cpu_id, start, end, NULL, NULL);
+}
+
+bool game::map_cpu_mem(Uint8 cpu_id, Uint32 start, Uint32 end, Uint8 *read_buf, Uint8 *write_buf)
+{
+	bool result = false;
+	struct cpudef *cpu = get_cpu_struct(cpu_id);
+
+	// make sure the range is sane and lines up with our pages
+	if ((cpu != NULL) && (start <= end) && (end < CPU_MEM_SIZE) &&
+		((start & MEM_PAGE_MASK) == 0) && ((end & MEM_PAGE_MASK) == MEM_PAGE_MASK))
+	{
+		for (Uint32 uPage = (start >> MEM_PAGE_SHIFT); uPage <= (end >> MEM_PAGE_SHIFT); uPage++)
+		{
+			Uint32 uOffset = (uPage << MEM_PAGE_SHIFT) - start;
+			cpu->mem_pages[uPage].read = (read_buf != NULL) ? (read_buf + uOffset) : NULL;
+			cpu->mem_pages[uPage].write = (write_buf != NULL) ? (write_buf + uOffset) : NULL;
+		}
+		m80_dynarec_flush();	// anything translated from the old mapping is no good anymore
+		result = true;
+	}
+	// else make the programmer fix this
+	else
+	{
+		char s[160];
+		sprintf(s, "map_cpu_mem() : can't map %x-%x for cpu %u (bad range or cpu doesn't exist)", start, end, cpu_id);
+		printline(s);
+	}
+
+	return result;
+}
+
 // reads a byte from the cpu's port
 Uint8 game::port_read(Uint16 port)
 {
@@ -504,9 +571,67 @@ void Scale(SDL_Surface* src, SDL_Surface* dst, long* matrix)
 }
 // end-add
 
+// Same as Scale, but only does the part of 'dst' that comes from 'srcrect'.
+// 'dstrect' gets set to that part (so that it can be blitted).
+void ScaleRect(SDL_Surface* src, SDL_Surface* dst, long* matrix, const SDL_Rect *srcrect, SDL_Rect *dstrect)
+{
+	long x0 = -1, x1 = 0, y0 = -1, y1 = 0;
+	long x, y;
+
+	// the first row of the matrix tells us which source column each destination column comes from,
+	//  and the first column tells us which source row each destination row comes from
+	for (x = 0; x < dst->w; x++)
+	{
+		long srcx = matrix[x];
+		if ((srcx >= srcrect->x) && (srcx < srcrect->x + srcrect->w))
+		{
+			if (x0 < 0) x0 = x;
+			x1 = x + 1;
+		}
+	}
+	for (y = 0; y < dst->h; y++)
+	{
+		long srcy = matrix[y * dst->w] / src->w;
+		if ((srcy >= srcrect->y) && (srcy < srcrect->y + srcrect->h))
+		{
+			if (y0 < 0) y0 = y;
+			y1 = y + 1;
+		}
+	}
+
+	// if nothing in the destination comes from this rect
+	if ((x0 < 0) || (y0 < 0))
+	{
+		x0 = x1 = y0 = y1 = 0;
+	}
+
+	Uint8* srcpixmap=(Uint8*)src->pixels;
+	Uint8* dstpixmap=(Uint8*)dst->pixels;
+
+	for (y = y0; y < y1; y++)
+	{
+		for (x = x0; x < x1; x++)
+		{
+			long i = x + (y * dst->w);
+			dstpixmap[i] = srcpixmap[matrix[i]];
+		}
+	}
+
+	dstrect->x = (Sint16) x0;
+	dstrect->y = (Sint16) y0;
+	dstrect->w = (Uint16) (x1 - x0);
+	dstrect->h = (Uint16) (y1 - y0);
+}
+
 // generic function to ensure that the video buffer gets drawn to the screen, will call video_repaint()
 void game::video_blit()
 {
+	// with run-ahead, the only overlay that gets blitted is the one from the frame that was run ahead to
+	if (!runahead_blit_allowed())
+	{
+		return;
+	}
+
 	// if something has actually changed in the game's video (video_blit() will probably get called regularly on each screen refresh,
 	// and we don't want to call the potentially expensive video_repaint() unless we have to)
 	if (m_video_overlay_needs_update)
@@ -518,9 +643,30 @@ void game::video_blit()
 		{
 			m_active_video_overlay = 0;
 		}
+
+		struct dirty_rect_list *dirty = &m_dirty_rects[m_active_video_overlay];
+
+		// if the game doesn't tell us what changed (or asked for an update without marking anything), everything has to be redrawn
+		if (!m_bDirtyRects || (dirty->uCount == 0))
+		{
+			dirty->bAll = true;
+		}
+
 		video_repaint();	// call game-specific function to get palette refreshed
 		m_video_overlay_needs_update = false;	// game will need to set this value to true next time it becomes needful for us to redraw the screen
 
+		// The screen holds the buffer that was blitted last time.  Anything that changed since then has also been
+		//  marked in this buffer's list (along with anything else that changed since this buffer was last painted),
+		//  so blitting this buffer's list is enough to bring the screen up to date.
+		// A palette change changes everything though.
+		const SDL_Rect *rects = dirty->bAll ? NULL : dirty->rects;
+		unsigned int uPaletteVersion = palette_get_version();
+		if (uPaletteVersion != m_uBlitPaletteVersion)
+		{
+			rects = NULL;
+			m_uBlitPaletteVersion = uPaletteVersion;
+		}
+
 		// if we are in non-VLDP mode, then we can blit to the main surface right here,
 		// otherwise we do nothing because the yuv_callback in ldp-vldp.cpp will take care of it
 		if (!g_ldp->is_vldp())
@@ -533,9 +679,9 @@ void game::video_blit()
 				// If we're not scaling the video
 				if (!m_bFullScale)
 				{                
-					vid_blit(m_video_overlay[m_active_video_overlay], 0, 0);
+					vid_blit_rects(m_video_overlay[m_active_video_overlay], 0, 0, rects, dirty->uCount);
 				}
-				else
+				else if (!rects)
 				{
 					// scale game graphics to the screen dimensions
 					Scale(m_video_overlay[m_active_video_overlay], 
@@ -543,6 +689,19 @@ void game::video_blit()
 						m_video_overlay_matrix);
 					vid_blit(m_video_overlay_scaled, 0, 0);
 				} /*endelse*/
+				else
+				{
+					// only scale what has changed
+					SDL_Rect scaled_rects[MAX_DIRTY_RECTS];
+					for (unsigned int u = 0; u < dirty->uCount; u++)
+					{
+						ScaleRect(m_video_overlay[m_active_video_overlay],
+							m_video_overlay_scaled,
+							m_video_overlay_matrix,
+							&rects[u], &scaled_rects[u]);
+					}
+					vid_blit_rects(m_video_overlay_scaled, 0, 0, scaled_rects, dirty->uCount);
+				}
 #ifdef USE_OPENGL
 			}
 			// else we're using OpenGL
@@ -555,9 +714,10 @@ void game::video_blit()
 					SDL_Surface *srf = m_video_overlay[m_active_video_overlay];
 
 					// blit in the center of the screen
-					vid_blit(srf,
+					vid_blit_rects(srf,
 						(m_video_screen_width >> 1) - (srf->w >> 1),
-						(m_video_screen_height >> 1) - (srf->h >> 1));
+						(m_video_screen_height >> 1) - (srf->h >> 1),
+						rects, dirty->uCount);
 				}
 
 				// else if 'fullscale' is enabled
@@ -571,9 +731,10 @@ void game::video_blit()
 
 					// blit in the center of the screen
 					SDL_Surface *srf = m_video_overlay[m_active_video_overlay];
-					vid_blit(srf,
+					vid_blit_rects(srf,
 						(m_video_screen_width >> 1) - (srf->w >> 1),
-						(m_video_screen_height >> 1) - (srf->h >> 1));
+						(m_video_screen_height >> 1) - (srf->h >> 1),
+						rects, dirty->uCount);
 					glPopMatrix();
 				}
 			} // end if using opengl
@@ -583,6 +744,10 @@ void game::video_blit()
 		} // end if this isn't VLDP
 
 		m_finished_video_overlay = m_active_video_overlay;
+
+		// this buffer is now up to date
+		dirty->uCount = 0;
+		dirty->bAll = false;
 	}
 }
 
@@ -593,7 +758,7 @@ void game::video_force_blit()
 	// if the game uses a video overlay, we have to go through this video_blit routine to update a bunch of variables
 	if (m_game_uses_video_overlay)
 	{
-		m_video_overlay_needs_update = true;
+		video_mark_all_dirty();
 		video_blit();
 	}
 
@@ -630,6 +795,95 @@ void game::set_video_overlay_needs_update(bool value)
 	m_video_overlay_needs_update = value;
 }
 
+void game::video_mark_dirty(int x, int y, int w, int h)
+{
+	// clip to the video overlay
+	if (x < 0)
+	{
+		w += x;
+		x = 0;
+	}
+	if (y < 0)
+	{
+		h += y;
+		y = 0;
+	}
+	if (x + w > (int) m_video_overlay_width) w = (int) m_video_overlay_width - x;
+	if (y + h > (int) m_video_overlay_height) h = (int) m_video_overlay_height - y;
+
+	// if it's entirely off the screen, nothing that can be seen has changed
+	if ((w <= 0) || (h <= 0))
+	{
+		return;
+	}
+
+	// Every buffer has to hear about this change, since each one gets painted over what it held
+	//  a few frames ago (when we are double or triple buffering).
+	for (int i = 0; i < MAX_VIDEO_OVERLAY_BUFFERS; i++)
+	{
+		struct dirty_rect_list *dirty = &m_dirty_rects[i];
+		unsigned int u = 0;
+
+		if (dirty->bAll)
+		{
+			continue;
+		}
+
+		// games tend to write the same area more than once per frame, so don't add it again if we already have it
+		for (u = 0; u < dirty->uCount; u++)
+		{
+			const SDL_Rect *r = &dirty->rects[u];
+			if ((x >= r->x) && (y >= r->y) && (x + w <= r->x + r->w) && (y + h <= r->y + r->h))
+			{
+				break;
+			}
+		}
+
+		// if we didn't find it
+		if (u == dirty->uCount)
+		{
+			// if we're out of room, so much has changed that it's probably faster to just do everything
+			if (dirty->uCount == MAX_DIRTY_RECTS)
+			{
+				dirty->bAll = true;
+			}
+			else
+			{
+				SDL_Rect *r = &dirty->rects[dirty->uCount++];
+				r->x = (Sint16) x;
+				r->y = (Sint16) y;
+				r->w = (Uint16) w;
+				r->h = (Uint16) h;
+			}
+		}
+	}
+
+	m_video_overlay_needs_update = true;
+}
+
+void game::video_mark_all_dirty()
+{
+	for (int i = 0; i < MAX_VIDEO_OVERLAY_BUFFERS; i++)
+	{
+		m_dirty_rects[i].bAll = true;
+	}
+	m_video_overlay_needs_update = true;
+}
+
+const SDL_Rect *game::video_get_dirty_rects(unsigned int *puCount)
+{
+	const struct dirty_rect_list *dirty = &m_dirty_rects[m_active_video_overlay];
+
+	if (dirty->bAll)
+	{
+		*puCount = 0;
+		return NULL;
+	}
+
+	*puCount = dirty->uCount;
+	return dirty->rects;
+}
+
 unsigned int game::get_video_overlay_height()
 {
 	return m_video_overlay_height;
@@ -1195,3 +1449,88 @@ bool game::getMouseEnabled()
 {
 	return m_bMouseEnabled;
 }
+
+bool game::is_snapshot_supported()
+{
+	return m_bSnapshotSupported;
+}
+
+// bump this whenever the layout of what game::save_state saves changes
+#define GAME_STATE_VERSION	1
+
+// returns where this game's nvram is (or NULL if it has none)
+static Uint8 *get_nvram_ptr(Uint8 *nvram_begin, Uint16 *EEPROM_9536_begin, bool bEEPROM_9536)
+{
+	if (bEEPROM_9536)
+	{
+		return (Uint8 *) EEPROM_9536_begin;
+	}
+	return nvram_begin;
+}
+
+bool game::save_state(struct snapshot *snap)
+{
+	unsigned int uSection = snapshot_begin_section(snap, "GAME", GAME_STATE_VERSION);
+	Uint8 *nvram = get_nvram_ptr(m_nvram_begin, m_EEPROM_9536_begin, m_EEPROM_9536);
+
+	snapshot_put(snap, m_cpumem, sizeof(m_cpumem));
+	snapshot_put(snap, &m_nvram_size, sizeof(m_nvram_size));
+	if (nvram)
+	{
+		snapshot_put(snap, nvram, m_nvram_size);
+	}
+
+	snapshot_end_section(snap, uSection);
+	return true;
+}
+
+bool game::load_state(struct snapshot *snap)
+{
+	Uint32 uNvramSize = 0;
+	Uint8 *nvram = get_nvram_ptr(m_nvram_begin, m_EEPROM_9536_begin, m_EEPROM_9536);
+
+	if (!snapshot_open_section(snap, "GAME", GAME_STATE_VERSION))
+	{
+		return false;
+	}
+
+	snapshot_get(snap, m_cpumem, sizeof(m_cpumem));
+	snapshot_get(snap, &uNvramSize, sizeof(uNvramSize));
+	if (uNvramSize != m_nvram_size)
+	{
+		printline("game::load_state() : snapshot has a different nvram size");
+		return false;
+	}
+	if (nvram)
+	{
+		snapshot_get(snap, nvram, m_nvram_size);
+	}
+
+	if (!snapshot_close_section(snap))
+	{
+		return false;
+	}
+
+	// the palette and the video overlay may depend on memory that we just changed
+	if (m_game_uses_video_overlay)
+	{
+		palette_calculate();
+		palette_finalize();
+		video_mark_all_dirty();
+	}
+
+	return true;
+}
+
+Uint32 game::get_boot_crc()
+{
+	Uint32 uCRC = crc32(0L, Z_NULL, 0);
+	Uint8 *nvram = get_nvram_ptr(m_nvram_begin, m_EEPROM_9536_begin, m_EEPROM_9536);
+
+	uCRC = crc32(uCRC, m_cpumem, sizeof(m_cpumem));
+	if (nvram)
+	{
+		uCRC = crc32(uCRC, nvram, m_nvram_size);
+	}
+	return uCRC;
+}
@@ -53,6 +53,17 @@ enum
 #include "../io/input.h"	// for SWITCH definitions, most/all games need them
 #include "../io/logger.h"
 
+// how many changed areas each video overlay buffer keeps track of before we give up and repaint the whole thing
+#define MAX_DIRTY_RECTS	64
+
+// the parts of one video overlay buffer that have changed since it was last painted
+struct dirty_rect_list
+{
+	SDL_Rect rects[MAX_DIRTY_RECTS];
+	unsigned int uCount;
+	bool bAll;	// if true, the whole buffer needs to be painted (and 'rects' is ignored)
+};
+
 typedef void * unzFile;	// because including the unzip header file gives some compiler error
 
 // structure for the cpu debugger... a memory address and its corresponding name
@@ -75,6 +86,8 @@ struct rom_def
 	unsigned int crc32;	// CRC32 of the ROM
 };
 
+struct snapshot;	// see snapshot.h
+
 class game
 {
 public:
@@ -100,6 +113,21 @@ public:
 	virtual Uint8 port_read(Uint16 port);		// read from port
 	virtual void port_write(Uint16 port, Uint8 value);		// write to a port
 	virtual void update_pc(Uint32 new_pc);		// update the PC
+
+	// Returns true if reading 'addr' through cpu_mem_read has no side effects, and the value it returns can only change
+	//  when a cpu event fires (or between cpu execute calls).  The cpu core can then skip over idle loops that poll
+	//  'addr' (see cpu/m80_idle.h).  By default nothing that goes through cpu_mem_read is considered safe.
+	virtual bool is_idle_read(Uint16 addr);
+
+	// PAGE TABLE MEMORY MAPPING (see cpu/memmap.h)
+	// Pages that are mapped get accessed directly by the cpu core instead of going through cpu_mem_read/cpu_mem_write.
+	// 'start' and 'end' are inclusive and must line up with page boundaries.  Must be called after the cpu has been added.
+	// Returns false if the range is bad or the cpu doesn't exist.
+	bool map_cpu_ram(Uint8 cpu_id, Uint32 start, Uint32 end);	// reads and writes go straight to the cpu's memory
+	bool map_cpu_rom(Uint8 cpu_id, Uint32 start, Uint32 end);	// reads go straight to the cpu's memory, writes go to cpu_mem_write
+	bool map_cpu_handler(Uint8 cpu_id, Uint32 start, Uint32 end);	// reads and writes go to cpu_mem_read/cpu_mem_write (the default)
+	// general case, 'read_buf' and 'write_buf' correspond to address 'start' (either can be NULL to use the handler)
+	bool map_cpu_mem(Uint8 cpu_id, Uint32 start, Uint32 end, Uint8 *read_buf, Uint8 *write_buf);
 	virtual void input_enable(Uint8);
 	virtual void input_disable(Uint8);
 	virtual void OnMouseMotion(Uint16 x, Uint16 y, Sint16 xrel, Sint16 yrel);  // Added by ScottD
@@ -136,6 +164,18 @@ public:
 	// a way for external functions to indicate that video needs update
 	// (currently the tms9128nl routines need to use this because they aren't part of the game class)
 	void set_video_overlay_needs_update(bool value);
+
+	// DIRTY RECTANGLES
+	// Games that set m_bDirtyRects (in their constructor) call these to say which part of the video overlay
+	//  has changed, so that video_repaint() only has to redraw that part and video_blit() only has to blit that part.
+	// Both of these also set m_video_overlay_needs_update.
+	// If a game sets m_video_overlay_needs_update without marking anything, the whole overlay gets repainted.
+	void video_mark_dirty(int x, int y, int w, int h);
+	void video_mark_all_dirty();
+
+	// For video_repaint() to use: returns the parts of the active video overlay that need to be repainted,
+	//  or NULL if the whole thing needs to be (which is always the case for games that don't set m_bDirtyRects).
+	const SDL_Rect *video_get_dirty_rects(unsigned int *puCount);
 	
 	// returns m_video_overlay_width
 	unsigned int get_video_overlay_width();
@@ -182,6 +222,19 @@ public:
 	// returns m_bMouseEnabled
 	bool getMouseEnabled();
 
+	// SNAPSHOTS (see snapshot.h)
+	// returns m_bSnapshotSupported
+	bool is_snapshot_supported();
+
+	// Saves/restores the game's state.  The generic versions handle m_cpumem and nvram, so games that keep any other
+	//  state (member variables, other memory buffers, laserdisc player interfaces, etc) must override these and call them.
+	virtual bool save_state(struct snapshot *snap);
+	virtual bool load_state(struct snapshot *snap);
+
+	// returns a CRC of the memory that determines what the boot sequence does (roms, nvram), so that a boot snapshot
+	//  can tell whether it is still valid.  Must be called before any cpu has executed.
+	Uint32 get_boot_crc();
+
 protected:
 	bool m_game_paused;	// whether the game is paused or not
 	const char *m_shortgamename;	// a one-word name for this game (ie "lair" "ace" "dle", etc)
@@ -246,6 +299,19 @@ protected:
 	// if the game uses the mouse, this should be set to true IN THE GAME'S CONSTRUCTOR
 	bool m_bMouseEnabled;
 
+	// if the game marks what has changed in its video overlay (see video_mark_dirty), this should be set to true IN THE GAME'S CONSTRUCTOR
+	bool m_bDirtyRects;
+
+	// if the game saves all of its state in save_state(), this should be set to true IN THE GAME'S CONSTRUCTOR
+	bool m_bSnapshotSupported;
+
+	// what has changed in each video overlay buffer since it was last painted
+	struct dirty_rect_list m_dirty_rects[MAX_VIDEO_OVERLAY_BUFFERS];
+
+	// the palette version (see palette_get_version) when video_blit last blitted, since a palette change means
+	//  everything on the screen has changed
+	unsigned int m_uBlitPaletteVersion;
+
 	// logger interface (for writing to daphne_log.txt file)
 	ILogger *m_pLogger;
 
@@ -49,6 +49,7 @@
 #include "../sound/sound.h"
 #include "../cpu/cpu.h"
 #include "../cpu/generic_z80.h"
+#include "snapshot.h"
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -78,6 +79,11 @@ m_pScoreboard(NULL)
 	cpu.mem = m_cpumem;
 	add_cpu(&cpu);	// add this cpu to the list (it will be our only one)
 
+	// Everything below 0xC000 is plain ROM/RAM when reading, so the cpu core can read it directly.
+	// RAM writes can also go straight through, except for the first page (0xA01C triggers sounds).
+	map_cpu_rom(0, 0x0000, 0xBFFF);
+	map_cpu_ram(0, 0xA100, 0xAFFF);
+
 	struct sounddef soundchip;
 	soundchip.type = SOUNDCHIP_AY_3_8910;  // Dragon's Lair hardware uses the ay-3-8910
 	soundchip.hz = LAIR_CPU_HZ / 2;   // DL halves the CPU clock for the sound chip
@@ -93,6 +99,7 @@ m_pScoreboard(NULL)
 	m_status_strobe_timer = 0;
 	m_uses_pr7820 = false;  // only used by lairalt()
 	m_leds_cleared = false; //hack so we can execute the clear command just once
+	m_bSnapshotSupported = true;	// (as long as we're using the LD-V1000)
 
 	m_num_sounds = 3;
 	m_sound_name[S_DL_CREDIT] = "dl_credit.wav";
@@ -409,6 +416,7 @@ lairalt::lairalt()
 {
 	m_shortgamename = "lair_a";
 	m_uses_pr7820 = true;
+	m_bSnapshotSupported = false;	// the PR-7820's state isn't saved
 
 	// NOTE : this must be static
 	static struct rom_def roms[] =
@@ -786,6 +794,27 @@ Uint8 lair::cpu_mem_read(Uint16 Addr)
 	return(result);
 }
 
+// The main loop of Lair/Ace spends most of its time polling the inputs and the laserdisc player
+//  while it waits for the next IRQ, so tell the cpu core which of the reads above it can skip over.
+bool lair::is_idle_read(Uint16 Addr)
+{
+	bool result = true;
+
+	switch(Addr)
+	{
+	case 0xC010:	// the PR-7820 gets asked if it's ready every time
+		result = !m_uses_pr7820;
+		break;
+	case 0xC020:	// searches and autostop are timed by the read itself
+		result = ldv1000_read_is_status();
+		break;
+	default:	// the rest only change with input or when the LD-V1000 strobes
+		break;
+	}
+
+	return(result);
+}
+
 // this is necessary so that we can use it as a function pointer
 SDL_Surface *lair_get_active_overlay()
 {
@@ -928,6 +957,79 @@ void lair::video_repaint()
 	m_pScoreboard->RepaintIfNeeded();
 }
 
+// bump this whenever the layout of what lair::save_state saves changes
+#define LAIR_STATE_VERSION	1
+
+bool lair::save_state(struct snapshot *snap)
+{
+	if (!game::save_state(snap))
+	{
+		return false;
+	}
+
+	unsigned int uSection = snapshot_begin_section(snap, "LAIR", LAIR_STATE_VERSION);
+
+	snapshot_put(snap, &m_soundchip_address_latch, sizeof(m_soundchip_address_latch));
+	snapshot_put(snap, &m_status_strobe_timer, sizeof(m_status_strobe_timer));
+	snapshot_put(snap, &m_joyskill_val, sizeof(m_joyskill_val));
+	snapshot_put(snap, &m_misc_val, sizeof(m_misc_val));
+	snapshot_put(snap, &m_leds_cleared, sizeof(m_leds_cleared));
+
+	// the scoreboard digits are only written when the score changes, so they have to be saved too
+	for (unsigned int u = 0; u < IScoreboard::DIGIT_COUNT; u++)
+	{
+		unsigned int uValue = 0;
+		if (m_pScoreboard)
+		{
+			m_pScoreboard->pre_get_digit(uValue, (IScoreboard::WhichDigit) u);
+		}
+		Uint8 u8Value = (Uint8) uValue;
+		snapshot_put(snap, &u8Value, sizeof(u8Value));
+	}
+
+	snapshot_end_section(snap, uSection);
+
+	ldv1000_save_state(snap);
+	return true;
+}
+
+bool lair::load_state(struct snapshot *snap)
+{
+	if (!game::load_state(snap) || !snapshot_open_section(snap, "LAIR", LAIR_STATE_VERSION))
+	{
+		return false;
+	}
+
+	snapshot_get(snap, &m_soundchip_address_latch, sizeof(m_soundchip_address_latch));
+	snapshot_get(snap, &m_status_strobe_timer, sizeof(m_status_strobe_timer));
+	snapshot_get(snap, &m_joyskill_val, sizeof(m_joyskill_val));
+	snapshot_get(snap, &m_misc_val, sizeof(m_misc_val));
+	snapshot_get(snap, &m_leds_cleared, sizeof(m_leds_cleared));
+
+	for (unsigned int u = 0; u < IScoreboard::DIGIT_COUNT; u++)
+	{
+		Uint8 u8Value = 0;
+		snapshot_get(snap, &u8Value, sizeof(u8Value));
+		if (m_pScoreboard)
+		{
+			m_pScoreboard->pre_set_digit(u8Value, (IScoreboard::WhichDigit) u);
+		}
+	}
+
+	if (!snapshot_close_section(snap))
+	{
+		return false;
+	}
+
+	// redraw the scoreboard now that the digits have changed
+	if (m_pScoreboard)
+	{
+		m_video_overlay_needs_update |= m_pScoreboard->is_repaint_needed();
+	}
+
+	return ldv1000_load_state(snap);
+}
+
 // basically 'preset' is a macro to set a bunch of other options; useful as a good shortcut
 void lair::set_preset(int preset)
 {
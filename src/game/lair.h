@@ -43,6 +43,7 @@ public:
 	void do_nmi();
 	Uint8 cpu_mem_read(Uint16 addr);
 	void cpu_mem_write(Uint16 addr, Uint8 value);
+	bool is_idle_read(Uint16 addr);
 	void input_enable(Uint8);
 	void input_disable(Uint8);
 	void OnVblank();
@@ -54,6 +55,9 @@ public:
 	bool set_bank(unsigned char, unsigned char);
 	void set_version(int);
 
+	bool save_state(struct snapshot *snap);
+	bool load_state(struct snapshot *snap);
+
 	// what follows are functions specific to this class
 	Uint8 read_C010();
 	void patch_roms();
@@ -119,6 +119,7 @@ mach3::mach3()
 	cpu.initial_pc = 0;
 	cpu.must_copy_context = true;	// set this to true when you add multiple 6502's
 	cpu.mem = m_cpumem2;
+	cpu.uThreadGroup = 1;	// the sound board only talks to the main board through the sound latch, so it can run on its own thread
 	add_cpu(&cpu);	// add first sound 6502 cpu
 
 	cpu.type = CPU_M6502;
@@ -146,6 +147,7 @@ mach3::mach3()
 	m_video_overlay_width = MACH3_OVERLAY_W;
 	m_video_overlay_height = MACH3_OVERLAY_H;
 	m_palette_color_count = MACH3_COLOR_COUNT + 1;  // one extra dummy color to 'disable' transparency
+	m_bDirtyRects = true;	// cpu_mem_write keeps track of which tiles and sprites have changed
 
 	// mack3 LD video starts off disabled
 	m_ldvideo_enabled = false;
@@ -346,7 +348,7 @@ void mach3::do_nmi()
 		if (m_palette_updated)
 		{
 			palette_calculate();
-			m_video_overlay_needs_update = true;
+			video_mark_all_dirty();
 			m_palette_updated = false;
 		}  
 
@@ -402,6 +404,24 @@ void mach3::do_nmi()
 	}
 }
 
+void mach3::write_sound_latch(Uint8 Value)
+{
+	m_sounddata_latch1.push(Value & 0x3F);
+	cpu_generate_irq(1, 0);	// generate IRQ for cpu #1
+
+	// maybe we should generate IRQ's for 0 being written too?
+	if (Value != 0)
+	{
+		m_sounddata_latch2.push(Value & 0x3F);
+		cpu_generate_irq(2, 0);	// generate IRQ for cpu #2
+	}
+}
+
+void mach3::write_sound_latch_callback(void *pMach3, unsigned int uValue)
+{
+	((mach3 *) pMach3)->write_sound_latch((Uint8) uValue);
+}
+
 void mach3::do_irq(unsigned int which)
 {
 	switch (cpu_getactivecpu())
@@ -558,8 +578,26 @@ void mach3::cpu_mem_write(Uint32 Addr, Uint8 Value)
 	{
 		if (Value != m_cpumem[Addr]) //skip if no change
 		{
-			m_cpumem[Addr] = Value; // store to RAM
-			m_video_overlay_needs_update = true;
+			// tile RAM (32x30 tiles), only the tile that was written to needs to be redrawn
+			if (Addr >= 0x3800 && Addr < 0x3800 + (32 * 30))
+			{
+				unsigned int uTile = Addr - 0x3800;
+				m_cpumem[Addr] = Value; // store to RAM
+				video_mark_dirty((uTile & 31) * 8, (uTile >> 5) * 8, 8, 8);
+			}
+			// sprite RAM (62 sprites, 4 bytes each), the sprite needs to be erased from where it was and drawn where it is now
+			else if (Addr < 0x3000 + (62 * 4))
+			{
+				Uint8 *pSpriteInfo = &m_cpumem[Addr & ~3];
+				mark_sprite_dirty(pSpriteInfo);
+				m_cpumem[Addr] = Value; // store to RAM
+				mark_sprite_dirty(pSpriteInfo);
+			}
+			// the rest of this RAM never gets drawn
+			else
+			{
+				m_cpumem[Addr] = Value; // store to RAM
+			}
 		}
 	}
 	else if (Addr >= 0x4000 && Addr <= 0x4FFF)
@@ -594,15 +632,8 @@ void mach3::cpu_mem_write(Uint32 Addr, Uint8 Value)
 		*/
 		//		sound_play(Value);
 
-		m_sounddata_latch1.push(Value & 0x3F);
-		cpu_generate_irq(1, 0);	// generate IRQ for cpu #1
-
-		// maybe we should generate IRQ's for 0 being written too?
-		if (Value != 0)
-		{
-			m_sounddata_latch2.push(Value & 0x3F);
-			cpu_generate_irq(2, 0);	// generate IRQ for cpu #2
-		}
+		// the sound cpus may be running on another thread
+		cpu_sync_point(write_sound_latch_callback, this, Value);
 		m_cpumem[Addr] = Value; // store to RAM
 	}
 	else if (Addr == 0x5803) // video control
@@ -620,9 +651,9 @@ void mach3::cpu_mem_write(Uint32 Addr, Uint8 Value)
 			m_ldvideo_enabled = ((Value & 8) == 8);
 			palette_set_transparency(0, m_ldvideo_enabled);
 		}
-		if ((Value & 0x04) != (m_cpumem[0x5803] & 0x04)) //enable display bit has changed
+		if ((Value & 0x07) != (m_cpumem[0x5803] & 0x07)) //priority, sprite bank or enable display bit has changed
 		{
-			m_video_overlay_needs_update = true; // we need to redraw when this bit changes
+			video_mark_all_dirty(); // we need to redraw everything when these bits change
 		}
 		m_cpumem[Addr] = Value; // store to RAM to compare next time
 	}
@@ -1117,32 +1148,67 @@ void mach3::palette_calculate()
 
 void mach3::video_repaint()
 {
+	unsigned int uCount = 0;
+	const SDL_Rect *rects = video_get_dirty_rects(&uCount);
+	SDL_Rect whole_screen;
 
-	//fast screen clear
-	SDL_FillRect(m_video_overlay[m_active_video_overlay], NULL, 0);
-
-	// graphics are blanked when this bit is cleared
-	// FIXME:  LD video should be blanked as well (screen should be all black)
-	if ((m_cpumem[0x5803] & 0x04) != 0x04) return;  
+	// if everything needs to be redrawn, just treat the whole screen as one big rect
+	if (!rects)
+	{
+		whole_screen.x = whole_screen.y = 0;
+		whole_screen.w = MACH3_OVERLAY_W;
+		whole_screen.h = MACH3_OVERLAY_H;
+		rects = &whole_screen;
+		uCount = 1;
+	}
 
-	if (m_cpumem[0x5803] & 0x01) // bit 1 set = priority reversed
+	for (unsigned int u = 0; u < uCount; u++)
 	{
-		draw_sprites();
-		draw_characters();
+		m_clip = rects[u];
+
+		//fast screen clear
+		SDL_Rect fill = m_clip;	// SDL_FillRect may change this
+		SDL_FillRect(m_video_overlay[m_active_video_overlay], &fill, 0);
+
+		// graphics are blanked when this bit is cleared
+		// FIXME:  LD video should be blanked as well (screen should be all black)
+		if ((m_cpumem[0x5803] & 0x04) != 0x04) continue;
+
+		if (m_cpumem[0x5803] & 0x01) // bit 1 set = priority reversed
+		{
+			draw_sprites();
+			draw_characters();
+		}
+		else
+		{
+			draw_characters();
+			draw_sprites();
+		}
 	}
-	else
+}
+
+void mach3::mark_sprite_dirty(const Uint8 *pSpriteInfo)
+{
+	// unused sprites (all zero bytes) aren't drawn
+	if (LOAD_LIL_UINT32(pSpriteInfo) != 0x00000000)
 	{
-		draw_characters();
-		draw_sprites();
+		// same offsets as draw_16x16
+		video_mark_dirty(pSpriteInfo[1] - 4, pSpriteInfo[0] - 13, 16, 16);
 	}
 }
 
 void mach3::draw_characters()
 {
+	// only the characters inside the clip rect need to be drawn
+	int xmin = m_clip.x / 8, xmax = (m_clip.x + m_clip.w + 7) / 8;
+	int ymin = m_clip.y / 8, ymax = (m_clip.y + m_clip.h + 7) / 8;
+	if (xmax > 32) xmax = 32;
+	if (ymax > 30) ymax = 30;
+
 	// 8x8 pixel characters, 32 columns (256 pixels) x 30 rows (240 pixels)
-	for (int charx = 0; charx < 32; charx++) 
+	for (int charx = xmin; charx < xmax; charx++) 
 	{
-		for (int chary = 0; chary < 30; chary++) 
+		for (int chary = ymin; chary < ymax; chary++) 
 		{
 			// draw 8x8 tiles from character generator 
 			int current_character = m_cpumem[chary * 32 + charx + 0x3800];
@@ -1205,7 +1271,14 @@ void mach3::draw_8x8(Uint8 character_number, Uint8 *character_set, Uint8 xcoord,
 	//	static Uint8 tmpchar = 0;  // test hack to show the whole character set
 	//  character_number =  tmpchar++;
 
-	for (int y = 0; y < 8; y++)
+	// only draw the part that is inside the clip rect
+	int xmin = 0, xmax = 8, ymin = 0, ymax = 8;
+	if (xcoord < m_clip.x) xmin = m_clip.x - xcoord;
+	if (ycoord < m_clip.y) ymin = m_clip.y - ycoord;
+	if (xcoord + 8 > m_clip.x + m_clip.w) xmax = m_clip.x + m_clip.w - xcoord;
+	if (ycoord + 8 > m_clip.y + m_clip.h) ymax = m_clip.y + m_clip.h - ycoord;
+
+	for (int y = ymin; y < ymax; y++)
 	{
 		//characters are contiguous blocks of 4-bpp values (32 bytes total for each 8x8 char)
 		pixel[0] = static_cast<Uint8>((character_set[(character_number * 32) + 0 + (y * 4)] & 0xF0) >> 4  );
@@ -1217,7 +1290,7 @@ void mach3::draw_8x8(Uint8 character_number, Uint8 *character_set, Uint8 xcoord,
 		pixel[6] = static_cast<Uint8>((character_set[(character_number * 32) + 3 + (y * 4)] & 0xF0) >> 4  );
 		pixel[7] = static_cast<Uint8>((character_set[(character_number * 32) + 3 + (y * 4)] & 0x0F) >> 0  );
 
-		for (int x = 0; x < 8; x++)
+		for (int x = xmin; x < xmax; x++)
 		{
 			if (pixel[x])
 			{
@@ -1269,6 +1342,20 @@ void mach3::draw_16x16(Uint8 character_number, Uint8 *character_set, Uint8 xpos,
 		}
 	}
 
+	// don't draw at all if it's completely outside the clip rect
+	if ((xcoord >= m_clip.x + m_clip.w) || (xcoord + 16 <= m_clip.x) ||
+		(ycoord >= m_clip.y + m_clip.h) || (ycoord + 16 <= m_clip.y))
+	{
+		return;
+	}
+
+	// only draw the part that is inside the clip rect
+	// (the clip rect is always inside the screen so this can only make the visible portion smaller)
+	if (xcoord + xmin < m_clip.x) xmin = static_cast<Uint8>(m_clip.x - xcoord);
+	if (ycoord + ymin < m_clip.y) ymin = static_cast<Uint8>(m_clip.y - ycoord);
+	if (xcoord + xmax > m_clip.x + m_clip.w) xmax = static_cast<Uint8>(m_clip.x + m_clip.w - xcoord);
+	if (ycoord + ymax > m_clip.y + m_clip.h) ymax = static_cast<Uint8>(m_clip.y + m_clip.h - ycoord);
+
 	for (int y = ymin; y < ymax; y++)
 	{
 
@@ -62,6 +62,11 @@ public:
 //	void set_version(int);
 //	bool handle_cmdline_arg(const char *arg);
 	void patch_roms();
+
+	// passes a command from the main cpu to both sound cpus
+	void write_sound_latch(Uint8 Value);
+	static void write_sound_latch_callback(void *pMach3, unsigned int uValue);	// for cpu_sync_point
+
 	Uint8 character[0x2000];  //character gfx ROM (8KB)
 	Uint8 sprite[0x10000];  //sprite gfx ROM (64KB for UVT, 32KB for MACH3)
    Uint8 m_cpumem2[0x10000]; // memory space for first 6502
@@ -89,6 +94,12 @@ protected:
 	void draw_8x8(Uint8 character_number, Uint8 *character_set, Uint8 xcoord, Uint8 ycoord);
 	void draw_16x16(Uint8 character_number, Uint8 *character_set, Uint8 xcoord, Uint8 ycoord);
 
+	// marks the area covered by a sprite (using its 4 bytes of sprite RAM) as needing to be redrawn
+	void mark_sprite_dirty(const Uint8 *pSpriteInfo);
+
+	// the part of the video overlay that video_repaint is currently redrawing (the draw methods don't touch anything outside of it)
+	SDL_Rect m_clip;
+
 	Uint8 m_frame_decoder_select_bit;
 	Uint8 m_audio_ready_bit;
 	Uint16 m_targetdata_offset;
@@ -643,6 +643,62 @@ void releasetest::test_vldp_render()
 {
 	bool test_result = false;
 	
+	// make sure each overlay compositing version that this cpu can run matches the C version
+	{
+		const unsigned int MAX_PAIRS = 360;	// 720 pixels wide, like most of our mpegs
+		static Uint8 Y1[MAX_PAIRS << 1], Y2[MAX_PAIRS << 1], U[MAX_PAIRS], V[MAX_PAIRS], overlay[MAX_PAIRS];
+		static Uint8 dst1_C[MAX_PAIRS << 2], dst2_C[MAX_PAIRS << 2], dst1[MAX_PAIRS << 2], dst2[MAX_PAIRS << 2];
+		Uint32 palette[256], opaque[256];
+		compose_func_t func = NULL;
+		const char *name = NULL;
+		unsigned int i = 0;
+
+		// fill everything with values (that are the same each time test is run, to make reproducing bugs easier)
+		for (i = 0; i < (MAX_PAIRS << 1); i++)
+		{
+			Y1[i] = (Uint8) i;
+			Y2[i] = (Uint8) (255 - i);
+		}
+		for (i = 0; i < MAX_PAIRS; i++)
+		{
+			U[i] = (Uint8) (i * 3);
+			V[i] = (Uint8) (i * 7);
+			// mostly transparent, with a few runs of solid colors, like a typical game overlay
+			overlay[i] = ((i % 40) < 12) ? (Uint8) (i / 3) : 0;
+		}
+		for (i = 0; i < 256; i++)
+		{
+			palette[i] = (i * 0x01010101) ^ 0x80FF0080;
+			opaque[i] = ((i == 0) || ((i % 5) == 0)) ? 0 : 0xFFFFFFFF;
+		}
+
+		printline("Beginning VLDP overlay compose accuracy test...");
+
+		// start at 1 because version 0 is the C version
+		for (unsigned int uKernel = 1; compose_get_kernel(uKernel, &func, &name); uKernel++)
+		{
+			bool result = true;
+
+			// try odd widths too, to make sure the leftovers are handled
+			for (unsigned int uPairs = MAX_PAIRS - 37; (uPairs <= MAX_PAIRS) && result; uPairs++)
+			{
+				for (int iUseOverlay = 0; (iUseOverlay < 2) && result; iUseOverlay++)
+				{
+					const Uint8 *pOverlay = iUseOverlay ? overlay : NULL;
+					compose_yuy2_c(dst1_C, dst2_C, Y1, Y2, U, V, pOverlay, palette, opaque, uPairs);
+					func(dst1, dst2, Y1, Y2, U, V, pOverlay, palette, opaque, uPairs);
+
+					if ((memcmp(dst1, dst1_C, uPairs << 2) != 0) || (memcmp(dst2, dst2_C, uPairs << 2) != 0))
+					{
+						result = false;
+					}
+				}
+			}
+
+			logtest(result, string("VLDP overlay compose accuracy test (") + name + ")");
+		}
+	}
+
 #ifdef USE_OPENGL
 	// make sure we're not in opengl mode
 	if (!get_use_opengl())
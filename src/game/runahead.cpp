@@ -0,0 +1,186 @@
+/*
+ * runahead.cpp
+ *
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of DAPHNE, a laserdisc arcade game emulator
+ *
+ * DAPHNE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * DAPHNE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string>
+#include "runahead.h"
+#include "snapshot.h"
+#include "game.h"
+#include "../daphne.h"	// for set_quitflag
+#include "../cpu/cpu.h"
+#include "../ldp-out/ldp.h"
+#include "../sound/sound.h"
+#include "../io/conout.h"
+#include "../io/numstr.h"
+
+using namespace std;
+
+static unsigned int g_uRunAheadFrames = 0;	// how many frames the user asked to run ahead
+static bool g_bRunAheadActive = false;	// whether run-ahead was requested and the game can support it
+static bool g_bRunAheadFrameDone = false;	// set when the game finishes a frame, so runahead_think knows to run ahead
+static bool g_bRunAheadSpeculating = false;	// whether the machine is being run ahead right now
+static bool g_bRunAheadStopped = false;	// set if the laserdisc player was given a command while running ahead
+static bool g_bRunAheadShowingReal = false;	// whether runahead_think is blitting the real frame
+static unsigned int g_uRunAheadFramesDone = 0;	// how many frames the game has finished while running ahead
+
+// The machine gets saved here before running ahead.
+// It is only ever cleared (not freed), so after the first frame, saving doesn't have to allocate anything.
+static struct snapshot g_runahead_snap;
+
+void runahead_set_frames(unsigned int uFrames)
+{
+	if (uFrames > RUNAHEAD_MAX_FRAMES)
+	{
+		string s = "runahead : can't run more than " + numstr::ToStr(RUNAHEAD_MAX_FRAMES) + " frames ahead";
+		printline(s.c_str());
+		uFrames = RUNAHEAD_MAX_FRAMES;
+	}
+	g_uRunAheadFrames = uFrames;
+}
+
+void runahead_start()
+{
+	g_bRunAheadActive = false;
+	g_bRunAheadFrameDone = false;
+
+	if (g_uRunAheadFrames == 0)
+	{
+		return;
+	}
+
+	if (!g_game->is_snapshot_supported())
+	{
+		printline("runahead : this game does not support snapshots, -runahead will be ignored");
+		return;
+	}
+
+	if (!g_game->get_active_video_overlay())
+	{
+		printline("runahead : this game does not use a video overlay, -runahead will be ignored");
+		return;
+	}
+
+	string s = "runahead : running " + numstr::ToStr(g_uRunAheadFrames) + " frame(s) ahead";
+	printline(s.c_str());
+	g_bRunAheadActive = true;
+}
+
+// saves the parts of the machine that running ahead can change
+// (the laserdisc player goes first because it's the part that is most likely to fail)
+static bool runahead_save()
+{
+	snapshot_clear(&g_runahead_snap);
+	return g_ldp->save_counters(&g_runahead_snap) && cpu_save_state(&g_runahead_snap) &&
+		g_game->save_state(&g_runahead_snap) && sound_save_state(&g_runahead_snap);
+}
+
+static bool runahead_load()
+{
+	snapshot_rewind(&g_runahead_snap);
+	return g_ldp->load_counters(&g_runahead_snap) && cpu_load_state(&g_runahead_snap) &&
+		g_game->load_state(&g_runahead_snap) && sound_load_state(&g_runahead_snap);
+}
+
+void runahead_think()
+{
+	if (!g_bRunAheadFrameDone)
+	{
+		return;
+	}
+
+	g_bRunAheadFrameDone = false;
+	g_uRunAheadFramesDone = 0;
+
+	// this fails while the disc is searching, in which case we just show the real frame
+	if (runahead_save())
+	{
+		unsigned int uMaxMs = g_uRunAheadFrames * RUNAHEAD_MAX_MS_PER_FRAME;
+
+		g_bRunAheadSpeculating = true;
+		g_bRunAheadStopped = false;
+
+		// the frame gets blitted from inside the game's vblank/NMI handler, so we always stop at the end of a ms
+		for (unsigned int uMs = 0; (uMs < uMaxMs) && (g_uRunAheadFramesDone < g_uRunAheadFrames) && !g_bRunAheadStopped; uMs++)
+		{
+			cpu_execute_ms();
+		}
+
+		g_bRunAheadSpeculating = false;
+
+		if (!runahead_load())
+		{
+			printline("runahead : could not restore the machine after running ahead!");
+			g_bRunAheadActive = false;
+			set_quitflag();
+			return;
+		}
+	}
+
+	// if running ahead didn't get as far as the frame it was supposed to show, show the real one
+	if (g_uRunAheadFramesDone < g_uRunAheadFrames)
+	{
+		g_bRunAheadShowingReal = true;
+		g_game->video_blit();
+		g_bRunAheadShowingReal = false;
+	}
+}
+
+bool runahead_is_speculating()
+{
+	return g_bRunAheadSpeculating;
+}
+
+bool runahead_blit_allowed()
+{
+	if (!g_bRunAheadActive)
+	{
+		return true;
+	}
+
+	if (g_bRunAheadSpeculating)
+	{
+		// only the last frame that we run ahead to gets shown
+		if (++g_uRunAheadFramesDone != g_uRunAheadFrames)
+		{
+			return false;
+		}
+	}
+	// else if the real machine has just finished a frame, runahead_think takes it from here
+	else if (!g_bRunAheadShowingReal)
+	{
+		g_bRunAheadFrameDone = true;
+		return false;
+	}
+
+	// what's on the screen may have come from a frame that never really happened, so it all has to be redrawn
+	g_game->video_mark_all_dirty();
+	return true;
+}
+
+bool runahead_block_ldp_command()
+{
+	if (g_bRunAheadSpeculating)
+	{
+		g_bRunAheadStopped = true;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,64 @@
+/*
+ * runahead.h
+ *
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of DAPHNE, a laserdisc arcade game emulator
+ *
+ * DAPHNE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * DAPHNE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// runahead.h
+// Run-ahead (-runahead <frames>) hides some of the input lag of the emulated machine.
+// After every frame (every time the game calls video_blit), the machine is saved to memory, run a few frames
+//  further with the input that the user is holding right now, and the video overlay from the last of those
+//  frames is shown.  Then the machine is restored and carries on as if nothing happened.
+// Only the video overlay can be run ahead.  The laserdisc player can't be told to do anything that would have to
+//  be taken back, so running ahead stops early whenever the game gives it a command (or while it is searching).
+// (Switching the disc's audio channels on or off isn't stopped, so that can happen up to a few frames early.)
+// The game driver must support snapshots (see snapshot.h) and use a video overlay.
+
+#ifndef RUNAHEAD_H
+#define RUNAHEAD_H
+
+// most frames that can be run ahead
+#define RUNAHEAD_MAX_FRAMES	8
+
+// if a frame takes longer than this many emulated ms, running ahead gives up
+#define RUNAHEAD_MAX_MS_PER_FRAME	100
+
+// sets how many frames to run ahead (0 turns run-ahead off, which is the default)
+void runahead_set_frames(unsigned int uFrames);
+
+// Called by cpu_execute before any cpu has executed.
+// Turns run-ahead off if the game can't support it.
+void runahead_start();
+
+// Called by cpu_execute at the end of every emulated ms (after input has been checked).
+// If the game has finished a frame, this runs ahead and shows the overlay from the frame that was run ahead to.
+void runahead_think();
+
+// returns true while the machine is being run ahead (anything that can't be taken back must not happen)
+bool runahead_is_speculating();
+
+// Called by game::video_blit.  Returns false if the overlay should not be blitted right now.
+// While run-ahead is on, the only overlay that gets blitted is the one from the frame that was run ahead to.
+bool runahead_blit_allowed();
+
+// Called by the laserdisc player before it carries out a command.
+// Returns true if the command must be ignored because the machine is being run ahead (running ahead then stops).
+bool runahead_block_ldp_command();
+
+#endif // RUNAHEAD_H
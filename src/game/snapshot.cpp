@@ -0,0 +1,415 @@
+/*
+ * snapshot.cpp
+ *
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of DAPHNE, a laserdisc arcade game emulator
+ *
+ * DAPHNE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * DAPHNE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// snapshot.cpp
+// Saves and restores the state of the whole emulated machine (see snapshot.h)
+
+#include <string.h>
+#include <zlib.h>	// for compression
+#include <string>
+#include "snapshot.h"
+#include "game.h"
+#include "../daphne.h"	// for get_daphne_version
+#include "../cpu/cpu.h"
+#include "../ldp-out/ldp.h"
+#include "../sound/sound.h"
+#include "../io/conout.h"
+#include "../io/homedir.h"
+#include "../io/numstr.h"
+
+using namespace std;
+
+// the tag of the section that identifies which build and game a snapshot came from
+static const char *SNAPSHOT_HEADER_TAG = "DSNP";
+
+// the tag of the section that -snapshot_boot puts in front of the machine state
+static const char *SNAPSHOT_BOOT_TAG = "BOOT";
+#define SNAPSHOT_BOOT_VERSION	1
+
+// if the snapshot can't be taken by this many ms after it was supposed to be (the disc may be searching), give up
+#define SNAPSHOT_BOOT_MAX_DELAY_MS	5000
+
+static bool g_bSnapshotBootEnabled = false;	// whether -snapshot_boot was requested
+static bool g_bSnapshotBootPending = false;	// whether we still need to take the boot snapshot
+static unsigned int g_uSnapshotBootMs = SNAPSHOT_BOOT_DEFAULT_MS;	// when to take the boot snapshot
+static Uint32 g_uSnapshotBootCmdlineCRC = 0;	// identifies the command line options the snapshot is good for
+static Uint32 g_uSnapshotBootMemCRC = 0;	// identifies the roms/nvram the snapshot is good for
+
+void snapshot_clear(struct snapshot *snap)
+{
+	snap->data.clear();
+	snapshot_rewind(snap);
+}
+
+void snapshot_rewind(struct snapshot *snap)
+{
+	snap->uReadPos = 0;
+	snap->uSectionEnd = 0;
+	snap->bError = false;
+}
+
+void snapshot_put(struct snapshot *snap, const void *src, unsigned int uSize)
+{
+	const Uint8 *p = (const Uint8 *) src;
+	snap->data.insert(snap->data.end(), p, p + uSize);
+}
+
+bool snapshot_get(struct snapshot *snap, void *dst, unsigned int uSize)
+{
+	// if there isn't enough left, it's a bad snapshot
+	if (snap->bError || (uSize > snap->data.size() - snap->uReadPos))
+	{
+		memset(dst, 0, uSize);
+		snap->bError = true;
+		return false;
+	}
+
+	memcpy(dst, &snap->data[snap->uReadPos], uSize);
+	snap->uReadPos += uSize;
+	return true;
+}
+
+unsigned int snapshot_begin_section(struct snapshot *snap, const char *tag, Uint32 uVersion)
+{
+	unsigned int uSectionStart = (unsigned int) snap->data.size();
+	Uint32 uLength = 0;	// filled in by snapshot_end_section
+
+	snapshot_put(snap, tag, 4);
+	snapshot_put(snap, &uVersion, sizeof(uVersion));
+	snapshot_put(snap, &uLength, sizeof(uLength));
+	return uSectionStart;
+}
+
+void snapshot_end_section(struct snapshot *snap, unsigned int uSectionStart)
+{
+	unsigned int uLengthPos = uSectionStart + 4 + sizeof(Uint32);
+	Uint32 uLength = (Uint32) (snap->data.size() - (uLengthPos + sizeof(Uint32)));
+	memcpy(&snap->data[uLengthPos], &uLength, sizeof(uLength));
+}
+
+bool snapshot_open_section(struct snapshot *snap, const char *tag, Uint32 uVersion)
+{
+	char actual_tag[4];
+	Uint32 uActualVersion = 0, uLength = 0;
+
+	snapshot_get(snap, actual_tag, sizeof(actual_tag));
+	snapshot_get(snap, &uActualVersion, sizeof(uActualVersion));
+	snapshot_get(snap, &uLength, sizeof(uLength));
+
+	if (snap->bError)
+	{
+		return false;
+	}
+
+	if ((memcmp(actual_tag, tag, 4) != 0) || (uActualVersion != uVersion) ||
+		(uLength > snap->data.size() - snap->uReadPos))
+	{
+		string s = "snapshot : expected section ";
+		s.append(tag, 4);
+		s += " version " + numstr::ToStr(uVersion) + ", but found ";
+		s.append(actual_tag, 4);
+		s += " version " + numstr::ToStr(uActualVersion);
+		printline(s.c_str());
+		snap->bError = true;
+		return false;
+	}
+
+	snap->uSectionEnd = snap->uReadPos + uLength;
+	return true;
+}
+
+bool snapshot_close_section(struct snapshot *snap)
+{
+	if (!snap->bError && (snap->uReadPos != snap->uSectionEnd))
+	{
+		printline("snapshot : a section was not the size that was expected");
+		snap->bError = true;
+	}
+	return !snap->bError;
+}
+
+// a string is saved as its length followed by its characters
+static void snapshot_put_string(struct snapshot *snap, const char *str)
+{
+	Uint32 uLength = (Uint32) strlen(str);
+	snapshot_put(snap, &uLength, sizeof(uLength));
+	snapshot_put(snap, str, uLength);
+}
+
+// returns true if the next string in the snapshot is 'str'
+static bool snapshot_match_string(struct snapshot *snap, const char *str)
+{
+	Uint32 uLength = 0;
+	snapshot_get(snap, &uLength, sizeof(uLength));
+
+	if (snap->bError || (uLength != strlen(str)) || (uLength > snap->data.size() - snap->uReadPos))
+	{
+		return false;
+	}
+
+	bool bMatch = (memcmp(&snap->data[snap->uReadPos], str, uLength) == 0);
+	snap->uReadPos += uLength;
+	return bMatch;
+}
+
+bool snapshot_save_machine(struct snapshot *snap)
+{
+	if (!g_game->is_snapshot_supported())
+	{
+		printline("snapshot : this game does not support snapshots");
+		return false;
+	}
+
+	// the header identifies which build and which game this came from, since cpu contexts, etc are saved as-is
+	unsigned int uSection = snapshot_begin_section(snap, SNAPSHOT_HEADER_TAG, SNAPSHOT_VERSION);
+	Uint32 uPointerSize = sizeof(void *);
+	snapshot_put_string(snap, get_daphne_version());
+	snapshot_put_string(snap, g_game->get_shortgamename());
+	snapshot_put(snap, &uPointerSize, sizeof(uPointerSize));
+	snapshot_end_section(snap, uSection);
+
+	// the laserdisc player goes last because it's the part that takes a while to restore
+	return cpu_save_state(snap) && g_game->save_state(snap) && sound_save_state(snap) && g_ldp->save_state(snap);
+}
+
+bool snapshot_load_machine(struct snapshot *snap)
+{
+	Uint32 uPointerSize = 0;
+
+	if (!g_game->is_snapshot_supported())
+	{
+		printline("snapshot : this game does not support snapshots");
+		return false;
+	}
+
+	if (!snapshot_open_section(snap, SNAPSHOT_HEADER_TAG, SNAPSHOT_VERSION))
+	{
+		return false;
+	}
+
+	if (!snapshot_match_string(snap, get_daphne_version()))
+	{
+		printline("snapshot : snapshot was made by a different version of DAPHNE, ignoring it");
+		return false;
+	}
+
+	if (!snapshot_match_string(snap, g_game->get_shortgamename()))
+	{
+		printline("snapshot : snapshot was made for a different game, ignoring it");
+		return false;
+	}
+
+	snapshot_get(snap, &uPointerSize, sizeof(uPointerSize));
+	if (uPointerSize != sizeof(void *))
+	{
+		printline("snapshot : snapshot was made by a different build of DAPHNE, ignoring it");
+		return false;
+	}
+
+	if (!snapshot_close_section(snap))
+	{
+		return false;
+	}
+
+	return cpu_load_state(snap) && g_game->load_state(snap) && sound_load_state(snap) && g_ldp->load_state(snap);
+}
+
+bool snapshot_write_file(const char *filename, const struct snapshot *snap)
+{
+	bool bResult = false;
+	string path = g_homedir.get_ramfile(filename);
+	gzFile f = gzopen(path.c_str(), "wb");
+
+	if (f)
+	{
+		// most of a snapshot is memory that compresses very well, but we don't want to take too long
+		gzsetparams(f, Z_BEST_SPEED, Z_DEFAULT_STRATEGY);
+
+		int iSize = (int) snap->data.size();
+		if ((iSize == 0) || (gzwrite(f, (voidp) &snap->data[0], iSize) == iSize))
+		{
+			string s = "Saved snapshot to " + path + " (" + numstr::ToStr(iSize) + " bytes)";
+			printline(s.c_str());
+			bResult = true;
+		}
+		gzclose(f);
+	}
+
+	if (!bResult)
+	{
+		string s = "snapshot : error saving snapshot to " + path;
+		printline(s.c_str());
+	}
+
+	return bResult;
+}
+
+bool snapshot_read_file(const char *filename, struct snapshot *snap)
+{
+	string path = g_homedir.get_ramfile(filename);
+	gzFile f = gzopen(path.c_str(), "rb");
+	Uint8 buf[65536];
+	int iRead = 0;
+
+	snapshot_clear(snap);
+
+	if (!f)
+	{
+		return false;
+	}
+
+	while ((iRead = gzread(f, buf, sizeof(buf))) > 0)
+	{
+		snapshot_put(snap, buf, (unsigned int) iRead);
+	}
+	gzclose(f);
+
+	// if there was a read error
+	if (iRead < 0)
+	{
+		string s = "snapshot : error reading snapshot from " + path;
+		printline(s.c_str());
+		snapshot_clear(snap);
+		return false;
+	}
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// where the boot snapshot lives (relative to the ram directory)
+static string snapshot_boot_filename()
+{
+	string filename = g_game->get_shortgamename();
+	filename += "-boot.snap";
+	return filename;
+}
+
+void snapshot_boot_enable(Uint32 uCmdlineCRC)
+{
+	g_bSnapshotBootEnabled = true;
+	g_uSnapshotBootCmdlineCRC = uCmdlineCRC;
+}
+
+void snapshot_boot_set_ms(unsigned int uMs)
+{
+	g_uSnapshotBootMs = uMs;
+}
+
+bool snapshot_boot_is_enabled()
+{
+	return g_bSnapshotBootEnabled;
+}
+
+bool snapshot_boot_restore()
+{
+	struct snapshot snap;
+	bool bResult = false;
+
+	if (!g_bSnapshotBootEnabled)
+	{
+		return false;
+	}
+
+	if (!g_game->is_snapshot_supported())
+	{
+		printline("snapshot : this game does not support snapshots, -snapshot_boot will be ignored");
+		g_bSnapshotBootEnabled = false;
+		return false;
+	}
+
+	// this has to be computed before anything executes since the cpus will change memory
+	g_uSnapshotBootMemCRC = g_game->get_boot_crc();
+
+	string filename = snapshot_boot_filename();
+	if (snapshot_read_file(filename.c_str(), &snap))
+	{
+		Uint32 uCmdlineCRC = 0, uMemCRC = 0;
+
+		// the snapshot is only good if the game was started the same way with the same roms/nvram
+		if (snapshot_open_section(&snap, SNAPSHOT_BOOT_TAG, SNAPSHOT_BOOT_VERSION))
+		{
+			snapshot_get(&snap, &uCmdlineCRC, sizeof(uCmdlineCRC));
+			snapshot_get(&snap, &uMemCRC, sizeof(uMemCRC));
+			snapshot_close_section(&snap);
+		}
+
+		if (snap.bError)
+		{
+			printline("snapshot : boot snapshot is not valid, it will be re-created");
+		}
+		else if ((uCmdlineCRC != g_uSnapshotBootCmdlineCRC) || (uMemCRC != g_uSnapshotBootMemCRC))
+		{
+			printline("snapshot : boot snapshot was made with different options, roms or nvram, it will be re-created");
+		}
+		else if (snapshot_load_machine(&snap))
+		{
+			printline("snapshot : restored boot snapshot, skipping boot sequence");
+			bResult = true;
+		}
+		else
+		{
+			// the machine may be half-restored, so start from scratch
+			printline("snapshot : boot snapshot could not be restored, it will be re-created");
+			cpu_reset();
+		}
+	}
+	else
+	{
+		printline("snapshot : no boot snapshot found, one will be made once the game has booted");
+	}
+
+	g_bSnapshotBootPending = !bResult;
+	return bResult;
+}
+
+void snapshot_think(unsigned int uElapsedMs)
+{
+	if (!g_bSnapshotBootPending || (uElapsedMs < g_uSnapshotBootMs))
+	{
+		return;
+	}
+
+	struct snapshot snap;
+	snapshot_clear(&snap);
+
+	unsigned int uSection = snapshot_begin_section(&snap, SNAPSHOT_BOOT_TAG, SNAPSHOT_BOOT_VERSION);
+	snapshot_put(&snap, &g_uSnapshotBootCmdlineCRC, sizeof(g_uSnapshotBootCmdlineCRC));
+	snapshot_put(&snap, &g_uSnapshotBootMemCRC, sizeof(g_uSnapshotBootMemCRC));
+	snapshot_end_section(&snap, uSection);
+
+	// if the machine can be saved right now
+	if (snapshot_save_machine(&snap))
+	{
+		string filename = snapshot_boot_filename();
+		snapshot_write_file(filename.c_str(), &snap);
+		g_bSnapshotBootPending = false;
+	}
+
+	// else try again next ms (the disc may be in the middle of a search), but don't keep trying forever
+	else if (uElapsedMs - g_uSnapshotBootMs > SNAPSHOT_BOOT_MAX_DELAY_MS)
+	{
+		printline("snapshot : could not take boot snapshot, giving up");
+		g_bSnapshotBootPending = false;
+	}
+}
@@ -0,0 +1,115 @@
+/*
+ * snapshot.h
+ *
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of DAPHNE, a laserdisc arcade game emulator
+ *
+ * DAPHNE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * DAPHNE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// snapshot.h
+// Saves and restores the state of the whole emulated machine (cpus, memory, laserdisc player, sound chips).
+// Each part of the machine writes its own section (see cpu_save_state, game::save_state, ldp::save_state
+//  and sound_save_state).  Sections are tagged and versioned so that a snapshot that doesn't match what
+//  this build expects gets rejected instead of being misread.
+// Game drivers must opt in (see game::m_bSnapshotSupported) because most of them keep state in member variables
+//  that the generic game class doesn't know about.
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <SDL.h>	// for Uint definitions
+#include <vector>
+
+// bump this whenever the layout of the snapshot header changes
+#define SNAPSHOT_VERSION	1
+
+// how many emulated ms -snapshot_boot lets the boot sequence run before taking its snapshot (if not overridden)
+#define SNAPSHOT_BOOT_DEFAULT_MS	10000
+
+struct snapshot
+{
+	std::vector<Uint8> data;	// the saved state
+	unsigned int uReadPos;	// where the next snapshot_get will read from
+	unsigned int uSectionEnd;	// where the section that is currently being read ends
+	bool bError;	// set if a read went past the end of the data or a section didn't match
+};
+
+// empties 'snap' so that it can be saved into
+void snapshot_clear(struct snapshot *snap);
+
+// rewinds 'snap' so that it can be loaded from
+void snapshot_rewind(struct snapshot *snap);
+
+// appends 'uSize' bytes to the snapshot
+void snapshot_put(struct snapshot *snap, const void *src, unsigned int uSize);
+
+// reads 'uSize' bytes from the snapshot
+// Returns false (and sets bError) if there aren't enough bytes left, in which case 'dst' is zeroed.
+bool snapshot_get(struct snapshot *snap, void *dst, unsigned int uSize);
+
+// Starts a new section.  'tag' must be 4 characters.
+// Returns a value that must be passed to snapshot_end_section.
+unsigned int snapshot_begin_section(struct snapshot *snap, const char *tag, Uint32 uVersion);
+
+// finishes a section (fills in its length)
+void snapshot_end_section(struct snapshot *snap, unsigned int uSectionStart);
+
+// Starts reading the next section.
+// Returns false (and sets bError) if the next section isn't 'tag' or isn't 'uVersion'.
+bool snapshot_open_section(struct snapshot *snap, const char *tag, Uint32 uVersion);
+
+// Finishes reading a section.
+// Returns false (and sets bError) if the section wasn't read exactly up to its end.
+bool snapshot_close_section(struct snapshot *snap);
+
+// Saves the state of the whole machine into 'snap'.
+// This must only be called from the cpu loop in between ms's (see cpu_execute) because that's
+//  the only time when every cpu is in between instructions.
+// Returns false if the machine can't be saved (or can't be saved right now, such as in the middle of a search).
+bool snapshot_save_machine(struct snapshot *snap);
+
+// Restores the state of the whole machine from 'snap' (same restrictions as snapshot_save_machine).
+// If this fails, the machine is in an undefined state and should be reset.
+bool snapshot_load_machine(struct snapshot *snap);
+
+// writes 'snap' to a compressed file (the filename is relative to the ram directory)
+bool snapshot_write_file(const char *filename, const struct snapshot *snap);
+
+// reads 'snap' from a compressed file (the filename is relative to the ram directory)
+bool snapshot_read_file(const char *filename, struct snapshot *snap);
+
+// FAST BOOT (-snapshot_boot)
+// The first time, the game boots normally and a snapshot is taken after the boot sequence has run for a while.
+// After that, the snapshot is restored instead of running the boot sequence.
+// 'uCmdlineCRC' identifies the rest of the command line, since dip switches, rom versions, etc
+//  change what the boot sequence does (so a snapshot made with different options can't be used).
+void snapshot_boot_enable(Uint32 uCmdlineCRC);
+
+// changes how many emulated ms the boot sequence runs before the snapshot is taken
+void snapshot_boot_set_ms(unsigned int uMs);
+
+// returns true if -snapshot_boot was requested
+bool snapshot_boot_is_enabled();
+
+// Called by cpu_execute after it has reset the cpu timers and before any cpu has executed.
+// Returns true if a boot snapshot was restored.
+bool snapshot_boot_restore();
+
+// Called by cpu_execute at the end of every emulated ms (so it has to be cheap).
+void snapshot_think(unsigned int uElapsedMs);
+
+#endif // SNAPSHOT_H
@@ -26,20 +26,27 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <zlib.h>	// for crc32
 #include "cmdline.h"
 #include "conout.h"
 #include "network.h"
 #include "numstr.h"
 #include "homedir.h"
 #include "input.h"	// to disable joystick use
+#include "inputrec.h"
 #include "../io/numstr.h"
 #include "../video/video.h"
 #include "../video/led.h"
 #include "../daphne.h"
+#include "../cpu/cpu.h"
 #include "../cpu/cpu-debug.h"	// for set_cpu_trace
+#include "../cpu/cpu-profile.h"
+#include "../cpu/m80_dynarec.h"
 #include "../game/lair.h"
 #include "../game/cliff.h"
 #include "../game/game.h"
+#include "../game/snapshot.h"
+#include "../game/runahead.h"
 #include "../game/superd.h"
 #include "../game/thayers.h"
 #include "../game/speedtest.h"
@@ -76,6 +83,7 @@
 #include "../ldp-out/ldp-combo.h"
 #include "../ldp-out/ldp-vldp.h"
 #include "../ldp-out/framemod.h"
+#include "../timer/timer.h"
 
 #ifdef UNIX
 #include <unistd.h>     // for unlink
@@ -640,6 +648,7 @@ bool parse_cmd_line(int argc, char **argv)
 	char s[320] = { 0 };	// in case they pass in a huge directory as part of the framefile
 	int i = 0;
 	bool log_was_disabled = false;	// if we actually get "-nolog" while going through arguments
+	bool bSnapshotBoot = false;	// if we get "-snapshot_boot"
 
 	//////////////////////////////////////////////////////////////////////////////////////
 
@@ -878,6 +887,85 @@ bool parse_cmd_line(int argc, char **argv)
 		{
 			g_game->set_fastboot(true);
 		}
+		// dumps cpu scheduler statistics to a file periodically (CSV, or JSON if the filename ends in .json)
+		else if (strcasecmp(s, "-cpu_profile")==0)
+		{
+			get_next_word(s, sizeof(s));
+			cpu_profile_set_output(s);
+		}
+		// how often (in milliseconds) the cpu statistics are dumped
+		else if (strcasecmp(s, "-cpu_profile_interval")==0)
+		{
+			get_next_word(s, sizeof(s));
+			cpu_profile_set_interval((unsigned int) atoi(s));
+		}
+		// runs the emulator as fast as possible, with all timing driven by emulated time instead of the host clock
+		// (useful for automated testing where the video/audio output is not being watched)
+		else if (strcasecmp(s, "-turbo")==0)
+		{
+			timer_set_virtual(true);
+			printline("Turbo mode enabled, emulation will not be throttled to real time");
+		}
+		// how close (in microseconds) the emulator sleeps to the end of each ms before it busy-waits the rest of the way
+		// (higher is more precise but burns more host cpu, 0 never busy-waits)
+		else if (strcasecmp(s, "-timer_slack_us")==0)
+		{
+			get_next_word(s, sizeof(s));
+			timer_set_sleep_slack_us((unsigned int) atoi(s));
+		}
+		// keeps every cpu on the main thread, even if the game driver could run some of them on other threads
+		else if (strcasecmp(s, "-nocputhreads")==0)
+		{
+			cpu_set_threads_allowed(false);
+		}
+		// runs every idle loop the slow way (for checking that skipping them doesn't change anything)
+		else if (strcasecmp(s, "-noidleskip")==0)
+		{
+			cpu_set_idle_skip(false);
+		}
+		// runs Z80 code that lives in rom through the recompiler instead of the interpreter
+		else if (strcasecmp(s, "-z80_dynarec")==0)
+		{
+			if (m80_dynarec_enable(true))
+			{
+				printline("Z80 dynarec enabled");
+			}
+		}
+		// skips the boot sequence by restoring a snapshot taken the first time the game booted
+		else if (strcasecmp(s, "-snapshot_boot")==0)
+		{
+			bSnapshotBoot = true;
+		}
+		// how many ms the boot sequence runs before the -snapshot_boot snapshot is taken
+		else if (strcasecmp(s, "-snapshot_boot_ms")==0)
+		{
+			get_next_word(s, sizeof(s));
+			snapshot_boot_set_ms((unsigned int) atoi(s));
+		}
+		// shows the video overlay from a few frames ahead to hide some of the game's input lag
+		else if (strcasecmp(s, "-runahead")==0)
+		{
+			get_next_word(s, sizeof(s));
+			runahead_set_frames((unsigned int) atoi(s));
+		}
+		// records all input (stamped with the cpu cycle it reached the game at) so it can be replayed
+		else if (strcasecmp(s, "-record_input")==0)
+		{
+			get_next_word(s, sizeof(s));
+			if (!inputrec_start_recording(s))
+			{
+				result = false;
+			}
+		}
+		// replays input recorded by -record_input, then quits and reports how long it took
+		else if (strcasecmp(s, "-replay_input")==0)
+		{
+			get_next_word(s, sizeof(s));
+			if (!inputrec_start_replay(s))
+			{
+				result = false;
+			}
+		}
 
 		// stretch video vertically by x amount (a value of 24 removes letterboxing effect in Cliffhanger)
 		else if (strcasecmp(s, "-vertical_stretch")==0)
@@ -1163,6 +1251,29 @@ bool parse_cmd_line(int argc, char **argv)
 		result = false;
 	}
 
+	// The boot snapshot is only good for the exact same options (dip switches, rom versions, etc), so identify
+	//  it by a CRC of the command line, minus the options that only say how to take the snapshot.
+	if (result && bSnapshotBoot)
+	{
+		Uint32 uCRC = crc32(0L, Z_NULL, 0);
+
+		for (i = 1; i < argc; i++)
+		{
+			if (strcasecmp(argv[i], "-snapshot_boot") == 0)
+			{
+				continue;
+			}
+			if (strcasecmp(argv[i], "-snapshot_boot_ms") == 0)
+			{
+				i++;	// skip its value too
+				continue;
+			}
+			uCRC = crc32(uCRC, (const Bytef *) argv[i], (uInt) strlen(argv[i]) + 1);
+		}
+
+		snapshot_boot_enable(uCRC);
+	}
+
 	// if we didn't receive "-nolog" while parsing, then it's ok to enable the log file now.
 	if (!log_was_disabled)
 	{
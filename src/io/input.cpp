@@ -24,6 +24,7 @@
 
 #include <time.h>
 #include "input.h"
+#include "inputrec.h"
 #include "conout.h"
 #include "homedir.h"
 #include "../video/video.h"
@@ -400,6 +401,16 @@ void SDL_check_input()
 	// added by JFA for -idleexit
 	if (get_idleexit() > 0 && elapsed_ms_time(idle_timer) > get_idleexit()) set_quitflag();
 
+	// if we're recording/replaying input, the coin queue has to be checked at the same cycle every time,
+	//  so inputrec_think takes care of it instead
+	if (!inputrec_is_active())
+	{
+		input_check_coin_queue();
+	}
+}
+
+void input_check_coin_queue()
+{
 	// if the coin queue has something entered into it
 	if (!g_coin_queue.empty())
 	{
@@ -426,7 +437,6 @@ void SDL_check_input()
 		// else it's not safe to activate the coin, so we just wait
 	}
 	// else the coin queue is empty, so we needn't do anything ...
-
 }
 
 #ifdef CPU_DEBUG
@@ -591,7 +601,10 @@ void process_event(SDL_Event *event)
 			break;
 		case SDL_MOUSEMOTION:
 			// added by ScottD
-			g_game->OnMouseMotion(event->motion.x, event->motion.y, event->motion.xrel, event->motion.yrel);
+			if (!inputrec_capture_mouse(event->motion.x, event->motion.y, event->motion.xrel, event->motion.yrel))
+			{
+				g_game->OnMouseMotion(event->motion.x, event->motion.y, event->motion.xrel, event->motion.yrel);
+			}
 			break;
 		case SDL_QUIT:
 			// if they are trying to close the window
@@ -794,6 +807,12 @@ void check_console_refresh()
 // if user has pressed a key/moved the joystick/pressed a button
 void input_enable(Uint8 move)
 {
+	// if we're recording/replaying input, it decides when (and whether) this input is acted on
+	if (inputrec_capture(true, move))
+	{
+		return;
+	}
+
 	// first test universal input, then pass unknown input on to the game driver
 
 	switch (move)
@@ -838,6 +857,11 @@ void input_enable(Uint8 move)
 // if user has released a key/released a button/moved joystick back to center position
 void input_disable(Uint8 move)
 {
+	if (inputrec_capture(false, move))
+	{
+		return;
+	}
+
 	// don't send reset or screenshots key-ups to the individual games because they will return warnings that will alarm users
 	if ((move != SWITCH_RESET) && (move != SWITCH_SCREENSHOT) && (move != SWITCH_QUIT)
 		&& (move != SWITCH_PAUSE))
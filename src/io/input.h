@@ -74,6 +74,10 @@ void FilterMouseEvents(bool bFilteredOut);
 
 void SDL_check_input();
 
+// activates/deactivates any coins in the coin queue whose time has come
+// (called by SDL_check_input, or by inputrec_think when recording/replaying input)
+void input_check_coin_queue();
+
 #ifdef CPU_DEBUG
 void toggle_console();
 #endif
@@ -0,0 +1,474 @@
+/*
+ * inputrec.cpp
+ *
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of DAPHNE, a laserdisc arcade game emulator
+ *
+ * DAPHNE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * DAPHNE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// inputrec.cpp
+// Records and replays input (see inputrec.h)
+
+// The file is plain text so that it can be looked at (and edited) by hand:
+//  daphne_input <version>
+//  game <shortgamename>
+//  <cycles> <memory crc> E <switch>	(input_enable)
+//  <cycles> <memory crc> D <switch>	(input_disable)
+//  <cycles> <memory crc> M <x> <y> <xrel> <yrel>	(mouse motion)
+//  <cycles> <memory crc> Q	(where the recording stopped)
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <zlib.h>	// for crc32
+#include "inputrec.h"
+#include "input.h"
+#include "conout.h"
+#include "numstr.h"
+#include "../daphne.h"	// for set_quitflag
+#include "../cpu/cpu.h"
+#include "../game/game.h"
+#include "../timer/timer.h"
+
+using namespace std;
+
+// bump this whenever the file format changes
+#define INPUTREC_VERSION 1
+
+// how much of cpu 0's memory goes into the CRC that checks whether the replay is still in sync
+#define INPUTREC_CRC_SIZE 0x10000
+
+struct inputrec_event
+{
+	Uint64 u64Cycles;	// cpu 0's total cycles when this input reached the game
+	Uint32 uMemCRC;	// CRC of cpu 0's memory right before this input reached the game
+	char type;	// 'E', 'D', 'M' or 'Q' (see top of file)
+	Uint8 move;	// which switch (for 'E' and 'D')
+	Uint16 x, y;	// for 'M'
+	Sint16 xrel, yrel;	// for 'M'
+};
+
+enum { INPUTREC_OFF, INPUTREC_RECORDING, INPUTREC_REPLAYING };
+static int g_inputrec_mode = INPUTREC_OFF;
+
+static FILE *g_inputrec_file = NULL;	// the recording that we're writing to
+static string g_inputrec_filename;
+
+// While recording, live inputs wait here until the end of the current emulated ms.
+// While replaying, this is the whole recording.
+static vector<struct inputrec_event> g_inputrec_events;
+static unsigned int g_inputrec_next = 0;	// which event we will replay next
+
+static bool g_inputrec_delivering = false;	// true while we are passing an input on to the game
+static bool g_inputrec_desync_reported = false;	// so we only complain about a desync once
+static bool g_inputrec_started = false;	// whether inputrec_think has been called yet
+static unsigned int g_inputrec_start_wall_ms = 0;	// host time when the first ms was emulated
+
+/////////////////////////////////////////////////////////////////////////////
+
+static Uint32 inputrec_mem_crc()
+{
+	Uint8 *mem = get_cpu_mem(0);
+	Uint32 uCRC = crc32(0L, Z_NULL, 0);
+
+	if (mem)
+	{
+		uCRC = crc32(uCRC, mem, INPUTREC_CRC_SIZE);
+	}
+	return uCRC;
+}
+
+// passes an input on to the game, the same way that input.cpp would have if we weren't recording/replaying
+static void inputrec_deliver(const struct inputrec_event &ev)
+{
+	g_inputrec_delivering = true;
+	switch (ev.type)
+	{
+	case 'E':
+		input_enable(ev.move);
+		break;
+	case 'D':
+		input_disable(ev.move);
+		break;
+	case 'M':
+		g_game->OnMouseMotion(ev.x, ev.y, ev.xrel, ev.yrel);
+		break;
+	default:
+		break;
+	}
+	g_inputrec_delivering = false;
+}
+
+static void inputrec_write_event(const struct inputrec_event &ev)
+{
+	string s = numstr::ToStr((MPO_UINT64) ev.u64Cycles) + " " + numstr::ToStr(ev.uMemCRC, 16, 8) + " " + ev.type;
+
+	if ((ev.type == 'E') || (ev.type == 'D'))
+	{
+		s += " " + numstr::ToStr((unsigned int) ev.move);
+	}
+	else if (ev.type == 'M')
+	{
+		s += " " + numstr::ToStr((unsigned int) ev.x) + " " + numstr::ToStr((unsigned int) ev.y) + " " +
+			numstr::ToStr((int) ev.xrel) + " " + numstr::ToStr((int) ev.yrel);
+	}
+	fprintf(g_inputrec_file, "%s\n", s.c_str());
+}
+
+// splits 'line' into words separated by whitespace
+static void inputrec_split(const char *line, vector<string> &words)
+{
+	string word;
+
+	words.clear();
+	for (const char *p = line; ; p++)
+	{
+		if ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n') || (*p == 0))
+		{
+			if (!word.empty())
+			{
+				words.push_back(word);
+				word.clear();
+			}
+			if (*p == 0)
+			{
+				break;
+			}
+		}
+		else
+		{
+			word += *p;
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool inputrec_start_recording(const char *filename)
+{
+	if (g_inputrec_mode != INPUTREC_OFF)
+	{
+		printline("inputrec : can't record and replay input at the same time");
+		return false;
+	}
+
+	g_inputrec_file = fopen(filename, "w");
+	if (!g_inputrec_file)
+	{
+		string s = "inputrec : could not open ";
+		s += filename;
+		s += " for writing";
+		printline(s.c_str());
+		return false;
+	}
+
+	fprintf(g_inputrec_file, "daphne_input %d\n", INPUTREC_VERSION);
+	fprintf(g_inputrec_file, "game %s\n", g_game->get_shortgamename());
+
+	g_inputrec_filename = filename;
+	g_inputrec_events.clear();
+	g_inputrec_mode = INPUTREC_RECORDING;
+	return true;
+}
+
+bool inputrec_start_replay(const char *filename)
+{
+	char line[160];
+	vector<string> words;
+	bool bResult = true;
+	unsigned int uLine = 0;
+
+	if (g_inputrec_mode != INPUTREC_OFF)
+	{
+		printline("inputrec : can't record and replay input at the same time");
+		return false;
+	}
+
+	FILE *F = fopen(filename, "r");
+	if (!F)
+	{
+		string s = "inputrec : could not open ";
+		s += filename;
+		printline(s.c_str());
+		return false;
+	}
+
+	g_inputrec_events.clear();
+
+	while (bResult && fgets(line, sizeof(line), F))
+	{
+		uLine++;
+		inputrec_split(line, words);
+
+		// skip blank lines
+		if (words.empty())
+		{
+			continue;
+		}
+
+		if (uLine == 1)
+		{
+			bResult = (words.size() == 2) && (words[0] == "daphne_input") &&
+				(numstr::ToInt32(words[1].c_str()) == INPUTREC_VERSION);
+		}
+		else if (uLine == 2)
+		{
+			bResult = (words.size() == 2) && (words[0] == "game");
+			if (bResult && (words[1] != g_game->get_shortgamename()))
+			{
+				string s = "inputrec : this recording is for " + words[1] + ", not " + g_game->get_shortgamename();
+				printline(s.c_str());
+				bResult = false;
+			}
+		}
+		else
+		{
+			struct inputrec_event ev;
+			memset(&ev, 0, sizeof(ev));
+
+			bResult = (words.size() >= 3) && (words[2].size() == 1);
+			if (bResult)
+			{
+				ev.u64Cycles = numstr::ToUint64(words[0].c_str());
+				ev.uMemCRC = numstr::ToUint32(words[1].c_str(), 16);
+				ev.type = words[2][0];
+
+				switch (ev.type)
+				{
+				case 'E':
+				case 'D':
+					bResult = (words.size() == 4);
+					if (bResult)
+					{
+						ev.move = (Uint8) numstr::ToUint32(words[3].c_str());
+					}
+					break;
+				case 'M':
+					bResult = (words.size() == 7);
+					if (bResult)
+					{
+						ev.x = (Uint16) numstr::ToUint32(words[3].c_str());
+						ev.y = (Uint16) numstr::ToUint32(words[4].c_str());
+						ev.xrel = (Sint16) numstr::ToInt32(words[5].c_str());
+						ev.yrel = (Sint16) numstr::ToInt32(words[6].c_str());
+					}
+					break;
+				case 'Q':
+					break;
+				default:
+					bResult = false;
+					break;
+				}
+
+				// the events have to be in order for the replay to work
+				if (bResult && !g_inputrec_events.empty() && (ev.u64Cycles < g_inputrec_events.back().u64Cycles))
+				{
+					bResult = false;
+				}
+			}
+
+			if (bResult)
+			{
+				g_inputrec_events.push_back(ev);
+			}
+		}
+
+		if (!bResult)
+		{
+			string s = "inputrec : error in " + string(filename) + " at line " + numstr::ToStr(uLine);
+			printline(s.c_str());
+		}
+	}
+
+	fclose(F);
+
+	if (bResult)
+	{
+		string s = "inputrec : replaying " + numstr::ToStr((unsigned int) g_inputrec_events.size()) + " inputs from " + filename;
+		printline(s.c_str());
+		g_inputrec_filename = filename;
+		g_inputrec_next = 0;
+		g_inputrec_mode = INPUTREC_REPLAYING;
+	}
+	else
+	{
+		g_inputrec_events.clear();
+	}
+
+	return bResult;
+}
+
+bool inputrec_is_active()
+{
+	return (g_inputrec_mode != INPUTREC_OFF);
+}
+
+bool inputrec_capture(bool bEnabled, Uint8 move)
+{
+	// if we are the ones passing this input on, or if we aren't doing anything, then let it through
+	if (g_inputrec_delivering || (g_inputrec_mode == INPUTREC_OFF))
+	{
+		return false;
+	}
+
+	// these don't affect the emulated machine, so the user can always use them
+	switch (move)
+	{
+	case SWITCH_QUIT:
+	case SWITCH_SCREENSHOT:
+	case SWITCH_PAUSE:
+	case SWITCH_CONSOLE:
+		return false;
+	default:
+		break;
+	}
+
+	// save it for the end of this ms
+	if (g_inputrec_mode == INPUTREC_RECORDING)
+	{
+		struct inputrec_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.type = bEnabled ? 'E' : 'D';
+		ev.move = move;
+		g_inputrec_events.push_back(ev);
+	}
+	// else we're replaying, so live input is ignored
+
+	return true;
+}
+
+bool inputrec_capture_mouse(Uint16 x, Uint16 y, Sint16 xrel, Sint16 yrel)
+{
+	if (g_inputrec_delivering || (g_inputrec_mode == INPUTREC_OFF))
+	{
+		return false;
+	}
+
+	if (g_inputrec_mode == INPUTREC_RECORDING)
+	{
+		struct inputrec_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.type = 'M';
+		ev.x = x;
+		ev.y = y;
+		ev.xrel = xrel;
+		ev.yrel = yrel;
+		g_inputrec_events.push_back(ev);
+	}
+
+	return true;
+}
+
+void inputrec_think()
+{
+	if (g_inputrec_mode == INPUTREC_OFF)
+	{
+		return;
+	}
+
+	if (!g_inputrec_started)
+	{
+		g_inputrec_start_wall_ms = GetRealTicksFunc();
+		g_inputrec_started = true;
+	}
+
+	if (g_inputrec_mode == INPUTREC_RECORDING)
+	{
+		if (!g_inputrec_events.empty())
+		{
+			Uint64 u64Cycles = get_total_cycles_executed(0);
+
+			for (vector<struct inputrec_event>::iterator i = g_inputrec_events.begin(); i != g_inputrec_events.end(); ++i)
+			{
+				i->u64Cycles = u64Cycles;
+				i->uMemCRC = inputrec_mem_crc();
+				inputrec_write_event(*i);
+				inputrec_deliver(*i);
+			}
+			g_inputrec_events.clear();
+		}
+	}
+
+	// else we're replaying
+	else
+	{
+		// (the cycle count only needs to be checked if we have events left)
+		while ((g_inputrec_next < g_inputrec_events.size()) &&
+			(g_inputrec_events[g_inputrec_next].u64Cycles <= get_total_cycles_executed(0)))
+		{
+			const struct inputrec_event &ev = g_inputrec_events[g_inputrec_next];
+
+			if (!g_inputrec_desync_reported && (ev.uMemCRC != inputrec_mem_crc()))
+			{
+				string s = "inputrec : WARNING : replay is out of sync with the recording at input " +
+					numstr::ToStr(g_inputrec_next + 1) + " (cycle " + numstr::ToStr((MPO_UINT64) ev.u64Cycles) + ")";
+				printline(s.c_str());
+				g_inputrec_desync_reported = true;
+			}
+
+			// the recording stopped here, so stop the replay too
+			if (ev.type == 'Q')
+			{
+				unsigned int uWallMs = GetRealTicksFunc() - g_inputrec_start_wall_ms;
+				Uint32 uHz = get_cpu_hz(0);
+				unsigned int uEmuMs = (uHz != 0) ? (unsigned int) ((ev.u64Cycles * 1000) / uHz) : 0;
+				char s[160];
+				sprintf(s, "inputrec : replay finished, %u emulated ms in %u wall ms (%.2f emulated ms per wall ms)%s",
+					uEmuMs, uWallMs, (uWallMs != 0) ? ((double) uEmuMs / uWallMs) : 0.0,
+					g_inputrec_desync_reported ? " [OUT OF SYNC]" : "");
+				printline(s);
+				g_inputrec_next = (unsigned int) g_inputrec_events.size();
+				set_quitflag();
+				break;
+			}
+
+			inputrec_deliver(ev);
+			g_inputrec_next++;
+		}
+	}
+
+	// Coins have to be taken off the coin queue at the same cycle every time too,
+	//  so SDL_check_input leaves that up to us while we're active.
+	input_check_coin_queue();
+}
+
+void inputrec_shutdown()
+{
+	if (g_inputrec_mode == INPUTREC_RECORDING)
+	{
+		struct inputrec_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.u64Cycles = get_total_cycles_executed(0);
+		ev.uMemCRC = inputrec_mem_crc();
+		ev.type = 'Q';
+		inputrec_write_event(ev);
+
+		fclose(g_inputrec_file);
+		g_inputrec_file = NULL;
+
+		string s = "inputrec : input recorded to " + g_inputrec_filename;
+		printline(s.c_str());
+	}
+	else if ((g_inputrec_mode == INPUTREC_REPLAYING) && (g_inputrec_next < g_inputrec_events.size()))
+	{
+		printline("inputrec : replay was stopped before the end of the recording");
+	}
+
+	g_inputrec_events.clear();
+	g_inputrec_mode = INPUTREC_OFF;
+}
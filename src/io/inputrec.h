@@ -0,0 +1,61 @@
+/*
+ * inputrec.h
+ *
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of DAPHNE, a laserdisc arcade game emulator
+ *
+ * DAPHNE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * DAPHNE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// inputrec.h
+// Records every input that reaches the game (-record_input <file>) and plays it back (-replay_input <file>)
+//  so that a play session can be repeated exactly, for benchmarking or for tracking down bugs.
+// Each input is stamped with the total cycles that cpu 0 has executed.  While recording or replaying, inputs
+//  only reach the game at the end of an emulated ms (see cpu_execute), so that the replay delivers each
+//  input at exactly the same cycle as the recording did.
+// The replay only stays in sync if the emulated machine doesn't depend on the host (for example on how long
+//  a VLDP search takes), so each input also records a CRC of cpu 0's memory; the replay warns if it doesn't match.
+
+#ifndef INPUTREC_H
+#define INPUTREC_H
+
+#include <SDL.h>	// for Uint definitions
+
+// starts recording inputs to 'filename' (call before the game starts)
+bool inputrec_start_recording(const char *filename);
+
+// starts replaying inputs from 'filename' (call before the game starts)
+// When the replay reaches the point where the recording was stopped, it prints how long it took and quits.
+bool inputrec_start_replay(const char *filename);
+
+// returns true if we are recording or replaying
+bool inputrec_is_active();
+
+// Called by input_enable/input_disable before they act on 'move'.
+// Returns true if the input has been taken care of (it will reach the game later if we're recording,
+//  and live input is ignored if we're replaying).
+bool inputrec_capture(bool bEnabled, Uint8 move);
+
+// same as inputrec_capture, but for mouse motion
+bool inputrec_capture_mouse(Uint16 x, Uint16 y, Sint16 xrel, Sint16 yrel);
+
+// Called by cpu_execute at the end of every emulated ms, delivers any inputs that are due.
+void inputrec_think();
+
+// Called by cpu_execute when it's done.  Finishes the recording or prints the replay results.
+void inputrec_shutdown();
+
+#endif // INPUTREC_H
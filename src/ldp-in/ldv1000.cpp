@@ -47,6 +47,7 @@
 #include "../io/conout.h"
 #include "../io/numstr.h"
 #include "../ldp-out/ldp.h"
+#include "../game/snapshot.h"
 #ifdef DEBUG
 #include <assert.h>
 #endif
@@ -143,6 +144,11 @@ unsigned char read_ldv1000()
 	return(result);
 }
 
+bool ldv1000_read_is_status()
+{
+	return (g_ldv1000_output_stack_pointer < 1) && (!g_ldv1000_search_pending) && ((g_ldv1000_output & 0x7F) != 0x54);
+}
+
 // pushes a value on the ldv1000 stack, returns 1 if successful or 0 if stack is full
 int ldv1000_stack_push(unsigned char value)
 {
@@ -719,3 +725,60 @@ void print_ldv1000_info()
 	printline(s.c_str());
 }
 
+// bump this whenever the layout of what ldv1000_save_state saves changes
+#define LDV1000_STATE_VERSION	1
+
+void ldv1000_save_state(struct snapshot *snap)
+{
+	unsigned int uSection = snapshot_begin_section(snap, "LDV1", LDV1000_STATE_VERSION);
+	Uint32 u32StackPointer = g_ldv1000_output_stack_pointer;
+	Uint32 u32LastEvent = g_ldv1000_last_event;
+
+	snapshot_put(snap, g_ldv1000_output_stack, sizeof(g_ldv1000_output_stack));
+	snapshot_put(snap, &u32StackPointer, sizeof(u32StackPointer));
+	snapshot_put(snap, &g_ldv1000_autostop_frame, sizeof(g_ldv1000_autostop_frame));
+	snapshot_put(snap, &audio1, sizeof(audio1));
+	snapshot_put(snap, &audio2, sizeof(audio2));
+	snapshot_put(snap, &audio_temp_mute, sizeof(audio_temp_mute));
+	snapshot_put(snap, ldv1000_frame, sizeof(ldv1000_frame));
+	snapshot_put(snap, &g_ldv1000_output, sizeof(g_ldv1000_output));
+	snapshot_put(snap, &g_ldv1000_search_pending, sizeof(g_ldv1000_search_pending));
+	snapshot_put(snap, &g_ldv1000_search_begin_cycles, sizeof(g_ldv1000_search_begin_cycles));
+	snapshot_put(snap, &u32LastEvent, sizeof(u32LastEvent));
+
+	snapshot_end_section(snap, uSection);
+}
+
+bool ldv1000_load_state(struct snapshot *snap)
+{
+	Uint32 u32StackPointer = 0;
+	Uint32 u32LastEvent = 0;
+
+	if (!snapshot_open_section(snap, "LDV1", LDV1000_STATE_VERSION))
+	{
+		return false;
+	}
+
+	snapshot_get(snap, g_ldv1000_output_stack, sizeof(g_ldv1000_output_stack));
+	snapshot_get(snap, &u32StackPointer, sizeof(u32StackPointer));
+	snapshot_get(snap, &g_ldv1000_autostop_frame, sizeof(g_ldv1000_autostop_frame));
+	snapshot_get(snap, &audio1, sizeof(audio1));
+	snapshot_get(snap, &audio2, sizeof(audio2));
+	snapshot_get(snap, &audio_temp_mute, sizeof(audio_temp_mute));
+	snapshot_get(snap, ldv1000_frame, sizeof(ldv1000_frame));
+	snapshot_get(snap, &g_ldv1000_output, sizeof(g_ldv1000_output));
+	snapshot_get(snap, &g_ldv1000_search_pending, sizeof(g_ldv1000_search_pending));
+	snapshot_get(snap, &g_ldv1000_search_begin_cycles, sizeof(g_ldv1000_search_begin_cycles));
+	snapshot_get(snap, &u32LastEvent, sizeof(u32LastEvent));
+
+	// don't trust the stack pointer blindly since it indexes an array
+	if (u32StackPointer > LDV1000_STACKSIZE)
+	{
+		printline("ldv1000_load_state() : bad output stack pointer");
+		return false;
+	}
+	g_ldv1000_output_stack_pointer = (int) u32StackPointer;
+	g_ldv1000_last_event = u32LastEvent;
+
+	return snapshot_close_section(snap);
+}
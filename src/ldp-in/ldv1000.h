@@ -27,6 +27,11 @@
 #define LDV1000_H
 
 unsigned char read_ldv1000();
+
+// returns true if read_ldv1000 would just return the player's status without doing anything else
+// (nothing on the stack, no search in progress and no autostop, so the status can only change when the game
+//  sends the player a command or when the player thinks)
+bool ldv1000_read_is_status();
 void write_ldv1000 (unsigned char value);
 void pre_display_disable();
 void pre_display_enable();
@@ -51,4 +56,9 @@ void ldv1000_set_seconds_per_search(double d);
 // for the cpu debugger's benefit
 void print_ldv1000_info();
 
+// saves/restores the LD-V1000's state (see game/snapshot.h)
+struct snapshot;
+void ldv1000_save_state(struct snapshot *snap);
+bool ldv1000_load_state(struct snapshot *snap);
+
 #endif
@@ -30,7 +30,9 @@
 #endif
 
 #ifdef UNIX
-//#define TRY_MMAP 1	// NOTE : this seems to fail on read-only filesystems (such as NTFS mounted from linux)
+// map the audio files into memory instead of copying them into RAM
+// NOTE : mmap has been known to fail on some filesystems (such as NTFS mounted from linux), so we always fall back to reading
+#define AUDIO_MMAP 1
 #endif
 
 #include "../timer/timer.h"
@@ -57,13 +59,26 @@
 #include <tremor/ivorbisfile.h>
 #endif
 
-#ifdef TRY_MMAP
+#ifdef AUDIO_MMAP
 #include <sys/mman.h>
 #endif
 
 // how much uncompressed audio we deal with at a time
 #define AUDIO_BUF_CHUNK	4096
 
+// PCM cache file (-pcm_cache) stuff
+#define PCM_CACHE_EXT	".pcm"
+#define PCM_CACHE_VERSION	1
+
+// goes at the beginning of every .pcm file, followed by the raw decoded audio (16-bit stereo 44100 Hz, little endian)
+struct pcm_cache_header
+{
+	char magic[4];	// always "DPCM"
+	Uint32 version;	// PCM_CACHE_VERSION
+	Uint32 ogg_size;	// size of the .ogg file this was decoded from (so we can tell if the .ogg has changed)
+	Uint32 pcm_size;	// how many bytes of audio follow this header
+};
+
 // Macros to lock and unlock the mutex for the audio to make sure we aren't playing audio while
 // we are loading or seeking
 #define OGG_LOCK	SDL_mutexP(g_ogg_mutex)
@@ -81,12 +96,20 @@ OggVorbis_File s_ogg;
 Uint32 g_audio_filesize = 0;	// total size of the audio stream
 Uint32 g_audio_filepos = 0;	// the position in the file of our audio stream
 Uint8 *g_big_buf = NULL;	// holds entire Ogg stream in RAM :)
+bool g_big_buf_mapped = false;	// whether g_big_buf is mapped (true) or allocated with new (false)
+Uint8 *g_pcm_base = NULL;	// the .pcm cache file in memory (including the header), NULL if we aren't using one
+Uint32 g_pcm_base_size = 0;	// size of the .pcm cache file
+bool g_pcm_base_mapped = false;	// whether g_pcm_base is mapped (true) or allocated with new (false)
+Uint8 *g_pcm_data = NULL;	// the decoded audio inside of g_pcm_base, NULL if we are decoding the .ogg on the fly
+Uint32 g_pcm_size = 0;	// how many bytes of decoded audio g_pcm_data holds
+Uint32 g_pcm_pos = 0;	// our current position inside g_pcm_data (in bytes)
 bool g_audio_ready = false;	// whether audio is ready to be parsed
 bool g_audio_playing = false;	// whether the audio is to be playing or not
 Uint32 g_playing_timer = 0;	// the time at which we began playing audio
 Uint32 g_samples_played = 0;	// how many samples have played since we've been timing
 bool g_audio_left_muted = false;	// left audio channel enabled
 bool g_audio_right_muted = false;	// right audio channel enabled
+char g_small_buf[AUDIO_BUF_CHUNK] = { 0 };	// holds audio as it comes out of the decoder
 
 #ifdef AUDIO_DEBUG
 Uint64 g_u64CallbackByteCount = 0;
@@ -96,6 +119,58 @@ unsigned int g_uCallbackDbgTimer = 0;
 
 ///////////////////////////////////////////////////////////////////////////////////
 
+// gets the contents of an opened file into memory, either by mapping it or by reading it into RAM
+// if bCanCopy is false, we will only map the file (used for files that are too big to want in RAM)
+// bMapped gets set to whether the returned buffer was mapped (so audio_unmap_file knows how to get rid of it)
+// returns NULL on failure
+static Uint8 *audio_map_file(mpo_io *io, Uint32 uSize, bool bCanCopy, bool &bMapped)
+{
+	Uint8 *result = NULL;
+
+	bMapped = false;
+
+#ifdef AUDIO_MMAP
+	void *ptr = mmap(NULL, uSize, PROT_READ, MAP_SHARED, fileno(io->handle), 0);
+	if (ptr != MAP_FAILED)
+	{
+		result = (Uint8 *) ptr;
+		bMapped = true;
+	}
+	else
+	{
+		printline("ldp-vldp-audio : mmap failed, falling back to reading the file into RAM");
+	}
+#endif
+
+	if (!result && bCanCopy)
+	{
+		result = new unsigned char[uSize];
+		if (result)
+		{
+			mpo_read(result, uSize, NULL, io);	// read entire file into RAM
+		}
+		else
+		{
+			printline("ERROR : out of memory");
+		}
+	}
+
+	return result;
+}
+
+// gets rid of a buffer that came from audio_map_file
+static void audio_unmap_file(Uint8 *buf, Uint32 uSize, bool bMapped)
+{
+#ifdef AUDIO_MMAP
+	if (bMapped)
+	{
+		munmap(buf, uSize);
+		return;
+	}
+#endif
+	delete [] buf;
+}
+
 // resets mm states
 void mmreset()
 {
@@ -189,16 +264,10 @@ int mmclose (void *datasource)
 		printline("ldp-vldp-audio.cpp: datasource != g_bigbuf, this should never happen!");
 	}
 	
-#ifdef TRY_MMAP
-	printline("Unmapping audio stream from memory ...");
-	munmap(g_big_buf, g_audio_filesize);
-	datasource = NULL;
-#else
 	printline("Freeing memory used to store audio stream...");
-	//free(datasource);
-	delete [] g_big_buf;
+	audio_unmap_file(g_big_buf, g_audio_filesize, g_big_buf_mapped);
 	g_big_buf = NULL;
-#endif
+	g_big_buf_mapped = false;
 
 	mpo_close(g_pIOAudioHandle);
 	g_pIOAudioHandle = NULL;
@@ -368,9 +437,149 @@ void ldp_vldp::close_audio_stream()
 	g_audio_playing = false;
 	ov_clear(&s_ogg);
 
+	// if we were playing from a .pcm cache, get rid of it too
+	if (g_pcm_base)
+	{
+		audio_unmap_file(g_pcm_base, g_pcm_base_size, g_pcm_base_mapped);
+		g_pcm_base = NULL;
+		g_pcm_base_mapped = false;
+		g_pcm_data = NULL;
+		g_pcm_base_size = g_pcm_size = g_pcm_pos = 0;
+	}
+
 	OGG_UNLOCK;
 }
 
+// maps a .pcm cache file into memory (or reads it in, if it can't be mapped) so the audio callback can use it instead of decoding the .ogg
+// returns false if the file doesn't exist, can't be loaded, or doesn't go with the .ogg we have open
+bool ldp_vldp::open_pcm_cache(const string &strPCMPath)
+{
+	bool result = false;
+	mpo_io *io = mpo_open(strPCMPath.c_str(), MPO_OPEN_READONLY);
+
+	if (io)
+	{
+		// mapping is preferred since the cache can be hundreds of megs, but if we can't map it, reading it into RAM still saves us from decoding
+		if ((io->size >= sizeof(struct pcm_cache_header)) && (io->size <= 0xFFFFFFFF))
+		{
+			bool bMapped = false;
+			Uint32 uSize = static_cast<Uint32>(io->size);
+			Uint8 *base = audio_map_file(io, uSize, true, bMapped);
+
+			if (base)
+			{
+				const struct pcm_cache_header *header = (const struct pcm_cache_header *) base;
+
+				// make sure this cache file is complete and was made from the .ogg we have open
+				if ((memcmp(header->magic, "DPCM", 4) == 0) &&
+					(header->version == PCM_CACHE_VERSION) &&
+					(header->ogg_size == g_audio_filesize) &&
+					(header->pcm_size == uSize - sizeof(struct pcm_cache_header)))
+				{
+					g_pcm_base = base;
+					g_pcm_base_size = uSize;
+					g_pcm_base_mapped = bMapped;
+					g_pcm_data = base + sizeof(struct pcm_cache_header);
+					g_pcm_size = header->pcm_size;
+					g_pcm_pos = 0;
+					result = true;
+				}
+				else
+				{
+					printline("ldp-vldp-audio : PCM cache file is stale or incomplete, it will be rebuilt");
+					audio_unmap_file(base, uSize, bMapped);
+				}
+			}
+		}
+
+		// the mapping stays valid after the file is closed
+		mpo_close(io);
+	}
+
+	return result;
+}
+
+// decodes the entire .ogg that we have open into a .pcm cache file
+// this only has to be done once, after that the .pcm file gets mapped in directly
+// returns true on success
+bool ldp_vldp::create_pcm_cache(const string &strPCMPath)
+{
+	bool result = false;
+	struct pcm_cache_header header;
+	mpo_io *io = NULL;
+	string s = "Creating PCM cache file " + strPCMPath + " (this only happens once) ...";
+
+	printline(s.c_str());
+
+	io = mpo_open(strPCMPath.c_str(), MPO_OPEN_CREATE);
+	if (io)
+	{
+		bool bError = false;
+		Uint32 uPCMSize = 0;
+		long samples_read = 0;
+		int nop;
+
+		// write a blank header first so that if we get interrupted, the incomplete file won't be used
+		memset(&header, 0, sizeof(header));
+		bError = !mpo_write(&header, sizeof(header), NULL, io);
+
+		while (!bError)
+		{
+#ifndef GP2X
+			samples_read = ov_read(&s_ogg, &g_small_buf[0], AUDIO_BUF_CHUNK,0,2,1, &nop);
+#else
+			samples_read = ov_read(&s_ogg, &g_small_buf[0], AUDIO_BUF_CHUNK, &nop);
+#endif
+			// end of stream
+			if (samples_read == 0)
+			{
+				break;
+			}
+			// else if we got an error
+			else if (samples_read < 0)
+			{
+				printline("ldp-vldp-audio : problem decoding .ogg while creating PCM cache");
+				bError = true;
+			}
+			else
+			{
+				bError = !mpo_write(g_small_buf, samples_read, NULL, io);
+				uPCMSize += samples_read;
+			}
+		}
+
+		// now that we know how big it is, fill in the real header
+		if (!bError)
+		{
+			memcpy(header.magic, "DPCM", 4);
+			header.version = PCM_CACHE_VERSION;
+			header.ogg_size = g_audio_filesize;
+			header.pcm_size = uPCMSize;
+			bError = !(mpo_seek(0, MPO_SEEK_SET, io) && mpo_write(&header, sizeof(header), NULL, io));
+		}
+
+		mpo_close(io);
+
+		if (!bError)
+		{
+			result = true;
+		}
+		else
+		{
+			printline("ldp-vldp-audio : could not write PCM cache file");
+		}
+
+		// the .ogg decoder is at the end of the stream now, so rewind it
+		ov_pcm_seek(&s_ogg, 0);
+	}
+	else
+	{
+		printline("ldp-vldp-audio : could not create PCM cache file (is the directory read-only?)");
+	}
+
+	return result;
+}
+
 bool ldp_vldp::open_audio_stream(const string &strFilename)
 {
 	bool result = false;
@@ -397,23 +606,7 @@ bool ldp_vldp::open_audio_stream(const string &strFilename)
 	if (g_pIOAudioHandle)
 	{
 		g_audio_filesize = static_cast<unsigned int>(g_pIOAudioHandle->size & 0xFFFFFFFF);
-#ifdef TRY_MMAP
-		g_big_buf = (Uint8 *) mmap(NULL, g_audio_filesize, PROT_READ, MAP_PRIVATE, fileno(g_pIOAudioHandle->handle), 0);
-		if (!g_big_buf)
-		{
-			printline("ERROR : mmap failed");
-		}
-#else
-		g_big_buf = new unsigned char[g_audio_filesize];
-		if (g_big_buf)
-		{
-			mpo_read(g_big_buf, g_audio_filesize, NULL, g_pIOAudioHandle);	// read entire stream into RAM
-		}
-		else
-		{
-			printline("ERROR : out of memory");
-		}
-#endif
+		g_big_buf = audio_map_file(g_pIOAudioHandle, g_audio_filesize, true, g_big_buf_mapped);
 		if (g_big_buf)
 		{
 			int open_result = ov_open_callbacks(g_big_buf, &s_ogg, NULL, 0, mycallbacks);
@@ -429,6 +622,22 @@ bool ldp_vldp::open_audio_stream(const string &strFilename)
 				{
 					g_audio_ready = true;
 					result = true;
+
+					// if the user wants the audio pre-decoded, use the .pcm cache (creating it if necessary)
+					if (m_bPCMCache)
+					{
+						string strPCMPath = m_mpeg_path + strFilename;
+						strPCMPath.replace(strPCMPath.length()-4, 4, PCM_CACHE_EXT);	// .ogg -> .pcm
+
+						if (!open_pcm_cache(strPCMPath))
+						{
+							// if we can't use a cache file, we'll just decode the .ogg on the fly like normal
+							if (!(create_pcm_cache(strPCMPath) && open_pcm_cache(strPCMPath)))
+							{
+								printline("ldp-vldp-audio : PCM cache is unavailable, decoding .ogg on the fly instead");
+							}
+						}
+					}
 				}
 				else
 				{
@@ -460,12 +669,9 @@ bool ldp_vldp::open_audio_stream(const string &strFilename)
 			// if we have memory allocated, de-allocate it
 			if (g_big_buf)
 			{
-#ifdef TRY_MMAP
-				munmap(g_big_buf, g_audio_filesize);
-#else
-				delete [] g_big_buf;
-#endif
+				audio_unmap_file(g_big_buf, g_audio_filesize, g_big_buf_mapped);
 				g_big_buf = NULL;
+				g_big_buf_mapped = false;
 			}
 		}
 			
@@ -494,7 +700,15 @@ bool ldp_vldp::seek_audio(Uint64 u64Samples)
 
 	OGG_LOCK;	// can't have audio callback running during this
 
-	if (ov_seekable(&s_ogg))
+	// if we have a PCM cache, seeking is just a matter of moving our position
+	if (g_pcm_data)
+	{
+		Uint64 u64Pos = u64Samples * AUDIO_BYTES_PER_SAMPLE;
+		g_pcm_pos = (u64Pos < g_pcm_size) ? (Uint32) u64Pos : g_pcm_size;
+		g_audio_playing = false;	// audio should not be playing immediately after a seek
+		result = true;
+	}
+	else if (ov_seekable(&s_ogg))
 	{
 		ov_pcm_seek(&s_ogg, u64Samples);
 		g_audio_playing = false;	// audio should not be playing immediately after a seek
@@ -530,7 +744,6 @@ void ldp_vldp::audio_pause()
 
 ////////////////////////////////////////////////////////////////////////////////////////
 
-char g_small_buf[AUDIO_BUF_CHUNK] = { 0 };
 Uint8 g_leftover_buf[AUDIO_BUF_CHUNK] = { 0 };
 int g_leftover_samples = 0;
 
@@ -586,6 +799,30 @@ void ldp_vldp_audio_callback(Uint8 *stream, int len, int unused)
 				}
 			}
 
+			// if we have a PCM cache, the audio is already decoded so we just copy it straight out
+			if (g_pcm_data)
+			{
+				// fill in whatever the leftover samples didn't
+				bytes_to_read = len - samples_copied;
+				if (bytes_to_read > (g_pcm_size - g_pcm_pos))
+				{
+					bytes_to_read = g_pcm_size - g_pcm_pos;
+				}
+
+				paudiocopy(stream + samples_copied, g_pcm_data + g_pcm_pos, bytes_to_read);
+				g_pcm_pos += bytes_to_read;
+				samples_copied += bytes_to_read;
+
+				// if we ran out of audio, fill the rest with silence
+				if (samples_copied < len)
+				{
+					memset(stream + samples_copied, 0, len - samples_copied);
+					samples_copied = len;
+					printline("End of audio stream detected!");
+					g_audio_playing = false;
+				}
+			}
+
 			while (samples_copied < len)
 			{
 #ifndef GP2X
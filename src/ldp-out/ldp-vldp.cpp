@@ -50,6 +50,7 @@
 #include "../io/mpo_mem.h"
 #include "../io/numstr.h"	// for debug
 #include "../io/network.h"	// to query amount of RAM the system has (get_sys_mem)
+#include "../io/cmdline.h"	// for get_next_word
 #include "../game/game.h"
 #include "../video/rgb2yuv.h"
 #include "ldp-vldp.h"
@@ -61,7 +62,7 @@
 #include "../video/SDL_DrawText.h"
 #include "../video/blend.h"
 
-#define API_VERSION 11
+#define API_VERSION 19
 
 static const unsigned int FREQ1000 = AUDIO_FREQ * 1000;	// let compiler compute this ...
 
@@ -131,6 +132,11 @@ ldp_vldp::ldp_vldp()
 
 	m_bPreCache = m_bPreCacheForce = false;
 	m_mPreCachedFiles.clear();
+	m_bPCMCache = false;
+	m_uFrameCacheSize = 8;	// this costs about 4 megs for a 720x480 mpeg, which is a small price to pay for faster repeat searches
+	m_uSliceThreads = 1;	// decode slices one at a time unless the user asks for more
+	m_uDecodeAhead = 0;	// decode each frame right before it's shown unless the user asks for a queue
+	m_uLowRes = 0;	// decode the video full size unless the user asks for it smaller
 
 	m_uSoundChipID = 0;
 
@@ -195,7 +201,18 @@ bool ldp_vldp::init_player()
 					g_local_info.render_blank_frame = blank_overlay;
 					g_local_info.blank_during_searches = m_blank_on_searches;
 					g_local_info.blank_during_skips = m_blank_on_skips;
-					g_local_info.GetTicksFunc = GetTicksFunc;
+					g_local_info.uFrameCacheSize = m_uFrameCacheSize;
+					g_local_info.uSliceThreads = m_uSliceThreads;
+					g_local_info.uDecodeAhead = m_uDecodeAhead;
+					// the video overlay has to match the mpeg's resolution, so shrinking the mpeg would make us lose the overlay
+					if (m_uLowRes && g_game->get_active_video_overlay())
+					{
+						printline("NOTE : -vldp_lowres can't be used with games that have a video overlay, so the video will be decoded at full size");
+						m_uLowRes = 0;
+					}
+					g_local_info.uLowRes = m_uLowRes;
+					// VLDP only uses this for its command timeouts, which must be in host time even in turbo mode
+					g_local_info.GetTicksFunc = GetRealTicksFunc;
 
 #ifdef USE_OPENGL
 					// if we're using openGL, then we have a different set of callbacks ...
@@ -346,6 +363,31 @@ void ldp_vldp::shutdown_player()
 	// if VLDP has been loaded
 	if (g_vldp_info)
 	{
+		// let the user know how quickly VLDP was responding to our commands (helps track down seek latency)
+		if (g_vldp_info->uCmdCount != 0)
+		{
+			string s = "VLDP acknowledged " + numstr::ToStr(g_vldp_info->uCmdCount) + " commands, average latency " +
+				numstr::ToStr(g_vldp_info->uCmdLatencyTotalMs / g_vldp_info->uCmdCount) + " ms, worst " +
+				numstr::ToStr(g_vldp_info->uCmdLatencyMaxMs) + " ms";
+			printline(s.c_str());
+		}
+
+		// acknowledging a search only means VLDP has started on it, so report how long they took to finish too
+		if (g_vldp_info->uSeekCount != 0)
+		{
+			string s = "VLDP finished " + numstr::ToStr(g_vldp_info->uSeekCount) + " searches/skips, average latency " +
+				numstr::ToStr(g_vldp_info->uSeekLatencyTotalMs / g_vldp_info->uSeekCount) + " ms, worst " +
+				numstr::ToStr(g_vldp_info->uSeekLatencyMaxMs) + " ms";
+			printline(s.c_str());
+		}
+
+		// and how often frames weren't decoded in time, so the user can tell whether the decode-ahead queue is big enough
+		if (m_uDecodeAhead != 0)
+		{
+			string s = "VLDP's decode-ahead queue ran dry " + numstr::ToStr(g_vldp_info->uDecodeAheadUnderruns) + " times";
+			printline(s.c_str());
+		}
+
 		g_vldp_info->shutdown();
 		g_vldp_info = NULL;
 	}
@@ -416,6 +458,36 @@ bool ldp_vldp::precache_and_block(const string &strFilename)
 	return bResult;
 }
 
+bool ldp_vldp::build_indexes_and_block(const vector<string> &vFullPaths)
+{
+	bool bResult = false;
+
+	// VLDP refers to this list until it's finished, which is fine because we wait for it below
+	vector<const char *> vNames;
+	for (vector<string>::const_iterator vi = vFullPaths.begin(); vi != vFullPaths.end(); vi++)
+	{
+		vNames.push_back(vi->c_str());
+	}
+
+	// nothing to do
+	if (vNames.empty())
+	{
+		return true;
+	}
+
+	// during parsing, blitting is allowed (see open_and_block)
+	blitting_allowed = true;
+
+	if (g_vldp_info->build_indexes(&vNames[0], (unsigned int) vNames.size()))
+	{
+		bResult = wait_for_status(STAT_STOPPED);
+	}
+
+	blitting_allowed = false;
+
+	return bResult;
+}
+
 bool ldp_vldp::wait_for_status(unsigned int uStatus)
 {
 	bool bResult = false;
@@ -786,6 +858,11 @@ void ldp_vldp::think()
 	// (m_uBlockedMsSincePlay is only non-zero when we've used blocking seeking)
 	g_local_info.uMsTimer = m_uElapsedMsSincePlay + m_uBlockedMsSincePlay;
 
+	// let VLDP know right away in case it's waiting to display a frame
+	if (g_vldp_info)
+	{
+		g_vldp_info->ms_timer_changed();
+	}
 }
 
 #ifdef DEBUG
@@ -1117,6 +1194,55 @@ void ldp_vldp::run_tests(list<string> &lstrPassed, list<string> &lstrFailed)
 	else lstrFailed.push_back("VLDP TESTS (Framefile had no entries)");
 }
 
+// reads the next word from the command line into 'uResult', which must be a plain number no bigger than 'uMax'
+// If it isn't, this complains about 'arg' and returns false ('uResult' is left alone).
+// If bClamp is true, a number that is too big is accepted as 'uMax' instead (with a note to the user).
+static bool get_next_uint_arg(const char *arg, unsigned int uMax, unsigned int &uResult, bool bClamp = false)
+{
+	bool result = false;
+	char s[81] = { 0 };
+	unsigned int u = 0;
+
+	get_next_word(s, sizeof(s));
+
+	// atoi would happily accept things like "foo" or "-3", so check every character ourselves
+	// (once the number is too big we stop adding digits so that it can't wrap around)
+	result = (s[0] != 0);
+	for (unsigned int i = 0; result && (s[i] != 0); i++)
+	{
+		if ((s[i] >= '0') && (s[i] <= '9'))
+		{
+			if (u <= uMax)
+			{
+				u = (u * 10) + (s[i] - '0');
+			}
+		}
+		else
+		{
+			result = false;
+		}
+	}
+
+	if (result && (u <= uMax))
+	{
+		uResult = u;
+	}
+	else if (result && bClamp)
+	{
+		string strMsg = string(arg) + " can't be more than " + numstr::ToStr(uMax) + ", so " + numstr::ToStr(uMax) + " will be used instead";
+		printline(strMsg.c_str());
+		uResult = uMax;
+	}
+	else
+	{
+		string strMsg = string(arg) + " requires a number from 0 to " + numstr::ToStr(uMax) + " after it. Instead, found: " + s;
+		printline(strMsg.c_str());
+		result = false;
+	}
+
+	return result;
+}
+
 // handles VLDP-specific command line args
 bool ldp_vldp::handle_cmdline_arg(const char *arg)
 {
@@ -1146,6 +1272,44 @@ bool ldp_vldp::handle_cmdline_arg(const char *arg)
 		m_bPreCache = true;
 		m_bPreCacheForce = true;
 	}
+	// should we decode the audio ahead of time (to a .pcm file next to the .ogg) so that playback doesn't need to decode?
+	else if (strcasecmp(arg, "-pcm_cache")==0)
+	{
+		m_bPCMCache = true;
+	}
+	// how many searched-to frames should VLDP keep decoded in memory? (0 to disable)
+	else if (strcasecmp(arg, "-vldp_frame_cache")==0)
+	{
+		result = get_next_uint_arg(arg, VLDP_FRAME_CACHE_MAX, m_uFrameCacheSize);
+	}
+	// how many threads should VLDP decode each picture's slices on? (1 to decode them one at a time)
+	else if (strcasecmp(arg, "-vldp_threads")==0)
+	{
+		result = get_next_uint_arg(arg, VLDP_SLICE_THREADS_MAX, m_uSliceThreads);
+	}
+	// how many frames should VLDP decode ahead of the one being shown? (0 to decode each one right before it's shown)
+	else if (strcasecmp(arg, "-vldp_decode_ahead")==0)
+	{
+		result = get_next_uint_arg(arg, VLDP_DECODE_AHEAD_MAX, m_uDecodeAhead, true);
+	}
+	// should VLDP decode the video at half (1) or a quarter (2) of its size? (for small screens, ignored by games with a video overlay)
+	else if (strcasecmp(arg, "-vldp_lowres")==0)
+	{
+		char s[81] = { 0 };
+		get_next_word(s, sizeof(s));
+
+		// only full size (0), half (1) and a quarter (2) are supported
+		if ((s[0] >= '0') && (s[0] <= '2') && (s[1] == 0))
+		{
+			m_uLowRes = (unsigned int) (s[0] - '0');
+		}
+		else
+		{
+			outstr("-vldp_lowres requires 0, 1 or 2 after it. Instead, found: ");
+			printline(s);
+			result = false;
+		}
+	}
 	
 	// else it's unknown
 	else
@@ -1352,7 +1516,21 @@ bool ldp_vldp::last_video_file_parsed()
 void ldp_vldp::parse_all_video()
 {
 	unsigned int i = 0;
+	vector<string> vFullPaths;
 
+	// parse all of the files at once first (this is a lot faster than parsing them one at a time)
+	for (i = 0; i < m_file_index; i++)
+	{
+		vFullPaths.push_back(m_mpeg_path + m_mpeginfo[i].name);
+	}
+
+	// if this fails, the loop below will find out which file is the problem
+	if (!build_indexes_and_block(vFullPaths))
+	{
+		printline("LDP-VLDP: Could not parse all video files at once, parsing them one at a time instead");
+	}
+
+	// now open each file to make sure it's good (this is quick since they have all been parsed)
 	for (i = 0; i < m_file_index; i++)
 	{
 		// if the file can be opened...
@@ -1738,13 +1916,13 @@ int prepare_frame_callback_with_overlay(struct yuv_buf *src)
 #endif
 			
 			unsigned int row = 0;
-			unsigned int col = 0;
 			Uint32 w_double = g_hw_overlay->w << 1;	// twice the overlay width, to avoid calculating this more than once
 			Uint32 h_half = g_hw_overlay->h >> 1;	// half of the overlay height, to avoid calculating this more than once
 			Uint8 *dst_ptr;
 			
-			// this could be global, any benefit?
-			t_yuv_color* yuv_palette = get_yuv_palette();
+			// the palette pre-packed into YUY2 pixel pairs, plus which colors are transparent
+			const Uint32 *yuy2_palette = get_yuy2_palette();
+			const Uint32 *yuy2_opaque = get_yuy2_opaque_mask();
 			
 			unsigned int channel0_pitch = g_hw_overlay->pitches[0];	// this val gets used a lot so we put it into a var
 			
@@ -1769,61 +1947,17 @@ int prepare_frame_callback_with_overlay(struct yuv_buf *src)
 				// calculate this here to avoid calculating too often
 				int adjusted_row = ((int) row) - g_vertical_offset;
 				bool row_in_range = ((adjusted_row >= 0) && (adjusted_row < gamevid->h));
-				t_yuv_color *palette = NULL;
-				
-				// do 4 bytes at a time, for twice the width of the overlay since we're using YUY2
-				for (col = 0; col < w_double; col += 4)
-				{
-					// if we can safely draw from the video overlay
-					if (row_in_range) palette = &yuv_palette[*gamevid_pixels];
-					
-					// If we are out of range, OR if the current color is transparent,
-					//  then draw the mpeg video pixel instead of the video overlay
-					// (if palette is NULL, the compiler shouldn't try to dereference palette->transparent)
-					if ((palette == NULL) || palette->transparent)
-					{
-						unsigned int Y_chunk = *((Uint16 *) Y);
-						unsigned int Y2_chunk = *((Uint16 *) Y2);
-						unsigned int V_chunk = *V;
-						unsigned int U_chunk = *U;
-						
-#if SDL_BYTEORDER == SDL_LIL_ENDIAN
-						//Little-Endian (Intel)
-						*((Uint32 *) (g_line_buf + col)) = (Y_chunk & 0xFF) | (U_chunk << 8) |
-							((Y_chunk & 0xFF00) << 8) | (V_chunk << 24);
-						*((Uint32 *) (g_line_buf2 + col)) = (Y2_chunk & 0xFF) | (U_chunk << 8) |
-							((Y2_chunk & 0xFF00) << 8) | (V_chunk << 24);
-#else						
-						//Big-Endian (Mac)			
-						*((Uint32 *) (g_line_buf + col)) = ((Y_chunk & 0xFF00) << 16) | ((U_chunk) << 16) |
-							((Y_chunk & 0xFF) << 8) | (V_chunk);
-						*((Uint32 *) (g_line_buf2 + col)) = ((Y2_chunk & 0xFF00) << 16) | ((U_chunk) << 16) |
-							((Y2_chunk & 0xFF) << 8) | (V_chunk);												
-#endif
-					}
-					
-					// if we have an overlay pixel to be drawn
-					else
-					{
-#if SDL_BYTEORDER == SDL_LIL_ENDIAN							
-						//Little-Endian (Intel)
-						*((Uint32 *) (g_line_buf + col)) = 
-							*((Uint32 *) (g_line_buf2 + col)) = palette->y | (palette->u << 8)
-							| (palette->y << 16) | (palette->v << 24);						
-#else					
-						//Big-Endian (Mac)
-						*((Uint32 *) (g_line_buf + col)) = 
-							*((Uint32 *) (g_line_buf2 + col)) = (palette->y << 24) | (palette->u << 16)
-							| (palette->y << 8) | (palette->v);
-#endif
-						
-					}
-					Y += 2;
-					Y2 += 2;
-					U++;
-					V++;
-					gamevid_pixels++;
-				}
+
+				// Build both YUY2 lines at once, 4 bytes (one overlay pixel) at a time, for twice the width of the overlay.
+				// If we are out of range, the mpeg video is drawn without the overlay.
+				g_compose_func(g_line_buf, g_line_buf2, Y, Y2, U, V, row_in_range ? gamevid_pixels : NULL,
+					yuy2_palette, yuy2_opaque, w_double >> 2);
+
+				Y += w_double >> 1;
+				Y2 += w_double >> 1;
+				U += w_double >> 2;
+				V += w_double >> 2;
+				gamevid_pixels += w_double >> 2;
 				
 				// if we're not doing scanlines
 				if (!(g_filter_type & FILTER_SCANLINES))
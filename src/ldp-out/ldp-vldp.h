@@ -28,6 +28,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 
 using namespace std;
 
@@ -65,6 +66,9 @@ public:
 	// NOTE : open_and_block prepands m_mpeg_path to the filename
 	bool open_and_block(const string &strFilename);
 	bool precache_and_block(const string &strFilename);
+
+	// builds the frame index of every file in the list at the same time (names must already include m_mpeg_path)
+	bool build_indexes_and_block(const vector<string> &vFullPaths);
 	bool wait_for_status(unsigned int uStatus);
 	bool nonblocking_search(char *);
 	int get_search_result();
@@ -146,6 +150,11 @@ private:
 	bool m_testing;	// should we do a few simple tests to make sure VLDP is functioning robustly?
 	bool m_bPreCache;	// should we precache all video?
 	bool m_bPreCacheForce;	// should we still precache all video even if we don't have enough RAM?
+	bool m_bPCMCache;	// should we decode the .ogg audio once to a .pcm file and play from that instead?
+	unsigned int m_uFrameCacheSize;	// how many searched-to frames VLDP should keep around (0 = disabled)
+	unsigned int m_uSliceThreads;	// how many threads VLDP should decode slices on (1 = no extra threads)
+	unsigned int m_uDecodeAhead;	// how many frames VLDP may decode ahead of the one being shown (0 = disabled)
+	unsigned int m_uLowRes;	// how many times VLDP halves the size of the video it decodes (0 = full size)
 
 	unsigned int m_uSoundChipID;	// so we can delete the soundchip once we're finished
 
@@ -167,6 +176,8 @@ private:
 	void audio_shutdown();
 	void close_audio_stream();
 	bool open_audio_stream(const string &strFilename);
+	bool open_pcm_cache(const string &strPCMPath);
+	bool create_pcm_cache(const string &strPCMPath);
 	bool seek_audio(Uint64 u64Samples);
 	void audio_play(Uint32);
 	void audio_pause();
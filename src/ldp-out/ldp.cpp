@@ -44,6 +44,8 @@
 #include "framemod.h"
 #include "../game/game.h"
 #include "../game/boardinfo.h"
+#include "../game/snapshot.h"
+#include "../game/runahead.h"
 #include "../cpu/cpu.h"
 #include "../cpu/generic_z80.h"
 
@@ -66,6 +68,7 @@ ldp::ldp() :
 //	m_play_cycles(0),
 	m_play_time(0),
 	m_start_time(-1),	// set to something invalid to force us to call pre_init
+	m_u64StartTimeUs(0),
 	m_status(LDP_STOPPED),
 	search_latency(0),
 	m_stop_on_quit(false),
@@ -124,6 +127,7 @@ bool ldp::pre_init()
 	player_initialized = init_player();
 	result = temp && player_initialized;
 	m_start_time = GET_TICKS();
+	m_u64StartTimeUs = timer_get_real_us();
 	m_uElapsedMsSincePlay = 0;
 	m_uBlockedMsSincePlay = 0;
 	m_uElapsedMsSinceStart = 0;
@@ -188,6 +192,12 @@ bool ldp::pre_search(const char* pszFrame, bool block_until_search_finishes)
 	bool result = false;
 	char s1[81] = { 0 };
 
+	// a command can't be taken back, so it can't be given while the machine is being run ahead
+	if (runahead_block_ldp_command())
+	{
+		return false;
+	}
+
 	// safety check, if they try to search without checking the search result ...
 	if (m_status == LDP_SEARCHING)
 	{
@@ -373,6 +383,12 @@ bool ldp::pre_skip_forward(Uint16 frames_to_skip)
 {
 	bool result = false;
 
+	// a command can't be taken back, so it can't be given while the machine is being run ahead
+	if (runahead_block_ldp_command())
+	{
+		return false;
+	}
+
 	// only skip if the LDP is playing
 	if (m_status == LDP_PLAYING)
 	{
@@ -401,6 +417,12 @@ bool ldp::pre_skip_backward(Uint16 frames_to_skip)
 {
 	bool result = false;
 
+	// a command can't be taken back, so it can't be given while the machine is being run ahead
+	if (runahead_block_ldp_command())
+	{
+		return false;
+	}
+
 	// only skip if the LDP is playing
 	if (m_status == LDP_PLAYING)
 	{
@@ -498,6 +520,12 @@ void ldp::pre_play()
 {
 //	Uint32 cpu_hz;	// used to calculate elapsed cycles
 
+	// a command can't be taken back, so it can't be given while the machine is being run ahead
+	if (runahead_block_ldp_command())
+	{
+		return;
+	}
+
 	// safety check, if they try to play without checking the search result ...
 	// THIS SAFETY CHECK CAN BE REMOVED ONCE ALL LDP DRIVERS HAVE BEEN CONVERTED OVER TO NON-BLOCKING SEEKING
 	if (m_status == LDP_SEARCHING)
@@ -557,6 +585,12 @@ unsigned int ldp::play()
 // prepares to pause
 void ldp::pre_pause()
 {
+	// a command can't be taken back, so it can't be given while the machine is being run ahead
+	if (runahead_block_ldp_command())
+	{
+		return;
+	}
+
 	// only send pause command if disc is playing
 	// some games (Super Don) repeatedly flood with a pause command and this doesn't work well with the Hitachi
 	if (m_status == LDP_PLAYING)
@@ -588,6 +622,12 @@ void ldp::pause()
 // the player has to spin up again to begin playing
 void ldp::pre_stop()
 {
+	// a command can't be taken back, so it can't be given while the machine is being run ahead
+	if (runahead_block_ldp_command())
+	{
+		return;
+	}
+
 	m_last_seeked_frame = m_uCurrentFrame = 0;
 	stop();
 	m_status = LDP_STOPPED;
@@ -603,6 +643,12 @@ bool ldp::pre_change_speed(unsigned int uNumerator, unsigned int uDenominator)
 {
 	string strMsg;
 
+	// a command can't be taken back, so it can't be given while the machine is being run ahead
+	if (runahead_block_ldp_command())
+	{
+		return false;
+	}
+
 	// if this is >= 1X
 	if (uDenominator == 1)
 	{
@@ -683,20 +729,23 @@ void ldp::think_delay(unsigned int uMsDelay)
 	{
 		pre_think();
 
-		unsigned int uElapsedMs = elapsed_ms_time(m_start_time);
-
-		// if we're ahead of where we need to be, then it's ok to stall ...
-		if (uElapsedMs < m_uElapsedMsSinceStart)
+		// in turbo mode, there is no reason to sleep, we just declare that the time has passed
+		if (timer_is_virtual())
 		{
-			/*
-			string msg = "uElapsedMs is " + numstr::ToStr(uElapsedMs) + " and m_uElapsedMssinceStart is " +
-				numstr::ToStr(m_uElapsedMsSinceStart);
-			printline(msg.c_str());	// REMOVE ME
-			*/
+			unsigned int uElapsedMs = elapsed_ms_time(m_start_time);
 
-			MAKE_DELAY(1);
+			// if we're ahead of where we need to be, then it's ok to stall ...
+			if (uElapsedMs < m_uElapsedMsSinceStart)
+			{
+				timer_advance_virtual(1);
+			}
+		}
+		// if we're ahead of where we need to be, stall until the host clock catches up
+		// (this returns right away if we're caught up or behind, so we just loop so we can make sure we're caught up)
+		else
+		{
+			timer_sleep_until_us(m_u64StartTimeUs + (((Uint64) m_uElapsedMsSinceStart) * 1000));
 		}
-		// otherwise we're caught up or behind, so just loop so we can make sure we're caught up
 	}
 }
 
@@ -826,7 +875,11 @@ void ldp::pre_think()
 	}
 	// otherwise the disc is idle, so we need not change the current frame
 
-	think();	// call implementation-specific function
+	// the player itself must not find out about time that passes while the machine is being run ahead
+	if (!runahead_is_speculating())
+	{
+		think();	// call implementation-specific function
+	}
 
 	// If vblank was asserted, let game know about it...
 	// NOTE : this should probably come at the end of this function
@@ -1127,6 +1180,189 @@ void ldp::setVerbose(bool thisBol)
 	m_bVerbose = thisBol;
 }
 
+// bump this whenever the layout of what ldp::save_state saves changes
+#define LDP_STATE_VERSION	1
+
+bool ldp::save_state(struct snapshot *snap)
+{
+	// we can't save in the middle of a search because there's no way to restore one
+	if (m_status == LDP_SEARCHING)
+	{
+		return false;
+	}
+
+	unsigned int uSection = snapshot_begin_section(snap, "LDP ", LDP_STATE_VERSION);
+	Sint32 iStatus = m_status;
+
+	snapshot_put(snap, &iStatus, sizeof(iStatus));
+	snapshot_put(snap, &m_uCurrentFrame, sizeof(m_uCurrentFrame));
+	snapshot_put(snap, &m_uElapsedMsSinceStart, sizeof(m_uElapsedMsSinceStart));
+	snapshot_put(snap, &m_uVblankCount, sizeof(m_uVblankCount));
+	snapshot_put(snap, &m_uVblankMiniCount, sizeof(m_uVblankMiniCount));
+	snapshot_put(snap, &m_uMsVblankBoundary, sizeof(m_uMsVblankBoundary));
+	snapshot_put(snap, &m_uFramesToSkipPerFrame, sizeof(m_uFramesToSkipPerFrame));
+	snapshot_put(snap, &m_uFramesToStallPerFrame, sizeof(m_uFramesToStallPerFrame));
+	snapshot_put(snap, &m_uStallFrames, sizeof(m_uStallFrames));
+
+	snapshot_end_section(snap, uSection);
+	return true;
+}
+
+bool ldp::load_state(struct snapshot *snap)
+{
+	Sint32 iStatus = LDP_STOPPED;
+	unsigned int uFrame = 0, uElapsedMsSinceStart = 0, uVblankCount = 0, uVblankMiniCount = 0, uMsVblankBoundary = 0;
+	bool result = true;
+
+	if (!snapshot_open_section(snap, "LDP ", LDP_STATE_VERSION))
+	{
+		return false;
+	}
+
+	snapshot_get(snap, &iStatus, sizeof(iStatus));
+	snapshot_get(snap, &uFrame, sizeof(uFrame));
+	snapshot_get(snap, &uElapsedMsSinceStart, sizeof(uElapsedMsSinceStart));
+	snapshot_get(snap, &uVblankCount, sizeof(uVblankCount));
+	snapshot_get(snap, &uVblankMiniCount, sizeof(uVblankMiniCount));
+	snapshot_get(snap, &uMsVblankBoundary, sizeof(uMsVblankBoundary));
+	snapshot_get(snap, &m_uFramesToSkipPerFrame, sizeof(m_uFramesToSkipPerFrame));
+	snapshot_get(snap, &m_uFramesToStallPerFrame, sizeof(m_uFramesToStallPerFrame));
+	snapshot_get(snap, &m_uStallFrames, sizeof(m_uStallFrames));
+
+	if (!snapshot_close_section(snap))
+	{
+		return false;
+	}
+
+	// if the disc was spinning, get it back to where it was
+	if ((iStatus == LDP_PLAYING) || (iStatus == LDP_PAUSED))
+	{
+		char frame[FRAME_ARRAY_SIZE] = { 0 };
+		int ldp_stat = LDP_SEARCHING;
+
+		// The saved frame has already been through frame conversion, so we can't go through pre_search.
+		framenum_to_frame((Uint16) uFrame, frame);
+		m_last_try_frame = (Uint16) uFrame;
+		m_status = LDP_SEARCHING;
+		result = nonblocking_search(frame);
+		m_dont_get_search_result = false;
+
+		if (result)
+		{
+			unsigned int cur_time = refresh_ms_time();
+
+			// same as a blocking search in pre_search
+			cpu_pause();
+			while (elapsed_ms_time(cur_time) < 7000)
+			{
+				ldp_stat = get_status();
+				if (ldp_stat != LDP_SEARCHING)
+				{
+					break;
+				}
+				MAKE_DELAY(1);
+				think();
+			}
+			cpu_unpause();
+		}
+
+		if (ldp_stat != LDP_PAUSED)
+		{
+			printline("ldp::load_state() : could not search to the saved frame");
+			m_status = LDP_ERROR;
+			return false;
+		}
+
+		// The frame timing restarts from here, so the frame may change up to 1 frame early or late compared
+		//  to the saved machine (the game has to cope with this much on real hardware anyway).
+		if (iStatus == LDP_PLAYING)
+		{
+			pre_play();
+		}
+	}
+	else
+	{
+		m_last_seeked_frame = (Uint16) uFrame;
+		m_uCurrentFrame = uFrame;
+		m_status = iStatus;
+	}
+
+	// vblank timing drives the game's interrupts, so it has to continue exactly where it left off
+	m_uElapsedMsSinceStart = uElapsedMsSinceStart;
+	m_uVblankCount = uVblankCount;
+	m_uVblankMiniCount = uVblankMiniCount;
+	m_uMsVblankBoundary = uMsVblankBoundary;
+
+	return result;
+}
+
+// bump this whenever the layout of what ldp::save_counters saves changes
+#define LDP_COUNTERS_VERSION	1
+
+bool ldp::save_counters(struct snapshot *snap)
+{
+	// the search result would have to be taken back too
+	if (m_status == LDP_SEARCHING)
+	{
+		return false;
+	}
+
+	unsigned int uSection = snapshot_begin_section(snap, "LDPC", LDP_COUNTERS_VERSION);
+	Sint32 iStatus = m_status;
+
+	snapshot_put(snap, &iStatus, sizeof(iStatus));
+	snapshot_put(snap, &m_last_try_frame, sizeof(m_last_try_frame));
+	snapshot_put(snap, &m_last_seeked_frame, sizeof(m_last_seeked_frame));
+	snapshot_put(snap, &m_uCurrentFrame, sizeof(m_uCurrentFrame));
+	snapshot_put(snap, &m_uCurrentOffsetFrame, sizeof(m_uCurrentOffsetFrame));
+	snapshot_put(snap, &m_uElapsedMsSincePlay, sizeof(m_uElapsedMsSincePlay));
+	snapshot_put(snap, &m_uBlockedMsSincePlay, sizeof(m_uBlockedMsSincePlay));
+	snapshot_put(snap, &m_bWaitingForVblankToPlay, sizeof(m_bWaitingForVblankToPlay));
+	snapshot_put(snap, &m_iSkipOffsetSincePlay, sizeof(m_iSkipOffsetSincePlay));
+	snapshot_put(snap, &m_uMsFrameBoundary, sizeof(m_uMsFrameBoundary));
+	snapshot_put(snap, &m_uElapsedMsSinceStart, sizeof(m_uElapsedMsSinceStart));
+	snapshot_put(snap, &m_uVblankCount, sizeof(m_uVblankCount));
+	snapshot_put(snap, &m_uVblankMiniCount, sizeof(m_uVblankMiniCount));
+	snapshot_put(snap, &m_uMsVblankBoundary, sizeof(m_uMsVblankBoundary));
+	snapshot_put(snap, &m_uFramesToSkipPerFrame, sizeof(m_uFramesToSkipPerFrame));
+	snapshot_put(snap, &m_uFramesToStallPerFrame, sizeof(m_uFramesToStallPerFrame));
+	snapshot_put(snap, &m_uStallFrames, sizeof(m_uStallFrames));
+
+	snapshot_end_section(snap, uSection);
+	return true;
+}
+
+bool ldp::load_counters(struct snapshot *snap)
+{
+	Sint32 iStatus = LDP_STOPPED;
+
+	if (!snapshot_open_section(snap, "LDPC", LDP_COUNTERS_VERSION))
+	{
+		return false;
+	}
+
+	snapshot_get(snap, &iStatus, sizeof(iStatus));
+	snapshot_get(snap, &m_last_try_frame, sizeof(m_last_try_frame));
+	snapshot_get(snap, &m_last_seeked_frame, sizeof(m_last_seeked_frame));
+	snapshot_get(snap, &m_uCurrentFrame, sizeof(m_uCurrentFrame));
+	snapshot_get(snap, &m_uCurrentOffsetFrame, sizeof(m_uCurrentOffsetFrame));
+	snapshot_get(snap, &m_uElapsedMsSincePlay, sizeof(m_uElapsedMsSincePlay));
+	snapshot_get(snap, &m_uBlockedMsSincePlay, sizeof(m_uBlockedMsSincePlay));
+	snapshot_get(snap, &m_bWaitingForVblankToPlay, sizeof(m_bWaitingForVblankToPlay));
+	snapshot_get(snap, &m_iSkipOffsetSincePlay, sizeof(m_iSkipOffsetSincePlay));
+	snapshot_get(snap, &m_uMsFrameBoundary, sizeof(m_uMsFrameBoundary));
+	snapshot_get(snap, &m_uElapsedMsSinceStart, sizeof(m_uElapsedMsSinceStart));
+	snapshot_get(snap, &m_uVblankCount, sizeof(m_uVblankCount));
+	snapshot_get(snap, &m_uVblankMiniCount, sizeof(m_uVblankMiniCount));
+	snapshot_get(snap, &m_uMsVblankBoundary, sizeof(m_uMsVblankBoundary));
+	snapshot_get(snap, &m_uFramesToSkipPerFrame, sizeof(m_uFramesToSkipPerFrame));
+	snapshot_get(snap, &m_uFramesToStallPerFrame, sizeof(m_uFramesToStallPerFrame));
+	snapshot_get(snap, &m_uStallFrames, sizeof(m_uStallFrames));
+	m_status = iStatus;
+
+	return snapshot_close_section(snap);
+}
+
 //////////////////
 
 bool fast_noldp::nonblocking_search(char *new_frame)
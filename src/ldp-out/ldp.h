@@ -54,6 +54,8 @@ using namespace std;
 // the size to make your frame array (the frame + the NULL terminator)
 #define FRAME_ARRAY_SIZE FRAME_SIZE + 1
 
+struct snapshot;	// see game/snapshot.h
+
 class ldp
 {
 public:
@@ -223,6 +225,18 @@ public:
 
 	void setVerbose(bool); // rdg2010
 
+	// Saves/restores where the disc is and the vblank timing (see game/snapshot.h).
+	// Saving fails if the player is in the middle of a search.
+	// Loading has to search to the saved frame, so it blocks until the search completes.
+	bool save_state(struct snapshot *snap);
+	bool load_state(struct snapshot *snap);
+
+	// Saves/restores only the counters that pre_think changes, without touching the player itself
+	//  (for run-ahead, see game/runahead.h, which never lets the player get a command while it's running ahead).
+	// Saving fails if the player is in the middle of a search.
+	bool save_counters(struct snapshot *snap);
+	bool load_counters(struct snapshot *snap);
+
 protected:
 	// helper function, shouldn't be called directly
 	void increment_current_frame();
@@ -241,6 +255,7 @@ protected:
 //	Uint64 m_play_cycles;	// # of elapsed cpu cycles from when we last issued a play command
 	Uint32 m_play_time;	// current time when we last issued a play command
 	unsigned int m_start_time;	// time when ldp() class was instantiated (only used when not using a cpu)
+	Uint64 m_u64StartTimeUs;	// same as m_start_time but in microseconds of host time (see think_delay)
 	int m_status;	// the current status of the laserdisc player
 	Uint32 search_latency;	// how many ms to stall before searching (to simulate slow laserdisc players)
 	bool m_stop_on_quit;	// should the LDP stop when it quits?
@@ -380,3 +380,15 @@ void gisound_shutdown(int index)
 	delete g_gi_chips[index];
 	g_gi_chips[index] = NULL;
 }
+
+// the chip is plain data, so its state is just a copy of it
+unsigned int gisound_getstate(void *buf, int index)
+{
+	memcpy(buf, g_gi_chips[index], sizeof(gi_sound_chip));
+	return sizeof(gi_sound_chip);
+}
+
+void gisound_setstate(const void *buf, int index)
+{
+	memcpy(g_gi_chips[index], buf, sizeof(gi_sound_chip));
+}
@@ -27,6 +27,8 @@ int gisound_initialize(Uint32 core_frequency);
 void gisound_writedata(Uint32, Uint32, int index);
 void gisound_stream(Uint8* stream, int length, int index);
 void gisound_shutdown(int index);
+unsigned int gisound_getstate(void *buf, int index);
+void gisound_setstate(const void *buf, int index);
 
 enum {
    CHANNEL_A_TONE_PERIOD_FINE,
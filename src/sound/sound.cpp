@@ -35,6 +35,8 @@
 #include "SDL_audio.h"
 
 #include "sound.h"
+#include "../game/snapshot.h"
+#include "../game/runahead.h"
 #include "sn_intf.h"
 #include "pc_beeper.h"
 #include "gisound.h"
@@ -252,7 +254,8 @@ bool sound_play(Uint32 whichone)
 	bool result = false;
 	
 	// only play a sound if sound has been initialized (and if whichone points to a valid wav)
-	if (is_sound_enabled() && (whichone < MAX_NUM_SOUNDS))
+	// (and not while the machine is being run ahead, because the sound would play again when the frame really happens)
+	if (is_sound_enabled() && (whichone < MAX_NUM_SOUNDS) && !runahead_is_speculating())
 	{
 		samples_play_sample(g_samples[whichone].pu8Buf, g_samples[whichone].uLength, g_samples[whichone].uChannels);
 		result = true;
@@ -267,7 +270,7 @@ bool sound_play_saveme()
 {
 	bool result = false;
 	
-	if (is_sound_enabled())
+	if (is_sound_enabled() && !runahead_is_speculating())
 	{
 		samples_play_sample(g_sample_saveme.pu8Buf, g_sample_saveme.uLength);
 		result = true;
@@ -430,6 +433,8 @@ unsigned int add_soundchip(struct sounddef *candidate)
 	cur->stream_callback = NULL;
 	cur->writedata_callback = NULL;
 	cur->write_ctrl_data_callback = NULL;
+	cur->getstate_callback = NULL;
+	cur->setstate_callback = NULL;
 
 	memset(cur->buffer, 0, g_uSoundChipBufSize);
 	
@@ -458,6 +463,8 @@ unsigned int add_soundchip(struct sounddef *candidate)
 		cur->shutdown_callback = gisound_shutdown;
 		cur->write_ctrl_data_callback = gisound_writedata;
 		cur->stream_callback = gisound_stream;
+		cur->getstate_callback = gisound_getstate;
+		cur->setstate_callback = gisound_setstate;
 		break;
 	case SOUNDCHIP_PC_BEEPER:	// used by DL2/SA91
 		cur->bNeedsConstantUpdates = true;	// for now we'll have it this way
@@ -912,3 +919,71 @@ void update_soundbuffer()
 		UNLOCK_AUDIO();
 	}
 }
+
+// bump this whenever the layout of what sound_save_state saves changes
+#define SOUND_STATE_VERSION	1
+
+bool sound_save_state(struct snapshot *snap)
+{
+	unsigned int uSection = snapshot_begin_section(snap, "SND ", SOUND_STATE_VERSION);
+	Uint8 state[MAX_SOUNDCHIP_STATE_SIZE];
+
+	// the audio callback must not run while we're looking at the chips
+	LOCK_AUDIO();
+	for (struct sounddef *cur = g_soundchip_head; cur; cur = cur->next_soundchip)
+	{
+		Sint32 iType = cur->type;
+		Uint32 uSize = 0;
+
+		// the chips only exist if sound was initialized
+		if (g_sound_initialized && cur->getstate_callback)
+		{
+			uSize = cur->getstate_callback(state, cur->internal_id);
+		}
+		snapshot_put(snap, &iType, sizeof(iType));
+		snapshot_put(snap, &uSize, sizeof(uSize));
+		snapshot_put(snap, state, uSize);
+	}
+	UNLOCK_AUDIO();
+
+	snapshot_end_section(snap, uSection);
+	return true;
+}
+
+bool sound_load_state(struct snapshot *snap)
+{
+	bool bSuccess = true;
+	Uint8 state[MAX_SOUNDCHIP_STATE_SIZE];
+
+	if (!snapshot_open_section(snap, "SND ", SOUND_STATE_VERSION))
+	{
+		return false;
+	}
+
+	LOCK_AUDIO();
+	for (struct sounddef *cur = g_soundchip_head; cur && bSuccess; cur = cur->next_soundchip)
+	{
+		Sint32 iType = 0;
+		Uint32 uSize = 0, uExpectedSize = 0;
+
+		if (g_sound_initialized && cur->getstate_callback)
+		{
+			uExpectedSize = cur->getstate_callback(state, cur->internal_id);
+		}
+
+		snapshot_get(snap, &iType, sizeof(iType));
+		snapshot_get(snap, &uSize, sizeof(uSize));
+		if ((iType != cur->type) || (uSize != uExpectedSize))
+		{
+			printline("sound_load_state() : snapshot has different sound chips");
+			bSuccess = false;
+		}
+		else if (snapshot_get(snap, state, uSize) && (uSize != 0))
+		{
+			cur->setstate_callback(state, cur->internal_id);
+		}
+	}
+	UNLOCK_AUDIO();
+
+	return bSuccess && snapshot_close_section(snap);
+}
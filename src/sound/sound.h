@@ -52,6 +52,9 @@
 // This is true even for big-endian platforms
 #define AUDIO_FORMAT AUDIO_S16LSB
 
+// the most bytes that a sound chip's getstate_callback can return
+#define MAX_SOUNDCHIP_STATE_SIZE 512
+
 // how many audio bytes needed to fill 1 millisecond of space
 static const unsigned int G_1MS_BUF_SIZE = (AUDIO_FREQ * AUDIO_BYTES_PER_SAMPLE) / 1000;
 
@@ -112,6 +115,12 @@ struct sounddef
 
 	void (*stream_callback)(Uint8* stream, int length, int internal_id); // callback to write stream to buffer
 
+	// optional callbacks to save/restore the sound chip's state (see game/snapshot.h)
+	// getstate_callback copies the state into 'buf' and returns its size (which must not exceed MAX_SOUNDCHIP_STATE_SIZE)
+	// Sound chips that don't define these are assumed to have no state worth saving (such as samples or VLDP).
+	unsigned int (*getstate_callback)(void *buf, int internal_id);
+	void (*setstate_callback)(const void *buf, int internal_id);
+
 	// *** THIS SECTION IS DEFINED WHEN SOUND CHIP IS ADDED
 	int type;	// type of sound chip (See enum's)
 	Uint32 hz;	// speed of sound chip in Hz
@@ -197,4 +206,9 @@ bool is_sound_enabled();
 // (re)calculates the right-shift value to be used to mix sounds (for fast division)
 void sound_recalc_rshift();
 
+// saves/restores the state of every sound chip (see game/snapshot.h)
+struct snapshot;
+bool sound_save_state(struct snapshot *snap);
+bool sound_load_state(struct snapshot *snap);
+
 #endif
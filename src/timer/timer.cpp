@@ -27,6 +27,15 @@
 
 #include "timer.h"
 
+#if defined(WIN32) && !defined(_XBOX)
+#include <windows.h>	// for QueryPerformanceCounter
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#include <time.h>	// for nanosleep
+#elif !defined(_XBOX)
+#include <time.h>	// for clock_gettime and nanosleep
+#endif
+
 // returns the elapsed time (in milliseconds) since the current
 // time and previous_time (which is also in milliseconds)
 unsigned int elapsed_ms_time(unsigned int previous_time)
@@ -39,6 +48,121 @@ unsigned int GetTicksFunc()
 	return GET_TICKS();
 }
 
+unsigned int GetRealTicksFunc()
+{
+	return GET_REAL_TICKS();
+}
+
+bool g_bVirtualTimer = false;
+volatile unsigned int g_uVirtualTicks = 0;
+
+void timer_set_virtual(bool bEnabled)
+{
+	// if we are switching the virtual timer on, start it where the host clock is so that
+	//  any timestamps taken before this point are still meaningful
+	if (bEnabled && !g_bVirtualTimer)
+	{
+		g_uVirtualTicks = GET_REAL_TICKS();
+	}
+	g_bVirtualTimer = bEnabled;
+}
+
+void timer_advance_virtual(unsigned int uMs)
+{
+	if (g_bVirtualTimer)
+	{
+		g_uVirtualTicks += uMs;
+	}
+}
+
+void timer_make_delay(unsigned int uMs)
+{
+	MAKE_REAL_DELAY(uMs);
+
+	// NOTE : only the main thread should call MAKE_DELAY while the virtual timer is enabled
+	timer_advance_virtual(uMs);
+}
+
+Uint64 timer_get_real_ns()
+{
+#if defined(WIN32) && !defined(_XBOX)
+	static LARGE_INTEGER s_freq = { 0 };
+	LARGE_INTEGER count;
+
+	if (s_freq.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&s_freq);
+	}
+	QueryPerformanceCounter(&count);
+
+	// split it up so that the multiply can't overflow
+	Uint64 u64Secs = count.QuadPart / s_freq.QuadPart;
+	Uint64 u64Rem = count.QuadPart % s_freq.QuadPart;
+	return (u64Secs * 1000000000) + ((u64Rem * 1000000000) / s_freq.QuadPart);
+#elif defined(__APPLE__)
+	static mach_timebase_info_data_t s_timebase = { 0, 0 };
+
+	if (s_timebase.denom == 0)
+	{
+		mach_timebase_info(&s_timebase);
+	}
+	return (mach_absolute_time() * s_timebase.numer) / s_timebase.denom;
+#elif !defined(_XBOX)
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (((Uint64) ts.tv_sec) * 1000000000) + ts.tv_nsec;
+#else
+	// no better clock available
+	return ((Uint64) GET_REAL_TICKS()) * 1000000;
+#endif
+}
+
+Uint64 timer_get_real_us()
+{
+	return timer_get_real_ns() / 1000;
+}
+
+static unsigned int g_uSleepSlackUs = TIMER_DEFAULT_SLEEP_SLACK_US;
+
+void timer_set_sleep_slack_us(unsigned int uSlackUs)
+{
+	g_uSleepSlackUs = uSlackUs;
+}
+
+void timer_sleep_until_us(Uint64 u64DeadlineUs)
+{
+	Uint64 u64NowUs = timer_get_real_us();
+
+	// sleep until we're within the slack of the deadline
+	while ((u64NowUs < u64DeadlineUs) && ((u64DeadlineUs - u64NowUs) > g_uSleepSlackUs))
+	{
+		Uint64 u64SleepUs = (u64DeadlineUs - u64NowUs) - g_uSleepSlackUs;
+
+#if !defined(WIN32) && !defined(_XBOX)
+		struct timespec ts;
+		ts.tv_sec = (time_t) (u64SleepUs / 1000000);
+		ts.tv_nsec = (long) ((u64SleepUs % 1000000) * 1000);
+		nanosleep(&ts, NULL);
+#else
+		// can only sleep in whole ms here
+		if (u64SleepUs < 1000)
+		{
+			break;
+		}
+		MAKE_REAL_DELAY((Uint32) (u64SleepUs / 1000));
+#endif
+
+		u64NowUs = timer_get_real_us();
+	}
+
+	// and busy-wait the rest of the way
+	while (u64NowUs < u64DeadlineUs)
+	{
+		u64NowUs = timer_get_real_us();
+	}
+}
+
 #ifdef GP2X
 unsigned int g_uLastTicks = 0;
 unsigned int g_uExtraMs = 0;
@@ -30,8 +30,8 @@
 
 #ifndef GP2X
 // not GP2X code ...
-#define GET_TICKS SDL_GetTicks
-#define MAKE_DELAY SDL_Delay
+#define GET_REAL_TICKS SDL_GetTicks
+#define MAKE_REAL_DELAY SDL_Delay
 #else
 
 // GP2X CODE HERE
@@ -42,15 +42,79 @@ unsigned int SDL_GP2X_GetMiniTicks();
 }
 
 unsigned int GP2X_GetTicks(unsigned int uMiniTicks);
-#define GET_TICKS(dummy) GP2X_GetTicks(SDL_GP2X_GetMiniTicks())
-#define MAKE_DELAY SDL_Delay
+#define GET_REAL_TICKS(dummy) GP2X_GetTicks(SDL_GP2X_GetMiniTicks())
+#define MAKE_REAL_DELAY SDL_Delay
 #endif // GP2X
 
+// VIRTUAL TIMER (used by turbo mode)
+// When the virtual timer is enabled, GET_TICKS no longer reflects the host clock.
+// Instead it returns a millisecond counter that only moves forward when the emulator
+//  says it should (once per emulated millisecond by cpu_execute, or by MAKE_DELAY).
+// This lets the cpu, the ldp and vldp all agree on how much time has passed while
+//  the emulator runs as fast as the host allows.
+extern bool g_bVirtualTimer;
+extern volatile unsigned int g_uVirtualTicks;
+
+inline unsigned int timer_get_ticks()
+{
+	if (!g_bVirtualTimer)
+	{
+		return GET_REAL_TICKS();
+	}
+	return g_uVirtualTicks;
+}
+
+// enables/disables the virtual timer (it starts where the host clock currently is)
+void timer_set_virtual(bool bEnabled);
+
+inline bool timer_is_virtual()
+{
+	return g_bVirtualTimer;
+}
+
+// moves the virtual timer forward by uMs milliseconds (does nothing if virtual timer is disabled)
+void timer_advance_virtual(unsigned int uMs);
+
+// sleeps for uMs milliseconds of host time.
+// If the virtual timer is enabled, it also advances the virtual timer by the same amount so that
+//  loops that wait for time to elapse (with a timeout) still terminate.
+void timer_make_delay(unsigned int uMs);
+
+#define GET_TICKS timer_get_ticks
+#define MAKE_DELAY timer_make_delay
+
 unsigned int elapsed_ms_time(unsigned int previous_time);
 
 // wrapper function to refer to GET_TICKS macro (in case the macro does not do a single function call!)
 unsigned int GetTicksFunc();
 
+// wrapper function that always returns host time, even if the virtual timer is enabled.
+// (for timeouts that are waiting on another thread to do some real work)
+unsigned int GetRealTicksFunc();
+
+// HIGH RESOLUTION TIMER
+// GET_TICKS only counts whole milliseconds and MAKE_DELAY(1) routinely sleeps for longer than 1 ms, which makes
+//  anything that paces itself with them run in bursts.  These functions use the host's monotonic clock instead
+//  (they always return host time, even if the virtual timer is enabled).
+// Only the difference between two values is meaningful.
+Uint64 timer_get_real_us();
+Uint64 timer_get_real_ns();
+
+// how far ahead of its deadline (in microseconds) timer_sleep_until_us stops sleeping and starts busy-waiting.
+// Host sleeps are only accurate to within a scheduler tick, which is coarser on windows.
+#ifdef WIN32
+#define TIMER_DEFAULT_SLEEP_SLACK_US 2000
+#else
+#define TIMER_DEFAULT_SLEEP_SLACK_US 200
+#endif
+
+// changes the slack used by timer_sleep_until_us (0 means never busy-wait)
+void timer_set_sleep_slack_us(unsigned int uSlackUs);
+
+// Waits until timer_get_real_us() reaches u64DeadlineUs (returns right away if it already has).
+// It sleeps until it is within the slack of the deadline, then busy-waits the rest of the way.
+void timer_sleep_until_us(Uint64 u64DeadlineUs);
+
 // legacy functions
 #define refresh_ms_time GET_TICKS
 #define make_delay MAKE_DELAY
@@ -28,6 +28,18 @@
 #include <assert.h>
 #endif
 
+// the SIMD compositing versions need gcc (for the target attribute and cpu detection)
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define COMPOSE_X86
+#include <immintrin.h>
+#endif
+
+// NEON is either there or not at compile time, so there's no need for detection
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && (SDL_BYTEORDER == SDL_LIL_ENDIAN)
+#define COMPOSE_NEON
+#include <arm_neon.h>
+#endif
+
 // if we aren't using the MMX version
 
 #ifndef USE_MMX
@@ -66,3 +78,311 @@ void debug_blend_mmx()
 #endif // DEBUG
 
 #endif // NATIVE_CPU_X86
+
+/////////////////////////////
+
+void compose_yuy2_c(Uint8 *dst1, Uint8 *dst2, const Uint8 *Y1, const Uint8 *Y2, const Uint8 *U, const Uint8 *V,
+					const Uint8 *overlay, const Uint32 *palette, const Uint32 *opaque, unsigned int uPairs)
+{
+	Uint32 *out1 = (Uint32 *) dst1;
+	Uint32 *out2 = (Uint32 *) dst2;
+
+	for (unsigned int i = 0; i < uPairs; i++)
+	{
+		// if we have an overlay pixel to be drawn
+		if (overlay && opaque[overlay[i]])
+		{
+			out1[i] = out2[i] = palette[overlay[i]];
+		}
+
+		// else draw the mpeg video pixel
+		else
+		{
+			unsigned int U_chunk = U[i];
+			unsigned int V_chunk = V[i];
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+			//Little-Endian (Intel)
+			out1[i] = Y1[i << 1] | (U_chunk << 8) | (Y1[(i << 1) + 1] << 16) | (V_chunk << 24);
+			out2[i] = Y2[i << 1] | (U_chunk << 8) | (Y2[(i << 1) + 1] << 16) | (V_chunk << 24);
+#else
+			//Big-Endian (Mac)
+			out1[i] = (Y1[i << 1] << 24) | (U_chunk << 16) | (Y1[(i << 1) + 1] << 8) | V_chunk;
+			out2[i] = (Y2[i << 1] << 24) | (U_chunk << 16) | (Y2[(i << 1) + 1] << 8) | V_chunk;
+#endif
+		}
+	}
+}
+
+#if defined(COMPOSE_X86) || defined(COMPOSE_NEON)
+// Looks up 'uCount' overlay pixels in the palette so the SIMD versions can blend them all at once.
+// Returns 0 if every one of them is transparent (which is most of the time for most games).
+static inline Uint32 compose_lookup(const Uint8 *overlay, const Uint32 *palette, const Uint32 *opaque,
+									Uint32 *pColors, Uint32 *pMask, unsigned int uCount)
+{
+	Uint32 uAny = 0;
+
+	for (unsigned int i = 0; i < uCount; i++)
+	{
+		Uint8 u8Color = overlay[i];
+		pColors[i] = palette[u8Color];
+		pMask[i] = opaque[u8Color];
+		uAny |= pMask[i];
+	}
+
+	return uAny;
+}
+#endif
+
+#ifdef COMPOSE_X86
+
+// does 16 pixel pairs at a time
+__attribute__((target("sse2")))
+static void compose_yuy2_sse2(Uint8 *dst1, Uint8 *dst2, const Uint8 *Y1, const Uint8 *Y2, const Uint8 *U, const Uint8 *V,
+							  const Uint8 *overlay, const Uint32 *palette, const Uint32 *opaque, unsigned int uPairs)
+{
+	unsigned int i = 0;
+
+	for (; (i + 16) <= uPairs; i += 16)
+	{
+		Uint32 uColors[16], uMask[16];
+		__m128i line1[4], line2[4];
+
+		// interleave U and V, then interleave Y with that to get Y U Y V
+		__m128i u = _mm_loadu_si128((const __m128i *) (U + i));
+		__m128i v = _mm_loadu_si128((const __m128i *) (V + i));
+		__m128i uv_lo = _mm_unpacklo_epi8(u, v);
+		__m128i uv_hi = _mm_unpackhi_epi8(u, v);
+		__m128i ya = _mm_loadu_si128((const __m128i *) (Y1 + (i << 1)));
+		__m128i yb = _mm_loadu_si128((const __m128i *) (Y1 + (i << 1) + 16));
+
+		line1[0] = _mm_unpacklo_epi8(ya, uv_lo);
+		line1[1] = _mm_unpackhi_epi8(ya, uv_lo);
+		line1[2] = _mm_unpacklo_epi8(yb, uv_hi);
+		line1[3] = _mm_unpackhi_epi8(yb, uv_hi);
+
+		ya = _mm_loadu_si128((const __m128i *) (Y2 + (i << 1)));
+		yb = _mm_loadu_si128((const __m128i *) (Y2 + (i << 1) + 16));
+		line2[0] = _mm_unpacklo_epi8(ya, uv_lo);
+		line2[1] = _mm_unpackhi_epi8(ya, uv_lo);
+		line2[2] = _mm_unpacklo_epi8(yb, uv_hi);
+		line2[3] = _mm_unpackhi_epi8(yb, uv_hi);
+
+		// if any overlay pixels are showing, blend them in using the transparency mask
+		if (overlay && compose_lookup(overlay + i, palette, opaque, uColors, uMask, 16))
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				__m128i m = _mm_loadu_si128((const __m128i *) (uMask + (j << 2)));
+				__m128i c = _mm_and_si128(m, _mm_loadu_si128((const __m128i *) (uColors + (j << 2))));
+				line1[j] = _mm_or_si128(c, _mm_andnot_si128(m, line1[j]));
+				line2[j] = _mm_or_si128(c, _mm_andnot_si128(m, line2[j]));
+			}
+		}
+
+		for (int j = 0; j < 4; j++)
+		{
+			_mm_storeu_si128((__m128i *) (dst1 + (i << 2) + (j << 4)), line1[j]);
+			_mm_storeu_si128((__m128i *) (dst2 + (i << 2) + (j << 4)), line2[j]);
+		}
+	}
+
+	// do whatever is left over the slow way
+	if (i < uPairs)
+	{
+		compose_yuy2_c(dst1 + (i << 2), dst2 + (i << 2), Y1 + (i << 1), Y2 + (i << 1), U + i, V + i,
+			overlay ? (overlay + i) : NULL, palette, opaque, uPairs - i);
+	}
+}
+
+// does 32 pixel pairs at a time
+// (the AVX2 unpack instructions work on each 128-bit half separately, so the inputs are shuffled
+//  first to make the output come out in order)
+__attribute__((target("avx2")))
+static void compose_yuy2_avx2(Uint8 *dst1, Uint8 *dst2, const Uint8 *Y1, const Uint8 *Y2, const Uint8 *U, const Uint8 *V,
+							  const Uint8 *overlay, const Uint32 *palette, const Uint32 *opaque, unsigned int uPairs)
+{
+	unsigned int i = 0;
+
+	for (; (i + 32) <= uPairs; i += 32)
+	{
+		Uint32 uColors[32], uMask[32];
+		__m256i line1[4], line2[4];
+
+		__m256i u = _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i *) (U + i)), 0xD8);
+		__m256i v = _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i *) (V + i)), 0xD8);
+		__m256i uv_lo = _mm256_permute4x64_epi64(_mm256_unpacklo_epi8(u, v), 0xD8);
+		__m256i uv_hi = _mm256_permute4x64_epi64(_mm256_unpackhi_epi8(u, v), 0xD8);
+		__m256i ya = _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i *) (Y1 + (i << 1))), 0xD8);
+		__m256i yb = _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i *) (Y1 + (i << 1) + 32)), 0xD8);
+
+		line1[0] = _mm256_unpacklo_epi8(ya, uv_lo);
+		line1[1] = _mm256_unpackhi_epi8(ya, uv_lo);
+		line1[2] = _mm256_unpacklo_epi8(yb, uv_hi);
+		line1[3] = _mm256_unpackhi_epi8(yb, uv_hi);
+
+		ya = _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i *) (Y2 + (i << 1))), 0xD8);
+		yb = _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i *) (Y2 + (i << 1) + 32)), 0xD8);
+		line2[0] = _mm256_unpacklo_epi8(ya, uv_lo);
+		line2[1] = _mm256_unpackhi_epi8(ya, uv_lo);
+		line2[2] = _mm256_unpacklo_epi8(yb, uv_hi);
+		line2[3] = _mm256_unpackhi_epi8(yb, uv_hi);
+
+		if (overlay && compose_lookup(overlay + i, palette, opaque, uColors, uMask, 32))
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				__m256i m = _mm256_loadu_si256((const __m256i *) (uMask + (j << 3)));
+				__m256i c = _mm256_loadu_si256((const __m256i *) (uColors + (j << 3)));
+				line1[j] = _mm256_blendv_epi8(line1[j], c, m);
+				line2[j] = _mm256_blendv_epi8(line2[j], c, m);
+			}
+		}
+
+		for (int j = 0; j < 4; j++)
+		{
+			_mm256_storeu_si256((__m256i *) (dst1 + (i << 2) + (j << 5)), line1[j]);
+			_mm256_storeu_si256((__m256i *) (dst2 + (i << 2) + (j << 5)), line2[j]);
+		}
+	}
+
+	// the SSE2 version takes care of whatever is left over
+	if (i < uPairs)
+	{
+		compose_yuy2_sse2(dst1 + (i << 2), dst2 + (i << 2), Y1 + (i << 1), Y2 + (i << 1), U + i, V + i,
+			overlay ? (overlay + i) : NULL, palette, opaque, uPairs - i);
+	}
+}
+
+#endif // COMPOSE_X86
+
+#ifdef COMPOSE_NEON
+
+// does 16 pixel pairs at a time (vst4 does the Y U Y V interleaving for us)
+static void compose_yuy2_neon(Uint8 *dst1, Uint8 *dst2, const Uint8 *Y1, const Uint8 *Y2, const Uint8 *U, const Uint8 *V,
+							  const Uint8 *overlay, const Uint32 *palette, const Uint32 *opaque, unsigned int uPairs)
+{
+	unsigned int i = 0;
+
+	for (; (i + 16) <= uPairs; i += 16)
+	{
+		Uint32 uColors[16], uMask[16];
+		uint8x16x2_t y;
+		uint8x16x4_t yuyv;
+		Uint8 *out1 = dst1 + (i << 2);
+		Uint8 *out2 = dst2 + (i << 2);
+
+		yuyv.val[1] = vld1q_u8(U + i);
+		yuyv.val[3] = vld1q_u8(V + i);
+
+		y = vld2q_u8(Y1 + (i << 1));	// splits Y into even and odd pixels
+		yuyv.val[0] = y.val[0];
+		yuyv.val[2] = y.val[1];
+		vst4q_u8(out1, yuyv);
+
+		y = vld2q_u8(Y2 + (i << 1));
+		yuyv.val[0] = y.val[0];
+		yuyv.val[2] = y.val[1];
+		vst4q_u8(out2, yuyv);
+
+		if (overlay && compose_lookup(overlay + i, palette, opaque, uColors, uMask, 16))
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				uint8x16_t m = vreinterpretq_u8_u32(vld1q_u32(uMask + (j << 2)));
+				uint8x16_t c = vreinterpretq_u8_u32(vld1q_u32(uColors + (j << 2)));
+				vst1q_u8(out1 + (j << 4), vbslq_u8(m, c, vld1q_u8(out1 + (j << 4))));
+				vst1q_u8(out2 + (j << 4), vbslq_u8(m, c, vld1q_u8(out2 + (j << 4))));
+			}
+		}
+	}
+
+	if (i < uPairs)
+	{
+		compose_yuy2_c(dst1 + (i << 2), dst2 + (i << 2), Y1 + (i << 1), Y2 + (i << 1), U + i, V + i,
+			overlay ? (overlay + i) : NULL, palette, opaque, uPairs - i);
+	}
+}
+
+#endif // COMPOSE_NEON
+
+struct compose_kernel
+{
+	compose_func_t func;
+	const char *name;
+};
+
+// every version that this cpu can run, slowest first
+static struct compose_kernel g_compose_kernels[4];
+static unsigned int g_compose_kernel_count = 0;
+
+static void compose_init()
+{
+	g_compose_kernels[0].func = compose_yuy2_c;
+	g_compose_kernels[0].name = "C";
+	g_compose_kernel_count = 1;
+
+#ifdef COMPOSE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+	{
+		g_compose_kernels[g_compose_kernel_count].func = compose_yuy2_sse2;
+		g_compose_kernels[g_compose_kernel_count].name = "SSE2";
+		g_compose_kernel_count++;
+
+		// the AVX2 version relies on the SSE2 version for leftovers
+		if (__builtin_cpu_supports("avx2"))
+		{
+			g_compose_kernels[g_compose_kernel_count].func = compose_yuy2_avx2;
+			g_compose_kernels[g_compose_kernel_count].name = "AVX2";
+			g_compose_kernel_count++;
+		}
+	}
+#endif // COMPOSE_X86
+
+#ifdef COMPOSE_NEON
+	g_compose_kernels[g_compose_kernel_count].func = compose_yuy2_neon;
+	g_compose_kernels[g_compose_kernel_count].name = "NEON";
+	g_compose_kernel_count++;
+#endif // COMPOSE_NEON
+
+	g_compose_func = g_compose_kernels[g_compose_kernel_count - 1].func;
+}
+
+// g_compose_func starts out pointing here so that the cpu gets checked the first time it's called
+static void compose_yuy2_first(Uint8 *dst1, Uint8 *dst2, const Uint8 *Y1, const Uint8 *Y2, const Uint8 *U, const Uint8 *V,
+							   const Uint8 *overlay, const Uint32 *palette, const Uint32 *opaque, unsigned int uPairs)
+{
+	compose_init();
+	g_compose_func(dst1, dst2, Y1, Y2, U, V, overlay, palette, opaque, uPairs);
+}
+
+compose_func_t g_compose_func = compose_yuy2_first;
+
+const char *compose_get_name()
+{
+	if (g_compose_kernel_count == 0)
+	{
+		compose_init();
+	}
+
+	return g_compose_kernels[g_compose_kernel_count - 1].name;
+}
+
+bool compose_get_kernel(unsigned int uIdx, compose_func_t *pFunc, const char **ppszName)
+{
+	bool bResult = false;
+
+	if (g_compose_kernel_count == 0)
+	{
+		compose_init();
+	}
+
+	if (uIdx < g_compose_kernel_count)
+	{
+		*pFunc = g_compose_kernels[uIdx].func;
+		*ppszName = g_compose_kernels[uIdx].name;
+		bResult = true;
+	}
+
+	return bResult;
+}
@@ -89,4 +89,29 @@ extern Uint32 g_blend_iterations;
 
 /////////////////////////////
 
+// OVERLAY COMPOSITING
+// Builds two lines of YUY2 (for the VLDP overlay) out of two lines of mpeg video that share the same U/V line,
+//  drawing the game's 8-bit video overlay on top.  Each overlay pixel covers one YUY2 pixel pair.
+// 'overlay' may be NULL, in which case the video is copied without an overlay (used when the overlay
+//  has been scrolled off of this row).
+// 'palette' and 'opaque' are the tables from get_yuy2_palette() and get_yuy2_opaque_mask().
+// 'uPairs' is how many YUY2 pixel pairs (4 bytes each) go into each destination line.  It can be any value.
+typedef void (*compose_func_t)(Uint8 *dst1, Uint8 *dst2, const Uint8 *Y1, const Uint8 *Y2, const Uint8 *U, const Uint8 *V,
+							   const Uint8 *overlay, const Uint32 *palette, const Uint32 *opaque, unsigned int uPairs);
+
+// the reference version (we always want this defined for the purpose of testing, see releasetest.cpp)
+void compose_yuy2_c(Uint8 *dst1, Uint8 *dst2, const Uint8 *Y1, const Uint8 *Y2, const Uint8 *U, const Uint8 *V,
+					const Uint8 *overlay, const Uint32 *palette, const Uint32 *opaque, unsigned int uPairs);
+
+// The fastest version this cpu supports (SSE2/AVX2 on x86, NEON on ARM).
+// The first call figures out which one that is.
+extern compose_func_t g_compose_func;
+
+// returns the name of the version that g_compose_func uses (for logging)
+const char *compose_get_name();
+
+// Gets the 'uIdx'th version that this cpu supports (0 is always the C version).
+// Returns false if there aren't that many versions.  This is so releasetest can check each one against the C version.
+bool compose_get_kernel(unsigned int uIdx, compose_func_t *pFunc, const char **ppszName);
+
 #endif
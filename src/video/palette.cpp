@@ -20,6 +20,7 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <string.h>	// for memset
 #include "../game/game.h"
 #include "../io/conout.h" // for printline
 #include "palette.h"
@@ -39,8 +40,30 @@ Uint32 g_uRGBAPalette[256];
 
 t_yuv_color *g_yuv_palette = NULL;
 
+// each color as a YUY2 pixel pair, and whether it is drawn on top of the video (0xFFFFFFFF) or not (0)
+// (to make VLDP overlay compositing faster, see compose_yuy2_c)
+Uint32 g_uYUY2Palette[256];
+Uint32 g_uYUY2OpaqueMask[256];
+
 bool g_palette_modified = true;
 
+// goes up every time any color changes (so that anything that caches converted colors knows when to start over)
+unsigned int g_uPaletteVersion = 0;
+
+// keeps the YUY2 lookup tables in sync with g_yuv_palette
+static void palette_update_yuy2(unsigned int uColorIndex)
+{
+	const t_yuv_color *color = &g_yuv_palette[uColorIndex];
+
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+	g_uYUY2Palette[uColorIndex] = color->y | (color->u << 8) | (color->y << 16) | (color->v << 24);
+#else
+	g_uYUY2Palette[uColorIndex] = (color->y << 24) | (color->u << 16) | (color->y << 8) | color->v;
+#endif
+
+	g_uYUY2OpaqueMask[uColorIndex] = color->transparent ? 0 : 0xFFFFFFFF;
+}
+
 // call this function once to set size of game palette
 bool palette_initialize (unsigned int num_colors)
 {
@@ -69,6 +92,10 @@ bool palette_initialize (unsigned int num_colors)
 	}
 	else
 	{
+		// colors beyond the end of the palette shouldn't ever be used, but make them transparent to be safe
+		memset(g_uYUY2Palette, 0, sizeof(g_uYUY2Palette));
+		memset(g_uYUY2OpaqueMask, 0, sizeof(g_uYUY2OpaqueMask));
+
 		// set all colors to unmodified and black
 		for (unsigned int x = 0; x < g_palette_size; x++)
 		{
@@ -81,6 +108,7 @@ bool palette_initialize (unsigned int num_colors)
 			g_yuv_palette[x].y = 0;
 			g_yuv_palette[x].u = g_yuv_palette[x].v = 0x7F;
 			g_yuv_palette[x].transparent = false;
+			palette_update_yuy2(x);
 		}
 
 		// Default color #0 to be transparent
@@ -99,6 +127,8 @@ void palette_set_transparency(unsigned int uColorIndex, bool transparent)
 #endif
 
 	g_yuv_palette[uColorIndex].transparent = transparent;
+	palette_update_yuy2(uColorIndex);
+	g_uPaletteVersion++;
 
 	if (transparent)
 	{
@@ -133,6 +163,7 @@ void palette_set_color (unsigned int color_num, SDL_Color color_value)
 	{
 		g_rgb_palette[color_num] = color_value;
 		g_palette_modified = true;	
+		g_uPaletteVersion++;
 
 		// change R,G,B, values, but don't change A
 		g_uRGBAPalette[color_num] = (g_uRGBAPalette[color_num] & 0xFF000000) |
@@ -147,6 +178,7 @@ void palette_set_color (unsigned int color_num, SDL_Color color_value)
 		g_yuv_palette[color_num].y = rgb2yuv_result_y;
 		g_yuv_palette[color_num].v = rgb2yuv_result_v;
 		g_yuv_palette[color_num].u = rgb2yuv_result_u;
+		palette_update_yuy2(color_num);
 	}
 
 }
@@ -216,3 +248,18 @@ Uint32 *get_rgba_palette(void)
 {
 	return g_uRGBAPalette;
 }
+
+unsigned int palette_get_version(void)
+{
+	return g_uPaletteVersion;
+}
+
+Uint32 *get_yuy2_palette(void)
+{
+	return g_uYUY2Palette;
+}
+
+Uint32 *get_yuy2_opaque_mask(void)
+{
+	return g_uYUY2OpaqueMask;
+}
@@ -45,3 +45,11 @@ void palette_finalize ();
 void palette_shutdown (void);
 t_yuv_color *get_yuv_palette(void);
 Uint32 *get_rgba_palette(void);
+
+// returns a number that changes every time any color (or its transparency) changes
+unsigned int palette_get_version(void);
+
+// the palette as YUY2 pixel pairs, and a mask that is 0xFFFFFFFF for every color that isn't transparent
+// (these are always 256 entries long)
+Uint32 *get_yuy2_palette(void);
+Uint32 *get_yuy2_opaque_mask(void);
@@ -496,18 +496,28 @@ void vid_blank()
 }
 
 #ifdef USE_OPENGL
-// converts an SDL surface to an opengl texture
-void vid_srf2tex(SDL_Surface *srf, GLuint uTexID)
+// which surface size g_pVidTex/g_texture_id currently hold a complete copy of (0 if they don't)
+// vid_blit_rects uses this to find out whether it can get away with updating just part of the texture
+static int g_iTexSrfW = 0, g_iTexSrfH = 0;
+
+// converts the part of an SDL surface inside 'rect' to RGBA (in g_pVidTex)
+static void vid_srf2rgba(SDL_Surface *srf, const SDL_Rect *rect)
 {
-	Uint8 *ptrPixelRow = (Uint8 *) srf->pixels;
-	Uint32 *RGBARow = (Uint32 *) g_pVidTex;
+	unsigned int uEndRow = rect->y + rect->h;
+	unsigned int uEndCol = rect->x + rect->w;
+	Uint8 *ptrPixelRow = (Uint8 *) srf->pixels + (rect->y * srf->pitch) + (rect->x * srf->format->BytesPerPixel);
+	Uint32 *RGBARow = (Uint32 *) g_pVidTex + (rect->y * GL_TEX_SIZE) + rect->x;
 	Uint32 *g_puRGBAPalette = get_rgba_palette();
-	for (unsigned int uRow = 0; (uRow < (unsigned) srf->h) && (uRow < GL_TEX_SIZE); ++uRow)
+
+	if (uEndRow > GL_TEX_SIZE) uEndRow = GL_TEX_SIZE;
+	if (uEndCol > GL_TEX_SIZE) uEndCol = GL_TEX_SIZE;
+
+	for (unsigned int uRow = rect->y; uRow < uEndRow; ++uRow)
 	{
 		Uint8 *ptrPixel = ptrPixelRow;
 		Uint32 *RGBA = RGBARow;
 
-		for (unsigned int uCol = 0; (uCol < (unsigned) srf->w) && (uCol < GL_TEX_SIZE); ++uCol)
+		for (unsigned int uCol = rect->x; uCol < uEndCol; ++uCol)
 		{
 			Uint8 R, G, B;
 
@@ -537,6 +547,16 @@ void vid_srf2tex(SDL_Surface *srf, GLuint uTexID)
 		ptrPixelRow += srf->pitch;
 		RGBARow += GL_TEX_SIZE;	// move down one row in the texture memory
 	}
+}
+
+// converts an SDL surface to an opengl texture
+void vid_srf2tex(SDL_Surface *srf, GLuint uTexID)
+{
+	SDL_Rect rect;
+	rect.x = rect.y = 0;
+	rect.w = (Uint16) srf->w;
+	rect.h = (Uint16) srf->h;
+	vid_srf2rgba(srf, &rect);
 
 	glBindTexture(GL_TEXTURE_2D, uTexID);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
@@ -552,6 +572,50 @@ void vid_srf2tex(SDL_Surface *srf, GLuint uTexID)
 		0,	// border is 0
 		GL_RGBA, GL_UNSIGNED_BYTE, g_pVidTex);
 
+	g_iTexSrfW = srf->w;
+	g_iTexSrfH = srf->h;
+}
+
+// updates only the parts of the texture that are inside 'rects'
+// (the texture must already hold the rest of the surface, see vid_blit_rects)
+static void vid_srf2tex_rects(SDL_Surface *srf, GLuint uTexID, const SDL_Rect *rects, unsigned int uCount)
+{
+	glBindTexture(GL_TEXTURE_2D, uTexID);
+
+	for (unsigned int u = 0; u < uCount; u++)
+	{
+		unsigned int uEndRow = rects[u].y + rects[u].h;
+		if (uEndRow > GL_TEX_SIZE) uEndRow = GL_TEX_SIZE;
+		if ((unsigned int) rects[u].y >= uEndRow) continue;
+
+		vid_srf2rgba(srf, &rects[u]);
+
+		// upload whole rows so that we don't have to mess with the unpack row length
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, rects[u].y, GL_TEX_SIZE, uEndRow - rects[u].y,
+			GL_RGBA, GL_UNSIGNED_BYTE, ((Uint32 *) g_pVidTex) + (rects[u].y * GL_TEX_SIZE));
+	}
+}
+
+// draws the texture that holds 'srf' at x,y
+static void vid_draw_tex(SDL_Surface *srf, int x, int y)
+{
+	// draw the textured rectangle
+	GLfloat fWidth = (GLfloat) srf->w / GL_TEX_SIZE;
+	GLfloat fHeight = (GLfloat) srf->h / GL_TEX_SIZE;
+
+	// convert y from top-to-bottom to bottom-to-top (SDL -> openGL)
+	y = g_vid_height - y;
+
+	// adjust coordinates so they match up with glOrtho projection
+	x -= (g_vid_width >> 1);
+	y -= (g_vid_height >> 1);
+
+	glBegin(GL_QUADS);
+	glTexCoord2f(0, 0); glVertex3i(x, y, 0); // top left
+	glTexCoord2f(0, fHeight); glVertex3i(x, y - srf->h, 0); // bottom left
+	glTexCoord2f(fWidth, fHeight); glVertex3i(x + srf->w, y - srf->h, 0); // bottom right
+	glTexCoord2f(fWidth, 0); glVertex3i(x + srf->w, y, 0); // top right
+	glEnd();
 }
 #endif
 
@@ -576,29 +640,69 @@ void vid_blit(SDL_Surface *srf, int x, int y)
 
 			// convert surface to a texture
 			vid_srf2tex(srf, g_texture_id);
+			vid_draw_tex(srf, x, y);
 
-			// draw the textured rectangle
-			GLfloat fWidth = (GLfloat) srf->w / GL_TEX_SIZE;
-			GLfloat fHeight = (GLfloat) srf->h / GL_TEX_SIZE;
+			// this surface may not be the one that vid_blit_rects is tracking, so the next
+			//  vid_blit_rects has to convert the whole thing
+			g_iTexSrfW = g_iTexSrfH = 0;
 
-			// convert y from top-to-bottom to bottom-to-top (SDL -> openGL)
-			y = g_vid_height - y;
+#endif // USE_OPENGL
+		}
+	}
+	// else blitting isn't allowed, so just ignore
+}
 
-			// adjust coordinates so they match up with glOrtho projection
-			x -= (g_vid_width >> 1);
-			y -= (g_vid_height >> 1);
+void vid_blit_rects(SDL_Surface *srf, int x, int y, const SDL_Rect *rects, unsigned int uCount)
+{
+	// if we don't know what changed, we have to do everything
+	if (!rects)
+	{
+		vid_blit(srf, x, y);
 
-			glBegin(GL_QUADS);
-			glTexCoord2f(0, 0); glVertex3i(x, y, 0); // top left
-			glTexCoord2f(0, fHeight); glVertex3i(x, y - srf->h, 0); // bottom left
-			glTexCoord2f(fWidth, fHeight); glVertex3i(x + srf->w, y - srf->h, 0); // bottom right
-			glTexCoord2f(fWidth, 0); glVertex3i(x + srf->w, y, 0); // top right
-			glEnd();
+#ifdef USE_OPENGL
+		// but now the texture holds a complete copy of this surface, so next time we can just do the changes
+		if (g_bUseOpenGL && g_ldp->is_blitting_allowed())
+		{
+			g_iTexSrfW = srf->w;
+			g_iTexSrfH = srf->h;
+		}
+#endif
+		return;
+	}
 
+	if (g_ldp->is_blitting_allowed())
+	{
+		if (!g_bUseOpenGL)
+		{
+			for (unsigned int u = 0; u < uCount; u++)
+			{
+				SDL_Rect src = rects[u];	// SDL_BlitSurface may change this
+				SDL_Rect dest;
+				dest.x = (short) (x + src.x);
+				dest.y = (short) (y + src.y);
+				dest.w = src.w;
+				dest.h = src.h;
+				SDL_BlitSurface(srf, &src, g_screen, &dest);
+			}
+		}
+
+		else
+		{
+#ifdef USE_OPENGL
+			// if the texture holds the rest of this surface, we only need to convert what changed
+			// (OpenGL always redraws the whole quad though, since the screen has been cleared)
+			if ((g_iTexSrfW == srf->w) && (g_iTexSrfH == srf->h))
+			{
+				vid_srf2tex_rects(srf, g_texture_id, rects, uCount);
+			}
+			else
+			{
+				vid_srf2tex(srf, g_texture_id);
+			}
+			vid_draw_tex(srf, x, y);
 #endif // USE_OPENGL
 		}
 	}
-	// else blitting isn't allowed, so just ignore
 }
 
 // redraws the proper display (Scoreboard, etc) on the screen, after first clearing the screen
@@ -65,6 +65,12 @@ void vid_blank();
 // blits an SDL Surface to the back buffer
 void vid_blit(SDL_Surface *srf, int x, int y);
 
+// Blits only the parts of an SDL Surface that have changed ('rects' is relative to the surface).
+// The parts of the back buffer (or texture, in OpenGL mode) outside of 'rects' must still hold what
+//  was blitted last time, which means that nothing else may have been blitted since then.
+// If 'rects' is NULL, the whole surface is blitted.
+void vid_blit_rects(SDL_Surface *srf, int x, int y, const SDL_Rect *rects, unsigned int uCount);
+
 void display_repaint();
 bool load_bmps();
 bool draw_led(int, int, int);
@@ -124,6 +124,8 @@ void mpeg2_slice (decoder_t * decoder, int code, const uint8_t * buffer);
 #define MPEG2_ACCEL_X86_MMX 1
 #define MPEG2_ACCEL_X86_3DNOW 2
 #define MPEG2_ACCEL_X86_MMXEXT 4
+#define MPEG2_ACCEL_X86_SSE2 8
+#define MPEG2_ACCEL_X86_AVX2 16
 #define MPEG2_ACCEL_PPC_ALTIVEC 1
 #define MPEG2_ACCEL_ALPHA 1
 #define MPEG2_ACCEL_ALPHA_MVI 2
@@ -141,6 +143,8 @@ int mpeg2_parse (mpeg2dec_t * mpeg2dec);
 
 void mpeg2_skip (mpeg2dec_t * mpeg2dec, int skip);
 void mpeg2_slice_region (mpeg2dec_t * mpeg2dec, int start, int end);
+void mpeg2_slice_threads (mpeg2dec_t * mpeg2dec, int threads);	/* 1 decodes slices one at a time */
+void mpeg2_lowres (mpeg2dec_t * mpeg2dec, int lowres);	/* 0 full size, 1 half, 2 quarter size */
 
 void mpeg2_pts (mpeg2dec_t * mpeg2dec, uint32_t pts);
 
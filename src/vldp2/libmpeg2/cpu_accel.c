@@ -35,14 +35,15 @@ static inline uint32_t arch_accel (void)
     int AMD;
     uint32_t caps;
 
-#ifndef PIC
+/* ecx is zeroed because leaf 7 takes a sub-leaf */
+#if !defined (PIC) || defined (__x86_64__)
 #define cpuid(op,eax,ebx,ecx,edx)	\
     __asm__ ("cpuid"			\
 	     : "=a" (eax),		\
 	       "=b" (ebx),		\
 	       "=c" (ecx),		\
 	       "=d" (edx)		\
-	     : "a" (op)			\
+	     : "a" (op), "c" (0)	\
 	     : "cc")
 #else	/* PIC version : save ebx */
 #define cpuid(op,eax,ebx,ecx,edx)	\
@@ -54,10 +55,11 @@ static inline uint32_t arch_accel (void)
 	       "=r" (ebx),		\
 	       "=c" (ecx),		\
 	       "=d" (edx)		\
-	     : "a" (op)			\
+	     : "a" (op), "c" (0)	\
 	     : "cc")
 #endif
 
+#ifndef __x86_64__	/* every x86-64 cpu has cpuid */
     __asm__ ("pushf\n\t"
 	     "pushf\n\t"
 	     "pop %0\n\t"
@@ -75,6 +77,7 @@ static inline uint32_t arch_accel (void)
 
     if (eax == ebx)		/* no cpuid */
 	return 0;
+#endif
 
     cpuid (0x00000000, eax, ebx, ecx, edx);
     if (!eax)			/* vendor string only */
@@ -90,6 +93,26 @@ static inline uint32_t arch_accel (void)
     if (edx & 0x02000000)	/* SSE - identical to AMD MMX extensions */
 	caps = MPEG2_ACCEL_X86_MMX | MPEG2_ACCEL_X86_MMXEXT;
 
+    if (edx & 0x04000000)	/* SSE2 */
+	caps |= MPEG2_ACCEL_X86_SSE2;
+
+    /* AVX2 also needs the OS to save the ymm registers (OSXSAVE and AVX) */
+    if ((caps & MPEG2_ACCEL_X86_SSE2) && (ecx & 0x18000000) == 0x18000000) {
+	uint32_t xcr0, xcr0_high;
+
+	__asm__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0_high) : "c" (0));
+	if ((xcr0 & 6) == 6) {
+	    uint32_t max_leaf;
+
+	    cpuid (0x00000000, max_leaf, ebx, ecx, edx);
+	    if (max_leaf >= 7) {
+		cpuid (0x00000007, eax, ebx, ecx, edx);
+		if (ebx & 0x00000020)
+		    caps |= MPEG2_ACCEL_X86_AVX2;
+	    }
+	}
+    }
+
     cpuid (0x80000000, eax, ebx, ecx, edx);
     if (eax < 0x80000001)	/* no extended capabilities */
 	return caps;
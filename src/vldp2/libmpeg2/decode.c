@@ -150,6 +150,20 @@ int mpeg2_seek_sequence (mpeg2dec_t * mpeg2dec)
 
 #define RECEIVED(code,state) (((state) << 8) + (code))
 
+/* decodes the queued slices and moves the slice that is being copied to */
+/* the start of the chunk buffer */
+static void slice_mt_flush (mpeg2dec_t * mpeg2dec)
+{
+    int size;
+
+    mpeg2_slice_mt_run (mpeg2dec->slice_mt, &(mpeg2dec->decoder));
+
+    size = mpeg2dec->chunk_ptr - mpeg2dec->chunk_start;
+    memmove (mpeg2dec->chunk_buffer, mpeg2dec->chunk_start, size);
+    mpeg2dec->chunk_start = mpeg2dec->chunk_buffer;
+    mpeg2dec->chunk_ptr = mpeg2dec->chunk_buffer + size;
+}
+
 int mpeg2_parse (mpeg2dec_t * mpeg2dec)
 {
     int size_buffer, size_chunk, copied;
@@ -180,12 +194,31 @@ int mpeg2_parse (mpeg2dec_t * mpeg2dec)
 		if (!copied) {
 		    /* filled the chunk buffer without finding a start code */
 		    mpeg2dec->bytes_since_pts += size_chunk;
+		    if (mpeg2dec->chunk_start != mpeg2dec->chunk_buffer) {
+			/* queued slices took up the room, so decode them */
+			mpeg2dec->chunk_ptr += size_chunk;
+			slice_mt_flush (mpeg2dec);
+			continue;
+		    }
 		    mpeg2dec->action = seek_chunk;
 		    return STATE_INVALID;
 		}
 	    }
 	    mpeg2dec->bytes_since_pts += copied;
 
+	    if (mpeg2dec->slice_mt && !(mpeg2dec->decoder.convert)) {
+		/* leave the slice in the chunk buffer until the picture is complete */
+		if (!mpeg2_slice_mt_queue (mpeg2dec->slice_mt, mpeg2dec->code,
+					   mpeg2dec->chunk_start)) {
+		    mpeg2_slice_mt_run (mpeg2dec->slice_mt, &(mpeg2dec->decoder));
+		    mpeg2_slice_mt_queue (mpeg2dec->slice_mt, mpeg2dec->code,
+					  mpeg2dec->chunk_start);
+		}
+		mpeg2dec->code = mpeg2dec->buf_start[-1];
+		mpeg2dec->chunk_start = mpeg2dec->chunk_ptr;
+		continue;
+	    }
+
 	    mpeg2_slice (&(mpeg2dec->decoder), mpeg2dec->code,
 			 mpeg2dec->chunk_start);
 	    mpeg2dec->code = mpeg2dec->buf_start[-1];
@@ -197,6 +230,13 @@ int mpeg2_parse (mpeg2dec_t * mpeg2dec)
 	    return -1;
     }
 
+    /* no more slices are coming for this picture */
+    if (mpeg2dec->chunk_start != mpeg2dec->chunk_buffer &&
+	mpeg2dec->slice_mt) {
+	mpeg2_slice_mt_run (mpeg2dec->slice_mt, &(mpeg2dec->decoder));
+	mpeg2dec->chunk_start = mpeg2dec->chunk_ptr = mpeg2dec->chunk_buffer;
+    }
+
     switch (RECEIVED (mpeg2dec->code, mpeg2dec->state)) {
     case RECEIVED (0x00, STATE_SLICE_1ST):
     case RECEIVED (0x00, STATE_SLICE):
@@ -369,6 +409,24 @@ void mpeg2_slice_region (mpeg2dec_t * mpeg2dec, int start, int end)
     mpeg2dec->nb_decode_slices = end - start;
 }
 
+void mpeg2_slice_threads (mpeg2dec_t * mpeg2dec, int threads)
+{
+    if (mpeg2dec->slice_mt) {
+	mpeg2_slice_mt_close (mpeg2dec->slice_mt);
+	mpeg2dec->slice_mt = NULL;
+    }
+    mpeg2dec->slice_mt = mpeg2_slice_mt_open (threads);
+}
+
+void mpeg2_lowres (mpeg2dec_t * mpeg2dec, int lowres)
+{
+    /* takes effect at the next sequence header, which is also where */
+    /* the caller finds out about the smaller picture size. */
+    /* The convert functions only know about full size pictures, so */
+    /* this doesn't mix with mpeg2_convert. */
+    mpeg2dec->lowres = (lowres < 0) ? 0 : (lowres > 2) ? 2 : lowres;
+}
+
 void mpeg2_pts (mpeg2dec_t * mpeg2dec, uint32_t pts)
 {
     mpeg2dec->pts_previous = mpeg2dec->pts_current;
@@ -424,10 +482,18 @@ mpeg2dec_t * mpeg2_init (void)
 void mpeg2_partial_init(mpeg2dec_t *mpeg2dec)
 {
 	uint8_t *tmp = mpeg2dec->chunk_buffer;	// save this since the whole struct is about to get wiped
+	slice_mt_t *slice_mt = mpeg2dec->slice_mt;	// (and so do the slice threads)
+	int lowres = mpeg2dec->lowres;	// (and the lowres setting)
+
+	// any slices that were queued up are from the stream we're leaving
+	if (slice_mt)
+		mpeg2_slice_mt_discard(slice_mt);
 
     memset (mpeg2dec, 0, sizeof (mpeg2dec_t));
 
     mpeg2dec->chunk_buffer = tmp;
+    mpeg2dec->slice_mt = slice_mt;
+    mpeg2dec->lowres = lowres;
     mpeg2dec->shift = 0xffffff00;
     mpeg2dec->action = mpeg2_seek_sequence;
     mpeg2dec->code = 0xb4;
@@ -447,6 +513,7 @@ void mpeg2_close (mpeg2dec_t * mpeg2dec)
     /* static uint8_t finalizer[] = {0,0,1,0xb4}; */
     /* mpeg2_decode_data (mpeg2dec, finalizer, finalizer+4); */
 
+    mpeg2_slice_mt_close (mpeg2dec->slice_mt);
     mpeg2_free (mpeg2dec->chunk_buffer);
     if (!mpeg2dec->custom_fbuf)
 	for (i = mpeg2dec->alloc_index_user; i < mpeg2dec->alloc_index; i++)
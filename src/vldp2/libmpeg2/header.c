@@ -307,9 +307,18 @@ static inline void finalize_sequence (sequence_t * sequence)
 void mpeg2_header_sequence_finalize (mpeg2dec_t * mpeg2dec)
 {
     sequence_t * sequence = &(mpeg2dec->new_sequence);
+    decoder_t * decoder = &(mpeg2dec->decoder);
 
     finalize_sequence (sequence);
 
+    /* width and height are the size of the pictures we hand out, */
+    /* picture_ and display_ sizes still describe the stream */
+    decoder->lowres = mpeg2dec->lowres;
+    sequence->width >>= decoder->lowres;
+    sequence->height >>= decoder->lowres;
+    sequence->chroma_width >>= decoder->lowres;
+    sequence->chroma_height >>= decoder->lowres;
+
     /*
      * according to 6.1.1.6, repeat sequence headers should be
      * identical to the original. However some DVDs dont respect that
@@ -442,7 +451,8 @@ int mpeg2_header_picture (mpeg2dec_t * mpeg2dec)
 		    fbuf->buf[2] = fbuf->buf[0] + mpeg2dec->convert_size[2];
 		} else {
 		    int size;
-		    size = mpeg2dec->decoder.width * mpeg2dec->decoder.height;
+		    size = ((mpeg2dec->decoder.width >> mpeg2dec->decoder.lowres) *
+			    (mpeg2dec->decoder.height >> mpeg2dec->decoder.lowres));
 		    fbuf->buf[0] = (uint8_t *) mpeg2_malloc (6 * size >> 2,
 							     ALLOC_YUV);
 		    fbuf->buf[1] = fbuf->buf[0] + size;
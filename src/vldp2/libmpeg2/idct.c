@@ -24,6 +24,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 
 #include "mpeg2.h"
@@ -45,6 +46,9 @@ void (* mpeg2_idct_add) (int last, int16_t * block,
 static uint8_t clip_lut[1024];
 #define CLIP(i) ((clip_lut+384)[(i)])
 
+/* where the selected idct wants the coefficient at [row*8+col] stored */
+static uint8_t lowres_perm[64];
+
 #if 0
 #define BUTTERFLY(t0,t1,W0,W1,d0,d1)	\
 do {					\
@@ -227,8 +231,132 @@ static void mpeg2_idct_add_c (const int last, int16_t * block,
     }
 }
 
+/*
+ * lowres idcts: only the top left 4x4 (or 2x2) coefficients are
+ * transformed, giving the 4x4 (2x2) picture a downscaled 8x8 idct would
+ * have given. The 4 point idct is the even half of the 8 point one.
+ */
+
+static int idct_lowres (const int lowres, const int16_t * const block,
+			int * out)
+{
+    int row[16];
+    int d0, d1, d2, d3;
+    int t0, t1, t2, t3;
+    int i;
+
+    if (lowres == 2) {
+	d0 = block[lowres_perm[0]];
+	d1 = block[lowres_perm[1]];
+	d2 = block[lowres_perm[8]];
+	d3 = block[lowres_perm[9]];
+	out[0] = (d0 + d1 + d2 + d3 + 4) >> 3;
+	out[1] = (d0 - d1 + d2 - d3 + 4) >> 3;
+	out[2] = (d0 + d1 - d2 - d3 + 4) >> 3;
+	out[3] = (d0 - d1 - d2 + d3 + 4) >> 3;
+	return 2;
+    }
+
+    for (i = 0; i < 4; i++) {
+	const uint8_t * const perm = lowres_perm + 8 * i;
+
+	d0 = block[perm[0]] << 11;
+	d1 = block[perm[1]];
+	d2 = block[perm[2]] << 11;
+	d3 = block[perm[3]];
+	t0 = d0 + d2;
+	t1 = d0 - d2;
+	BUTTERFLY (t2, t3, W6, W2, d3, d1);
+	row[4*i+0] = (t0 + t2 + 1024) >> 11;
+	row[4*i+1] = (t1 + t3 + 1024) >> 11;
+	row[4*i+2] = (t1 - t3 + 1024) >> 11;
+	row[4*i+3] = (t0 - t2 + 1024) >> 11;
+    }
+    for (i = 0; i < 4; i++) {
+	d0 = row[4*0+i] << 11;
+	d1 = row[4*1+i];
+	d2 = row[4*2+i] << 11;
+	d3 = row[4*3+i];
+	t0 = d0 + d2;
+	t1 = d0 - d2;
+	BUTTERFLY (t2, t3, W6, W2, d3, d1);
+	out[4*0+i] = (t0 + t2 + 8192) >> 14;
+	out[4*1+i] = (t1 + t3 + 8192) >> 14;
+	out[4*2+i] = (t1 - t3 + 8192) >> 14;
+	out[4*3+i] = (t0 - t2 + 8192) >> 14;
+    }
+    return 4;
+}
+
+void mpeg2_idct_copy_lowres (const int lowres, int16_t * block,
+			     uint8_t * dest, const int stride)
+{
+    int out[16];
+    int size, i, j;
+
+    size = idct_lowres (lowres, block, out);
+    for (i = 0; i < size; i++) {
+	for (j = 0; j < size; j++)
+	    dest[j] = CLIP (out[i * size + j]);
+	dest += stride;
+    }
+    memset (block, 0, 64 * sizeof (int16_t));
+}
+
+void mpeg2_idct_add_lowres (const int lowres, const int last, int16_t * block,
+			    uint8_t * dest, const int stride)
+{
+    int out[16];
+    int size, i, j;
+
+    if (last != 129 || (block[0] & 7) == 4) {
+	size = idct_lowres (lowres, block, out);
+	for (i = 0; i < size; i++) {
+	    for (j = 0; j < size; j++)
+		dest[j] = CLIP (out[i * size + j] + dest[j]);
+	    dest += stride;
+	}
+	memset (block, 0, 64 * sizeof (int16_t));
+    } else {
+	int DC;
+
+	DC = (block[0] + 4) >> 3;
+	block[0] = block[63] = 0;
+	size = 8 >> lowres;
+	for (i = 0; i < size; i++) {
+	    for (j = 0; j < size; j++)
+		dest[j] = CLIP (DC + dest[j]);
+	    dest += stride;
+	}
+    }
+}
+
 void mpeg2_idct_init (uint32_t accel)
 {
+    extern uint8_t mpeg2_scan_norm[64];
+    extern uint8_t mpeg2_scan_alt[64];
+    uint8_t scan_norm[64];
+    int i, j;
+
+    /* the lowres idcts use the C clipping, whichever idct gets picked */
+    for (i = -384; i < 640; i++)
+	clip_lut[i+384] = (i < 0) ? 0 : ((i > 255) ? 255 : i);
+    memcpy (scan_norm, mpeg2_scan_norm, 64);
+
+#ifdef LIBMPEG2_AVX2
+    if (accel & MPEG2_ACCEL_X86_AVX2) {
+	mpeg2_idct_copy = mpeg2_idct_copy_avx2;
+	mpeg2_idct_add = mpeg2_idct_add_avx2;
+	mpeg2_idct_sse2_init ();
+    } else
+#endif
+#ifdef LIBMPEG2_SSE2
+    if (accel & MPEG2_ACCEL_X86_SSE2) {
+	mpeg2_idct_copy = mpeg2_idct_copy_sse2;
+	mpeg2_idct_add = mpeg2_idct_add_sse2;
+	mpeg2_idct_sse2_init ();
+    } else
+#endif
 #ifdef ARCH_X86
     if (accel & MPEG2_ACCEL_X86_MMXEXT) {
 	mpeg2_idct_copy = mpeg2_idct_copy_mmxext;
@@ -266,14 +394,8 @@ void mpeg2_idct_init (uint32_t accel)
     } else
 #endif
     {
-	extern uint8_t mpeg2_scan_norm[64];
-	extern uint8_t mpeg2_scan_alt[64];
-	int i, j;
-
 	mpeg2_idct_copy = mpeg2_idct_copy_c;
 	mpeg2_idct_add = mpeg2_idct_add_c;
-	for (i = -384; i < 640; i++)
-	    clip_lut[i+384] = (i < 0) ? 0 : ((i > 255) ? 255 : i);
 	for (i = 0; i < 64; i++) {
 	    j = mpeg2_scan_norm[i];
 	    mpeg2_scan_norm[i] = ((j & 0x36) >> 1) | ((j & 0x09) << 2);
@@ -281,4 +403,9 @@ void mpeg2_idct_init (uint32_t accel)
 	    mpeg2_scan_alt[i] = ((j & 0x36) >> 1) | ((j & 0x09) << 2);
 	}
     }
+
+    /* the idct init above may have reordered the scan tables, */
+    /* so that is where the coefficients are going to end up */
+    for (i = 0; i < 64; i++)
+	lowres_perm[scan_norm[i]] = mpeg2_scan_norm[i];
 }
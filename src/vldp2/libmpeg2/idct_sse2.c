@@ -0,0 +1,418 @@
+/*
+ * idct_sse2.c
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of mpeg2dec, a free MPEG-2 video stream decoder.
+ * See http://libmpeg2.sourceforge.net/ for updates.
+ *
+ * mpeg2dec is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpeg2dec is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+
+#include "mpeg2.h"
+#include "mpeg2_internal.h"
+
+#ifdef LIBMPEG2_SSE2
+
+#include <emmintrin.h>
+#ifdef LIBMPEG2_AVX2
+#include <immintrin.h>
+#endif
+
+/*
+ * These compute exactly the same thing as the c idct (idct.c), using the
+ * same reordered input, so the decoded pictures are bit-identical whichever
+ * one gets picked.  Both passes work on all eight rows (or columns) at once,
+ * with each row in its own lane, so the block gets transposed before the row
+ * pass and again before the column pass.  All the arithmetic is done in 32
+ * bits and the results are truncated to 16 bits, just like the c code does
+ * when it stores them back into the block.
+ */
+
+#define W1 2841 /* 2048*sqrt (2)*cos (1*pi/16) */
+#define W2 2676 /* 2048*sqrt (2)*cos (2*pi/16) */
+#define W3 2408 /* 2048*sqrt (2)*cos (3*pi/16) */
+#define W5 1609 /* 2048*sqrt (2)*cos (5*pi/16) */
+#define W6 1108 /* 2048*sqrt (2)*cos (6*pi/16) */
+#define W7 565  /* 2048*sqrt (2)*cos (7*pi/16) */
+
+/* pairs of 16-bit constants for pmaddwd */
+#define PAIR(a,b) _mm_set_epi16 (b, a, b, a, b, a, b, a)
+
+static inline void transpose (__m128i * const r)
+{
+    __m128i a0, a1, a2, a3, a4, a5, a6, a7;
+    __m128i b0, b1, b2, b3, b4, b5, b6, b7;
+
+    a0 = _mm_unpacklo_epi16 (r[0], r[1]);
+    a1 = _mm_unpackhi_epi16 (r[0], r[1]);
+    a2 = _mm_unpacklo_epi16 (r[2], r[3]);
+    a3 = _mm_unpackhi_epi16 (r[2], r[3]);
+    a4 = _mm_unpacklo_epi16 (r[4], r[5]);
+    a5 = _mm_unpackhi_epi16 (r[4], r[5]);
+    a6 = _mm_unpacklo_epi16 (r[6], r[7]);
+    a7 = _mm_unpackhi_epi16 (r[6], r[7]);
+
+    b0 = _mm_unpacklo_epi32 (a0, a2);
+    b1 = _mm_unpackhi_epi32 (a0, a2);
+    b2 = _mm_unpacklo_epi32 (a1, a3);
+    b3 = _mm_unpackhi_epi32 (a1, a3);
+    b4 = _mm_unpacklo_epi32 (a4, a6);
+    b5 = _mm_unpackhi_epi32 (a4, a6);
+    b6 = _mm_unpacklo_epi32 (a5, a7);
+    b7 = _mm_unpackhi_epi32 (a5, a7);
+
+    r[0] = _mm_unpacklo_epi64 (b0, b4);
+    r[1] = _mm_unpackhi_epi64 (b0, b4);
+    r[2] = _mm_unpacklo_epi64 (b1, b5);
+    r[3] = _mm_unpackhi_epi64 (b1, b5);
+    r[4] = _mm_unpacklo_epi64 (b2, b6);
+    r[5] = _mm_unpackhi_epi64 (b2, b6);
+    r[6] = _mm_unpacklo_epi64 (b3, b7);
+    r[7] = _mm_unpackhi_epi64 (b3, b7);
+}
+
+/* x * 181, without needing a 32-bit multiply */
+static inline __m128i mul181 (const __m128i x)
+{
+    return _mm_add_epi32 (_mm_add_epi32 (_mm_slli_epi32 (x, 7),
+					 _mm_slli_epi32 (x, 5)),
+			  _mm_add_epi32 (_mm_add_epi32 (_mm_slli_epi32 (x, 4),
+							_mm_slli_epi32 (x, 2)),
+					 x));
+}
+
+/* truncates two vectors of 32-bit results to 16 bits */
+static inline __m128i pack (const __m128i lo, const __m128i hi)
+{
+    return _mm_packs_epi32 (_mm_srai_epi32 (_mm_slli_epi32 (lo, 16), 16),
+			    _mm_srai_epi32 (_mm_slli_epi32 (hi, 16), 16));
+}
+
+/* unpacks the low or high four lanes of two vectors into pairs */
+#define UNPACK(hi,a,b) \
+    ((hi) ? _mm_unpackhi_epi16 (a, b) : _mm_unpacklo_epi16 (a, b))
+
+/* one pass of the idct, on four of the eight lanes */
+static inline void idct_half_sse2 (const __m128i * const x, __m128i * const y,
+				   const int hi, const int col)
+{
+    const __m128i rnd = _mm_set1_epi32 (col ? 65536 : 128);
+    __m128i p, a0, a1, a2, a3, b0, b1, b2, b3, t0, t1, t2, t3;
+
+    /* d0 = x[0] << 11, d2 = x[2] << 11 */
+    p = UNPACK (hi, x[0], x[2]);
+    t0 = _mm_add_epi32 (_mm_madd_epi16 (p, PAIR (2048, 2048)), rnd);
+    t1 = _mm_add_epi32 (_mm_madd_epi16 (p, PAIR (2048, -2048)), rnd);
+    /* BUTTERFLY (t2, t3, W6, W2, d3, d1) */
+    p = UNPACK (hi, x[3], x[1]);
+    t2 = _mm_madd_epi16 (p, PAIR (W6, W2));
+    t3 = _mm_madd_epi16 (p, PAIR (-W2, W6));
+    a0 = _mm_add_epi32 (t0, t2);
+    a1 = _mm_add_epi32 (t1, t3);
+    a2 = _mm_sub_epi32 (t1, t3);
+    a3 = _mm_sub_epi32 (t0, t2);
+
+    /* BUTTERFLY (t0, t1, W7, W1, d3, d0) */
+    p = UNPACK (hi, x[7], x[4]);
+    t0 = _mm_madd_epi16 (p, PAIR (W7, W1));
+    t1 = _mm_madd_epi16 (p, PAIR (-W1, W7));
+    /* BUTTERFLY (t2, t3, W3, W5, d1, d2) */
+    p = UNPACK (hi, x[5], x[6]);
+    t2 = _mm_madd_epi16 (p, PAIR (W3, W5));
+    t3 = _mm_madd_epi16 (p, PAIR (-W5, W3));
+    b0 = _mm_add_epi32 (t0, t2);
+    b3 = _mm_add_epi32 (t1, t3);
+    t0 = _mm_sub_epi32 (t0, t2);
+    t1 = _mm_sub_epi32 (t1, t3);
+
+    if (!col) {
+	b1 = _mm_srai_epi32 (mul181 (_mm_add_epi32 (t0, t1)), 8);
+	b2 = _mm_srai_epi32 (mul181 (_mm_sub_epi32 (t0, t1)), 8);
+
+	y[0] = _mm_srai_epi32 (_mm_add_epi32 (a0, b0), 8);
+	y[1] = _mm_srai_epi32 (_mm_add_epi32 (a1, b1), 8);
+	y[2] = _mm_srai_epi32 (_mm_add_epi32 (a2, b2), 8);
+	y[3] = _mm_srai_epi32 (_mm_add_epi32 (a3, b3), 8);
+	y[4] = _mm_srai_epi32 (_mm_sub_epi32 (a3, b3), 8);
+	y[5] = _mm_srai_epi32 (_mm_sub_epi32 (a2, b2), 8);
+	y[6] = _mm_srai_epi32 (_mm_sub_epi32 (a1, b1), 8);
+	y[7] = _mm_srai_epi32 (_mm_sub_epi32 (a0, b0), 8);
+    } else {
+	t0 = _mm_srai_epi32 (t0, 8);
+	t1 = _mm_srai_epi32 (t1, 8);
+	b1 = mul181 (_mm_add_epi32 (t0, t1));
+	b2 = mul181 (_mm_sub_epi32 (t0, t1));
+
+	y[0] = _mm_srai_epi32 (_mm_add_epi32 (a0, b0), 17);
+	y[1] = _mm_srai_epi32 (_mm_add_epi32 (a1, b1), 17);
+	y[2] = _mm_srai_epi32 (_mm_add_epi32 (a2, b2), 17);
+	y[3] = _mm_srai_epi32 (_mm_add_epi32 (a3, b3), 17);
+	y[4] = _mm_srai_epi32 (_mm_sub_epi32 (a3, b3), 17);
+	y[5] = _mm_srai_epi32 (_mm_sub_epi32 (a2, b2), 17);
+	y[6] = _mm_srai_epi32 (_mm_sub_epi32 (a1, b1), 17);
+	y[7] = _mm_srai_epi32 (_mm_sub_epi32 (a0, b0), 17);
+    }
+}
+
+static inline void idct_pass_sse2 (__m128i * const x, const int col)
+{
+    __m128i lo[8], hi[8];
+    int i;
+
+    idct_half_sse2 (x, lo, 0, col);
+    idct_half_sse2 (x, hi, 1, col);
+    if (!col)
+	for (i = 0; i < 8; i++)
+	    x[i] = pack (lo[i], hi[i]);
+    else
+	/* these only get clipped to 0..255 from here on (the c code can't */
+	/* cope with anything outside of -384..639), so saturating is fine */
+	for (i = 0; i < 8; i++)
+	    x[i] = _mm_packs_epi32 (lo[i], hi[i]);
+}
+
+/* loads the block and runs both passes, leaving the rows of pixels in r */
+static inline void idct_sse2 (int16_t * const block, __m128i * const r)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+	r[i] = _mm_loadu_si128 ((__m128i *) (block + 8 * i));
+    transpose (r);
+    idct_pass_sse2 (r, 0);
+    transpose (r);
+    idct_pass_sse2 (r, 1);
+}
+
+static inline void clear_block (int16_t * const block)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    int i;
+
+    for (i = 0; i < 8; i++)
+	_mm_storeu_si128 ((__m128i *) (block + 8 * i), zero);
+}
+
+static inline void copy_rows (const __m128i * const r, uint8_t * dest,
+			      const int stride)
+{
+    int i;
+
+    for (i = 0; i < 8; i++) {
+	_mm_storel_epi64 ((__m128i *) dest, _mm_packus_epi16 (r[i], r[i]));
+	dest += stride;
+    }
+}
+
+static inline void add_rows (const __m128i * const r, uint8_t * dest,
+			     const int stride)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    __m128i pixels;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+	pixels = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((__m128i *) dest), zero);
+	pixels = _mm_adds_epi16 (pixels, r[i]);
+	_mm_storel_epi64 ((__m128i *) dest, _mm_packus_epi16 (pixels, pixels));
+	dest += stride;
+    }
+}
+
+static inline void add_dc (int16_t * const block, uint8_t * dest,
+			   const int stride)
+{
+    __m128i r[8];
+    int i;
+
+    r[0] = _mm_set1_epi16 ((block[0] + 4) >> 3);
+    for (i = 1; i < 8; i++)
+	r[i] = r[0];
+    block[0] = block[63] = 0;
+    add_rows (r, dest, stride);
+}
+
+void mpeg2_idct_copy_sse2 (int16_t * const block, uint8_t * const dest,
+			   const int stride)
+{
+    __m128i r[8];
+
+    idct_sse2 (block, r);
+    clear_block (block);
+    copy_rows (r, dest, stride);
+}
+
+void mpeg2_idct_add_sse2 (const int last, int16_t * const block,
+			  uint8_t * const dest, const int stride)
+{
+    __m128i r[8];
+
+    if (last != 129 || (block[0] & 7) == 4) {
+	idct_sse2 (block, r);
+	clear_block (block);
+	add_rows (r, dest, stride);
+    } else
+	add_dc (block, dest, stride);
+}
+
+#ifdef LIBMPEG2_AVX2
+
+/*
+ * The avx2 version only differs in the passes themselves : both halves fit
+ * in one register, so each pass takes half as many instructions.
+ */
+
+#define AVX2 __attribute__ ((target ("avx2")))
+
+#define PAIR_AVX2(a,b) _mm256_set_epi16 (b, a, b, a, b, a, b, a,	\
+					 b, a, b, a, b, a, b, a)
+
+/* pairs up all eight lanes of two vectors */
+static inline AVX2 __m256i unpack_avx2 (const __m128i a, const __m128i b)
+{
+    return _mm256_inserti128_si256
+	(_mm256_castsi128_si256 (_mm_unpacklo_epi16 (a, b)),
+	 _mm_unpackhi_epi16 (a, b), 1);
+}
+
+static inline AVX2 __m256i mul181_avx2 (const __m256i x)
+{
+    return _mm256_add_epi32
+	(_mm256_add_epi32 (_mm256_slli_epi32 (x, 7), _mm256_slli_epi32 (x, 5)),
+	 _mm256_add_epi32 (_mm256_add_epi32 (_mm256_slli_epi32 (x, 4),
+					     _mm256_slli_epi32 (x, 2)), x));
+}
+
+static inline AVX2 void idct_pass_avx2 (__m128i * const x, const int col)
+{
+    const __m256i rnd = _mm256_set1_epi32 (col ? 65536 : 128);
+    __m256i p, a0, a1, a2, a3, b0, b1, b2, b3, t0, t1, t2, t3;
+    __m256i y[8];
+    int i;
+
+    p = unpack_avx2 (x[0], x[2]);
+    t0 = _mm256_add_epi32 (_mm256_madd_epi16 (p, PAIR_AVX2 (2048, 2048)), rnd);
+    t1 = _mm256_add_epi32 (_mm256_madd_epi16 (p, PAIR_AVX2 (2048, -2048)),
+			   rnd);
+    p = unpack_avx2 (x[3], x[1]);
+    t2 = _mm256_madd_epi16 (p, PAIR_AVX2 (W6, W2));
+    t3 = _mm256_madd_epi16 (p, PAIR_AVX2 (-W2, W6));
+    a0 = _mm256_add_epi32 (t0, t2);
+    a1 = _mm256_add_epi32 (t1, t3);
+    a2 = _mm256_sub_epi32 (t1, t3);
+    a3 = _mm256_sub_epi32 (t0, t2);
+
+    p = unpack_avx2 (x[7], x[4]);
+    t0 = _mm256_madd_epi16 (p, PAIR_AVX2 (W7, W1));
+    t1 = _mm256_madd_epi16 (p, PAIR_AVX2 (-W1, W7));
+    p = unpack_avx2 (x[5], x[6]);
+    t2 = _mm256_madd_epi16 (p, PAIR_AVX2 (W3, W5));
+    t3 = _mm256_madd_epi16 (p, PAIR_AVX2 (-W5, W3));
+    b0 = _mm256_add_epi32 (t0, t2);
+    b3 = _mm256_add_epi32 (t1, t3);
+    t0 = _mm256_sub_epi32 (t0, t2);
+    t1 = _mm256_sub_epi32 (t1, t3);
+
+    if (!col) {
+	b1 = _mm256_srai_epi32 (mul181_avx2 (_mm256_add_epi32 (t0, t1)), 8);
+	b2 = _mm256_srai_epi32 (mul181_avx2 (_mm256_sub_epi32 (t0, t1)), 8);
+    } else {
+	t0 = _mm256_srai_epi32 (t0, 8);
+	t1 = _mm256_srai_epi32 (t1, 8);
+	b1 = mul181_avx2 (_mm256_add_epi32 (t0, t1));
+	b2 = mul181_avx2 (_mm256_sub_epi32 (t0, t1));
+    }
+
+    y[0] = _mm256_add_epi32 (a0, b0);
+    y[1] = _mm256_add_epi32 (a1, b1);
+    y[2] = _mm256_add_epi32 (a2, b2);
+    y[3] = _mm256_add_epi32 (a3, b3);
+    y[4] = _mm256_sub_epi32 (a3, b3);
+    y[5] = _mm256_sub_epi32 (a2, b2);
+    y[6] = _mm256_sub_epi32 (a1, b1);
+    y[7] = _mm256_sub_epi32 (a0, b0);
+
+    for (i = 0; i < 8; i++) {
+	__m256i v;
+
+	if (!col) {
+	    /* truncate to 16 bits, like the sse2 version */
+	    v = _mm256_srai_epi32 (y[i], 8);
+	    v = _mm256_srai_epi32 (_mm256_slli_epi32 (v, 16), 16);
+	} else
+	    v = _mm256_srai_epi32 (y[i], 17);
+	x[i] = _mm_packs_epi32 (_mm256_castsi256_si128 (v),
+				_mm256_extracti128_si256 (v, 1));
+    }
+}
+
+static inline AVX2 void idct_avx2 (int16_t * const block, __m128i * const r)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+	r[i] = _mm_loadu_si128 ((__m128i *) (block + 8 * i));
+    transpose (r);
+    idct_pass_avx2 (r, 0);
+    transpose (r);
+    idct_pass_avx2 (r, 1);
+}
+
+AVX2 void mpeg2_idct_copy_avx2 (int16_t * const block, uint8_t * const dest,
+				const int stride)
+{
+    __m128i r[8];
+
+    idct_avx2 (block, r);
+    clear_block (block);
+    copy_rows (r, dest, stride);
+}
+
+AVX2 void mpeg2_idct_add_avx2 (const int last, int16_t * const block,
+			       uint8_t * const dest, const int stride)
+{
+    __m128i r[8];
+
+    if (last != 129 || (block[0] & 7) == 4) {
+	idct_avx2 (block, r);
+	clear_block (block);
+	add_rows (r, dest, stride);
+    } else
+	add_dc (block, dest, stride);
+}
+
+#endif /* LIBMPEG2_AVX2 */
+
+void mpeg2_idct_sse2_init (void)
+{
+    extern uint8_t mpeg2_scan_norm[64];
+    extern uint8_t mpeg2_scan_alt[64];
+    int i, j;
+
+    /* same reordered input as the c idct */
+
+    for (i = 0; i < 64; i++) {
+	j = mpeg2_scan_norm[i];
+	mpeg2_scan_norm[i] = ((j & 0x36) >> 1) | ((j & 0x09) << 2);
+	j = mpeg2_scan_alt[i];
+	mpeg2_scan_alt[i] = ((j & 0x36) >> 1) | ((j & 0x09) << 2);
+    }
+}
+
+#endif /* LIBMPEG2_SSE2 */
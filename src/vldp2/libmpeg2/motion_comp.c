@@ -29,9 +29,22 @@
 #include "mpeg2_internal.h"
 
 mpeg2_mc_t mpeg2_mc;
+mpeg2_mc_t mpeg2_mc_lowres[2];
+
+static void mc_lowres_init (void);
 
 void mpeg2_mc_init (uint32_t accel)
 {
+#ifdef LIBMPEG2_AVX2
+    if (accel & MPEG2_ACCEL_X86_AVX2)
+	mpeg2_mc = mpeg2_mc_avx2;
+    else
+#endif
+#ifdef LIBMPEG2_SSE2
+    if (accel & MPEG2_ACCEL_X86_SSE2)
+	mpeg2_mc = mpeg2_mc_sse2;
+    else
+#endif
 #ifdef ARCH_X86
     if (accel & MPEG2_ACCEL_X86_MMXEXT)
 	mpeg2_mc = mpeg2_mc_mmxext;
@@ -57,6 +70,8 @@ void mpeg2_mc_init (uint32_t accel)
     else
 #endif
 	mpeg2_mc = mpeg2_mc_c;
+
+    mc_lowres_init ();
 }
 
 #define avg2(a,b) ((a+b+1)>>1)
@@ -127,3 +142,60 @@ MC_FUNC (put,xy)
 MC_FUNC (avg,xy)
 
 MPEG2_MC_EXTERN (c)
+
+/* narrower blocks for lowres decoding, which only needs them in C */
+
+#define MC_FUNC_LOWRES(op,xy)						\
+static void MC_##op##_##xy##_4_c (uint8_t * dest, const uint8_t * ref,	\
+				  const int stride, int height)		\
+{									\
+    do {								\
+	op (predict_##xy, 0);						\
+	op (predict_##xy, 1);						\
+	op (predict_##xy, 2);						\
+	op (predict_##xy, 3);						\
+	ref += stride;							\
+	dest += stride;							\
+    } while (--height);							\
+}									\
+static void MC_##op##_##xy##_2_c (uint8_t * dest, const uint8_t * ref,	\
+				  const int stride, int height)		\
+{									\
+    do {								\
+	op (predict_##xy, 0);						\
+	op (predict_##xy, 1);						\
+	ref += stride;							\
+	dest += stride;							\
+    } while (--height);							\
+}
+
+MC_FUNC_LOWRES (put,o)
+MC_FUNC_LOWRES (avg,o)
+MC_FUNC_LOWRES (put,x)
+MC_FUNC_LOWRES (avg,x)
+MC_FUNC_LOWRES (put,y)
+MC_FUNC_LOWRES (avg,y)
+MC_FUNC_LOWRES (put,xy)
+MC_FUNC_LOWRES (avg,xy)
+
+static mpeg2_mc_t mpeg2_mc_lowres_c = {
+    {MC_put_o_4_c, MC_put_x_4_c, MC_put_y_4_c, MC_put_xy_4_c,
+     MC_put_o_2_c, MC_put_x_2_c, MC_put_y_2_c, MC_put_xy_2_c},
+    {MC_avg_o_4_c, MC_avg_x_4_c, MC_avg_y_4_c, MC_avg_xy_4_c,
+     MC_avg_o_2_c, MC_avg_x_2_c, MC_avg_y_2_c, MC_avg_xy_2_c}
+};
+
+/* half size luma blocks are 8 wide, so they can keep using the accelerated */
+/* functions, everything narrower than that uses the C ones above */
+static void mc_lowres_init (void)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+	mpeg2_mc_lowres[0].put[i] = mpeg2_mc.put[4+i];
+	mpeg2_mc_lowres[0].avg[i] = mpeg2_mc.avg[4+i];
+	mpeg2_mc_lowres[0].put[4+i] = mpeg2_mc_lowres_c.put[i];
+	mpeg2_mc_lowres[0].avg[4+i] = mpeg2_mc_lowres_c.avg[i];
+    }
+    mpeg2_mc_lowres[1] = mpeg2_mc_lowres_c;
+}
@@ -0,0 +1,345 @@
+/*
+ * motion_comp_sse2.c
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of mpeg2dec, a free MPEG-2 video stream decoder.
+ * See http://libmpeg2.sourceforge.net/ for updates.
+ *
+ * mpeg2dec is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpeg2dec is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+
+#include "mpeg2.h"
+#include "mpeg2_internal.h"
+
+#ifdef LIBMPEG2_SSE2
+
+#include <emmintrin.h>
+#ifdef LIBMPEG2_AVX2
+#include <immintrin.h>
+#endif
+
+/*
+ * (x+y+1)>>1 is exactly what pavgb computes.  (a+b+c+d+2)>>2 isn't the same
+ * as averaging twice, so the xy predictions are done in 16 bits.  Neither
+ * dest nor ref is assumed to be aligned.
+ */
+
+#define LOAD16(p) _mm_loadu_si128 ((const __m128i *) (p))
+#define STORE16(p,x) _mm_storeu_si128 ((__m128i *) (p), x)
+#define LOAD8(p) _mm_loadl_epi64 ((const __m128i *) (p))
+#define STORE8(p,x) _mm_storel_epi64 ((__m128i *) (p), x)
+
+#define predict_o(LOAD,ref,stride) LOAD (ref)
+#define predict_x(LOAD,ref,stride) _mm_avg_epu8 (LOAD (ref), LOAD ((ref) + 1))
+#define predict_y(LOAD,ref,stride) \
+    _mm_avg_epu8 (LOAD (ref), LOAD ((ref) + (stride)))
+
+#define put(LOAD,dest,pred) (pred)
+#define avg(LOAD,dest,pred) _mm_avg_epu8 (pred, LOAD (dest))
+
+/* mc function template for the o, x and y predictions */
+
+#define MC_FUNC(op,xy)							\
+static void MC_##op##_##xy##_16_sse2 (uint8_t * dest, const uint8_t * ref,\
+				      const int stride, int height)	\
+{									\
+    do {								\
+	STORE16 (dest, op (LOAD16, dest,				\
+			   predict_##xy (LOAD16, ref, stride)));	\
+	ref += stride;							\
+	dest += stride;							\
+    } while (--height);							\
+}									\
+static void MC_##op##_##xy##_8_sse2 (uint8_t * dest, const uint8_t * ref,\
+				     const int stride, int height)	\
+{									\
+    do {								\
+	STORE8 (dest, op (LOAD8, dest,					\
+			  predict_##xy (LOAD8, ref, stride)));		\
+	ref += stride;							\
+	dest += stride;							\
+    } while (--height);							\
+}
+
+MC_FUNC (put,o)
+MC_FUNC (avg,o)
+MC_FUNC (put,x)
+MC_FUNC (avg,x)
+MC_FUNC (put,y)
+MC_FUNC (avg,y)
+
+/* sum of a pixel and its right neighbour, in 16 bits */
+static inline void sum_x_16 (const uint8_t * const ref, __m128i * const lo,
+			     __m128i * const hi)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    __m128i a = LOAD16 (ref);
+    __m128i b = LOAD16 (ref + 1);
+
+    *lo = _mm_add_epi16 (_mm_unpacklo_epi8 (a, zero),
+			 _mm_unpacklo_epi8 (b, zero));
+    *hi = _mm_add_epi16 (_mm_unpackhi_epi8 (a, zero),
+			 _mm_unpackhi_epi8 (b, zero));
+}
+
+static inline __m128i sum_x_8 (const uint8_t * const ref)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+
+    return _mm_add_epi16 (_mm_unpacklo_epi8 (LOAD8 (ref), zero),
+			  _mm_unpacklo_epi8 (LOAD8 (ref + 1), zero));
+}
+
+/* each row's horizontal sums are used again for the row below it */
+
+static inline void MC_xy_16_sse2 (const int average, uint8_t * dest,
+				  const uint8_t * ref, const int stride,
+				  int height)
+{
+    const __m128i round2 = _mm_set1_epi16 (2);
+    __m128i top_lo, top_hi, bottom_lo, bottom_hi, pred;
+
+    sum_x_16 (ref, &top_lo, &top_hi);
+    do {
+	ref += stride;
+	sum_x_16 (ref, &bottom_lo, &bottom_hi);
+	pred = _mm_packus_epi16
+	    (_mm_srli_epi16 (_mm_add_epi16 (_mm_add_epi16 (top_lo, bottom_lo),
+					    round2), 2),
+	     _mm_srli_epi16 (_mm_add_epi16 (_mm_add_epi16 (top_hi, bottom_hi),
+					    round2), 2));
+	if (average)
+	    pred = _mm_avg_epu8 (pred, LOAD16 (dest));
+	STORE16 (dest, pred);
+	top_lo = bottom_lo;
+	top_hi = bottom_hi;
+	dest += stride;
+    } while (--height);
+}
+
+static inline void MC_xy_8_sse2 (const int average, uint8_t * dest,
+				 const uint8_t * ref, const int stride,
+				 int height)
+{
+    const __m128i round2 = _mm_set1_epi16 (2);
+    __m128i top, bottom, pred;
+
+    top = sum_x_8 (ref);
+    do {
+	ref += stride;
+	bottom = sum_x_8 (ref);
+	pred = _mm_srli_epi16 (_mm_add_epi16 (_mm_add_epi16 (top, bottom),
+					      round2), 2);
+	pred = _mm_packus_epi16 (pred, pred);
+	if (average)
+	    pred = _mm_avg_epu8 (pred, LOAD8 (dest));
+	STORE8 (dest, pred);
+	top = bottom;
+	dest += stride;
+    } while (--height);
+}
+
+static void MC_put_xy_16_sse2 (uint8_t * dest, const uint8_t * ref,
+			       const int stride, int height)
+{
+    MC_xy_16_sse2 (0, dest, ref, stride, height);
+}
+
+static void MC_avg_xy_16_sse2 (uint8_t * dest, const uint8_t * ref,
+			       const int stride, int height)
+{
+    MC_xy_16_sse2 (1, dest, ref, stride, height);
+}
+
+static void MC_put_xy_8_sse2 (uint8_t * dest, const uint8_t * ref,
+			      const int stride, int height)
+{
+    MC_xy_8_sse2 (0, dest, ref, stride, height);
+}
+
+static void MC_avg_xy_8_sse2 (uint8_t * dest, const uint8_t * ref,
+			      const int stride, int height)
+{
+    MC_xy_8_sse2 (1, dest, ref, stride, height);
+}
+
+MPEG2_MC_EXTERN (sse2)
+
+#ifdef LIBMPEG2_AVX2
+
+/*
+ * The avx2 versions do two rows at a time in the 16-pixel wide functions,
+ * and in the 8-pixel wide xy ones (which need 16 bits per pixel).  The
+ * height is always even (16, 8 or 4).  The 8-pixel wide o, x and y
+ * predictions are no wider than an sse2 register, so the sse2 ones are used.
+ */
+
+#define AVX2 __attribute__ ((target ("avx2")))
+
+/* rows p and p + stride, in the low and high half */
+#define LOAD2ROWS(p,stride)						\
+    _mm256_inserti128_si256 (_mm256_castsi128_si256 (LOAD16 (p)),	\
+			     LOAD16 ((p) + (stride)), 1)
+#define STORE2ROWS(p,stride,x)						\
+do {									\
+    STORE16 (p, _mm256_castsi256_si128 (x));				\
+    STORE16 ((p) + (stride), _mm256_extracti128_si256 (x, 1));		\
+} while (0)
+
+#define predict2_o(ref,stride) LOAD2ROWS (ref, stride)
+#define predict2_x(ref,stride) \
+    _mm256_avg_epu8 (LOAD2ROWS (ref, stride), LOAD2ROWS ((ref) + 1, stride))
+#define predict2_y(ref,stride) \
+    _mm256_avg_epu8 (LOAD2ROWS (ref, stride),				\
+		     LOAD2ROWS ((ref) + (stride), stride))
+
+#define put2(dest,stride,pred) (pred)
+#define avg2(dest,stride,pred) _mm256_avg_epu8 (pred, LOAD2ROWS (dest, stride))
+
+#define MC_FUNC_AVX2(op,xy)						\
+static AVX2 void MC_##op##_##xy##_16_avx2 (uint8_t * dest,		\
+					   const uint8_t * ref,		\
+					   const int stride, int height)\
+{									\
+    __m256i pred;							\
+									\
+    do {								\
+	pred = op##2 (dest, stride, predict2_##xy (ref, stride));	\
+	STORE2ROWS (dest, stride, pred);				\
+	ref += 2 * stride;						\
+	dest += 2 * stride;						\
+    } while (height -= 2);						\
+}
+
+MC_FUNC_AVX2 (put,o)
+MC_FUNC_AVX2 (avg,o)
+MC_FUNC_AVX2 (put,x)
+MC_FUNC_AVX2 (avg,x)
+MC_FUNC_AVX2 (put,y)
+MC_FUNC_AVX2 (avg,y)
+
+/* sum of a pixel and its right neighbour for 16 pixels, in 16 bits */
+static inline AVX2 __m256i sum_x_16_avx2 (const uint8_t * const ref)
+{
+    return _mm256_add_epi16 (_mm256_cvtepu8_epi16 (LOAD16 (ref)),
+			     _mm256_cvtepu8_epi16 (LOAD16 (ref + 1)));
+}
+
+/* same thing for 8 pixels of two rows */
+static inline AVX2 __m256i sum_x_8_avx2 (const uint8_t * const ref,
+					 const int stride)
+{
+    return _mm256_add_epi16
+	(_mm256_cvtepu8_epi16 (_mm_unpacklo_epi64 (LOAD8 (ref),
+						   LOAD8 (ref + stride))),
+	 _mm256_cvtepu8_epi16 (_mm_unpacklo_epi64 (LOAD8 (ref + 1),
+						   LOAD8 (ref + stride + 1))));
+}
+
+/* packs 16 16-bit pixels back into the low half */
+static inline AVX2 __m128i pack_avx2 (const __m256i x)
+{
+    return _mm256_castsi256_si128
+	(_mm256_permute4x64_epi64 (_mm256_packus_epi16 (x, x), 0xd8));
+}
+
+static inline AVX2 void MC_xy_16_avx2 (const int average, uint8_t * dest,
+				       const uint8_t * ref, const int stride,
+				       int height)
+{
+    const __m256i round2 = _mm256_set1_epi16 (2);
+    __m256i top, bottom;
+    __m128i pred;
+
+    top = sum_x_16_avx2 (ref);
+    do {
+	ref += stride;
+	bottom = sum_x_16_avx2 (ref);
+	pred = pack_avx2 (_mm256_srli_epi16 (_mm256_add_epi16
+					     (_mm256_add_epi16 (top, bottom),
+					      round2), 2));
+	if (average)
+	    pred = _mm_avg_epu8 (pred, LOAD16 (dest));
+	STORE16 (dest, pred);
+	top = bottom;
+	dest += stride;
+    } while (--height);
+}
+
+static inline AVX2 void MC_xy_8_avx2 (const int average, uint8_t * dest,
+				      const uint8_t * ref, const int stride,
+				      int height)
+{
+    const __m256i round2 = _mm256_set1_epi16 (2);
+    __m256i top, bottom;
+    __m128i pred;
+
+    do {
+	/* rows n and n + 1 on top of rows n + 1 and n + 2 */
+	top = sum_x_8_avx2 (ref, stride);
+	bottom = sum_x_8_avx2 (ref + stride, stride);
+	pred = pack_avx2 (_mm256_srli_epi16 (_mm256_add_epi16
+					     (_mm256_add_epi16 (top, bottom),
+					      round2), 2));
+	if (average)
+	    pred = _mm_avg_epu8 (pred, _mm_unpacklo_epi64
+				 (LOAD8 (dest), LOAD8 (dest + stride)));
+	STORE8 (dest, pred);
+	STORE8 (dest + stride, _mm_unpackhi_epi64 (pred, pred));
+	ref += 2 * stride;
+	dest += 2 * stride;
+    } while (height -= 2);
+}
+
+static AVX2 void MC_put_xy_16_avx2 (uint8_t * dest, const uint8_t * ref,
+				    const int stride, int height)
+{
+    MC_xy_16_avx2 (0, dest, ref, stride, height);
+}
+
+static AVX2 void MC_avg_xy_16_avx2 (uint8_t * dest, const uint8_t * ref,
+				    const int stride, int height)
+{
+    MC_xy_16_avx2 (1, dest, ref, stride, height);
+}
+
+static AVX2 void MC_put_xy_8_avx2 (uint8_t * dest, const uint8_t * ref,
+				   const int stride, int height)
+{
+    MC_xy_8_avx2 (0, dest, ref, stride, height);
+}
+
+static AVX2 void MC_avg_xy_8_avx2 (uint8_t * dest, const uint8_t * ref,
+				   const int stride, int height)
+{
+    MC_xy_8_avx2 (1, dest, ref, stride, height);
+}
+
+#define MC_put_o_8_avx2 MC_put_o_8_sse2
+#define MC_avg_o_8_avx2 MC_avg_o_8_sse2
+#define MC_put_x_8_avx2 MC_put_x_8_sse2
+#define MC_avg_x_8_avx2 MC_avg_x_8_sse2
+#define MC_put_y_8_avx2 MC_put_y_8_sse2
+#define MC_avg_y_8_avx2 MC_avg_y_8_sse2
+
+MPEG2_MC_EXTERN (avx2)
+
+#endif /* LIBMPEG2_AVX2 */
+
+#endif /* LIBMPEG2_SSE2 */
@@ -104,6 +104,9 @@ struct decoder_s {
     int height;
     int vertical_position_extension;
 
+    /* the decoded pictures are only (width >> lowres) x (height >> lowres) */
+    int lowres;
+
     /* picture header stuff */
 
     /* what type of picture this is (I, P, B, D) */
@@ -141,6 +144,8 @@ typedef struct {
     fbuf_t fbuf;
 } fbuf_alloc_t;
 
+typedef struct slice_mt_s slice_mt_t;
+
 struct mpeg2dec_s {
     decoder_t decoder;
 
@@ -193,6 +198,12 @@ struct mpeg2dec_s {
     uint8_t * buf_end;
 
     int16_t display_offset_x, display_offset_y;
+
+    /* decodes slices on several threads (NULL to decode them one at a time) */
+    slice_mt_t * slice_mt;
+
+    /* lowres setting that the next sequence header will pick up */
+    int lowres;
 };
 
 typedef struct {
@@ -208,6 +219,7 @@ typedef struct {
 #define ALLOC_YUV 2
 #define ALLOC_CONVERT_ID 3
 #define ALLOC_CONVERTED 4
+#define ALLOC_SLICE_MT 5
 void * mpeg2_malloc (int size, int reason);
 void mpeg2_free (void * buf);
 
@@ -237,6 +249,20 @@ void mpeg2_set_fbuf (mpeg2dec_t * mpeg2dec, int coding_type);
 
 /* idct.c */
 void mpeg2_idct_init (uint32_t accel);
+void mpeg2_idct_copy_lowres (int lowres, int16_t * block,
+			     uint8_t * dest, int stride);
+void mpeg2_idct_add_lowres (int lowres, int last, int16_t * block,
+			    uint8_t * dest, int stride);
+
+/* slice_mt.c */
+#define SLICE_MT_MAX_THREADS 16
+#define SLICE_MT_MAX_JOBS 1024	/* most slices that are queued before they get decoded */
+slice_mt_t * mpeg2_slice_mt_open (int threads);
+void mpeg2_slice_mt_close (slice_mt_t * mt);
+int mpeg2_slice_mt_queue (slice_mt_t * mt, int code, const uint8_t * buffer);
+int mpeg2_slice_mt_pending (slice_mt_t * mt);
+void mpeg2_slice_mt_discard (slice_mt_t * mt);
+void mpeg2_slice_mt_run (slice_mt_t * mt, decoder_t * decoder);
 
 /* idct_mlib.c */
 void mpeg2_idct_add_mlib (int last, int16_t * block,
@@ -246,6 +272,24 @@ void mpeg2_idct_copy_mlib_non_ieee (int16_t * block, uint8_t * dest,
 void mpeg2_idct_add_mlib_non_ieee (int last, int16_t * block,
 				   uint8_t * dest, int stride);
 
+/* the sse2 code needs a compiler that can assume sse2 (any x86-64 one), */
+/* the avx2 code is only enabled for the functions that use it */
+#if defined (ARCH_X86) && (defined (__SSE2__) || defined (_M_X64))
+#define LIBMPEG2_SSE2
+#if defined (__GNUC__) && (__GNUC__ >= 5 || defined (__clang__))
+#define LIBMPEG2_AVX2
+#endif
+#endif
+
+/* idct_sse2.c */
+void mpeg2_idct_copy_sse2 (int16_t * block, uint8_t * dest, int stride);
+void mpeg2_idct_add_sse2 (int last, int16_t * block,
+			  uint8_t * dest, int stride);
+void mpeg2_idct_copy_avx2 (int16_t * block, uint8_t * dest, int stride);
+void mpeg2_idct_add_avx2 (int last, int16_t * block,
+			  uint8_t * dest, int stride);
+void mpeg2_idct_sse2_init (void);
+
 /* idct_mmx.c */
 void mpeg2_idct_copy_mmxext (int16_t * block, uint8_t * dest, int stride);
 void mpeg2_idct_add_mmxext (int last, int16_t * block,
@@ -288,6 +332,9 @@ typedef struct {
 };
 
 extern mpeg2_mc_t mpeg2_mc_c;
+extern mpeg2_mc_t mpeg2_mc_lowres[2];	/* 8/4 and 4/2 pixel wide blocks */
+extern mpeg2_mc_t mpeg2_mc_sse2;
+extern mpeg2_mc_t mpeg2_mc_avx2;
 extern mpeg2_mc_t mpeg2_mc_mmx;
 extern mpeg2_mc_t mpeg2_mc_mmxext;
 extern mpeg2_mc_t mpeg2_mc_3dnow;
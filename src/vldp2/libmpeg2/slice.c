@@ -30,6 +30,7 @@
 #include "attributes.h"
 
 extern mpeg2_mc_t mpeg2_mc;
+extern mpeg2_mc_t mpeg2_mc_lowres[2];
 extern void (* mpeg2_idct_copy) (int16_t * block, uint8_t * dest, int stride);
 extern void (* mpeg2_idct_add) (int last, int16_t * block,
 				uint8_t * dest, int stride);
@@ -977,7 +978,11 @@ static inline void slice_intra_DCT (decoder_t * const decoder, const int cc,
 	get_intra_block_B15 (decoder);
     else
 	get_intra_block_B14 (decoder);
-    mpeg2_idct_copy (decoder->DCTblock, dest, stride);
+    if (decoder->lowres)
+	mpeg2_idct_copy_lowres (decoder->lowres, decoder->DCTblock,
+				dest, stride);
+    else
+	mpeg2_idct_copy (decoder->DCTblock, dest, stride);
 #undef bit_buf
 #undef bits
 #undef bit_ptr
@@ -992,52 +997,77 @@ static inline void slice_non_intra_DCT (decoder_t * const decoder,
 	last = get_mpeg1_non_intra_block (decoder);
     else
 	last = get_non_intra_block (decoder);
-    mpeg2_idct_add (last, decoder->DCTblock, dest, stride);
+    if (decoder->lowres)
+	mpeg2_idct_add_lowres (decoder->lowres, last, decoder->DCTblock,
+			       dest, stride);
+    else
+	mpeg2_idct_add (last, decoder->DCTblock, dest, stride);
+}
+
+/* the mc functions for the block sizes of the picture being decoded */
+static inline const mpeg2_mc_t * motion_mc (const decoder_t * const decoder)
+{
+    return (decoder->lowres ?
+	    &(mpeg2_mc_lowres[decoder->lowres - 1]) : &mpeg2_mc);
 }
 
+/* turns a half pel position into one in the (lowres) picture being decoded */
+#define LOWRES(pos) (((pos) + ((1 << decoder->lowres) >> 1)) >> decoder->lowres)
+
 #define MOTION(table,ref,motion_x,motion_y,size,y)			      \
     pos_x = 2 * decoder->offset + motion_x;				      \
     pos_y = 2 * decoder->v_offset + motion_y + 2 * y;			      \
     if ((pos_x > decoder->limit_x) || (pos_y > decoder->limit_y_ ## size))    \
 	return;								      \
+    pos_x = LOWRES (pos_x);	pos_y = LOWRES (pos_y);			      \
     xy_half = ((pos_y & 1) << 1) | (pos_x & 1);				      \
-    table[xy_half] (decoder->dest[0] + y * decoder->stride + decoder->offset, \
+    table[xy_half] (decoder->dest[0] +					      \
+		    (y >> decoder->lowres) * decoder->stride +		      \
+		    (decoder->offset >> decoder->lowres),		      \
 		    ref[0] + (pos_x >> 1) + (pos_y >> 1) * decoder->stride,   \
-		    decoder->stride, size);				      \
+		    decoder->stride, size >> decoder->lowres);		      \
     motion_x /= 2;	motion_y /= 2;					      \
-    xy_half = ((motion_y & 1) << 1) | (motion_x & 1);			      \
-    offset = (((decoder->offset + motion_x) >> 1) +			      \
-	      ((((decoder->v_offset + motion_y) >> 1) + y/2) *		      \
-	       decoder->uv_stride));					      \
-    table[4+xy_half] (decoder->dest[1] + y/2 * decoder->uv_stride +	      \
-		      (decoder->offset >> 1), ref[1] + offset,		      \
-		      decoder->uv_stride, size/2);			      \
-    table[4+xy_half] (decoder->dest[2] + y/2 * decoder->uv_stride +	      \
-		      (decoder->offset >> 1), ref[2] + offset,		      \
-		      decoder->uv_stride, size/2)
+    pos_x = LOWRES (decoder->offset + motion_x);			      \
+    pos_y = LOWRES (decoder->v_offset + motion_y + y);			      \
+    xy_half = ((pos_y & 1) << 1) | (pos_x & 1);				      \
+    offset = (pos_x >> 1) + (pos_y >> 1) * decoder->uv_stride;		      \
+    table[4+xy_half] (decoder->dest[1] +				      \
+		      (y >> decoder->lowres)/2 * decoder->uv_stride +	      \
+		      (decoder->offset >> (decoder->lowres + 1)),	      \
+		      ref[1] + offset, decoder->uv_stride,		      \
+		      (size/2) >> decoder->lowres);			      \
+    table[4+xy_half] (decoder->dest[2] +				      \
+		      (y >> decoder->lowres)/2 * decoder->uv_stride +	      \
+		      (decoder->offset >> (decoder->lowres + 1)),	      \
+		      ref[2] + offset, decoder->uv_stride,		      \
+		      (size/2) >> decoder->lowres)
 
 #define MOTION_FIELD(table,ref,motion_x,motion_y,dest_field,op,src_field)     \
     pos_x = 2 * decoder->offset + motion_x;				      \
     pos_y = decoder->v_offset + motion_y;				      \
     if ((pos_x > decoder->limit_x) || (pos_y > decoder->limit_y))	      \
 	return;								      \
+    pos_x = LOWRES (pos_x);	pos_y = LOWRES (pos_y);			      \
     xy_half = ((pos_y & 1) << 1) | (pos_x & 1);				      \
     table[xy_half] (decoder->dest[0] + dest_field * decoder->stride +	      \
-		    decoder->offset,					      \
+		    (decoder->offset >> decoder->lowres),		      \
 		    (ref[0] + (pos_x >> 1) +				      \
 		     ((pos_y op) + src_field) * decoder->stride),	      \
-		    2 * decoder->stride, 8);				      \
+		    2 * decoder->stride, 8 >> decoder->lowres);		      \
     motion_x /= 2;	motion_y /= 2;					      \
-    xy_half = ((motion_y & 1) << 1) | (motion_x & 1);			      \
-    offset = (((decoder->offset + motion_x) >> 1) +			      \
-	      (((decoder->v_offset >> 1) + (motion_y op) + src_field) *	      \
-	       decoder->uv_stride));					      \
+    pos_x = LOWRES (decoder->offset + motion_x);			      \
+    pos_y = LOWRES ((decoder->v_offset >> 1) + motion_y);		      \
+    xy_half = ((pos_y & 1) << 1) | (pos_x & 1);				      \
+    offset = ((pos_x >> 1) +						      \
+	      ((pos_y op) + src_field) * decoder->uv_stride);		      \
     table[4+xy_half] (decoder->dest[1] + dest_field * decoder->uv_stride +    \
-		      (decoder->offset >> 1), ref[1] + offset,		      \
-		      2 * decoder->uv_stride, 4);			      \
+		      (decoder->offset >> (decoder->lowres + 1)),	      \
+		      ref[1] + offset,					      \
+		      2 * decoder->uv_stride, 4 >> decoder->lowres);	      \
     table[4+xy_half] (decoder->dest[2] + dest_field * decoder->uv_stride +    \
-		      (decoder->offset >> 1), ref[2] + offset,		      \
-		      2 * decoder->uv_stride, 4)
+		      (decoder->offset >> (decoder->lowres + 1)),	      \
+		      ref[2] + offset,					      \
+		      2 * decoder->uv_stride, 4 >> decoder->lowres)
 
 static void motion_mp1 (decoder_t * const decoder, motion_t * const motion,
 			mpeg2_mc_fct * const * const table)
@@ -1152,6 +1182,7 @@ static void motion_fr_dmv (decoder_t * const decoder, motion_t * const motion,
 #define bit_buf (decoder->bitstream_buf)
 #define bits (decoder->bitstream_bits)
 #define bit_ptr (decoder->bitstream_ptr)
+    const mpeg2_mc_t * const mc = motion_mc (decoder);
     int motion_x, motion_y, dmv_x, dmv_y, m, other_x, other_y;
     unsigned int pos_x, pos_y, xy_half, offset;
 
@@ -1172,41 +1203,49 @@ static void motion_fr_dmv (decoder_t * const decoder, motion_t * const motion,
     m = decoder->top_field_first ? 1 : 3;
     other_x = ((motion_x * m + (motion_x > 0)) >> 1) + dmv_x;
     other_y = ((motion_y * m + (motion_y > 0)) >> 1) + dmv_y - 1;
-    MOTION_FIELD (mpeg2_mc.put, motion->ref[0], other_x, other_y, 0, | 1, 0);
+    MOTION_FIELD (mc->put, motion->ref[0], other_x, other_y, 0, | 1, 0);
 
     m = decoder->top_field_first ? 3 : 1;
     other_x = ((motion_x * m + (motion_x > 0)) >> 1) + dmv_x;
     other_y = ((motion_y * m + (motion_y > 0)) >> 1) + dmv_y + 1;
-    MOTION_FIELD (mpeg2_mc.put, motion->ref[0], other_x, other_y, 1, & ~1, 0);
-
-    xy_half = ((motion_y & 1) << 1) | (motion_x & 1);
-    offset = (decoder->offset + (motion_x >> 1) +
-	      (decoder->v_offset + (motion_y & ~1)) * decoder->stride);
-    mpeg2_mc.avg[xy_half]
-	(decoder->dest[0] + decoder->offset,
-	 motion->ref[0][0] + offset, 2 * decoder->stride, 8);
-    mpeg2_mc.avg[xy_half]
-	(decoder->dest[0] + decoder->stride + decoder->offset,
-	 motion->ref[0][0] + decoder->stride + offset, 2 * decoder->stride, 8);
+    MOTION_FIELD (mc->put, motion->ref[0], other_x, other_y, 1, & ~1, 0);
+
+    pos_x = LOWRES (2 * decoder->offset + motion_x);
+    pos_y = LOWRES (decoder->v_offset + motion_y);
+    xy_half = ((pos_y & 1) << 1) | (pos_x & 1);
+    offset = (pos_x >> 1) + (pos_y & ~1) * decoder->stride;
+    mc->avg[xy_half]
+	(decoder->dest[0] + (decoder->offset >> decoder->lowres),
+	 motion->ref[0][0] + offset, 2 * decoder->stride,
+	 8 >> decoder->lowres);
+    mc->avg[xy_half]
+	(decoder->dest[0] + decoder->stride +
+	 (decoder->offset >> decoder->lowres),
+	 motion->ref[0][0] + decoder->stride + offset, 2 * decoder->stride,
+	 8 >> decoder->lowres);
     motion_x /= 2;	motion_y /= 2;
-    xy_half = ((motion_y & 1) << 1) | (motion_x & 1);
-    offset = (((decoder->offset + motion_x) >> 1) +
-	      (((decoder->v_offset >> 1) + (motion_y & ~1)) *
-	       decoder->uv_stride));
-    mpeg2_mc.avg[4+xy_half]
-	(decoder->dest[1] + (decoder->offset >> 1),
-	 motion->ref[0][1] + offset, 2 * decoder->uv_stride, 4);
-    mpeg2_mc.avg[4+xy_half]
-	(decoder->dest[1] + decoder->uv_stride + (decoder->offset >> 1),
+    pos_x = LOWRES (decoder->offset + motion_x);
+    pos_y = LOWRES ((decoder->v_offset >> 1) + motion_y);
+    xy_half = ((pos_y & 1) << 1) | (pos_x & 1);
+    offset = (pos_x >> 1) + (pos_y & ~1) * decoder->uv_stride;
+    mc->avg[4+xy_half]
+	(decoder->dest[1] + (decoder->offset >> (decoder->lowres + 1)),
+	 motion->ref[0][1] + offset, 2 * decoder->uv_stride,
+	 4 >> decoder->lowres);
+    mc->avg[4+xy_half]
+	(decoder->dest[1] + decoder->uv_stride +
+	 (decoder->offset >> (decoder->lowres + 1)),
 	 motion->ref[0][1] + decoder->uv_stride + offset,
-	 2 * decoder->uv_stride, 4);
-    mpeg2_mc.avg[4+xy_half]
-	(decoder->dest[2] + (decoder->offset >> 1),
-	 motion->ref[0][2] + offset, 2 * decoder->uv_stride, 4);
-    mpeg2_mc.avg[4+xy_half]
-	(decoder->dest[2] + decoder->uv_stride + (decoder->offset >> 1),
+	 2 * decoder->uv_stride, 4 >> decoder->lowres);
+    mc->avg[4+xy_half]
+	(decoder->dest[2] + (decoder->offset >> (decoder->lowres + 1)),
+	 motion->ref[0][2] + offset, 2 * decoder->uv_stride,
+	 4 >> decoder->lowres);
+    mc->avg[4+xy_half]
+	(decoder->dest[2] + decoder->uv_stride +
+	 (decoder->offset >> (decoder->lowres + 1)),
 	 motion->ref[0][2] + decoder->uv_stride + offset,
-	 2 * decoder->uv_stride, 4);
+	 2 * decoder->uv_stride, 4 >> decoder->lowres);
 #undef bit_buf
 #undef bits
 #undef bit_ptr
@@ -1229,19 +1268,20 @@ static inline void motion_zero (const decoder_t * const decoder,
 				const motion_t * const motion,
 				mpeg2_mc_fct * const * const table)
 {
+    const int lowres = decoder->lowres;
     unsigned int offset;
 
-    table[0] (decoder->dest[0] + decoder->offset,
-	      (motion->ref[0][0] + decoder->offset +
-	       decoder->v_offset * decoder->stride),
-	      decoder->stride, 16);
-
-    offset = ((decoder->offset >> 1) +
-	      (decoder->v_offset >> 1) * decoder->uv_stride);
-    table[4] (decoder->dest[1] + (decoder->offset >> 1),
-	      motion->ref[0][1] + offset, decoder->uv_stride, 8);
-    table[4] (decoder->dest[2] + (decoder->offset >> 1),
-	      motion->ref[0][2] + offset, decoder->uv_stride, 8);
+    table[0] (decoder->dest[0] + (decoder->offset >> lowres),
+	      (motion->ref[0][0] + (decoder->offset >> lowres) +
+	       (decoder->v_offset >> lowres) * decoder->stride),
+	      decoder->stride, 16 >> lowres);
+
+    offset = ((decoder->offset >> (lowres + 1)) +
+	      (decoder->v_offset >> (lowres + 1)) * decoder->uv_stride);
+    table[4] (decoder->dest[1] + (decoder->offset >> (lowres + 1)),
+	      motion->ref[0][1] + offset, decoder->uv_stride, 8 >> lowres);
+    table[4] (decoder->dest[2] + (decoder->offset >> (lowres + 1)),
+	      motion->ref[0][2] + offset, decoder->uv_stride, 8 >> lowres);
 }
 
 /* like motion_frame, but parsing without actual motion compensation */
@@ -1356,6 +1396,7 @@ static void motion_fi_dmv (decoder_t * const decoder, motion_t * const motion,
 #define bit_buf (decoder->bitstream_buf)
 #define bits (decoder->bitstream_bits)
 #define bit_ptr (decoder->bitstream_ptr)
+    const mpeg2_mc_t * const mc = motion_mc (decoder);
     int motion_x, motion_y, other_x, other_y;
     unsigned int pos_x, pos_y, xy_half, offset;
 
@@ -1374,8 +1415,8 @@ static void motion_fi_dmv (decoder_t * const decoder, motion_t * const motion,
     other_y = (((motion_y + (motion_y > 0)) >> 1) + get_dmv (decoder) +
 	       decoder->dmv_offset);
 
-    MOTION (mpeg2_mc.put, motion->ref[0], motion_x, motion_y, 16, 0);
-    MOTION (mpeg2_mc.avg, motion->ref[1], other_x, other_y, 16, 0);
+    MOTION (mc->put, motion->ref[0], motion_x, motion_y, 16, 0);
+    MOTION (mc->avg, motion->ref[1], other_x, other_y, 16, 0);
 #undef bit_buf
 #undef bits
 #undef bit_ptr
@@ -1411,11 +1452,11 @@ static void motion_fi_conceal (decoder_t * const decoder)
 #define MOTION_CALL(routine,direction)				\
 do {								\
     if ((direction) & MACROBLOCK_MOTION_FORWARD)		\
-	routine (decoder, &(decoder->f_motion), mpeg2_mc.put);	\
+	routine (decoder, &(decoder->f_motion), mc->put);	\
     if ((direction) & MACROBLOCK_MOTION_BACKWARD)		\
 	routine (decoder, &(decoder->b_motion),			\
 		 ((direction) & MACROBLOCK_MOTION_FORWARD ?	\
-		  mpeg2_mc.avg : mpeg2_mc.put));		\
+		  mc->avg : mc->put));				\
 } while (0)
 
 #define NEXT_MACROBLOCK							\
@@ -1429,9 +1470,9 @@ do {									\
 		if (decoder->coding_type == B_TYPE)			\
 		    break;						\
 	    }								\
-	    decoder->dest[0] += 16 * decoder->stride;			\
-	    decoder->dest[1] += 4 * decoder->stride;			\
-	    decoder->dest[2] += 4 * decoder->stride;			\
+	    decoder->dest[0] += (16 >> decoder->lowres) * decoder->stride; \
+	    decoder->dest[1] += (4 >> decoder->lowres) * decoder->stride; \
+	    decoder->dest[2] += (4 >> decoder->lowres) * decoder->stride; \
 	} while (0);							\
 	decoder->v_offset += 16;					\
 	if (decoder->v_offset > decoder->limit_y) {			\
@@ -1448,7 +1489,7 @@ void mpeg2_init_fbuf (decoder_t * decoder, uint8_t * current_fbuf[3],
 {
     int offset, stride, height, bottom_field;
 
-    stride = decoder->width;
+    stride = decoder->width >> decoder->lowres;
     bottom_field = (decoder->picture_structure == BOTTOM_FIELD);
     offset = bottom_field ? stride : 0;
     height = decoder->height;
@@ -1519,7 +1560,7 @@ static inline int slice_init (decoder_t * const decoder, int code)
     decoder->v_offset = (code - 1) * 16;
     offset = 0;
     if (!(decoder->convert) || decoder->coding_type != B_TYPE)
-	offset = (code - 1) * decoder->stride * 4;
+	offset = (code - 1) * decoder->stride * (4 >> decoder->lowres);
 
     decoder->dest[0] = decoder->picture_dest[0] + offset * 4;
     decoder->dest[1] = decoder->picture_dest[1] + offset;
@@ -1563,9 +1604,9 @@ static inline int slice_init (decoder_t * const decoder, int code)
     while (decoder->offset - decoder->width >= 0) {
 	decoder->offset -= decoder->width;
 	if (!(decoder->convert) || decoder->coding_type != B_TYPE) {
-	    decoder->dest[0] += 16 * decoder->stride;
-	    decoder->dest[1] += 4 * decoder->stride;
-	    decoder->dest[2] += 4 * decoder->stride;
+	    decoder->dest[0] += (16 >> decoder->lowres) * decoder->stride;
+	    decoder->dest[1] += (4 >> decoder->lowres) * decoder->stride;
+	    decoder->dest[2] += (4 >> decoder->lowres) * decoder->stride;
 	}
 	decoder->v_offset += 16;
     }
@@ -1584,6 +1625,8 @@ void mpeg2_slice (decoder_t * const decoder, const int code,
 #define bit_buf (decoder->bitstream_buf)
 #define bits (decoder->bitstream_bits)
 #define bit_ptr (decoder->bitstream_ptr)
+    const mpeg2_mc_t * const mc = motion_mc (decoder);
+    const int lowres = decoder->lowres;
     cpu_state_t cpu_state;
 
     bitstream_init (decoder, buffer);
@@ -1629,16 +1672,17 @@ void mpeg2_slice (decoder_t * const decoder, const int code,
 		DCT_offset = decoder->stride;
 		DCT_stride = decoder->stride * 2;
 	    } else {
-		DCT_offset = decoder->stride * 8;
+		DCT_offset = decoder->stride * (8 >> lowres);
 		DCT_stride = decoder->stride;
 	    }
 
-	    offset = decoder->offset;
+	    offset = decoder->offset >> lowres;
 	    dest_y = decoder->dest[0] + offset;
 	    slice_intra_DCT (decoder, 0, dest_y, DCT_stride);
-	    slice_intra_DCT (decoder, 0, dest_y + 8, DCT_stride);
+	    slice_intra_DCT (decoder, 0, dest_y + (8 >> lowres), DCT_stride);
 	    slice_intra_DCT (decoder, 0, dest_y + DCT_offset, DCT_stride);
-	    slice_intra_DCT (decoder, 0, dest_y + DCT_offset + 8, DCT_stride);
+	    slice_intra_DCT (decoder, 0, dest_y + DCT_offset + (8 >> lowres),
+			     DCT_stride);
 	    slice_intra_DCT (decoder, 1, decoder->dest[1] + (offset >> 1),
 			     decoder->uv_stride);
 	    slice_intra_DCT (decoder, 2, decoder->dest[2] + (offset >> 1),
@@ -1710,23 +1754,25 @@ void mpeg2_slice (decoder_t * const decoder, const int code,
 		    DCT_offset = decoder->stride;
 		    DCT_stride = decoder->stride * 2;
 		} else {
-		    DCT_offset = decoder->stride * 8;
+		    DCT_offset = decoder->stride * (8 >> lowres);
 		    DCT_stride = decoder->stride;
 		}
 
 		coded_block_pattern = get_coded_block_pattern (decoder);
 
-		offset = decoder->offset;
+		offset = decoder->offset >> lowres;
 		dest_y = decoder->dest[0] + offset;
 		if (coded_block_pattern & 0x20)
 		    slice_non_intra_DCT (decoder, dest_y, DCT_stride);
 		if (coded_block_pattern & 0x10)
-		    slice_non_intra_DCT (decoder, dest_y + 8, DCT_stride);
+		    slice_non_intra_DCT (decoder, dest_y + (8 >> lowres),
+					 DCT_stride);
 		if (coded_block_pattern & 0x08)
 		    slice_non_intra_DCT (decoder, dest_y + DCT_offset,
 					 DCT_stride);
 		if (coded_block_pattern & 0x04)
-		    slice_non_intra_DCT (decoder, dest_y + DCT_offset + 8,
+		    slice_non_intra_DCT (decoder,
+					 dest_y + DCT_offset + (8 >> lowres),
 					 DCT_stride);
 		if (coded_block_pattern & 0x2)
 		    slice_non_intra_DCT (decoder,
@@ -0,0 +1,241 @@
+/*
+ * slice_mt.c
+ * Copyright (C) 2026 DAPHNE contributors
+ *
+ * This file is part of mpeg2dec, a free MPEG-2 video stream decoder.
+ * See http://libmpeg2.sourceforge.net/ for updates.
+ *
+ * mpeg2dec is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpeg2dec is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Decodes the slices of a picture on several threads at once (VLDP addition).
+ *
+ * mpeg2_parse queues up every slice of a picture (the slices stay in the
+ * chunk buffer) and then calls mpeg2_slice_mt_run, which hands them out to
+ * the helper threads and to the calling thread, and returns once they have
+ * all been decoded.  Every slice starts from the same picture-wide decoder
+ * state, only writes its own macroblocks, and only reads from reference
+ * frames that are already finished, so the picture comes out exactly the
+ * same as when the slices are decoded one after another.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <inttypes.h>
+
+#ifdef WIN32
+#include <SDL.h>	/* only used for threading */
+#else
+#include <SDL/SDL.h>	/* only used for threading */
+#endif
+
+#include "mpeg2.h"
+#include "mpeg2_internal.h"
+
+typedef struct {
+    int code;
+    const uint8_t * buffer;
+} slice_job_t;
+
+typedef struct {
+    struct slice_mt_s * mt;
+    SDL_Thread * thread;
+    decoder_t * decoder;	/* this helper's own decoder (kept aligned) */
+} slice_helper_t;
+
+struct slice_mt_s {
+    slice_helper_t helper[SLICE_MT_MAX_THREADS];
+    int nb_helpers;
+
+    /* picture-wide decoder state that the helpers start every slice from */
+    decoder_t picture;
+
+    slice_job_t job[SLICE_MT_MAX_JOBS];
+    int nb_jobs;
+
+    /* everything below is protected by mutex while the helpers are running */
+    SDL_mutex * mutex;
+    SDL_cond * work_cond;	/* signalled when a new batch starts */
+    SDL_cond * done_cond;	/* signalled when the last helper is done */
+    int next_job;		/* next job that hasn't been handed out */
+    int busy;			/* how many helpers are still working */
+    unsigned int batch;		/* incremented every time a batch starts */
+    int quit;
+};
+
+static int slice_mt_helper (void * arg)
+{
+    slice_helper_t * helper = (slice_helper_t *) arg;
+    slice_mt_t * mt = helper->mt;
+    unsigned int batch = 0;
+    int i;
+
+    SDL_mutexP (mt->mutex);
+    while (1) {
+	while (!mt->quit && mt->batch == batch)
+	    SDL_CondWait (mt->work_cond, mt->mutex);
+	if (mt->quit)
+	    break;
+	batch = mt->batch;
+
+	memcpy (helper->decoder, &(mt->picture), sizeof (decoder_t));
+
+	while (mt->next_job < mt->nb_jobs) {
+	    i = mt->next_job++;
+	    SDL_mutexV (mt->mutex);
+	    mpeg2_slice (helper->decoder, mt->job[i].code, mt->job[i].buffer);
+	    SDL_mutexP (mt->mutex);
+	}
+
+	if (!--(mt->busy))
+	    SDL_CondSignal (mt->done_cond);
+    }
+    SDL_mutexV (mt->mutex);
+
+    return 0;
+}
+
+slice_mt_t * mpeg2_slice_mt_open (int threads)
+{
+    slice_mt_t * mt;
+    int i;
+
+    if (threads > SLICE_MT_MAX_THREADS)
+	threads = SLICE_MT_MAX_THREADS;
+    if (threads < 2)
+	return NULL;
+
+    mt = (slice_mt_t *) mpeg2_malloc (sizeof (slice_mt_t), ALLOC_SLICE_MT);
+    if (mt == NULL)
+	return NULL;
+    memset (mt, 0, sizeof (slice_mt_t));
+
+    mt->mutex = SDL_CreateMutex ();
+    mt->work_cond = SDL_CreateCond ();
+    mt->done_cond = SDL_CreateCond ();
+    if (!mt->mutex || !mt->work_cond || !mt->done_cond) {
+	mpeg2_slice_mt_close (mt);
+	return NULL;
+    }
+
+    /* the calling thread decodes slices too, so it counts as one */
+    for (i = 0; i < threads - 1; i++) {
+	slice_helper_t * helper = &(mt->helper[mt->nb_helpers]);
+
+	helper->mt = mt;
+	helper->decoder = (decoder_t *) mpeg2_malloc (sizeof (decoder_t),
+						      ALLOC_SLICE_MT);
+	if (helper->decoder == NULL)
+	    break;
+	helper->thread = SDL_CreateThread (slice_mt_helper, helper);
+	if (helper->thread == NULL) {
+	    mpeg2_free (helper->decoder);
+	    break;
+	}
+	mt->nb_helpers++;
+    }
+
+    if (!mt->nb_helpers) {
+	mpeg2_slice_mt_close (mt);
+	return NULL;
+    }
+
+    return mt;
+}
+
+void mpeg2_slice_mt_close (slice_mt_t * mt)
+{
+    int i;
+
+    if (mt == NULL)
+	return;
+
+    if (mt->nb_helpers) {
+	SDL_mutexP (mt->mutex);
+	mt->quit = 1;
+	SDL_CondBroadcast (mt->work_cond);
+	SDL_mutexV (mt->mutex);
+
+	for (i = 0; i < mt->nb_helpers; i++) {
+	    SDL_WaitThread (mt->helper[i].thread, NULL);
+	    mpeg2_free (mt->helper[i].decoder);
+	}
+    }
+
+    if (mt->done_cond)
+	SDL_DestroyCond (mt->done_cond);
+    if (mt->work_cond)
+	SDL_DestroyCond (mt->work_cond);
+    if (mt->mutex)
+	SDL_DestroyMutex (mt->mutex);
+    mpeg2_free (mt);
+}
+
+int mpeg2_slice_mt_queue (slice_mt_t * mt, int code, const uint8_t * buffer)
+{
+    if (mt->nb_jobs == SLICE_MT_MAX_JOBS)
+	return 0;
+
+    mt->job[mt->nb_jobs].code = code;
+    mt->job[mt->nb_jobs].buffer = buffer;
+    mt->nb_jobs++;
+    return 1;
+}
+
+int mpeg2_slice_mt_pending (slice_mt_t * mt)
+{
+    return mt->nb_jobs;
+}
+
+void mpeg2_slice_mt_discard (slice_mt_t * mt)
+{
+    mt->nb_jobs = 0;
+}
+
+void mpeg2_slice_mt_run (slice_mt_t * mt, decoder_t * decoder)
+{
+    int i;
+
+    /* a lone slice isn't worth waking the helpers up for */
+    if (mt->nb_jobs < 2) {
+	if (mt->nb_jobs)
+	    mpeg2_slice (decoder, mt->job[0].code, mt->job[0].buffer);
+	mt->nb_jobs = 0;
+	return;
+    }
+
+    memcpy (&(mt->picture), decoder, sizeof (decoder_t));
+
+    SDL_mutexP (mt->mutex);
+    mt->next_job = 0;
+    mt->busy = mt->nb_helpers;
+    mt->batch++;
+    SDL_CondBroadcast (mt->work_cond);
+
+    while (mt->next_job < mt->nb_jobs) {
+	i = mt->next_job++;
+	SDL_mutexV (mt->mutex);
+	mpeg2_slice (decoder, mt->job[i].code, mt->job[i].buffer);
+	SDL_mutexP (mt->mutex);
+    }
+
+    /* every helper has to check in, even if there was nothing left for it */
+    while (mt->busy)
+	SDL_CondWait (mt->done_cond, mt->mutex);
+    mt->nb_jobs = 0;
+    SDL_mutexV (mt->mutex);
+}
@@ -40,7 +40,9 @@ struct yuv_buf g_yuv_buf[YUV_BUF_COUNT];
 
 ////
 
-static void null_draw_frame (vo_instance_t *instance, uint8_t * const * buf, void *id)
+// shows a decoded frame when it's due (or skips or drops it), and takes care of pausing and multi-speed playback
+// If bElided is set, libmpeg2 didn't decode the frame, so it gets dropped instead of shown.
+void null_present_frame(struct yuv_buf *pBuf, VLDP_BOOL bElided)
 {
     Sint32 correct_elapsed_ms = 0;	// we want this signed since we compare against actual_elapsed_ms
     Sint32 actual_elapsed_ms = 0;	// we want this signed because it could be negative
@@ -82,7 +84,8 @@ static void null_draw_frame (vo_instance_t *instance, uint8_t * const * buf, voi
 				// this is the potentially expensive callback that gets the hardware overlay
 				// ready to be displayed, so we do this before we sleep
 				// NOTE : if this callback fails, we don't want to display the frame due to double buffering considerations
-				if (g_in_info->prepare_frame(&g_yuv_buf[(int) id]))
+				// (if libmpeg2 was told not to decode this frame, the buffer holds garbage, so it gets dropped instead)
+				if (!bElided && g_in_info->prepare_frame(pBuf))
 				{
 #ifndef VLDP_BENCHMARK
 				
@@ -93,7 +96,9 @@ static void null_draw_frame (vo_instance_t *instance, uint8_t * const * buf, voi
 						// IMPORTANT: this delay should come before the check for ivldp_got_new_command,
 						//  so that if we get a new command, we exit the loop immediately without
 						//  delaying, so that we don't have to check a second time for a new command.
-	    				SDL_Delay(1);	// note, if this is set to 0, we don't get commands as quickly
+						// This sleeps until the parent moves uMsTimer up to when the frame is due (or a command comes in),
+						//  so the frame goes out on the ms that it should instead of whenever a 1 ms sleep wakes up.
+						ivldp_wait_for_ms_timer(s_timer + correct_elapsed_ms);
 
 						// Breaking when getting a new commend before our frame has expired
 						//  will shorten 1 frame's length.  However, it could speed skips up,
@@ -103,7 +108,7 @@ static void null_draw_frame (vo_instance_t *instance, uint8_t * const * buf, voi
 						if (ivldp_got_new_command())
 						{
 							// strip off count and examine command
-							switch(g_req_cmdORcount & 0xF0)
+							switch(ivldp_cur_cmd())
 							{
 							case VLDP_REQ_PAUSE:
 							case VLDP_REQ_STEP_FORWARD:
@@ -132,8 +137,14 @@ static void null_draw_frame (vo_instance_t *instance, uint8_t * const * buf, voi
 					{
 #endif
 						// draw the frame
-						// we are using the pointer 'id' as an index, kind of risky, but convenient :)
-						g_in_info->display_frame(&g_yuv_buf[(int) id]);
+						g_in_info->display_frame(pBuf);
+						ivldp_seek_frame_shown();	// if we just skipped, the skip is finished now
+
+						// if this is the frame we searched to, hang onto it in case we search to it again
+						if (s_uFrameCacheStoreFrame != 0)
+						{
+							ivldp_frame_cache_store(pBuf);
+						}
 #ifndef VLDP_BENCHMARK
 					} // end if we didn't get a new command to interrupt the frame being displayed
 #endif
@@ -268,6 +279,19 @@ static void null_draw_frame (vo_instance_t *instance, uint8_t * const * buf, voi
 	// end MATT
 }
 
+static void null_draw_frame (vo_instance_t *instance, uint8_t * const * buf, void *id)
+{
+	// we are using the pointer 'id' as an index, kind of risky, but convenient :)
+	struct yuv_buf *pBuf = &g_yuv_buf[(int) id];
+
+	// if frames are being decoded ahead, the frame gets queued up and is shown later on by the presentation stage,
+	//  otherwise we show it now
+	if (!ivldp_ahead_queue_frame(pBuf, s_bFrameElided))
+	{
+		null_present_frame(pBuf, s_bFrameElided);
+	}
+}
+
 static void null_setup_fbuf (vo_instance_t * _instance,
 			    uint8_t ** buf, void ** id)
 {
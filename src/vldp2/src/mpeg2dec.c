@@ -46,6 +46,20 @@ static mpeg2dec_t * mpeg2dec;
 static vo_open_t * output_open = NULL;
 static vo_instance_t * output;
 
+/* for -a, so that each kind of acceleration can be checked on its own */
+static struct {
+    const char * name;
+    uint32_t accel;
+} accels[] = {
+    {"c", 0},
+    {"mmx", MPEG2_ACCEL_X86_MMX},
+    {"mmxext", MPEG2_ACCEL_X86_MMX | MPEG2_ACCEL_X86_MMXEXT},
+    {"3dnow", MPEG2_ACCEL_X86_MMX | MPEG2_ACCEL_X86_3DNOW},
+    {"sse2", MPEG2_ACCEL_X86_SSE2},
+    {"avx2", MPEG2_ACCEL_X86_SSE2 | MPEG2_ACCEL_X86_AVX2},
+    {NULL, 0}
+};
+
 static void handle_args (int argc, char ** argv)
 {
     int c;
@@ -53,7 +67,7 @@ static void handle_args (int argc, char ** argv)
     int i;
 
     drivers = vo_drivers ();
-    while ((c = getopt (argc, argv, "s::t:pco:")) != -1)
+    while ((c = getopt (argc, argv, "s::t:pca:o:")) != -1)
 	switch (c) {
 	case 'o':
 	    for (i = 0; drivers[i].name != NULL; i++)
@@ -64,6 +78,21 @@ static void handle_args (int argc, char ** argv)
 	    }
 	    break;
 
+	case 'c':
+	    mpeg2_accel (0);
+	    break;
+
+	case 'a':
+	    for (i = 0; accels[i].name != NULL; i++)
+		if (strcmp (accels[i].name, optarg) == 0)
+		    break;
+	    if (accels[i].name == NULL) {
+		fprintf (stderr, "Invalid acceleration: %s\n", optarg);
+		exit (1);
+	    }
+	    mpeg2_accel (accels[i].accel);
+	    break;
+
 	default:
 		printf("Bad command line\n");
 	}
@@ -60,318 +60,923 @@ Sample mpeg2 byte sequence: 00 00 01 B5 25 06 06 06 0B 42 0F 00
 
 */
 
+// This scans mpeg video streams to find where each picture begins, so that VLDP can seek to any frame.
+// A stream is split up into chunks which are scanned in parallel (one thread per cpu core), and several
+//  streams can be scanned at the same time, so the first launch of a game with lots of video doesn't take forever.
+// Each chunk's results are appended to a journal file (.dat.part) as soon as the chunk is finished, so if the
+//  scan is interrupted, it picks up where it left off the next time.
+
 #include <stdio.h>
 #include <stdlib.h>	// for malloc
+#include <string.h>
+#include "vldp_common.h"
+#include "vldp_internal.h"	// for dat_header
 #include "mpegscan.h"
 
-unsigned char g_last_three[3] = { 0 };		// the last 3 bytes read
-unsigned int g_last_three_loc[3] = { 0 };	// the position of the last 3 bytes read
+#ifdef WIN32
+#include <windows.h>	// for GetSystemInfo and MoveFileEx
+#else
+#include <unistd.h>	// for sysconf
+#endif
+
+// how many bytes of the stream each worker thread scans at a time
+#define MPEGSCAN_CHUNK_SIZE (4 * 1024 * 1024)
+
+// how many bytes past the end of a chunk we may need, to finish reading a header that began inside the chunk
+#define MPEGSCAN_OVERLAP 16
+
+// how many bytes before the beginning of a chunk we need, to recognize a start code that begins right at the start of the chunk
+#define MPEGSCAN_PREROLL 3
+
+// the most worker threads we will start, regardless of how many cpu cores there are
+#define MPEGSCAN_MAX_THREADS 16
 
-int g_last_three_pos = 0;
-int g_iframe_count = 0;
-int g_pframe_count = 0;
-int g_bframe_count = 0;
-int g_gop_count = 0;	// group of picture count
-int g_curframe = 0;
-unsigned int g_goppos = 0;
-unsigned int g_filepos = 0;	// where we are in the file
-unsigned int g_frame_type = 0;	// I, P, B frame, etc
-unsigned int g_last_header_pos = 0;	// the position of the last header we've parsed
+// journal stuff
+#define MPEGSCAN_PART_MAGIC "VPRT"
+#define MPEGSCAN_PART_VERSION 1
 
-int g_fields_detected = 0;	// whether the stream uses fields
-int g_frames_detected = 0;	// whether the stream uses frames (these are both here to detect errors)
+// flags that describe what a chunk found (also stored in the journal)
+#define CHUNK_FIELDS_DETECTED 1	// found at least one picture that was a field
+#define CHUNK_FRAMES_DETECTED 2	// found at least one picture that was a full frame
+#define CHUNK_GOP_PENDING 4	// found a GOP header after the last picture (so the next chunk's first picture starts a GOP)
 
 enum { IN_NOTHING, IN_PIC, IN_PIC_EXT };
-int g_status = 0;	// whether we are in a special area (inside a picture header, for example)
-int g_rel_pos = 0;	// which byte of the special area we are in (relative position)
 
-// 1 = sequence_ext, 2 = sequence_display_ext, 8 = picture_coding_ext
-unsigned char g_ext_type = 0;
+struct mpegscan_file
+{
+	char mpeg_name[STRSIZE];	// the stream being scanned
+	char dat_name[STRSIZE];	// the index we're creating
+	char part_name[STRSIZE];	// the journal that holds finished chunks until the whole stream is done
+	Uint32 uSize;	// size of the stream
+	unsigned int uFirstChunk;	// index (into the job's chunk array) of the stream's first chunk
+	unsigned int uChunkCount;	// how many chunks the stream was split into
+	FILE *journal;	// the open journal (NULL if it couldn't be created, in which case we just can't resume)
+	VLDP_BOOL bError;	// whether anything went wrong with this stream
+};
+
+struct mpegscan_chunk
+{
+	struct mpegscan_file *file;	// which stream this chunk belongs to
+	unsigned int uIndex;	// which chunk of the stream this is (0 is the first)
+	Uint32 uStart;	// first byte of the chunk
+	Uint32 uEnd;	// last byte of the chunk + 1
+	VLDP_BOOL bDone;	// whether this chunk has been scanned (or was loaded from the journal)
+	struct mpegscan_picture *pPictures;	// the pictures that begin inside this chunk (in stream order)
+	unsigned int uCount;	// how many entries pPictures holds
+	unsigned int uAlloc;	// how many entries pPictures has room for
+	Uint8 u8Flags;	// CHUNK_xxx flags
+};
+
+struct mpegscan_job
+{
+	struct mpegscan_file *pFiles;
+	unsigned int uFileCount;
+	struct mpegscan_chunk *pChunks;
+	unsigned int uChunkCount;
+	unsigned int uNextChunk;	// the next chunk that a worker thread should pick up
+	unsigned int uChunksDone;	// how many chunks are finished or had to be given up on (for progress reporting)
+	unsigned int uWorkersLive;	// how many workers haven't returned yet (so we don't wait on workers that have quit)
+	SDL_mutex *mutex;	// protects everything in this struct that changes while the workers are running
+};
 
 /////////////////////////////////////////////////
 
-// resets all state variables to their initial values.  This needs to be called every time an mpeg is parsed
-void init_mpegscan()
+// returns how many cpu cores we can use
+static unsigned int mpegscan_cpu_count()
 {
-	int i = 0;
-	
-	// clear arrays
-	for (i = 0; i < 3; i++)
+	unsigned int result = 1;
+
+#ifdef WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	result = info.dwNumberOfProcessors;
+#else
+	long lCount = sysconf(_SC_NPROCESSORS_ONLN);
+	if (lCount > 0)
 	{
-		g_last_three[i] = 0;
-		g_last_three_loc[i] = 0;
+		result = (unsigned int) lCount;
 	}
-	g_last_three_pos = 0;
-	g_iframe_count = 0;
-	g_pframe_count = 0;
-	g_bframe_count = 0;
-	g_gop_count = 0;	// group of picture count
-	g_curframe = 0;
-	g_goppos = 0;
-	g_filepos = 0;	// where we are in the file
-	g_frame_type = 0;
-	g_last_header_pos = 0;
-	g_status = 0;
-	g_rel_pos = 0;
-	g_fields_detected = 0;	// assume we don't use fields
-	g_frames_detected = 0;	// " " " frames
-	g_ext_type = 0;
+#endif
+
+	if (result < 1) result = 1;
+	if (result > MPEGSCAN_MAX_THREADS) result = MPEGSCAN_MAX_THREADS;
+
+	return result;
 }
 
-/*
-int get_next_byte(FILE *F)
+// adds a picture to the end of a chunk's picture list, returns VLDP_FALSE if we ran out of memory
+static VLDP_BOOL mpegscan_add_picture(struct mpegscan_chunk *chunk, Uint32 uPos, Uint8 u8Flags)
 {
-	g_filepos++;
-	g_rel_pos++;
-	return getc(F);
+	if (chunk->uCount == chunk->uAlloc)
+	{
+		unsigned int uNewAlloc = (chunk->uAlloc != 0) ? (chunk->uAlloc << 1) : 1024;
+		struct mpegscan_picture *pNew = (struct mpegscan_picture *) realloc(chunk->pPictures, uNewAlloc * sizeof(struct mpegscan_picture));
+		if (!pNew)
+		{
+			return VLDP_FALSE;
+		}
+		chunk->pPictures = pNew;
+		chunk->uAlloc = uNewAlloc;
+	}
+
+	chunk->pPictures[chunk->uCount].pos = uPos;
+	chunk->pPictures[chunk->uCount].flags = u8Flags;
+	chunk->uCount++;
+
+	return VLDP_TRUE;
 }
-*/
 
-// skip ahead number of bytes in the file stream
-/*
-void skip_bytes (FILE *F, long bytes_to_skip)
+// scans one chunk of a stream
+// 'buf' holds the chunk (plus preroll and overlap), and 'uBufPos' is the position in the stream of buf[0]
+// Only headers that begin inside the chunk count, so that each picture is found by exactly one chunk.
+static VLDP_BOOL mpegscan_scan_chunk(struct mpegscan_chunk *chunk, const Uint8 *buf, unsigned int uBufLen, Uint32 uBufPos)
 {
-	fseek(F, bytes_to_skip, SEEK_CUR);
-	g_filepos += bytes_to_skip;
+	Uint32 uLastThree = 0xFFFFFF;	// the last 3 bytes we've seen (so we can spot 00 00 01)
+	int status = IN_NOTHING;	// whether we are in a special area (inside a picture header, for example)
+	int rel_pos = 0;	// which byte of the special area we are in (relative position)
+	unsigned int frame_type = 0;	// I, P, B frame, etc
+	Uint32 uHeaderPos = 0;	// the position of the header we're in the middle of
+	Uint8 ext_type = 0;	// 1 = sequence_ext, 2 = sequence_display_ext, 8 = picture_coding_ext
+	VLDP_BOOL bGOPPending = VLDP_FALSE;	// whether the next picture is the first in a GOP
+	unsigned int i = 0;
+
+	for (i = 0; i < uBufLen; i++)
+	{
+		Uint32 uPos = uBufPos + i;
+		Uint8 ch = buf[i];
+
+		// if we are in the middle of a picture header
+		if (status == IN_PIC)
+		{
+			// the first two bytes after the picture start code hold the temporal reference and the picture type
+			if (rel_pos == 0)
+			{
+				frame_type = ch << 8;
+			}
+			else
+			{
+				frame_type = ((frame_type | ch) >> 3) & 7;	// isolate frame type
+
+				if (!mpegscan_add_picture(chunk, uHeaderPos,
+					(Uint8) ((frame_type & MPEGSCAN_TYPE_MASK) | (bGOPPending ? MPEGSCAN_GOP_START : 0))))
+				{
+					return VLDP_FALSE;
+				}
+				bGOPPending = VLDP_FALSE;
+				status = IN_NOTHING;	// we got what we came for
+			}
+			rel_pos++;
+		}
+
+		// if we're in an extension header
+		else if (status == IN_PIC_EXT)
+		{
+			// if we're about to get the EXT type
+			if (rel_pos == 0)
+			{
+				ext_type = ch >> 4;
+			}
+
+			// this is where we either find out if we're using fields/frames or eject
+			// (the sequence_ext progressive flag is just a hint and can be wrong, so we can't rely on it)
+			else if (rel_pos >= 2)
+			{
+				// if we have ext type 8 (picture_coding_ext), we can see if this picture is a frame or a field
+				if (ext_type == 8)
+				{
+					Uint8 u8Val = ch & 3;
+
+					// 1 is the code for TOP FIELD, 2 is the code for BOTTOM_FIELD
+					if ((u8Val == 1) || (u8Val == 2))
+					{
+						chunk->u8Flags |= CHUNK_FIELDS_DETECTED;
+					}
+					// 3 is code for a full image
+					else if (u8Val == 3)
+					{
+						chunk->u8Flags |= CHUNK_FRAMES_DETECTED;
+					}
+				}
+				// else other ext type which we ignore ...
+
+				status = IN_NOTHING;
+			}
+			rel_pos++;
+		}
+
+		// else if we're looking for a new header and the last 3 bytes were a start code prefix
+		else if (uLastThree == 0x000001)
+		{
+			uHeaderPos = uPos - 3;
+
+			// if the header began after this chunk, the next chunk will take care of it, so we're done
+			if (uHeaderPos >= chunk->uEnd)
+			{
+				break;
+			}
+
+			// if the header began before this chunk, the previous chunk took care of it
+			if (uHeaderPos >= chunk->uStart)
+			{
+				switch (ch)
+				{
+				case 0:	// picture
+					status = IN_PIC;
+					rel_pos = 0;
+					break;
+				case 0xB5:	// extension header
+					status = IN_PIC_EXT;
+					rel_pos = 0;
+					break;
+				case 0xB8:	// Group of Pictures
+					bGOPPending = VLDP_TRUE;
+					break;
+				default:
+					break;
+				}
+			}
+		}
+
+		uLastThree = ((uLastThree << 8) | ch) & 0xFFFFFF;
+	}
+
+	if (bGOPPending)
+	{
+		chunk->u8Flags |= CHUNK_GOP_PENDING;
+	}
+
+	return VLDP_TRUE;
+}
+
+// appends a finished chunk to its stream's journal
+static void mpegscan_journal_write(struct mpegscan_chunk *chunk)
+{
+	FILE *F = chunk->file->journal;
+	Uint32 uHeader[3];
+	unsigned int u = 0;
+
+	if (!F)
+	{
+		return;
+	}
+
+	uHeader[0] = chunk->uIndex;
+	uHeader[1] = chunk->u8Flags;
+	uHeader[2] = chunk->uCount;
+	fwrite(uHeader, sizeof(uHeader), 1, F);
+	for (u = 0; u < chunk->uCount; u++)
+	{
+		fwrite(&chunk->pPictures[u].pos, sizeof(Uint32), 1, F);
+		fwrite(&chunk->pPictures[u].flags, sizeof(Uint8), 1, F);
+	}
+	fflush(F);	// so that it's on disk if we get interrupted
 }
-*/
 
-// return the last 3 bytes that have been read, storing them in a, b, and c
-// a is the most recent byte, c is the oldest
-// for example, a header of 0 0 1 would be a = 1, b = 0, c = 0
-// header is the position of the 'c' byte (oldest byte)
-void get_last_three(unsigned char *a, unsigned char *b, unsigned char *c, unsigned int *header)
+// frees the pictures that a chunk found
+static void mpegscan_chunk_free(struct mpegscan_chunk *chunk)
 {
+	free(chunk->pPictures);
+	chunk->pPictures = NULL;
+	chunk->uCount = chunk->uAlloc = 0;
+	chunk->u8Flags = 0;
+}
 
-	int count = 0;
-	unsigned char result[3] = { 0 };
-	int pos = g_last_three_pos;
+// loads any chunks that were finished during a previous (interrupted) scan of 'file', then
+//  starts a fresh journal that holds just those chunks.
+// Returns how many chunks were loaded.
+static unsigned int mpegscan_journal_open(struct mpegscan_job *job, struct mpegscan_file *file)
+{
+	unsigned int uLoaded = 0;
+	unsigned int u = 0;
+	char magic[4];
+	Uint32 uHeader[3];	// version, stream size, chunk size
+	FILE *F = fopen(file->part_name, "rb");
 
-	while (count < 3)
+	if (F)
 	{
-		pos--;
-		if (pos < 0)
+		// the journal is only any good if it goes with this exact stream and was split up the same way
+		if ((fread(magic, sizeof(magic), 1, F) == 1) && (memcmp(magic, MPEGSCAN_PART_MAGIC, 4) == 0) &&
+			(fread(uHeader, sizeof(uHeader), 1, F) == 1) && (uHeader[0] == MPEGSCAN_PART_VERSION) &&
+			(uHeader[1] == file->uSize) && (uHeader[2] == MPEGSCAN_CHUNK_SIZE))
 		{
-			pos = 2;
+			Uint32 uRecord[3];	// chunk index, flags, picture count
+
+			// if the last record got cut off, we stop there and that chunk gets scanned again
+			while (fread(uRecord, sizeof(uRecord), 1, F) == 1)
+			{
+				struct mpegscan_chunk *chunk = NULL;
+				VLDP_BOOL bOK = VLDP_TRUE;
+
+				if (uRecord[0] >= file->uChunkCount)
+				{
+					break;
+				}
+
+				chunk = &job->pChunks[file->uFirstChunk + uRecord[0]];
+				mpegscan_chunk_free(chunk);
+
+				for (u = 0; (u < uRecord[2]) && bOK; u++)
+				{
+					Uint32 uPos = 0;
+					Uint8 u8Flags = 0;
+					bOK = (fread(&uPos, sizeof(uPos), 1, F) == 1) && (fread(&u8Flags, sizeof(u8Flags), 1, F) == 1) &&
+						mpegscan_add_picture(chunk, uPos, u8Flags);
+				}
+
+				if (!bOK)
+				{
+					mpegscan_chunk_free(chunk);
+					if (chunk->bDone)
+					{
+						chunk->bDone = VLDP_FALSE;
+						uLoaded--;
+					}
+					break;
+				}
+
+				chunk->u8Flags = (Uint8) uRecord[1];
+				if (!chunk->bDone)
+				{
+					chunk->bDone = VLDP_TRUE;
+					uLoaded++;
+				}
+			}
 		}
+		fclose(F);
+	}
 
-		result[count] = g_last_three[pos];
-		*header = g_last_three_loc[pos];	// this works out so that the oldest value is the final value
-		count++;
+	// start a fresh journal so a half-written record from last time doesn't get in the way
+	file->journal = fopen(file->part_name, "wb");
+	if (file->journal)
+	{
+		uHeader[0] = MPEGSCAN_PART_VERSION;
+		uHeader[1] = file->uSize;
+		uHeader[2] = MPEGSCAN_CHUNK_SIZE;
+		fwrite(MPEGSCAN_PART_MAGIC, 4, 1, file->journal);
+		fwrite(uHeader, sizeof(uHeader), 1, file->journal);
+
+		for (u = 0; u < file->uChunkCount; u++)
+		{
+			if (job->pChunks[file->uFirstChunk + u].bDone)
+			{
+				mpegscan_journal_write(&job->pChunks[file->uFirstChunk + u]);
+			}
+		}
+		fflush(file->journal);
+	}
+	else
+	{
+		fprintf(stderr, "VLDP : couldn't create %s, if this scan is interrupted it will have to start over\n", file->part_name);
 	}
 
-	*a = result[0];	// newest
-	*b = result[1];
-	*c = result[2];	// oldest
+	if (uLoaded != 0)
+	{
+		fprintf(stderr, "VLDP : resuming scan of %s (%u of %u chunks were already done)\n", file->mpeg_name, uLoaded, file->uChunkCount);
+	}
 
+	return uLoaded;
 }
 
-
-// updates the last 3 values that we've read, replacing the oldest one with 'val'
-// pos is the position of the 'val' in the file
-void add_to_last_three(unsigned char val, unsigned int pos)
+// reads in one chunk (plus the bytes on either side of it that we need) and scans it
+static VLDP_BOOL mpegscan_read_and_scan(struct mpegscan_chunk *chunk, Uint8 *buf)
 {
-	g_last_three[g_last_three_pos] = val;
-	g_last_three_loc[g_last_three_pos] = pos;
-	g_last_three_pos++;
-	if (g_last_three_pos > 2)
+	VLDP_BOOL bResult = VLDP_FALSE;
+	Uint32 uReadStart = (chunk->uStart >= MPEGSCAN_PREROLL) ? (chunk->uStart - MPEGSCAN_PREROLL) : 0;
+	Uint32 uReadEnd = chunk->uEnd + MPEGSCAN_OVERLAP;
+	FILE *F = NULL;
+
+	if ((uReadEnd > chunk->file->uSize) || (uReadEnd < chunk->uEnd))
+	{
+		uReadEnd = chunk->file->uSize;
+	}
+
+	// each worker opens the file itself so that the workers never have to fight over a file position
+	F = fopen(chunk->file->mpeg_name, "rb");
+	if (F)
 	{
-		g_last_three_pos = 0;
+		size_t len = uReadEnd - uReadStart;
+
+		if ((fseek(F, uReadStart, SEEK_SET) == 0) && (fread(buf, 1, len, F) == len))
+		{
+			bResult = mpegscan_scan_chunk(chunk, buf, (unsigned int) len, uReadStart);
+		}
+		fclose(F);
 	}
+
+	return bResult;
 }
 
-// parses from file stream, length # of bytes
-// writes results to the open datafile
-// returns stat codes
-int parse_video_stream(FILE *datafile, unsigned int length)
+// each worker thread runs this, scanning chunks until there are none left
+// (whoever starts a worker must add it to job->uWorkersLive first, the worker takes itself off when it returns)
+static int mpegscan_worker(void *pData)
 {
-	int result = P_IN_PROGRESS;
-	int ch = 0;
-	unsigned int start_pos = g_filepos;
-	const int minus_one = -1;
-	unsigned int buf_index = 0;
-	size_t bytes_read = 0;
-	unsigned char *buf = (unsigned char *) malloc(length);	// allocate a chunk of memory to read in file
+	struct mpegscan_job *job = (struct mpegscan_job *) pData;
+	Uint8 *buf = (Uint8 *) malloc(MPEGSCAN_PREROLL + MPEGSCAN_CHUNK_SIZE + MPEGSCAN_OVERLAP);
 
+	// if we can't get memory, the other workers (or the calling thread) will have to pick up the slack
 	if (!buf)
 	{
-		return P_ERROR;
+		SDL_mutexP(job->mutex);
+		job->uWorkersLive--;
+		SDL_mutexV(job->mutex);
+		return 0;
 	}
 
-	bytes_read = io_read(buf, length);	// read in a chunk
-
-	// parse this chunk of video
-	while (g_filepos  - start_pos < length)
+	for (;;)
 	{
-		// this should always be true unless we hit EOF
-		if (buf_index < bytes_read)
-		{
-			g_filepos++;
-			g_rel_pos++;
-			ch = buf[buf_index++];
-		}
-		// if we've hit EOF
-		else
+		struct mpegscan_chunk *chunk = NULL;
+		VLDP_BOOL bOK = VLDP_FALSE;
+
+		// grab the next chunk that needs scanning
+		SDL_mutexP(job->mutex);
+		while (job->uNextChunk < job->uChunkCount)
 		{
-			// if we're certain we're using fields
-			if ((g_fields_detected) && (!g_frames_detected))
+			struct mpegscan_chunk *pNext = &job->pChunks[job->uNextChunk++];
+			if (!pNext->bDone && !pNext->file->bError)
 			{
-				result = P_FINISHED_FIELDS;
+				chunk = pNext;
+				break;
 			}
-			// else if we're certain we're not using fields
-			// (for mpeg1 g_fields_detected and g_frames_detected will both be 0)
-			else if (!g_fields_detected)
+
+			// the rest of a file that had an error won't get scanned, but it still has to count as finished
+			if (!pNext->bDone)
 			{
-				result = P_FINISHED_FRAMES;
+				job->uChunksDone++;
 			}
-			// else we can't determine what's going on, so do an error to be safe
-			else
+		}
+		SDL_mutexV(job->mutex);
+
+		// if there is nothing left to do
+		if (!chunk)
+		{
+			break;
+		}
+
+		bOK = mpegscan_read_and_scan(chunk, buf);
+
+		SDL_mutexP(job->mutex);
+		if (bOK)
+		{
+			chunk->bDone = VLDP_TRUE;
+			mpegscan_journal_write(chunk);
+		}
+		else
+		{
+			fprintf(stderr, "VLDP : error scanning %s at position %u\n", chunk->file->mpeg_name, chunk->uStart);
+			chunk->file->bError = VLDP_TRUE;
+		}
+		job->uChunksDone++;
+		SDL_mutexV(job->mutex);
+	}
+
+	SDL_mutexP(job->mutex);
+	job->uWorkersLive--;
+	SDL_mutexV(job->mutex);
+
+	free(buf);
+	return 0;
+}
+
+// puts all of a stream's chunks together and writes out its .dat file
+static VLDP_BOOL mpegscan_write_index(struct mpegscan_job *job, struct mpegscan_file *file)
+{
+	VLDP_BOOL bResult = VLDP_FALSE;
+	struct mpegscan_chunk *pChunks = &job->pChunks[file->uFirstChunk];
+	struct dat_header header;
+	Uint32 uCounts[2] = { 0, 0 };	// how many pictures, how many I frames
+	Uint8 u8Flags = 0;
+	VLDP_BOOL bGOPPending = VLDP_FALSE;
+	char tmp_name[STRSIZE + 4];
+	unsigned int u = 0, v = 0;
+	FILE *F = NULL;
+
+	for (u = 0; u < file->uChunkCount; u++)
+	{
+		// a GOP header at the very end of one chunk belongs to the first picture of a later chunk
+		if (bGOPPending && (pChunks[u].uCount != 0))
+		{
+			pChunks[u].pPictures[0].flags |= MPEGSCAN_GOP_START;
+			bGOPPending = VLDP_FALSE;
+		}
+		if (pChunks[u].u8Flags & CHUNK_GOP_PENDING)
+		{
+			bGOPPending = VLDP_TRUE;
+		}
+
+		u8Flags |= pChunks[u].u8Flags;
+		uCounts[0] += pChunks[u].uCount;
+		for (v = 0; v < pChunks[u].uCount; v++)
+		{
+			if ((pChunks[u].pPictures[v].flags & MPEGSCAN_TYPE_MASK) == MPEGSCAN_TYPE_I)
 			{
-				result = P_ERROR;
+				uCounts[1]++;
 			}
-			break; // end loop
 		}
+	}
+
+	// if we found both fields and frames, we can't determine what's going on, so do an error to be safe
+	// (for mpeg1, neither will be detected, which means frames)
+	if ((u8Flags & CHUNK_FIELDS_DETECTED) && (u8Flags & CHUNK_FRAMES_DETECTED))
+	{
+		fprintf(stderr, "VLDP : %s seems to use both fields and frames, so it can't be indexed\n", file->mpeg_name);
+		return VLDP_FALSE;
+	}
+
+	header.version = DAT_VERSION;
+	header.finished = 1;
+	header.uses_fields = (u8Flags & CHUNK_FIELDS_DETECTED) ? 1 : 0;
+	header.length = file->uSize;
 
-		// We must make sure we only process 1 byte per iteration of this loop so that we don't
-		// exceed the maximum length.
+	// write to a temporary file first, so that a half-written .dat never gets used
+	sprintf(tmp_name, "%s.tmp", file->dat_name);
+	F = fopen(tmp_name, "wb");
+	if (F)
+	{
+		VLDP_BOOL bOK = (fwrite(&header, sizeof(header), 1, F) == 1) && (fwrite(uCounts, sizeof(uCounts), 1, F) == 1);
 
-		// if we are in the middle of a frame header
-		if (g_status == IN_PIC)
+		// first the flags of every picture, one byte each ...
+		for (u = 0; (u < file->uChunkCount) && bOK; u++)
 		{
-			// if we need the first byte following a frame header
-			if (g_rel_pos == 0)
+			for (v = 0; (v < pChunks[u].uCount) && bOK; v++)
 			{
-				g_frame_type = ch << 8;
+				bOK = (fwrite(&pChunks[u].pPictures[v].flags, 1, 1, F) == 1);
 			}
-			// else if we need the second byte following a frame header
-			else if (g_rel_pos == 1)
-			{
-				g_frame_type = g_frame_type | ch;
-				g_frame_type = (g_frame_type >> 3) & 3;	// isolate frame type
+		}
 
-				// examine which type of frame we've found
-				switch (g_frame_type)
+		// ... then the position of every I frame (the only frames we can seek to)
+		for (u = 0; (u < file->uChunkCount) && bOK; u++)
+		{
+			for (v = 0; (v < pChunks[u].uCount) && bOK; v++)
+			{
+				if ((pChunks[u].pPictures[v].flags & MPEGSCAN_TYPE_MASK) == MPEGSCAN_TYPE_I)
 				{
-				case 1:		// I frame
-					g_iframe_count++;
-					fwrite(&g_last_header_pos, sizeof(g_last_header_pos), 1, datafile);	// actual beginning of I frame
-#ifdef VLDP_DEBUG
-//					fprintf(stderr, "Found an I frame at %x\n", g_last_header_pos);
-#endif
-					break;
-				default:	// if it's not an I frame, just write -1
-					fwrite(&minus_one, sizeof(minus_one), 1, datafile);
-#ifdef VLDP_DEBUG
-//					fprintf(stderr, "Found a non I frame at %x\n", g_last_header_pos);
-#endif
-					break;
+					bOK = (fwrite(&pChunks[u].pPictures[v].pos, sizeof(Uint32), 1, F) == 1);
 				}
-				g_status = IN_NOTHING;	// we got what we came for, now get it :)
-			} // end if we are on the second byte of the picture
-		} // end if we're in a frame header
-		
-		// if we're in a picture header extension ...
-		else if (g_status == IN_PIC_EXT)
+			}
+		}
+
+		if (fclose(F) != 0)
 		{
-			// if we're about to get the EXT type
-			if (g_rel_pos == 0)
+			bOK = VLDP_FALSE;
+		}
+
+		// only replace the old index once the new one is completely written, and do it in one step
+		// (if anything goes wrong, the old index is left alone)
+		if (bOK)
+		{
+#ifdef WIN32
+			// rename won't replace an existing file on windows, but MoveFileEx will
+			bResult = MoveFileExA(tmp_name, file->dat_name, MOVEFILE_REPLACE_EXISTING) ? VLDP_TRUE : VLDP_FALSE;
+#else
+			bResult = (rename(tmp_name, file->dat_name) == 0) ? VLDP_TRUE : VLDP_FALSE;
+#endif
+		}
+
+		if (!bResult)
+		{
+			remove(tmp_name);
+		}
+	}
+
+	if (!bResult)
+	{
+		fprintf(stderr, "Could not create file %s\n", file->dat_name);
+		fprintf(stderr, "This probably means you don't have permission to create the file\n");
+	}
+
+	return bResult;
+}
+
+// returns VLDP_TRUE if 'dat_name' is a finished, up-to-date index for a stream that is 'uMpegSize' bytes long
+// If 'ppFile' isn't NULL and the index is good, the file is left open (positioned right after the header) for the caller.
+static VLDP_BOOL mpegscan_index_is_valid(const char *dat_name, Uint32 uMpegSize, FILE **ppFile)
+{
+	VLDP_BOOL bResult = VLDP_FALSE;
+	struct dat_header header;
+	FILE *F = fopen(dat_name, "rb");
+
+	if (F)
+	{
+		// if version, file size, or finished are wrong, the dat file is no good and has to be regenerated
+		if ((fread(&header, sizeof(header), 1, F) == 1) &&
+			(header.version == DAT_VERSION) && (header.finished == 1) && (header.length == uMpegSize))
+		{
+			bResult = VLDP_TRUE;
+		}
+
+		if (bResult && ppFile)
+		{
+			*ppFile = F;
+		}
+		else
+		{
+			fclose(F);
+		}
+	}
+
+	return bResult;
+}
+
+// returns the size of a file (or 0 if it can't be opened or is too big for us)
+static Uint32 mpegscan_file_size(const char *name)
+{
+	Uint32 uResult = 0;
+	FILE *F = fopen(name, "rb");
+
+	if (F)
+	{
+		if (fseek(F, 0L, SEEK_END) == 0)
+		{
+			long lSize = ftell(F);
+			if (lSize > 0)
 			{
-				g_ext_type = ch >> 4;
+				uResult = (Uint32) lSize;
 			}
+		}
+		fclose(F);
+	}
+
+	return uResult;
+}
+
+/////////////////////////////////////////////////
+
+void mpegscan_dat_name(char *dst, unsigned int uSize, const char *mpeg_name)
+{
+	size_t len = 0;
+
+	SAFE_STRCPY(dst, mpeg_name, uSize);
+
+	// change extension of file to be dat instead of (presumably) m2v
+	len = strlen(dst);
+	if (len >= 3)
+	{
+		strcpy(&dst[len - 3], "dat");
+	}
+}
 
-			// UPDATE : It seems that this information is just a hint of whether the mpeg is interlaced or progressive, and
-			//  may be wrong, so we cannot rely on this information.
-			/*
-			// if we have ext type 1 (sequence_ext) then we can see if it's frames or fields
-			else if ((g_rel_pos == 1) && (g_ext_type == 1))
+VLDP_BOOL mpegscan_build_indexes(const char *const *ppszMpegNames, unsigned int uCount, void (*report_progress)(double))
+{
+	VLDP_BOOL bResult = VLDP_TRUE;
+	struct mpegscan_job job;
+	SDL_Thread *threads[MPEGSCAN_MAX_THREADS];
+	unsigned int uThreadCount = 0;
+	unsigned int uChunksToDo = 0;
+	unsigned int u = 0, v = 0;
+
+	memset(&job, 0, sizeof(job));
+	job.pFiles = (struct mpegscan_file *) calloc((uCount != 0) ? uCount : 1, sizeof(struct mpegscan_file));
+	if (!job.pFiles)
+	{
+		return VLDP_FALSE;
+	}
+
+	// figure out which streams need to be scanned
+	for (u = 0; u < uCount; u++)
+	{
+		struct mpegscan_file *file = &job.pFiles[job.uFileCount];
+		VLDP_BOOL bDupe = VLDP_FALSE;
+
+		// it's legal for a framefile to list the same file more than once
+		for (v = 0; v < job.uFileCount; v++)
+		{
+			if (strcmp(job.pFiles[v].mpeg_name, ppszMpegNames[u]) == 0)
 			{
-				// are we progressive?
-				if (ch & 8)
-				{
-					g_frames_detected = 1;
-				}
-				// else we're using fields
-				else
-				{
-					g_fields_detected = 1;
-				}
-				g_status = IN_NOTHING;
+				bDupe = VLDP_TRUE;
 			}
-			*/
+		}
+		if (bDupe)
+		{
+			continue;
+		}
 
-			// this is where we either find out if we're using fields/frames or eject
-			else if (g_rel_pos >= 2)
-			{
-				// if we have ext type 8, then we can see if this uses frames or fields
-				if ((g_rel_pos == 2) && (g_ext_type == 8))
-				{
-					unsigned char u8Val = ch & 3;
+		SAFE_STRCPY(file->mpeg_name, ppszMpegNames[u], sizeof(file->mpeg_name));
+		mpegscan_dat_name(file->dat_name, sizeof(file->dat_name), file->mpeg_name);
+		sprintf(file->part_name, "%.*s.part", (int) (sizeof(file->part_name) - 6), file->dat_name);
+		file->uSize = mpegscan_file_size(file->mpeg_name);
 
-					// we need to detect whether the stream uses fields so we can adjust our searches accordingly
-					// 1 is the code for TOP FIELD, 2 is the code for BOTTOM_FIELD
-					if ((u8Val == 1) || (u8Val == 2))
-					{
-						g_fields_detected = 1;
-					}
+		// not necessarily fatal here, the caller will complain when it tries to open this file
+		if (file->uSize == 0)
+		{
+			fprintf(stderr, "VLDP : can't scan %s because it can't be opened (or is empty)\n", file->mpeg_name);
+			bResult = VLDP_FALSE;
+			continue;
+		}
 
-					// 3 is code for a full image
-					else if (u8Val == 3)
-					{
-						g_frames_detected = 1;
-					}
-				} // end if ext type is 8 ...
-				// else other ext type which we ignore ...
+		// if it has already been scanned, there's nothing to do
+		if (mpegscan_index_is_valid(file->dat_name, file->uSize, NULL))
+		{
+			continue;
+		}
+
+		file->uFirstChunk = job.uChunkCount;
+		file->uChunkCount = (file->uSize / MPEGSCAN_CHUNK_SIZE) + (((file->uSize % MPEGSCAN_CHUNK_SIZE) != 0) ? 1 : 0);
+		job.uChunkCount += file->uChunkCount;
+		job.uFileCount++;
+	}
+
+	// if everything has been scanned already, we're done
+	if (job.uFileCount == 0)
+	{
+		free(job.pFiles);
+		return bResult;
+	}
+
+	job.pChunks = (struct mpegscan_chunk *) calloc(job.uChunkCount, sizeof(struct mpegscan_chunk));
+	job.mutex = SDL_CreateMutex();
+	if (!job.pChunks || !job.mutex)
+	{
+		fprintf(stderr, "VLDP : out of memory in mpegscan_build_indexes\n");
+		if (job.mutex) SDL_DestroyMutex(job.mutex);
+		free(job.pChunks);
+		free(job.pFiles);
+		return VLDP_FALSE;
+	}
+
+	for (u = 0; u < job.uFileCount; u++)
+	{
+		struct mpegscan_file *file = &job.pFiles[u];
 
-				// when we get this far, we are done parsing EXT ...
-				g_status = IN_NOTHING;
+		for (v = 0; v < file->uChunkCount; v++)
+		{
+			struct mpegscan_chunk *chunk = &job.pChunks[file->uFirstChunk + v];
+			chunk->file = file;
+			chunk->uIndex = v;
+			chunk->uStart = v * MPEGSCAN_CHUNK_SIZE;
+			chunk->uEnd = (v == (file->uChunkCount - 1)) ? file->uSize : (chunk->uStart + MPEGSCAN_CHUNK_SIZE);
+		}
+
+		// pick up where we left off if we were interrupted last time
+		job.uChunksDone += mpegscan_journal_open(&job, file);
+	}
+
+	report_progress(-1);	// notify other thread that we're starting
+
+	// start one worker per cpu core (but not more workers than there are chunks to scan)
+	uChunksToDo = job.uChunkCount - job.uChunksDone;
+	for (u = 0; (u < mpegscan_cpu_count()) && (u < uChunksToDo); u++)
+	{
+		SDL_mutexP(job.mutex);
+		job.uWorkersLive++;
+		SDL_mutexV(job.mutex);
+
+		threads[uThreadCount] = SDL_CreateThread(mpegscan_worker, &job);
+		if (threads[uThreadCount])
+		{
+			uThreadCount++;
+		}
+		else
+		{
+			SDL_mutexP(job.mutex);
+			job.uWorkersLive--;
+			SDL_mutexV(job.mutex);
+		}
+	}
+
+	// wait for the workers to finish, reporting progress as we go
+	if (uThreadCount > 0)
+	{
+		for (;;)
+		{
+			unsigned int uDone = 0;
+			unsigned int uLive = 0;
+
+			SDL_mutexP(job.mutex);
+			uDone = job.uChunksDone;
+			uLive = job.uWorkersLive;
+			SDL_mutexV(job.mutex);
+
+			// if every worker has quit (for example, none of them could get memory), waiting any longer won't help
+			if ((uDone >= job.uChunkCount) || (uLive == 0))
+			{
+				break;
 			}
 
+			report_progress((double) uDone / job.uChunkCount);
+			SDL_Delay(100);
+		}
+
+		for (u = 0; u < uThreadCount; u++)
+		{
+			SDL_WaitThread(threads[u], NULL);
+		}
+	}
+
+	// if we couldn't start any threads (or none of them could get memory), do whatever is left ourselves
+	// (if there's still something left after this, that file won't get an index and we'll return failure)
+	job.uWorkersLive++;
+	mpegscan_worker(&job);
+
+	report_progress(1);	// notify other thread that we're done
+
+	// now write out the index for every stream that scanned cleanly
+	for (u = 0; u < job.uFileCount; u++)
+	{
+		struct mpegscan_file *file = &job.pFiles[u];
+		VLDP_BOOL bFileOK = !file->bError;
+
+		for (v = 0; (v < file->uChunkCount) && bFileOK; v++)
+		{
+			bFileOK = job.pChunks[file->uFirstChunk + v].bDone;
+		}
+
+		if (file->journal)
+		{
+			fclose(file->journal);
 		}
 
-		// if we are in nothing, looking for a new header
+		if (bFileOK && mpegscan_write_index(&job, file))
+		{
+			remove(file->part_name);	// don't need the journal anymore
+		}
 		else
 		{
-			unsigned char header[3] = { 0 };
+			fprintf(stderr, "There was an error parsing the MPEG file %s.\n", file->mpeg_name);
+			fprintf(stderr, "Either there is a bug in the parser or the MPEG file is corrupt.\n");
+			bResult = VLDP_FALSE;
+		}
+
+		for (v = 0; v < file->uChunkCount; v++)
+		{
+			mpegscan_chunk_free(&job.pChunks[file->uFirstChunk + v]);
+		}
+	}
+
+	SDL_DestroyMutex(job.mutex);
+	free(job.pChunks);
+	free(job.pFiles);
+
+	return bResult;
+}
+
+VLDP_BOOL mpegscan_read_index(const char *dat_name, Uint32 uMpegSize, Uint32 *pFramePositions, unsigned int uMaxFrames,
+							  unsigned int *puFrameCount, Uint8 *pu8UsesFields)
+{
+	VLDP_BOOL bResult = VLDP_FALSE;
+	struct dat_header header;
+	FILE *F = NULL;
 
-			get_last_three(&header[0], &header[1], &header[2], &g_last_header_pos);
+	if (!mpegscan_index_is_valid(dat_name, uMpegSize, &F))
+	{
+		return VLDP_FALSE;
+	}
 
-			// if we're at a place where a header is
-			if ((header[2] == 0) && (header[1] == 0) && (header[0] == 1))
+	fseek(F, 0L, SEEK_SET);
+	if (fread(&header, sizeof(header), 1, F) == 1)
+	{
+		Uint32 uCounts[2] = { 0, 0 };	// how many pictures, how many I frames
+		Uint8 *pFlags = NULL;
+		Uint32 *pOffsets = NULL;
+
+		if (fread(uCounts, sizeof(uCounts), 1, F) == 1)
+		{
+			pFlags = (Uint8 *) malloc(uCounts[0] + 1);
+			pOffsets = (Uint32 *) malloc((uCounts[1] + 1) * sizeof(Uint32));
+		}
+
+		if (pFlags && pOffsets &&
+			(fread(pFlags, 1, uCounts[0], F) == uCounts[0]) &&
+			(fread(pOffsets, sizeof(Uint32), uCounts[1], F) == uCounts[1]))
+		{
+			unsigned int uFrames = uCounts[0];
+			unsigned int uIFrame = 0;
+			unsigned int u = 0;
+
+			// safety check, it is possible to make mpegs with too many frames to fit onto one CAV laserdisc
+			// (in fact I did this, and it caused a lot of problems in the debug stages hehe)
+			if (uFrames > uMaxFrames)
 			{
+				fprintf(stderr, "ERROR : current mpeg has too many frames, VLDP will ignore any frames above %u\n", uMaxFrames);
+				uFrames = uMaxFrames;
+			}
 
-				// see what type of header this is
-				switch (ch)
-				{
-				case 0:	// video frame
-					g_curframe++;	// advance frame pointer
-					g_rel_pos = -1;	// this gets incremented to 0 before we check, and I wanted 0 to mean 1st byte
-					g_status = IN_PIC;
-					break;
-				case 0xB3:	// sequence header
-					break;
-				case 0xB5:	// extension header
-					g_rel_pos = -1;
-					g_status = IN_PIC_EXT;
-					break;
-				case 0xB8:	// Group of Picture
-					g_goppos = g_last_header_pos;
-					g_gop_count++;
-#ifdef VLDP_DEBUG
-					fprintf(stderr, "Got GOP at %x\n", g_goppos);
-#endif
-					break;
-				default:
-					break;
-				} // end switch
-			} // end if we found a header
-		} // end if we are looking for a new header
+			bResult = VLDP_TRUE;
 
-		add_to_last_three((unsigned char) ch, g_filepos - 1);
+			// we can only seek to I frames, so every other frame gets -1
+			for (u = 0; u < uFrames; u++)
+			{
+				pFramePositions[u] = 0xFFFFFFFF;
+				if ((pFlags[u] & MPEGSCAN_TYPE_MASK) == MPEGSCAN_TYPE_I)
+				{
+					// if more I frames are flagged than there are positions for, the file is corrupt
+					if (uIFrame >= uCounts[1])
+					{
+						bResult = VLDP_FALSE;
+						break;
+					}
+					pFramePositions[u] = pOffsets[uIFrame++];
+				}
+			}
 
-	} // end while we're not done with video stream
+			*puFrameCount = uFrames;
+			*pu8UsesFields = header.uses_fields;
+		}
 
-	free(buf);	// de-allocate buffer
+		free(pFlags);
+		free(pOffsets);
+	}
 
-	return result;
+	fclose(F);
 
+	return bResult;
 }
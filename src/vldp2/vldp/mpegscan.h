@@ -20,7 +20,40 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
-enum { P_ERROR, P_IN_PROGRESS, P_FINISHED_FRAMES, P_FINISHED_FIELDS };
+#ifndef MPEGSCAN_H
+#define MPEGSCAN_H
 
-void init_mpegscan();
-int parse_video_stream(FILE *datafile, unsigned int length);
+#include "vldp.h"	// for VLDP_BOOL and the SDL types
+
+// the flags stored for every picture in the index
+#define MPEGSCAN_TYPE_MASK 0x07	// the picture coding type (1 = I, 2 = P, 3 = B)
+#define MPEGSCAN_TYPE_I 1
+#define MPEGSCAN_GOP_START 0x08	// this picture is the first one after a GOP header
+
+// one picture found by the scanner
+struct mpegscan_picture
+{
+	Uint32 pos;	// position in the stream of the picture's start code
+	Uint8 flags;	// MPEGSCAN_xxx flags
+};
+
+// figures out the name of the index file for an mpeg (same name, but with a .dat extension)
+void mpegscan_dat_name(char *dst, unsigned int uSize, const char *mpeg_name);
+
+// Creates the index (.dat file) for every mpeg in the list that doesn't already have an up-to-date one.
+// All of the mpegs are scanned at the same time, using one thread per cpu core.
+// If a scan gets interrupted, it resumes from where it left off the next time this is called.
+// 'report_progress' is called with -1 when scanning starts, 0-1 as it goes, and 1 when it's done (it is
+//  not called at all if every index is already up-to-date).
+// Returns VLDP_TRUE if every mpeg in the list has a good index.
+VLDP_BOOL mpegscan_build_indexes(const char *const *ppszMpegNames, unsigned int uCount, void (*report_progress)(double));
+
+// Reads an index created by mpegscan_build_indexes.
+// 'uMpegSize' is the size of the mpeg that goes with the index (if it doesn't match, the index is stale).
+// Fills 'pFramePositions' with the position of every I frame (every other frame gets 0xFFFFFFFF, since we can't seek to it),
+//  stores how many frames there are in 'puFrameCount' and whether the mpeg uses fields in 'pu8UsesFields'.
+// Returns VLDP_FALSE if the index doesn't exist, is stale, or is corrupt.
+VLDP_BOOL mpegscan_read_index(const char *dat_name, Uint32 uMpegSize, Uint32 *pFramePositions, unsigned int uMaxFrames,
+							  unsigned int *puFrameCount, Uint8 *pu8UsesFields);
+
+#endif // MPEGSCAN_H
@@ -27,11 +27,14 @@
 #include "vldp.h"
 #include "vldp_common.h"
 
-#define API_VERSION 11
+#define API_VERSION 19
 
 //////////////////////////////////////////////////////////////////////////////////////
 
-int vldp_cmd(int cmd);
+void vldp_cmd_init(struct vldp_cmd_entry *entry, int cmd);
+int vldp_cmd_post(const struct vldp_cmd_entry *entry, Uint32 *puTicket);
+int vldp_cmd_wait(Uint32 uTicket);
+int vldp_cmd(struct vldp_cmd_entry *entry);
 int vldp_wait_for_status(int stat);
 
 //////////////////////////////////////////////////////////////////////////////////////
@@ -40,56 +43,126 @@ SDL_Thread *private_thread = NULL;
 
 int p_initialized = 0;	// whether VLDP has been initialized
 
-Uint8 g_req_cmdORcount = CMDORCOUNT_INITIAL;	// the current command parent thread requests of the child thread
-unsigned int g_ack_count = ACK_COUNT_INITIAL;	// the result returned by the internal child thread
-char g_req_file[STRSIZE];	// requested mpeg filename
-Uint32 g_req_timer = 0;	// requests timer value to be used for mpeg playback
-Uint16 g_req_frame = 0;		// requested frame to search to
-Uint32 g_req_min_seek_ms = 0;	// seek must take at least this many milliseconds (simulate laserdisc seek delay)
-unsigned int g_req_precache = VLDP_FALSE;	// whether g_req_idx has any meaning
-unsigned int g_req_idx = 0;	// multipurpose index (used by precaching)
-unsigned int g_req_skip_per_frame = 0;	// how many frames to skip per frame (for playing at 2X for example)
-unsigned int g_req_stall_per_frame = 0;	// how many frames to stall per frame (for playing at 1/2X for example)
+struct vldp_cmd_entry g_cmd_ring[VLDP_CMD_RING_SIZE];	// the commands the parent thread has issued to the child thread
+volatile Uint32 g_cmd_head = 0;	// how many commands we've issued
+volatile Uint32 g_cmd_tail = 0;	// how many commands the child thread has acknowledged
+SDL_mutex *g_cmd_mutex = NULL;
+SDL_cond *g_cmd_wake_cond = NULL;
+SDL_cond *g_cmd_done_cond = NULL;
+Uint32 g_uMsTimerWakeAt = 0;
+int g_bMsTimerWaiting = 0;
 struct vldp_out_info g_out_info;	// contains info that the parent thread should have access to
 const struct vldp_in_info *g_in_info;	// contains info from parent thread that VLDP should have access to
 
 /////////////////////////////////////////////////////////////////////
 
-// issues a command to the internal thread and returns 1 if the internal thread acknowledged our command
-// or 0 if we timed out without getting a response
-// NOTE : this does not mean that the internal thread has finished executing our requested command, only
-// that the command has been received
-int vldp_cmd(int cmd)
+// returns true if the child thread has acknowledged every command up to and including uTicket
+#define VLDP_TICKET_DONE(uTicket) ((Sint32) (g_cmd_tail - (uTicket)) >= 0)
+
+// sleeps until the child thread acknowledges a command or changes its status (or until uMs has passed)
+static void vldp_sleep_for_child(Uint32 uMs)
+{
+	SDL_mutexP(g_cmd_mutex);
+	SDL_CondWaitTimeout(g_cmd_done_cond, g_cmd_mutex, uMs);
+	SDL_mutexV(g_cmd_mutex);
+}
+
+// wakes the child thread up if it's waiting for uMsTimer to reach a value that it has now reached
+static void vldp_ms_timer_changed()
+{
+	// the child thread sets up its wait while holding the mutex, so taking it here means we can't miss a wait
+	//  that started before uMsTimer changed
+	SDL_mutexP(g_cmd_mutex);
+	if (g_bMsTimerWaiting && ((Sint32) (g_in_info->uMsTimer - g_uMsTimerWakeAt) >= 0))
+	{
+		g_bMsTimerWaiting = 0;
+		SDL_CondSignal(g_cmd_wake_cond);
+	}
+	SDL_mutexV(g_cmd_mutex);
+}
+
+// clears out a command entry so that it can be filled in and issued
+void vldp_cmd_init(struct vldp_cmd_entry *entry, int cmd)
+{
+	memset(entry, 0, sizeof(struct vldp_cmd_entry));
+	entry->cmd = cmd;
+}
+
+// queues up a command for the internal thread and returns immediately
+// 'puTicket' gets a ticket that can be passed to vldp_cmd_wait (it may be NULL if nobody cares)
+// Returns 1 if the command was queued or 0 if the queue stayed full until we timed out.
+int vldp_cmd_post(const struct vldp_cmd_entry *entry, Uint32 *puTicket)
 {
-	int result = 0;
 	Uint32 cur_time = g_in_info->GetTicksFunc();
-	Uint8 tmp = g_req_cmdORcount;	// we want to replace the real value atomically so we use a tmp variable first
-	static unsigned int old_ack_count = ACK_COUNT_INITIAL;
+	struct vldp_cmd_entry *slot = NULL;
 
-	tmp++;	// increment the counter so child thread knows we're issuing a new command
-	tmp &= 0xF;	// strip off old command
-	tmp |= cmd;	// replace it with new command
-	g_req_cmdORcount = tmp;	// here is the atomic replacement
-	
-	// loop until we timeout or get a response
-	while ((g_in_info->GetTicksFunc() - cur_time) < VLDP_TIMEOUT)
+	// if the queue is full, wait for the child thread to make room
+	while ((g_cmd_head - g_cmd_tail) >= VLDP_CMD_RING_SIZE)
 	{
-		// if the count has changed, it means the other thread has acknowledged our new command
-		if (g_ack_count != old_ack_count)
+		if ((g_in_info->GetTicksFunc() - cur_time) >= VLDP_TIMEOUT)
 		{
-			result = 1;
-			old_ack_count = g_ack_count;	// prepare to receive the next command
-			break;
+			fprintf(stderr, "VLDP error!  Timed out waiting for room in the command queue!\n");
+			return 0;
 		}
-		SDL_Delay(0);	// switch to other thread
+		vldp_sleep_for_child(1);
 	}
 
-	// if we weren't able to communicate, notify user
-	if (!result)
+	slot = &g_cmd_ring[g_cmd_head & (VLDP_CMD_RING_SIZE - 1)];
+	memcpy(slot, entry, sizeof(struct vldp_cmd_entry));
+	slot->uIssueMs = g_in_info->GetTicksFunc();
+
+	// the entry must be completely written before the child thread can see the new head
+	VLDP_MEMORY_BARRIER();
+	g_cmd_head++;
+
+	// wake the child thread up in case it's sleeping
+	// (we hold the mutex while signalling so that the child can't miss the wakeup)
+	SDL_mutexP(g_cmd_mutex);
+	SDL_CondSignal(g_cmd_wake_cond);
+	SDL_mutexV(g_cmd_mutex);
+
+	// the ticket is the value the tail will have once this command has been acknowledged
+	if (puTicket)
 	{
-		fprintf(stderr, "VLDP error!  Timed out waiting for internal thread to accept command!\n");
+		*puTicket = g_cmd_head;
 	}
-	
+
+	return 1;
+}
+
+// waits for the internal thread to acknowledge the command that 'uTicket' came from
+// returns 1 if it was acknowledged or 0 if we timed out
+int vldp_cmd_wait(Uint32 uTicket)
+{
+	Uint32 cur_time = g_in_info->GetTicksFunc();
+
+	while (!VLDP_TICKET_DONE(uTicket))
+	{
+		if ((g_in_info->GetTicksFunc() - cur_time) >= VLDP_TIMEOUT)
+		{
+			fprintf(stderr, "VLDP error!  Timed out waiting for internal thread to accept command!\n");
+			return 0;
+		}
+		vldp_sleep_for_child(10);
+	}
+
+	return 1;
+}
+
+// issues a command to the internal thread and returns 1 if the internal thread acknowledged our command
+// or 0 if we timed out without getting a response
+// NOTE : this does not mean that the internal thread has finished executing our requested command, only
+// that the command has been received
+int vldp_cmd(struct vldp_cmd_entry *entry)
+{
+	int result = 0;
+	Uint32 uTicket = 0;
+
+	if (vldp_cmd_post(entry, &uTicket))
+	{
+		result = vldp_cmd_wait(uTicket);
+	}
+
 	return result;
 }
 
@@ -102,6 +175,10 @@ int vldp_wait_for_status(int stat)
 	int result = 0;	// assume error unless we explicitly
 	int done = 0;
 	Uint32 cur_time = g_in_info->GetTicksFunc();
+
+	// the status doesn't mean anything until the child thread has seen every command we've sent it
+	vldp_cmd_wait(g_cmd_head);
+
 	while (!done && ((g_in_info->GetTicksFunc() - cur_time) < VLDP_TIMEOUT))
 	{
 		if (g_out_info.status == stat)
@@ -113,8 +190,11 @@ int vldp_wait_for_status(int stat)
 		{
 			done = 1;
 		}
-		// else keep waiting
-		SDL_Delay(0);	// switch to other thread, timing is critical so we delay for 0
+		// else sleep until the child thread changes its status
+		else
+		{
+			vldp_sleep_for_child(10);
+		}
 	}
 
 	// if we timed out but are busy, indicate that
@@ -139,10 +219,29 @@ void vldp_shutdown()
 	// only shutdown if we have previous initialized
 	if (p_initialized)
 	{
-		vldp_cmd(VLDP_REQ_QUIT);
+		struct vldp_cmd_entry entry;
+		vldp_cmd_init(&entry, VLDP_REQ_QUIT);
+		vldp_cmd(&entry);
 		SDL_WaitThread(private_thread, NULL);	// wait for private thread to terminate
 	}
 	p_initialized = 0;
+
+	// now that the private thread is gone, nobody else can be using these
+	if (g_cmd_done_cond)
+	{
+		SDL_DestroyCond(g_cmd_done_cond);
+		g_cmd_done_cond = NULL;
+	}
+	if (g_cmd_wake_cond)
+	{
+		SDL_DestroyCond(g_cmd_wake_cond);
+		g_cmd_wake_cond = NULL;
+	}
+	if (g_cmd_mutex)
+	{
+		SDL_DestroyMutex(g_cmd_mutex);
+		g_cmd_mutex = NULL;
+	}
 }
 
 // requests that we open an mpeg file
@@ -159,10 +258,12 @@ int vldp_open(const char *filename)
 		// if file exists, we can open it
 		if (F)
 		{
+			struct vldp_cmd_entry entry;
 			fclose(F);
-			SAFE_STRCPY(g_req_file, filename, sizeof(g_req_file));
-			g_req_precache = VLDP_FALSE;	// we're not precaching ...
-			result = vldp_cmd(VLDP_REQ_OPEN);
+			vldp_cmd_init(&entry, VLDP_REQ_OPEN);
+			SAFE_STRCPY(entry.file, filename, sizeof(entry.file));
+			entry.precache = VLDP_FALSE;	// we're not precaching ...
+			result = vldp_cmd(&entry);
 		}
 		else
 		{
@@ -179,11 +280,13 @@ VLDP_BOOL vldp_open_precached(unsigned int uIdx, const char *filename)
 
 	if (p_initialized)
 	{
+		struct vldp_cmd_entry entry;
+		vldp_cmd_init(&entry, VLDP_REQ_OPEN);
 		// even though we're using an index, we still need filename to compute .dat filename
-		SAFE_STRCPY(g_req_file, filename, sizeof(g_req_file));
-		g_req_idx = uIdx;
-		g_req_precache = VLDP_TRUE;
-		bResult = vldp_cmd(VLDP_REQ_OPEN);
+		SAFE_STRCPY(entry.file, filename, sizeof(entry.file));
+		entry.idx = uIdx;
+		entry.precache = VLDP_TRUE;
+		bResult = (VLDP_BOOL) vldp_cmd(&entry);
 	}
 
 	return bResult;
@@ -215,14 +318,32 @@ VLDP_BOOL vldp_precache(const char *filename)
 
 	if (p_initialized)
 	{
-		SAFE_STRCPY(g_req_file, filename, sizeof(g_req_file));
-		bResult = vldp_cmd(VLDP_REQ_PRECACHE);
+		struct vldp_cmd_entry entry;
+		vldp_cmd_init(&entry, VLDP_REQ_PRECACHE);
+		SAFE_STRCPY(entry.file, filename, sizeof(entry.file));
+		bResult = (VLDP_BOOL) vldp_cmd(&entry);
 	}
 	// else return false
 
 	return bResult;
 }
 
+VLDP_BOOL vldp_build_indexes(const char *const *ppszFilenames, unsigned int uCount)
+{
+	VLDP_BOOL bResult = VLDP_FALSE;
+
+	if (p_initialized)
+	{
+		struct vldp_cmd_entry entry;
+		vldp_cmd_init(&entry, VLDP_REQ_BUILD_INDEX);
+		entry.ppszFiles = ppszFilenames;
+		entry.uFileCount = uCount;
+		bResult = (VLDP_BOOL) vldp_cmd(&entry);
+	}
+
+	return bResult;
+}
+
 // issues search command and returns immediately to parent thread.
 // Search will not be complete until the VLDP status is STAT_PAUSED
 int vldp_search(Uint16 frame, Uint32 min_seek_ms)
@@ -231,9 +352,11 @@ int vldp_search(Uint16 frame, Uint32 min_seek_ms)
 
 	if (p_initialized)
 	{
-		g_req_frame = frame;
-		g_req_min_seek_ms = min_seek_ms;
-		result = vldp_cmd(VLDP_REQ_SEARCH);
+		struct vldp_cmd_entry entry;
+		vldp_cmd_init(&entry, VLDP_REQ_SEARCH);
+		entry.frame = frame;
+		entry.min_seek_ms = min_seek_ms;
+		result = vldp_cmd(&entry);
 	}
 	return result;
 }
@@ -245,9 +368,11 @@ int vldp_search_and_block(Uint16 frame, Uint32 min_seek_ms)
 
 	if (p_initialized)
 	{
-		g_req_frame = frame;
-		g_req_min_seek_ms = min_seek_ms;
-		vldp_cmd(VLDP_REQ_SEARCH);
+		struct vldp_cmd_entry entry;
+		vldp_cmd_init(&entry, VLDP_REQ_SEARCH);
+		entry.frame = frame;
+		entry.min_seek_ms = min_seek_ms;
+		vldp_cmd(&entry);
 		result = vldp_wait_for_status(STAT_PAUSED);
 	}
 	return result;
@@ -259,8 +384,10 @@ int vldp_play(Uint32 timer)
 
 	if (p_initialized)
 	{
-		g_req_timer = timer;
-		vldp_cmd(VLDP_REQ_PLAY);
+		struct vldp_cmd_entry entry;
+		vldp_cmd_init(&entry, VLDP_REQ_PLAY);
+		entry.timer = timer;
+		vldp_cmd(&entry);
 		result = vldp_wait_for_status(STAT_PLAYING);	// play could get an error if we're at EOF
 	}
 	return(result);
@@ -273,9 +400,11 @@ int vldp_skip(Uint16 frame)
 	// we can only skip if the mpeg is already playing (esp. since we don't accept a timer as an argument)
 	if (p_initialized && (g_out_info.status == STAT_PLAYING))
 	{
-		g_req_frame = frame;
-		g_req_min_seek_ms = 0;	// just for safety purposes, we want to ensure that there is no minimum skip delay
-		result = vldp_cmd(VLDP_REQ_SKIP);
+		struct vldp_cmd_entry entry;
+		vldp_cmd_init(&entry, VLDP_REQ_SKIP);
+		entry.frame = frame;
+		entry.min_seek_ms = 0;	// just for safety purposes, we want to ensure that there is no minimum skip delay
+		result = vldp_cmd(&entry);
 #ifdef VLDP_DEBUG
 		if (!result) fprintf(stderr, "vldp_cmd rejected SKIP request!\n");
 #endif
@@ -299,7 +428,9 @@ int vldp_pause()
 	int result = 0;
 	if (p_initialized)
 	{
-		result = vldp_cmd(VLDP_REQ_PAUSE);
+		struct vldp_cmd_entry entry;
+		vldp_cmd_init(&entry, VLDP_REQ_PAUSE);
+		result = vldp_cmd(&entry);
 	}
 	return result;
 }
@@ -310,7 +441,9 @@ int vldp_step_forward()
 		
 	if (p_initialized)
 	{
-		result = vldp_cmd(VLDP_REQ_STEP_FORWARD);
+		struct vldp_cmd_entry entry;
+		vldp_cmd_init(&entry, VLDP_REQ_STEP_FORWARD);
+		result = vldp_cmd(&entry);
 	}
 	return result;
 }
@@ -326,9 +459,14 @@ VLDP_BOOL vldp_speedchange(unsigned int uSkipPerFrame, unsigned int uStallPerFra
 
 	if (p_initialized)
 	{
-		g_req_skip_per_frame = uSkipPerFrame;
-		g_req_stall_per_frame = uStallPerFrame;
-		result = vldp_cmd(VLDP_REQ_SPEEDCHANGE);
+		struct vldp_cmd_entry entry;
+		vldp_cmd_init(&entry, VLDP_REQ_SPEEDCHANGE);
+		entry.skip_per_frame = uSkipPerFrame;
+		entry.stall_per_frame = uStallPerFrame;
+
+		// nothing the parent does depends on when the speed change takes effect, so we don't wait for it
+		// (it will still be carried out in order with respect to any other commands)
+		result = (VLDP_BOOL) vldp_cmd_post(&entry, NULL);
 	}
 	return result;
 }
@@ -339,7 +477,9 @@ VLDP_BOOL vldp_lock(unsigned int uTimeoutMs)
 	
 	if (p_initialized)
 	{
-		result = vldp_cmd(VLDP_REQ_LOCK);
+		struct vldp_cmd_entry entry;
+		vldp_cmd_init(&entry, VLDP_REQ_LOCK);
+		result = (VLDP_BOOL) vldp_cmd(&entry);
 	}
 	return result;
 }
@@ -350,7 +490,9 @@ VLDP_BOOL vldp_unlock(unsigned int uTimeoutMs)
 	
 	if (p_initialized)
 	{
-		result = vldp_cmd(VLDP_REQ_UNLOCK);
+		struct vldp_cmd_entry entry;
+		vldp_cmd_init(&entry, VLDP_REQ_UNLOCK);
+		result = (VLDP_BOOL) vldp_cmd(&entry);
 	}
 	return result;
 }
@@ -366,6 +508,15 @@ const struct vldp_out_info *vldp_init(const struct vldp_in_info *in_info)
 
 	g_in_info = in_info;
 
+	// start with an empty command queue
+	g_cmd_head = g_cmd_tail = 0;
+	g_out_info.uCmdCount = g_out_info.uCmdLatencyTotalMs = g_out_info.uCmdLatencyMaxMs = 0;
+	g_out_info.uSeekCount = g_out_info.uSeekLatencyTotalMs = g_out_info.uSeekLatencyMaxMs = 0;
+	g_out_info.uDecodeAheadDepth = g_out_info.uDecodeAheadUnderruns = 0;
+	g_cmd_mutex = SDL_CreateMutex();
+	g_cmd_wake_cond = SDL_CreateCond();
+	g_cmd_done_cond = SDL_CreateCond();
+
 	// So parent thread knows if it's compatible with us
 	g_out_info.uApiVersion = API_VERSION;
 
@@ -375,6 +526,7 @@ const struct vldp_out_info *vldp_init(const struct vldp_in_info *in_info)
 	g_out_info.open_precached = vldp_open_precached;
 	g_out_info.open_and_block = vldp_open_and_block;
 	g_out_info.precache = vldp_precache;
+	g_out_info.build_indexes = vldp_build_indexes;
 	g_out_info.play = vldp_play;
 	g_out_info.search = vldp_search;
 	g_out_info.search_and_block = vldp_search_and_block;
@@ -385,6 +537,14 @@ const struct vldp_out_info *vldp_init(const struct vldp_in_info *in_info)
 	g_out_info.speedchange = vldp_speedchange;
 	g_out_info.lock = vldp_lock;
 	g_out_info.unlock = vldp_unlock;
+	g_out_info.ms_timer_changed = vldp_ms_timer_changed;
+
+	// we can't talk to the internal thread without these
+	if (!g_cmd_mutex || !g_cmd_wake_cond || !g_cmd_done_cond)
+	{
+		fprintf(stderr, "VLDP error!  Could not create command queue mutex/conditions!\n");
+		return NULL;
+	}
 
 	private_thread = SDL_CreateThread(idle_handler, NULL);	// start our internal thread
 	
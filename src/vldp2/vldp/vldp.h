@@ -54,6 +54,15 @@ struct yuv_buf
 // since this is C and not C++, we can't use booleans ...
 enum { VLDP_FALSE=0, VLDP_TRUE=1 } typedef VLDP_BOOL;
 
+// how many decoded frames the frame cache can hold at most (the parent thread picks the actual size, see uFrameCacheSize)
+#define VLDP_FRAME_CACHE_MAX 32
+
+// how many threads libmpeg2 can decode slices on at most (same as its SLICE_MT_MAX_THREADS, see uSliceThreads)
+#define VLDP_SLICE_THREADS_MAX 16
+
+// how many decoded frames can be queued up ahead of the one being shown at most (the parent thread picks the actual number, see uDecodeAhead)
+#define VLDP_DECODE_AHEAD_MAX 16
+
 // callback functions and state information provided to VLDP from the parent thread
 struct vldp_in_info
 {
@@ -87,6 +96,23 @@ struct vldp_in_info
 	// Callback to get an arbitrary millisecond timer (such as SDL_GetTicks)
 	// (for instances when we know uMsTimer will not be updated, we will call this function instead)
 	unsigned int (*GetTicksFunc)();
+
+	// How many decoded frames VLDP should keep around for repeat searches (0 disables the frame cache).
+	// Each frame costs (width * height * 1.5) bytes.
+	unsigned int uFrameCacheSize;
+
+	// How many threads libmpeg2 should decode the slices of each picture on (0 or 1 decodes them one at a time).
+	unsigned int uSliceThreads;
+
+	// How many decoded frames VLDP may queue up ahead of the one being shown (0 decodes each frame just before it's shown).
+	// If this is non-zero, frames are decoded on their own thread, so that a frame that is slow to decode doesn't make
+	//  VLDP drop frames.  Each frame costs (width * height * 1.5) bytes.
+	unsigned int uDecodeAhead;
+
+	// How much smaller than the mpeg VLDP should decode the video, for when it's going to be shown smaller anyway
+	//  (0 decodes it full size, 1 at half the width and height, 2 at a quarter).  The smaller size is what
+	//  report_mpeg_dimensions gets told and what the yuv buffers hold.
+	unsigned int uLowRes;
 };
 
 // functions and state information provided to the parent thread from VLDP
@@ -116,6 +142,12 @@ struct vldp_out_info
 	//  by its precache index instead of a filename.  Behavior is similar to 'open'.
 	VLDP_BOOL (*open_precached)(unsigned int uIdx, const char *filename);
 
+	// Creates the frame index (.dat file) for every mpeg in the list that doesn't already have an up-to-date one,
+	//  scanning all of them at the same time.  Opening an mpeg does this too, but only one file at a time.
+	// IMPORTANT : indexes won't be finished until status == STAT_STOPPED (or STAT_ERROR if any of them failed).
+	//  'ppszFilenames' must stay valid until then.
+	VLDP_BOOL (*build_indexes)(const char *const *ppszFilenames, unsigned int uCount);
+
 	// plays the mpeg that has been previously open.  'timer' is the value relative to uMsTimer that
 	// we should use for the beginning of the first frame that will be displayed
 	// returns 0 on failure, 1 on success, 2 on busy
@@ -149,6 +181,7 @@ struct vldp_out_info
 	int (*stop)();
 
 	// Changes the speed of playback (while still maintaining framerate)
+	// This returns as soon as the command is queued (it doesn't wait for VLDP to acknowledge it).
 	// For example, to get 2X, uSkipPerFrame = 1, uStallPerFrame = 0
 	// To get 3X,  uSkipPerFrame = 2, uStallPerFrame = 0
 	// To get 1/2X, uSkipPerFrame = 0, uStallPerFrame = 1
@@ -160,6 +193,10 @@ struct vldp_out_info
 	
 	// Unlocks a previous lock operation. Returns true if unlock was successful, or false if we timed out.
 	VLDP_BOOL (*unlock)(unsigned int uTimeoutMs);
+
+	// The parent thread should call this every time it changes uMsTimer.
+	// It wakes VLDP up as soon as the frame it is waiting to display is due (instead of VLDP polling uMsTimer).
+	void (*ms_timer_changed)();
 	
 	////////////////////////////////////////////////////////////
 
@@ -173,6 +210,22 @@ struct vldp_out_info
 	int status;	// the current status of the VLDP (see STAT_ enum's)
 	unsigned int current_frame;	// the current frame of the opened mpeg that we are on
 	unsigned int uLastCachedIndex;	// the index of the file that was last precached (if any)
+
+	// Command latency statistics (how long commands sat in the queue before VLDP acknowledged them)
+	unsigned int uCmdCount;	// how many commands have been acknowledged
+	unsigned int uCmdLatencyTotalMs;	// sum of all of the acknowledgement latencies (divide by uCmdCount to get the average)
+	unsigned int uCmdLatencyMaxMs;	// the worst acknowledgement latency we've seen
+
+	// Seek latency statistics (how long searches and skips took from being issued until they were finished)
+	// A search is finished when the status changes to STAT_PAUSED or STAT_ERROR, a skip when the first frame
+	//  after the skip is shown (or the status changes to STAT_ERROR).
+	unsigned int uSeekCount;	// how many searches and skips have finished
+	unsigned int uSeekLatencyTotalMs;	// sum of all of the seek latencies (divide by uSeekCount to get the average)
+	unsigned int uSeekLatencyMaxMs;	// the worst seek latency we've seen
+
+	// Decode-ahead statistics (only used if uDecodeAhead is non-zero)
+	unsigned int uDecodeAheadDepth;	// how many decoded frames were queued up behind the frame that was just shown
+	unsigned int uDecodeAheadUnderruns;	// how many times a frame was due before the decoder had it ready
 };
 
 enum
@@ -43,31 +43,64 @@
 #define VLDP_REQ_UNLOCK	0xB0
 #define VLDP_REQ_SPEEDCHANGE 0xC0
 #define VLDP_REQ_PRECACHE 0xD0
-
-// these are defined to emphasize the importance of the same value being initialized in more than one place
-#define CMDORCOUNT_INITIAL 0
-#define ACK_COUNT_INITIAL 0
+#define VLDP_REQ_BUILD_INDEX 0xE0
 
 // how big all our character arrays will be
 // (needs to be able to accomodate huge paths)
 #define STRSIZE 320
 
-extern Uint16 g_req_frame;	// which frame to seek to
-extern Uint32 g_req_min_seek_ms;	// minimum # of milliseconds that this seek can take
-extern Uint32 g_req_timer;
-extern unsigned int g_req_idx;	// multipurpose index
-extern unsigned int g_req_precache;
-extern char g_req_file[];	// which file to open
-extern Uint8 g_req_cmdORcount;	// the current command count OR'd with the current command of parent thread
-								// made 8-bit to ensure that it's atomic
-extern unsigned int g_ack_count;	// how many times we've acknowledged a command
+// how many commands the parent thread can have queued up for the private thread (must be a power of 2)
+#define VLDP_CMD_RING_SIZE 16
+
+// a command from the parent thread, along with everything the private thread needs to carry it out
+// (each command gets its own copy of its arguments, so queued commands can't clobber each other)
+struct vldp_cmd_entry
+{
+	int cmd;	// which command this is (VLDP_REQ_xxx)
+	Uint32 uIssueMs;	// when the parent thread issued this command (for measuring latency)
+	char file[STRSIZE];	// which file to open/precache
+	Uint32 timer;	// timer value to be used for mpeg playback
+	Uint16 frame;	// which frame to seek to
+	Uint32 min_seek_ms;	// minimum # of milliseconds that this seek can take
+	unsigned int precache;	// whether 'idx' has any meaning
+	unsigned int idx;	// multipurpose index (used by precaching)
+	unsigned int skip_per_frame;	// how many frames to skip per frame (for playing at 2X for example)
+	unsigned int stall_per_frame;	// how many frames to stall per frame (for playing at 1/2X for example)
+	const char *const *ppszFiles;	// which files to build indexes for (owned by the parent, which waits for the build to finish)
+	unsigned int uFileCount;	// how many entries ppszFiles has
+};
+
+// Single producer (parent thread), single consumer (private thread) command queue.
+// The parent fills in g_cmd_ring[g_cmd_head] and then increments g_cmd_head.
+// The private thread looks at g_cmd_ring[g_cmd_tail] and increments g_cmd_tail to acknowledge it.
+// Neither index wraps around explicitly; they are masked with (VLDP_CMD_RING_SIZE - 1) when used.
+extern struct vldp_cmd_entry g_cmd_ring[VLDP_CMD_RING_SIZE];
+extern volatile Uint32 g_cmd_head;	// how many commands the parent has issued (only changed by the parent)
+extern volatile Uint32 g_cmd_tail;	// how many commands the private thread has acknowledged (only changed by the private thread)
+
+// The queue itself doesn't need locking, these are only used so that each thread can sleep
+//  until the other one has something for it, instead of spinning.
+extern SDL_mutex *g_cmd_mutex;
+extern SDL_cond *g_cmd_wake_cond;	// signalled by the parent when a new command is queued
+extern SDL_cond *g_cmd_done_cond;	// signalled by the private thread when a command is acknowledged or the status changes
+
+// When g_bMsTimerWaiting is set, the private thread is waiting on g_cmd_wake_cond for g_in_info->uMsTimer
+//  to reach g_uMsTimerWakeAt, and the parent signals it as soon as it does (both are protected by g_cmd_mutex).
+extern Uint32 g_uMsTimerWakeAt;
+extern int g_bMsTimerWaiting;
+
+// makes sure that writes to the queue entries are seen by the other thread before the index changes
+#ifdef WIN32
+void _ReadWriteBarrier(void);
+#pragma intrinsic(_ReadWriteBarrier)
+#define VLDP_MEMORY_BARRIER() _ReadWriteBarrier()	/* x86 doesn't reorder stores with other stores, so a compiler barrier is enough */
+#else
+#define VLDP_MEMORY_BARRIER() __sync_synchronize()
+#endif
 
 extern struct vldp_out_info g_out_info;	// contains info that the parent thread should have access to
 extern const struct vldp_in_info *g_in_info;	// contains info from parent thread that VLDP should have access to
 
-extern unsigned int g_req_skip_per_frame;	// how many frames to skip per frame (for playing at 2X for example)
-extern unsigned int g_req_stall_per_frame;	// how many frames to stall per frame (for playing at 1/2X for example)
-
 int idle_handler(void *);
 
 // how ms to wait for responses from the private thread before we give up and return an error
@@ -41,6 +41,14 @@
 #include <inttypes.h>
 #endif
 
+// memory mapping is only supported on unix-like platforms right now
+#if !defined(WIN32) && !defined(GP2X)
+#define VLDP_MMAP
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "mpeg2.h"
 #include "video_out.h"
 
@@ -48,7 +56,6 @@
 
 // NOTICE : these variables should only be used by the private thread !!!!!!!!!!!!
 
-Uint8 s_old_req_cmdORcount = CMDORCOUNT_INITIAL;	// the last value of the command byte we received
 int s_paused = 0;	// whether the video is to be paused
 int s_step_forward = 0;	// whether to step 1 frame forward
 int s_blanked = 0;	// whether the mpeg video is to be blanked
@@ -84,10 +91,84 @@ unsigned int s_uCurPreCacheIdx = 0;	// if pre-caching is enabled, which index is
 unsigned int s_uPreCacheIdxCount = 0;	// how many files have been precached
 struct precache_entry_s s_sPreCacheEntries[MAX_PRECACHE_FILES];	// struct array holding precache data
 
+// decoded frame cache variables
+// Games tend to search to the same handful of frames over and over again (the start of each scene, for example).
+// We hang onto the last few frames that were searched to, so that a repeat search can show the frame
+//  right away instead of making the parent thread wait while we decode up to it from the previous I frame.
+struct frame_cache_entry_s s_sFrameCache[VLDP_FRAME_CACHE_MAX];
+Uint32 s_uFrameCacheClock = 0;	// gets incremented every time the cache is used, so we can tell which entry was used least recently
+unsigned int s_uFrameCacheStoreFrame = 0;	// (frame # + 1) that the next displayed frame should be cached as, 0 if none
+VLDP_BOOL s_bCachedFrameShown = VLDP_FALSE;	// whether we've reported STAT_PAUSED early because the search target was cached
+unsigned int s_uFrameCacheHits = 0;	// statistics, so we can see whether the cache is worthwhile
+unsigned int s_uFrameCacheMisses = 0;
+
+static VLDP_BOOL s_bSeekPending = VLDP_FALSE;	// whether a search or skip has been acknowledged but hasn't finished yet
+static VLDP_BOOL s_bSeekIsSkip = VLDP_FALSE;	// whether the pending seek is a skip (finished by showing a frame) or a search
+static Uint32 s_uSeekIssueMs = 0;	// when the parent thread issued the pending search or skip (from GetTicksFunc)
+
+static unsigned int s_uLowRes = 0;	// how many times libmpeg2 halves the size of the pictures it decodes (see uLowRes)
+
+// decode elision variables
+// Frames that null_present_frame() is going to skip or drop don't need to be decoded at all, so we tell libmpeg2
+//  to skip them ahead of time.  B pictures can always be left out; I and P pictures can only be left out if every
+//  frame that is predicted from them is going to be skipped as well.
+VLDP_BOOL s_bFrameElided = VLDP_FALSE;	// whether the frame that the next draw would show was never decoded
+static VLDP_BOOL s_bFwdRefDecoded = VLDP_TRUE;	// whether the older of libmpeg2's two reference pictures was decoded
+static VLDP_BOOL s_bBwdRefDecoded = VLDP_TRUE;	// whether the newer of libmpeg2's two reference pictures was decoded
+static unsigned int s_uDecodePicture = 0;	// index (in stream order, like g_frame_position) of the next picture to be decoded
+static unsigned int s_uBRun = 0;	// how many B pictures in a row we've seen since the last I or P picture
+static unsigned int s_uMaxBRun = 2;	// the longest run of B pictures we've seen (most mpegs use IBBP, so we start at 2)
+static unsigned int s_uFramesElided = 0;	// statistics, so we can see how much decoding we're saving
+
+// decode-ahead variables
+// If the parent thread asks for it, libmpeg2 runs on its own thread (the decoder stage) while ivldp_render() is going,
+//  and queues up to g_in_info->uDecodeAhead decoded frames.  This thread (the presentation stage) shows them when they
+//  are due, so a frame that takes a long time to decode just eats into the queue instead of making us drop frames.
+// The decoder stage only runs while ivldp_render() is going, so everything else can use libmpeg2 and io_* as usual.
+enum { AHEAD_IDLE, AHEAD_RUN, AHEAD_STOP, AHEAD_QUIT };	// what the decoder stage is doing (or has been asked to do)
+
+struct ahead_frame_s
+{
+	struct yuv_buf buf;	// the decoded frame (the buffers are allocated the first time the slot is used)
+	VLDP_BOOL bElided;	// whether the frame wasn't decoded (so it must not be shown)
+	VLDP_BOOL bEnd;	// whether this is the end of the mpeg instead of a frame
+};
+
+static SDL_Thread *s_pAheadThread = NULL;	// the decoder stage (NULL if decode-ahead is disabled)
+static SDL_mutex *s_pAheadMutex = NULL;	// protects everything below
+static SDL_cond *s_pAheadCond = NULL;	// signalled whenever s_iAheadState changes or a slot is freed up
+static volatile int s_iAheadState = AHEAD_IDLE;
+static struct ahead_frame_s s_sAheadRing[VLDP_DECODE_AHEAD_MAX + 1];	// + 1 for the end marker
+static unsigned int s_uAheadHead = 0;	// oldest queued frame (the next one to show)
+static unsigned int s_uAheadCount = 0;	// how many frames are queued
+static unsigned int s_uAheadSize = 0;	// how many frames can be queued
+
+// These are only used by the decoder stage.
+static VLDP_BOOL s_bAheadDecoding = VLDP_FALSE;	// whether the decoder stage is the one calling libmpeg2
+static int s_iAheadSkip = 0;	// how many of the frames it queues will be skipped (s_frames_to_skip, but from the decoder's point of view)
+
+// This is only used by the presentation stage.
+static VLDP_BOOL s_bAheadStarved = VLDP_FALSE;	// whether we've already counted the current underrun
+
+static void ivldp_ahead_open();
+static void ivldp_ahead_close();
+static void ivldp_ahead_start();
+static void ivldp_ahead_stop();
+static VLDP_BOOL ivldp_ahead_present();
+
 
 #define MAX_LDP_FRAMES 65535 // rdg2010: increase frames cap limit to 16-bit max
 
 static FILE *g_mpeg_handle = NULL;	// mpeg file we currently have open
+
+#ifdef VLDP_MMAP
+// If the mpeg could be memory mapped, these are used instead of g_mpeg_handle.
+// The decoder reads straight out of the mapping, so nothing gets copied and several
+//  processes playing the same disc can share the OS's page cache.
+static Uint8 *g_mmap_ptr = NULL;	// beginning of the mapping (NULL if nothing is mapped)
+static unsigned int g_mmap_length = 0;	// length of the mapping (same as the file length)
+static unsigned int g_mmap_pos = 0;	// our current position within the mapping
+#endif // VLDP_MMAP
 static mpeg2dec_t *g_mpeg_data = NULL;	// structure for libmpeg2's state
 static vo_instance_t *s_video_output = NULL;
 static Uint32 g_frame_position[MAX_LDP_FRAMES] = { 0 };	// the file position of each I frame
@@ -117,6 +198,13 @@ int idle_handler(void *surface)
 	if (s_video_output)
 	{
 		g_mpeg_data = mpeg2_init();
+		if (g_mpeg_data)
+		{
+			mpeg2_slice_threads(g_mpeg_data, g_in_info->uSliceThreads);
+			s_uLowRes = (g_in_info->uLowRes > 2) ? 2 : g_in_info->uLowRes;
+			mpeg2_lowres(g_mpeg_data, s_uLowRes);
+			ivldp_ahead_open();
+		}
 	}
 	else
 	{
@@ -133,7 +221,7 @@ int idle_handler(void *surface)
 		while (ivldp_got_new_command() && !done)
 		{
 			// examine the actual command (strip off the count)
-			switch(g_req_cmdORcount & 0xF0)
+			switch(ivldp_cur_cmd())
 			{
 			case VLDP_REQ_QUIT:
 				done = 1;
@@ -144,6 +232,9 @@ int idle_handler(void *surface)
 			case VLDP_REQ_PRECACHE:
 				idle_handler_precache();
 				break;
+			case VLDP_REQ_BUILD_INDEX:
+				idle_handler_build_index();
+				break;
 			case VLDP_REQ_PLAY:
 				idle_handler_play();
 				break;
@@ -155,14 +246,19 @@ int idle_handler(void *surface)
 				break;
 			case VLDP_REQ_PAUSE:	// pause command while we're already idle?  this is an error
 			case VLDP_REQ_STOP:	// stop command while we're already idle? this is an error
-				g_out_info.status = STAT_ERROR;
+				ivldp_set_status(STAT_ERROR);
 				ivldp_ack_command();
 				break;
 			case VLDP_REQ_LOCK:
 				ivldp_lock_handler();
 				break;
+			case VLDP_REQ_SPEEDCHANGE:
+				// speed changes aren't waited on by the parent thread, so they can arrive while we're idle
+				ivldp_respond_req_speedchange();
+				break;
 			default:
 				fprintf(stderr, "VLDP WARNING : Idle handler received command which it is ignoring\n");
+				ivldp_ack_command();	// get it out of the queue so it doesn't hold up the commands behind it
 				break;
 			} // end switch
 			SDL_Delay(0);	// give other threads some breathing room (but not much hehe)
@@ -173,11 +269,12 @@ int idle_handler(void *surface)
 		// we need to delay here because otherwise, this idle loop will execute at 100% cpu speed and really slow things down
 		// It shouldn't hurt us when we get a command that requires immediate attention (such as skip) because of the
 		// inner while loop above (while ivldp_got_new_command)
-		// NOTE : we want to delay for about 1 frame (or field) here
-		SDL_Delay(16);	// 1 field is 16.666ms assuming 60 hz
+		// NOTE : we want to delay for about 1 frame (or field) here, but we wake up immediately if a command comes in
+		ivldp_wait_for_command(16);	// 1 field is 16.666ms assuming 60 hz
 
 	} // end while we have not received a quit command
 
+	ivldp_ahead_close();	// (the decoder stage is never running while we're idle)
 	io_close();
 	/*
 	// if we have a file open, close it
@@ -188,7 +285,7 @@ int idle_handler(void *surface)
 	}
 	*/
 
-	g_out_info.status = STAT_ERROR;
+	ivldp_set_status(STAT_ERROR);
 	mpeg2_close(g_mpeg_data);	// shutdown libmpeg2
 	s_video_output->close(s_video_output);		// shutdown null driver
 
@@ -199,6 +296,18 @@ int idle_handler(void *surface)
 		free(s_sPreCacheEntries[s_uPreCacheIdxCount].ptrBuf);
 	}
 
+	// de-allocate the frame cache
+	if ((s_uFrameCacheHits + s_uFrameCacheMisses) != 0)
+	{
+		fprintf(stderr, "VLDP : frame cache had %u hits and %u misses\n", s_uFrameCacheHits, s_uFrameCacheMisses);
+	}
+	ivldp_frame_cache_clear(VLDP_TRUE);
+
+	if (s_uFramesElided != 0)
+	{
+		fprintf(stderr, "VLDP : skipped decoding %u frames that weren't going to be shown\n", s_uFramesElided);
+	}
+
 	ivldp_ack_command();	// acknowledge quit command
 
 	return 0;
@@ -209,21 +318,149 @@ int ivldp_got_new_command()
 {
 	int result = 0;
 
-	// if they are no longer equal	
-	if (g_req_cmdORcount != s_old_req_cmdORcount)
+	// if the parent has issued more commands than we've acknowledged
+	if (g_cmd_head != g_cmd_tail)
 	{
+		// make sure we don't look at the queue entry before the parent has finished writing it
+		VLDP_MEMORY_BARRIER();
 		result = 1;
 	}
 	
 	return result;
 }
 
+// returns the command at the front of the queue (or VLDP_REQ_NONE if there isn't one)
+int ivldp_cur_cmd()
+{
+	int result = VLDP_REQ_NONE;
+
+	if (ivldp_got_new_command())
+	{
+		result = ivldp_cur_req()->cmd;
+	}
+
+	return result;
+}
+
+// returns the command at the front of the queue, along with its arguments
+// This should only be called if ivldp_got_new_command() returns true.
+// NOTE : the entry can be reused by the parent thread as soon as we acknowledge it, so copy anything you need first!
+const struct vldp_cmd_entry *ivldp_cur_req()
+{
+	return &g_cmd_ring[g_cmd_tail & (VLDP_CMD_RING_SIZE - 1)];
+}
+
 // acknowledges a command sent by the parent thread
 // NOTE : We don't check to see if parent thread got our acknowledgement because it creates too much latency
 void ivldp_ack_command()
 {
-	s_old_req_cmdORcount = g_req_cmdORcount;
-	g_ack_count++;	// here is where we acknowledge
+	// keep track of how long the command waited for us, to help find out where seek latency is coming from
+	unsigned int uLatencyMs = g_in_info->GetTicksFunc() - ivldp_cur_req()->uIssueMs;
+
+	g_out_info.uCmdCount++;
+	g_out_info.uCmdLatencyTotalMs += uLatencyMs;
+	if (uLatencyMs > g_out_info.uCmdLatencyMaxMs)
+	{
+		g_out_info.uCmdLatencyMaxMs = uLatencyMs;
+	}
+#ifdef VLDP_DEBUG
+	fprintf(stderr, "VLDP : command %x acknowledged after %u ms\n", ivldp_cur_req()->cmd, uLatencyMs);
+#endif
+
+	// we must be finished with the entry before the parent thread is allowed to reuse it
+	VLDP_MEMORY_BARRIER();
+	g_cmd_tail++;	// here is where we acknowledge
+
+	// wake up the parent thread if it's waiting on us
+	SDL_mutexP(g_cmd_mutex);
+	SDL_CondBroadcast(g_cmd_done_cond);
+	SDL_mutexV(g_cmd_mutex);
+}
+
+// changes our status and lets the parent thread know about it (in case it is waiting for a certain status)
+void ivldp_set_status(int stat)
+{
+	// a search is finished once we report that we're playing, paused, or couldn't do it (and a skip, if we couldn't do it)
+	if ((stat == STAT_ERROR) || (!s_bSeekIsSkip && ((stat == STAT_PLAYING) || (stat == STAT_PAUSED))))
+	{
+		ivldp_seek_done();
+	}
+
+	g_out_info.status = stat;
+
+	SDL_mutexP(g_cmd_mutex);
+	SDL_CondBroadcast(g_cmd_done_cond);
+	SDL_mutexV(g_cmd_mutex);
+}
+
+// records how long the pending search or skip (if any) took, from the parent thread issuing it until now
+void ivldp_seek_done()
+{
+	if (s_bSeekPending)
+	{
+		unsigned int uLatencyMs = g_in_info->GetTicksFunc() - s_uSeekIssueMs;
+
+		g_out_info.uSeekCount++;
+		g_out_info.uSeekLatencyTotalMs += uLatencyMs;
+		if (uLatencyMs > g_out_info.uSeekLatencyMaxMs)
+		{
+			g_out_info.uSeekLatencyMaxMs = uLatencyMs;
+		}
+#ifdef VLDP_DEBUG
+		fprintf(stderr, "VLDP : seek finished after %u ms\n", uLatencyMs);
+#endif
+		s_bSeekPending = VLDP_FALSE;
+		s_bSeekIsSkip = VLDP_FALSE;
+	}
+}
+
+// called whenever a frame is displayed, because a skip is finished once the first frame after it is shown
+// (searches aren't finished until they change the status)
+void ivldp_seek_frame_shown()
+{
+	if (s_bSeekIsSkip)
+	{
+		ivldp_seek_done();
+	}
+}
+
+// sleeps for up to uMs milliseconds, or until the parent thread issues a new command
+void ivldp_wait_for_command(Uint32 uMs)
+{
+	SDL_mutexP(g_cmd_mutex);
+
+	// the parent signals us while holding the mutex, so if there's no command now, we can't miss its signal
+	if (!ivldp_got_new_command())
+	{
+		SDL_CondWaitTimeout(g_cmd_wake_cond, g_cmd_mutex, uMs);
+	}
+
+	SDL_mutexV(g_cmd_mutex);
+}
+
+// sleeps until g_in_info->uMsTimer reaches uMsTimer, or until the parent thread issues a new command
+void ivldp_wait_for_ms_timer(Uint32 uMsTimer)
+{
+	SDL_mutexP(g_cmd_mutex);
+
+	// the parent checks g_bMsTimerWaiting while holding the mutex after it changes uMsTimer, so we can't miss its signal
+	if (!ivldp_got_new_command())
+	{
+		Sint32 iRemainingMs = (Sint32) (uMsTimer - g_in_info->uMsTimer);
+
+		if (iRemainingMs > 0)
+		{
+			g_uMsTimerWakeAt = uMsTimer;
+			g_bMsTimerWaiting = 1;
+
+			// uMsTimer usually advances at 1 ms per host ms, so the timeout is only a safety net for
+			//  a parent thread that isn't calling ms_timer_changed (or has stopped updating uMsTimer)
+			SDL_CondWaitTimeout(g_cmd_wake_cond, g_cmd_mutex, (Uint32) iRemainingMs);
+			g_bMsTimerWaiting = 0;
+		}
+	}
+
+	SDL_mutexV(g_cmd_mutex);
 }
 
 void ivldp_lock_handler()
@@ -238,10 +475,10 @@ void ivldp_lock_handler()
 		// the user should unlock immediately after locking, so we need not check for other commands
 		while (bLocked == VLDP_TRUE)
 		{
-			SDL_Delay(1);
+			ivldp_wait_for_command(16);
 			if (ivldp_got_new_command())
 			{
-				switch (g_req_cmdORcount & 0xF0)
+				switch (ivldp_cur_cmd())
 				{
 				case VLDP_REQ_UNLOCK:
 #ifdef VLDP_DEBUG
@@ -251,7 +488,8 @@ void ivldp_lock_handler()
 					bLocked = VLDP_FALSE;
 					break;
 				default:
-					fprintf(stderr, "WARNING : lock handler received a command %x that wasn't to unlock it\n", g_req_cmdORcount);
+					fprintf(stderr, "WARNING : lock handler received a command %x that wasn't to unlock it\n", ivldp_cur_cmd());
+					ivldp_ack_command();	// drop it, otherwise the unlock command would be stuck behind it forever
 					break;
 				}
 			}
@@ -264,9 +502,11 @@ void ivldp_lock_handler()
 void paused_handler()
 {
 	// the moment we render the still frame, we need to reset the FPS timer so we don't try to catch-up
-	if (g_out_info.status != STAT_PAUSED)
+	// (if we showed a cached frame, our status is already STAT_PAUSED, but this is the first time we've really gotten here)
+	if ((g_out_info.status != STAT_PAUSED) || s_bCachedFrameShown)
 	{
-		g_out_info.status = STAT_PAUSED;
+		s_bCachedFrameShown = VLDP_FALSE;
+		ivldp_set_status(STAT_PAUSED);
 
 		// reset these vars because otherwise null_draw_frame will loop redundantly for no good reason
 		s_timer = g_in_info->uMsTimer;	// since we have just rendered the frame we searched to, we refresh the timer
@@ -281,7 +521,7 @@ void paused_handler()
 	if (ivldp_got_new_command())
 	{
 		// strip off the count and examine the command
-		switch (g_req_cmdORcount & 0xF0)
+		switch (ivldp_cur_cmd())
 		{
 		case VLDP_REQ_PLAY:
 			ivldp_respond_req_play();
@@ -304,8 +544,11 @@ void paused_handler()
 		case VLDP_REQ_LOCK:
 			ivldp_lock_handler();
 			break;
+		case VLDP_REQ_SPEEDCHANGE:
+			ivldp_respond_req_speedchange();
+			break;
 		default:	// else if we get a pause command or another command we don't know how to handle, just ignore it
-			fprintf(stderr, "WARNING : pause handler received command %x that it is ignoring\n", g_req_cmdORcount);
+			fprintf(stderr, "WARNING : pause handler received command %x that it is ignoring\n", ivldp_cur_cmd());
 			ivldp_ack_command();	// acknowledge the command
 			break;
 		} // end switch
@@ -320,7 +563,7 @@ void play_handler()
 	if (ivldp_got_new_command())
 	{
 		// strip off count and examine command
-		switch(g_req_cmdORcount & 0xF0)
+		switch(ivldp_cur_cmd())
 		{
 		case VLDP_REQ_NONE:	// no incoming command
 			break;
@@ -395,6 +638,163 @@ void ivldp_set_framerate(Uint8 frame_rate_code)
 
 /////////////////
 
+// returns how many ms late the next frame is (negative if it isn't due yet), using the same math as null_present_frame()
+static Sint32 ivldp_next_frame_lateness()
+{
+	Sint64 s64Ms = s_uFramesShownSinceTimer;
+	s64Ms = (s64Ms * 1000000) / g_out_info.uFpks;
+
+	return (Sint32) (g_in_info->uMsTimer - s_timer) - ((Sint32) (s64Ms) + (Sint32) s_extra_delay_ms);
+}
+
+// returns how many of the frames, starting with the next one that is decoded, are going to be skipped
+static int ivldp_frames_to_skip()
+{
+	// If frames are being decoded ahead, s_frames_to_skip counts from the frame being shown instead of the one being
+	//  decoded, and it is reset whenever multi-speed playback shows a frame, so we can only count on the frames
+	//  that a search skipped over.
+	if (s_bAheadDecoding)
+	{
+		return s_iAheadSkip;
+	}
+
+	return s_frames_to_skip;
+}
+
+// returns VLDP_TRUE if nothing else is going to be shown before libmpeg2 is reset
+static VLDP_BOOL ivldp_bailing_out()
+{
+	// we're bailing out to handle a new command (once s_skip_all has been set, it stays set until ivldp_render() returns)
+	// or the presentation stage has told the decoder stage to stop
+	return (s_skip_all || (s_bAheadDecoding && (s_iAheadState != AHEAD_RUN)));
+}
+
+// returns VLDP_TRUE if null_present_frame() is certain to skip or drop the next frame instead of showing it
+static VLDP_BOOL ivldp_next_frame_dropped()
+{
+	// searching or multi-speed playback, or we're bailing out
+	if ((ivldp_frames_to_skip() > 0) || ivldp_bailing_out())
+	{
+		return VLDP_TRUE;
+	}
+
+	// if we're decoding ahead, the frame won't be shown for a while, so we can't tell whether it will be late
+	if (s_bAheadDecoding)
+	{
+		return VLDP_FALSE;
+	}
+
+#ifndef VLDP_BENCHMARK
+	// If we are already too far behind to show the next frame, null_present_frame() is going to drop it, and decoding
+	//  it would only put us further behind.
+	// If we are paused or stalling, the frame gets shown again later on, so it has to be decoded.
+	if (!s_paused && !s_step_forward && (s_stall_per_frame == 0))
+	{
+		if (ivldp_next_frame_lateness() >= (Sint32) g_out_info.u2milDivFpks)
+		{
+			return VLDP_TRUE;
+		}
+	}
+#endif // VLDP_BENCHMARK
+
+	return VLDP_FALSE;
+}
+
+// returns VLDP_TRUE if every frame that depends on the P picture that is about to be decoded is going to be skipped
+static VLDP_BOOL ivldp_rest_of_gop_skipped()
+{
+	unsigned int uNextI = s_uDecodePicture + 1;
+	int iSkip = 0;
+
+	// libmpeg2 gets reset before anything else is shown
+	if (ivldp_bailing_out())
+	{
+		return VLDP_TRUE;
+	}
+
+	iSkip = ivldp_frames_to_skip();
+
+	// without an index we can't tell how far away the next I frame is
+	if ((iSkip <= 0) || (g_totalframes == 0))
+	{
+		return VLDP_FALSE;
+	}
+
+	while ((uNextI < g_totalframes) && (g_frame_position[uNextI] == 0xFFFFFFFF))
+	{
+		++uNextI;
+	}
+
+	// Every picture up to the next I frame is predicted from this one, the next I frame's draw shows the last P picture
+	//  before it, and the B pictures right after the I frame can still be predicted from that P picture (open GOP).
+	// The skip count covers the draws for this picture and the ones that follow it.
+	return (s_uDecodePicture + iSkip > uNextI + s_uMaxBRun);
+}
+
+// decides whether libmpeg2 has to decode the picture it has just started on
+static void ivldp_elide_picture(int type)
+{
+	VLDP_BOOL bElide = VLDP_FALSE;
+
+	if (type == PIC_FLAG_CODING_TYPE_B)
+	{
+		++s_uBRun;
+
+		// nothing is predicted from a B picture, so it only has to be decoded if it's going to be shown
+		// (and if one of the pictures it is predicted from wasn't decoded, it can't be shown anyway)
+		bElide = !(s_bFwdRefDecoded && s_bBwdRefDecoded) || ivldp_next_frame_dropped();
+
+		// B pictures are shown as soon as they are decoded
+		s_bFrameElided = bElide;
+	}
+	else
+	{
+		if (s_uBRun > s_uMaxBRun)
+		{
+			s_uMaxBRun = s_uBRun;
+		}
+		s_uBRun = 0;
+
+		// a P picture can't be decoded properly if the picture it is predicted from wasn't decoded
+		if ((type == PIC_FLAG_CODING_TYPE_P) && !s_bBwdRefDecoded)
+		{
+			bElide = VLDP_TRUE;
+		}
+		// otherwise only leave it out if everything that is predicted from it is going to be skipped too
+		else if (type == PIC_FLAG_CODING_TYPE_P)
+		{
+			bElide = ivldp_rest_of_gop_skipped();
+		}
+		else
+		{
+			bElide = ivldp_bailing_out();
+		}
+
+		// I and P pictures are shown one picture late, so the next draw shows the previous I or P picture
+		s_bFrameElided = !s_bBwdRefDecoded;
+		s_bFwdRefDecoded = s_bBwdRefDecoded;
+		s_bBwdRefDecoded = !bElide;
+	}
+
+	if (bElide)
+	{
+		++s_uFramesElided;
+	}
+
+	mpeg2_skip(g_mpeg_data, bElide);
+	++s_uDecodePicture;
+}
+
+// must be called whenever libmpeg2 is reset, uPicture is the index of the picture that decoding will start from
+static void ivldp_elide_reset(unsigned int uPicture)
+{
+	s_bFrameElided = VLDP_FALSE;
+	s_bFwdRefDecoded = s_bBwdRefDecoded = VLDP_TRUE;
+	s_uDecodePicture = uPicture;
+	s_uBRun = 0;
+	mpeg2_skip(g_mpeg_data, 0);
+}
+
 // decode_mpeg2 function taken from mpeg2dec.c and optimized a bit
 static void decode_mpeg2 (uint8_t * current, uint8_t * end)
 {
@@ -442,17 +842,21 @@ static void decode_mpeg2 (uint8_t * current, uint8_t * end)
 		    break;
 		case STATE_PICTURE:
 		    /* might skip */
-		    /* might set fbuf */
+			ivldp_elide_picture(info->current_picture->flags & PIC_MASK_CODING_TYPE);
 
-			// all possible stuff we could've done here was removed because the null driver
-			// doesn't do any of it
-		    
+		    /* might set fbuf */
+			// the null driver doesn't do any of this
 		    break;
 		case STATE_PICTURE_2ND:
 		    /* should not do anything */
+			// (the second field gets decoded or skipped along with the first one, but it counts as a picture in the index)
+			++s_uDecodePicture;
 		    break;
-		case STATE_SLICE:
 		case STATE_END:
+			// the end of the sequence shows the last I or P picture
+			s_bFrameElided = !s_bBwdRefDecoded;
+			// fall through
+		case STATE_SLICE:
 		    /* draw current picture */
 		    /* might free frame buffer */
 			// if the init hasn't been called yet, this may fail so we have to put the conditional
@@ -469,6 +873,334 @@ static void decode_mpeg2 (uint8_t * current, uint8_t * end)
 
 /////////////////
 
+// queues up a frame for the presentation stage (if buf is NULL, the end of the mpeg is queued up instead)
+static void ivldp_ahead_queue(const struct yuv_buf *buf, VLDP_BOOL bElided)
+{
+	struct ahead_frame_s *frame = NULL;
+
+	SDL_mutexP(s_pAheadMutex);
+
+	// wait for a free slot (there is always room for the end marker)
+	while ((s_iAheadState == AHEAD_RUN) && buf && (s_uAheadCount >= s_uAheadSize))
+	{
+		SDL_CondWait(s_pAheadCond, s_pAheadMutex);
+	}
+
+	// if we've been stopped, nobody is going to show the frame
+	if (s_iAheadState != AHEAD_RUN)
+	{
+		SDL_mutexV(s_pAheadMutex);
+		return;
+	}
+
+	frame = &s_sAheadRing[(s_uAheadHead + s_uAheadCount) % (s_uAheadSize + 1)];
+	SDL_mutexV(s_pAheadMutex);
+
+	// the presentation stage doesn't touch free slots, so we can fill this one in without holding the mutex
+	frame->bElided = bElided;
+	frame->bEnd = (buf == NULL);
+
+	// frames that weren't decoded don't need to be copied, since they won't be shown
+	if (buf && !bElided)
+	{
+		// the first time a slot is used (or if the video size has changed), we need to allocate its buffers
+		if ((frame->buf.Y_size != buf->Y_size) || (frame->buf.UV_size != buf->UV_size))
+		{
+			free(frame->buf.Y);
+			free(frame->buf.U);
+			free(frame->buf.V);
+			frame->buf.Y = malloc(buf->Y_size);
+			frame->buf.U = malloc(buf->UV_size);
+			frame->buf.V = malloc(buf->UV_size);
+			frame->buf.Y_size = buf->Y_size;
+			frame->buf.UV_size = buf->UV_size;
+		}
+
+		if (frame->buf.Y && frame->buf.U && frame->buf.V)
+		{
+			memcpy(frame->buf.Y, buf->Y, buf->Y_size);
+			memcpy(frame->buf.U, buf->U, buf->UV_size);
+			memcpy(frame->buf.V, buf->V, buf->UV_size);
+		}
+		else
+		{
+			fprintf(stderr, "VLDP : out of memory while decoding ahead, dropping frame\n");
+			frame->buf.Y_size = frame->buf.UV_size = 0;	// so we try to allocate again next time
+			frame->bElided = VLDP_TRUE;
+		}
+	}
+
+	SDL_mutexP(s_pAheadMutex);
+	s_uAheadCount++;
+	SDL_mutexV(s_pAheadMutex);
+
+	// wake up the presentation stage if it's waiting for us
+	SDL_mutexP(g_cmd_mutex);
+	SDL_CondSignal(g_cmd_wake_cond);
+	SDL_mutexV(g_cmd_mutex);
+}
+
+// Called by null_draw_frame() when libmpeg2 has a frame ready.  If the frame is being decoded ahead, it gets queued up
+//  for the presentation stage and this returns VLDP_TRUE.  Otherwise it returns VLDP_FALSE and the frame should be shown now.
+VLDP_BOOL ivldp_ahead_queue_frame(const struct yuv_buf *buf, VLDP_BOOL bElided)
+{
+	if (!s_bAheadDecoding)
+	{
+		return VLDP_FALSE;
+	}
+
+	// keep track of which frames the presentation stage is going to skip over
+	if (s_iAheadSkip > 0)
+	{
+		--s_iAheadSkip;
+	}
+
+	ivldp_ahead_queue(buf, bElided);
+	return VLDP_TRUE;
+}
+
+// the decoder stage: decodes from the current position until the end of the mpeg, or until we are stopped
+static void ivldp_ahead_decode()
+{
+	Uint8 *start = NULL;
+	unsigned int uBytesRead = 0;
+
+	s_bAheadDecoding = VLDP_TRUE;
+
+	while (s_iAheadState == AHEAD_RUN)
+	{
+		// (if the file is mapped or precached, start will point directly into it instead of into g_buffer)
+		uBytesRead = io_read_ptr(&start, BUFFER_SIZE);
+
+		// safety check, they could be equal if we were already at EOF before we tried this
+		if (uBytesRead != 0)
+		{
+			decode_mpeg2 (start, start + uBytesRead);	// queue up the frames for the presentation stage
+		}
+
+		// if we've read to the end of the mpeg2 file, let the presentation stage know (after it has shown everything else)
+		if (uBytesRead != BUFFER_SIZE)
+		{
+			ivldp_ahead_queue(NULL, VLDP_FALSE);
+			break;
+		}
+	}
+
+	s_bAheadDecoding = VLDP_FALSE;
+}
+
+static int ivldp_ahead_thread(void *arg)
+{
+	SDL_mutexP(s_pAheadMutex);
+
+	for (;;)
+	{
+		// wait for ivldp_render() to get us going
+		while (s_iAheadState == AHEAD_IDLE)
+		{
+			SDL_CondWait(s_pAheadCond, s_pAheadMutex);
+		}
+
+		if (s_iAheadState == AHEAD_QUIT)
+		{
+			break;
+		}
+
+		SDL_mutexV(s_pAheadMutex);
+		ivldp_ahead_decode();
+		SDL_mutexP(s_pAheadMutex);
+
+		// let ivldp_ahead_stop() know that libmpeg2 and the file are free to be used again
+		s_iAheadState = AHEAD_IDLE;
+		SDL_CondBroadcast(s_pAheadCond);
+	}
+
+	SDL_mutexV(s_pAheadMutex);
+
+	return 0;
+}
+
+// starts up the decoder stage's thread, if the parent thread wants frames to be decoded ahead
+static void ivldp_ahead_open()
+{
+	s_uAheadSize = g_in_info->uDecodeAhead;
+
+	if (s_uAheadSize == 0)
+	{
+		return;
+	}
+
+	if (s_uAheadSize > VLDP_DECODE_AHEAD_MAX)
+	{
+		s_uAheadSize = VLDP_DECODE_AHEAD_MAX;
+	}
+
+	s_iAheadState = AHEAD_IDLE;
+	s_pAheadMutex = SDL_CreateMutex();
+	s_pAheadCond = SDL_CreateCond();
+	if (s_pAheadMutex && s_pAheadCond)
+	{
+		s_pAheadThread = SDL_CreateThread(ivldp_ahead_thread, NULL);
+	}
+
+	if (!s_pAheadThread)
+	{
+		fprintf(stderr, "VLDP : couldn't start decode-ahead thread, frames will be decoded right before they are shown\n");
+	}
+}
+
+// shuts down the decoder stage's thread (it must not be running)
+static void ivldp_ahead_close()
+{
+	unsigned int u = 0;
+
+	if (s_pAheadThread)
+	{
+		SDL_mutexP(s_pAheadMutex);
+		s_iAheadState = AHEAD_QUIT;
+		SDL_CondBroadcast(s_pAheadCond);
+		SDL_mutexV(s_pAheadMutex);
+
+		SDL_WaitThread(s_pAheadThread, NULL);
+		s_pAheadThread = NULL;
+	}
+
+	if (s_pAheadCond)
+	{
+		SDL_DestroyCond(s_pAheadCond);
+		s_pAheadCond = NULL;
+	}
+	if (s_pAheadMutex)
+	{
+		SDL_DestroyMutex(s_pAheadMutex);
+		s_pAheadMutex = NULL;
+	}
+
+	for (u = 0; u < (sizeof(s_sAheadRing) / sizeof(s_sAheadRing[0])); u++)
+	{
+		free(s_sAheadRing[u].buf.Y);
+		free(s_sAheadRing[u].buf.U);
+		free(s_sAheadRing[u].buf.V);
+	}
+	memset(s_sAheadRing, 0, sizeof(s_sAheadRing));
+}
+
+// gets the decoder stage going from the current position
+static void ivldp_ahead_start()
+{
+	SDL_mutexP(s_pAheadMutex);
+	s_uAheadHead = s_uAheadCount = 0;
+	s_iAheadSkip = s_frames_to_skip;	// a search sets this up before calling ivldp_render()
+	s_iAheadState = AHEAD_RUN;
+	SDL_CondBroadcast(s_pAheadCond);
+	SDL_mutexV(s_pAheadMutex);
+
+	s_bAheadStarved = VLDP_FALSE;
+}
+
+// stops the decoder stage and throws away any frames it queued up
+// When this returns, libmpeg2 and the file can be used again.
+static void ivldp_ahead_stop()
+{
+	if (!s_pAheadThread)
+	{
+		return;
+	}
+
+	SDL_mutexP(s_pAheadMutex);
+
+	if (s_iAheadState == AHEAD_RUN)
+	{
+		s_iAheadState = AHEAD_STOP;
+		SDL_CondBroadcast(s_pAheadCond);
+	}
+
+	// the decoder stage finishes the buffer it is on, but doesn't decode anything else
+	while (s_iAheadState != AHEAD_IDLE)
+	{
+		SDL_CondWait(s_pAheadCond, s_pAheadMutex);
+	}
+
+	s_uAheadHead = s_uAheadCount = 0;
+	SDL_mutexV(s_pAheadMutex);
+
+	g_out_info.uDecodeAheadDepth = 0;
+}
+
+// the presentation stage: shows (or skips/drops) the next frame that the decoder stage has queued up
+// Returns VLDP_FALSE once the end of the mpeg has been reached.
+static VLDP_BOOL ivldp_ahead_present()
+{
+	struct ahead_frame_s *frame = NULL;
+	unsigned int uCount = 0;
+
+	SDL_mutexP(g_cmd_mutex);
+
+	SDL_mutexP(s_pAheadMutex);
+	uCount = s_uAheadCount;
+	SDL_mutexV(s_pAheadMutex);
+
+	// if there's nothing to show yet, wait for the decoder stage
+	// (the decoder stage signals us while holding g_cmd_mutex, so we can't miss its signal)
+	if (uCount == 0)
+	{
+		// keep track of how often the decoder stage can't keep up
+		if (!s_bAheadStarved && !s_paused && (ivldp_next_frame_lateness() >= 0))
+		{
+			s_bAheadStarved = VLDP_TRUE;
+			g_out_info.uDecodeAheadUnderruns++;
+		}
+
+		// commands that end ivldp_render() need to be looked at right away, the others wait until we have a frame
+		switch (ivldp_cur_cmd())
+		{
+		case VLDP_REQ_QUIT:
+		case VLDP_REQ_OPEN:
+		case VLDP_REQ_SEARCH:
+		case VLDP_REQ_STOP:
+		case VLDP_REQ_SKIP:
+			break;
+		default:
+			SDL_CondWaitTimeout(g_cmd_wake_cond, g_cmd_mutex, 16);
+			break;
+		}
+	}
+
+	SDL_mutexV(g_cmd_mutex);
+
+	SDL_mutexP(s_pAheadMutex);
+	uCount = s_uAheadCount;
+	SDL_mutexV(s_pAheadMutex);
+
+	if (uCount == 0)
+	{
+		return VLDP_TRUE;
+	}
+
+	// only this thread changes s_uAheadHead, and the decoder stage won't touch a slot that is queued
+	frame = &s_sAheadRing[s_uAheadHead];
+
+	if (frame->bEnd)
+	{
+		return VLDP_FALSE;
+	}
+
+	s_bAheadStarved = VLDP_FALSE;
+	g_out_info.uDecodeAheadDepth = uCount - 1;
+	null_present_frame(&frame->buf, frame->bElided);
+
+	// the slot can be reused now
+	SDL_mutexP(s_pAheadMutex);
+	s_uAheadHead = (s_uAheadHead + 1) % (s_uAheadSize + 1);
+	s_uAheadCount--;
+	SDL_CondBroadcast(s_pAheadCond);
+	SDL_mutexV(s_pAheadMutex);
+
+	return VLDP_TRUE;
+}
+
+/////////////////
+
 // Pre-caches sequence header so that vldp_process_sequence_header (and thus any seeks) are faster
 // NOTE: this does change the file position
 void vldp_cache_sequence_header()
@@ -510,19 +1242,25 @@ void vldp_process_sequence_header()
 void idle_handler_open()
 {
 	char req_file[STRSIZE] = { 0 };
-	unsigned int req_idx = g_req_idx;
-	VLDP_BOOL req_precache = g_req_precache;
+	unsigned int req_idx = ivldp_cur_req()->idx;
+	VLDP_BOOL req_precache = (VLDP_BOOL) ivldp_cur_req()->precache;
 	VLDP_BOOL bSuccess = VLDP_FALSE;
 
-	SAFE_STRCPY(req_file, g_req_file, sizeof(req_file));	// after we ack the command, this string could become clobbered at any time
+	SAFE_STRCPY(req_file, ivldp_cur_req()->file, sizeof(req_file));	// after we ack the command, this string could become clobbered at any time
 
 	// NOTE : it is very important that we change our status to BUSY before acknowledging the command, because
 	//  our previous status could be STAT_ERROR, which causes problems with the *_and_block commands.
-	g_out_info.status = STAT_BUSY;	// make us busy while opening the file
+	ivldp_set_status(STAT_BUSY);	// make us busy while opening the file
 	ivldp_ack_command();	// acknowledge open command
 
 	// reset libmpeg2 so it is prepared to begin reading from a new m2v file
 	mpeg2_partial_init(g_mpeg_data);
+	ivldp_elide_reset(0);
+	s_uMaxBRun = 2;	// the new file could be put together differently
+	s_bSeekPending = VLDP_FALSE;	// a search or skip that got interrupted by the open will never finish
+
+	// any frames we have cached belong to the old file
+	ivldp_frame_cache_clear(VLDP_FALSE);
 
 	// if we have previously opened an mpeg, we need to close it and reset
 	if (io_is_open())
@@ -561,8 +1299,8 @@ void idle_handler_open()
 		// if we find the proper mpeg2 video header at the beginning of the file
 		if (((small_buf[0] << 24) | (small_buf[1] << 16) | (small_buf[2] << 8) | small_buf[3]) == 0x000001B3)
 		{
-			g_out_info.w = (small_buf[4] << 4) | (small_buf[5] >> 4);	// get mpeg width
-			g_out_info.h = ((small_buf[5] & 0x0F) << 8) | small_buf[6];	// get mpeg height
+			g_out_info.w = ((small_buf[4] << 4) | (small_buf[5] >> 4)) >> s_uLowRes;	// get mpeg width (the size we'll decode it at)
+			g_out_info.h = (((small_buf[5] & 0x0F) << 8) | small_buf[6]) >> s_uLowRes;	// get mpeg height
 			ivldp_set_framerate(small_buf[7] & 0xF);	// set the framerate
 
 			io_seek(0);	// go back to beginning for parser's benefit
@@ -578,13 +1316,13 @@ void idle_handler_open()
 
 				io_seek(0);	// seek back to beginning of file
 
-				g_out_info.status = STAT_STOPPED;	// now that the file is open, we're ready to play
+				ivldp_set_status(STAT_STOPPED);	// now that the file is open, we're ready to play
 			}
 			else
 			{
 				io_close();
 				fprintf(stderr, "VLDP PARSE ERROR : Is the video stream damaged?\n");
-				g_out_info.status = STAT_ERROR;	// change from BUSY to ERROR
+				ivldp_set_status(STAT_ERROR);	// change from BUSY to ERROR
 			}
 		} // end if a proper mpeg header was found
 		
@@ -593,28 +1331,49 @@ void idle_handler_open()
 		{
 			io_close();
 			fprintf(stderr, "VLDP ERROR : Did not find expected header.  Is this mpeg stream demultiplexed??\n");
-			g_out_info.status = STAT_ERROR;
+			ivldp_set_status(STAT_ERROR);
 		}
 	} // end if file exists
 	else
 	{
 		fprintf(stderr, "VLDP ERROR : Could not open file!\n");
-		g_out_info.status = STAT_ERROR;
+		ivldp_set_status(STAT_ERROR);
 	}
 #ifdef VLDP_DEBUG
 	printf("idle_handler_open returning ...\n");
 #endif
 }
 
+// gets called when the user wants frame indexes built for a list of files ahead of time
+void idle_handler_build_index()
+{
+	// the parent thread keeps this list around until we change our status, so it's safe to use after we ack
+	const char *const *ppszFiles = ivldp_cur_req()->ppszFiles;
+	unsigned int uFileCount = ivldp_cur_req()->uFileCount;
+
+	// always set the status before acknowledging the command so previous status doesn't get through
+	ivldp_set_status(STAT_BUSY);
+	ivldp_ack_command();
+
+	if (mpegscan_build_indexes(ppszFiles, uFileCount, g_in_info->report_parse_progress))
+	{
+		ivldp_set_status(STAT_STOPPED);
+	}
+	else
+	{
+		ivldp_set_status(STAT_ERROR);
+	}
+}
+
 // gets called when the user wants to precache a file ...
 void idle_handler_precache()
 {
 	char req_file[STRSIZE] = { 0 };
 	
-	SAFE_STRCPY(req_file, g_req_file, sizeof(req_file));	// after we ack the command, this string could become clobbered at any time
+	SAFE_STRCPY(req_file, ivldp_cur_req()->file, sizeof(req_file));	// after we ack the command, this string could become clobbered at any time
 
 	// always set the status before acknowledging the command so previous status doesn't get through
-	g_out_info.status = STAT_BUSY;	// make us busy while opening the file
+	ivldp_set_status(STAT_BUSY);	// make us busy while opening the file
 	ivldp_ack_command();
 
 	// if we still have room in our array to precache ...
@@ -675,25 +1434,25 @@ void idle_handler_precache()
 				// (this must be done after we've read in the file so that the index is correct for that operation)
 				++s_uPreCacheIdxCount;
 
-				g_out_info.status = STAT_STOPPED;	// success
+				ivldp_set_status(STAT_STOPPED);	// success
 			}
 			// else malloc failed
 			else
 			{
-				g_out_info.status = STAT_ERROR;
+				ivldp_set_status(STAT_ERROR);
 			}
 			fclose(F);
 		}
 		// else we couldn't open the file
 		else
 		{
-			g_out_info.status = STAT_ERROR;
+			ivldp_set_status(STAT_ERROR);
 		}
 	}
 	// else we're out of room, so return an error
 	else
 	{
-		g_out_info.status = STAT_ERROR;
+		ivldp_set_status(STAT_ERROR);
 	}
 }
 
@@ -712,12 +1471,12 @@ void idle_handler_play()
 // responds to play request
 void ivldp_respond_req_play()
 {
-	s_timer = g_req_timer;
+	s_timer = ivldp_cur_req()->timer;
 #ifdef VLDP_DEBUG
-	fprintf(stderr, "ivldp_respond_req_play() : g_req_timer is %u, and uMstimer is %u\n", g_req_timer, g_in_info->uMsTimer);	// REMOVE ME
+	fprintf(stderr, "ivldp_respond_req_play() : requested timer is %u, and uMstimer is %u\n", s_timer, g_in_info->uMsTimer);	// REMOVE ME
 #endif // VLDP_DEBUG
 	s_uFramesShownSinceTimer = PLAY_FRAME_STALL;	// we want to render the currently shown frame for 1 frame before moving on
-	g_out_info.status = STAT_PLAYING;	// we strive for instant response (and catch-up to maintain timing)
+	ivldp_set_status(STAT_PLAYING);	// we strive for instant response (and catch-up to maintain timing)
 	ivldp_ack_command();	// acknowledge the play command
 	s_paused = 0;	// we to not want to pause on 1 frame
 	s_blanked = 0;	// we want to see the video
@@ -730,7 +1489,7 @@ void ivldp_respond_req_play()
 void ivldp_respond_req_pause_or_step()
 {
 	// if they've also requested a step forward
-	if ((g_req_cmdORcount & 0xF0) == VLDP_REQ_STEP_FORWARD)
+	if ((ivldp_cur_cmd()) == VLDP_REQ_STEP_FORWARD)
 	{
 		s_step_forward = 1;
 	}
@@ -748,8 +1507,8 @@ void ivldp_respond_req_pause_or_step()
 //  is a speed change command
 void ivldp_respond_req_speedchange()
 {
-	s_skip_per_frame = g_req_skip_per_frame;
-	s_stall_per_frame = g_req_stall_per_frame;
+	s_skip_per_frame = ivldp_cur_req()->skip_per_frame;
+	s_stall_per_frame = ivldp_cur_req()->stall_per_frame;
 	ivldp_ack_command();
 }
 
@@ -758,6 +1517,8 @@ void ivldp_respond_req_speedchange()
 void ivldp_render()
 {
     Uint8 *end = NULL;
+	Uint8 *start = NULL;
+	unsigned int uBytesRead = 0;
 	int render_finished = 0;
 
 #ifdef VLDP_BENCHMARK
@@ -779,30 +1540,52 @@ void ivldp_render()
 	{
 		render_finished = 1;
 		fprintf(stderr, "VLDP RENDER ERROR : we tried to render an mpeg but none was open!\n");
-		g_out_info.status = STAT_ERROR;
+		ivldp_set_status(STAT_ERROR);
+	}
+
+	// if frames are decoded ahead, get the decoder stage going
+	else if (s_pAheadThread)
+	{
+		ivldp_ahead_start();
 	}
 
 	// while we're not finished playing and pausing		
     while (!render_finished)
     {
-//		end = g_buffer + fread (g_buffer, 1, BUFFER_SIZE, g_mpeg_handle);
-		end = g_buffer + io_read(g_buffer, BUFFER_SIZE);
-		
-		// safety check, they could be equal if we were already at EOF before we tried this
-		if (g_buffer != end)
+		VLDP_BOOL bEnd = VLDP_FALSE;	// whether we've reached the end of the mpeg
+
+		// if frames are decoded ahead, the decoder stage does the reading and decoding, and we just show the frames
+		if (s_pAheadThread)
 		{
-			// read chunk of video stream
-			decode_mpeg2 (g_buffer, end);	// display it to the screen
+			bEnd = !ivldp_ahead_present();
+		}
+		else
+		{
+//			end = g_buffer + fread (g_buffer, 1, BUFFER_SIZE, g_mpeg_handle);
+			// (if the file is mapped or precached, start will point directly into it instead of into g_buffer)
+			uBytesRead = io_read_ptr(&start, BUFFER_SIZE);
+			end = start + uBytesRead;
+		
+			// safety check, they could be equal if we were already at EOF before we tried this
+			if (start != end)
+			{
+				// read chunk of video stream
+				decode_mpeg2 (start, end);	// display it to the screen
+			}
+
+			bEnd = (uBytesRead != BUFFER_SIZE);
 		}
 		
 		// if we've read to the end of the mpeg2 file, then we can't play anymore, so we pause on last frame
-		if (end != (g_buffer + BUFFER_SIZE))
+		if (bEnd)
 		{
-			g_out_info.status = STAT_STOPPED;	// it's a toss-up between this and STAT_PAUSED
+			ivldp_ahead_stop();	// (the decoder stage has finished already, but we have to wait for it to let go of libmpeg2)
+			ivldp_set_status(STAT_STOPPED);	// it's a toss-up between this and STAT_PAUSED
 			render_finished = 1;
 			
 			// reset libmpeg2 so it is prepared to begin reading from the beginning of the file
 			mpeg2_partial_init(g_mpeg_data);
+			ivldp_elide_reset(0);
 			io_seek(0);	// seek to the beginning of the file
 			g_out_info.current_frame = 0;	// set frame # to beginning of file where it belongs
 		}
@@ -811,13 +1594,13 @@ void ivldp_render()
 		if (ivldp_got_new_command())
 		{
 			// check to see if we need to suddenly abort the rendering process
-			switch (g_req_cmdORcount & 0xF0)
+			switch (ivldp_cur_cmd())
 			{
 			case VLDP_REQ_QUIT:
 			case VLDP_REQ_OPEN:
 			case VLDP_REQ_SEARCH:
 			case VLDP_REQ_STOP:
-				g_out_info.status = STAT_BUSY;
+				ivldp_set_status(STAT_BUSY);
 				render_finished = 1;
 				break;
 			case VLDP_REQ_SKIP:
@@ -828,6 +1611,9 @@ void ivldp_render()
 		} // end if they got a new command
     } // end while
 
+	// whatever the decoder stage has queued up is no good to us now (searches and skips start decoding somewhere else)
+	ivldp_ahead_stop();
+
 #ifdef VLDP_BENCHMARK
 	fprintf(F, "Benchmarking result:\n");
 	total_frames = g_out_info.current_frame - render_start_frame;
@@ -851,8 +1637,8 @@ void ivldp_render()
 void idle_handler_search(int skip)
 {
 	Uint32 proposed_pos = 0;
-	Uint16 req_frame = g_req_frame; // after we acknowledge the command, g_req_frame could become clobbered
-	Uint32 min_seek_ms = g_req_min_seek_ms;	// g_req_min_seek_ms can be clobbered at any time after we acknowledge command
+	Uint16 req_frame = ivldp_cur_req()->frame; // after we acknowledge the command, the queue entry could become clobbered
+	Uint32 min_seek_ms = ivldp_cur_req()->min_seek_ms;
 
 	// adjusted req frame is the requested frame with fields taken into account
 	unsigned int uAdjustedReqFrame = 0;
@@ -860,9 +1646,18 @@ void idle_handler_search(int skip)
 	unsigned int actual_frame = 0;
 	int skipped_I = 0;
 
+	// if another search or skip was still going, it never finished, so only this one gets timed
+	s_uSeekIssueMs = ivldp_cur_req()->uIssueMs;
+	s_bSeekIsSkip = skip ? VLDP_TRUE : VLDP_FALSE;
+	s_bSeekPending = VLDP_TRUE;
+
+	// whatever the last search was doing with the frame cache, it's over now
+	s_uFrameCacheStoreFrame = 0;
+	s_bCachedFrameShown = VLDP_FALSE;
+
 	// status must be changed before acknowledging command, because previous status could be STAT_ERROR, which
 	//  causes problems with *_and_block vldp API commands.
-	if (!skip) g_out_info.status = STAT_BUSY;
+	if (!skip) ivldp_set_status(STAT_BUSY);
 	// else we're skipping
 	// (our status is already STAT_PLAYING so we don't need to set it)
 	else
@@ -998,7 +1793,9 @@ void idle_handler_search(int skip)
 		printf("position in mpeg2 stream we are seeking to : %x\n", proposed_pos);
 #endif
 
+		io_advise(proposed_pos, BUFFER_SIZE);	// we're about to need this part of the file, so ask the OS to start reading it in
 		io_seek(proposed_pos);
+		ivldp_elide_reset(actual_frame);	// decoding starts from this I frame
 //		fseek(g_mpeg_handle, proposed_pos, SEEK_SET);	// go to the place in the stream where the I frame begins
 
 		// if we're seeking, we can change the frame right now ...
@@ -1016,212 +1813,196 @@ void idle_handler_search(int skip)
 
 		s_blanked = 0;	// we want to see the frame
 
+		// if this is a search, see if we have the frame cached
+		// (if the parent thread wants us to simulate seek delay, we can't show the frame early, so don't bother)
+		if (!skip && (min_seek_ms == 0) && (ivldp_frame_cache_size() > 0))
+		{
+			struct frame_cache_entry_s *entry = ivldp_frame_cache_lookup(req_frame);
+
+			// If it's cached, show it and let the parent thread know the search is done right now.
+			// We still have to decode up to the frame (so that playback can continue from it), but the parent can
+			//  get on with other things while we do, and if it searches somewhere else in the meantime we just bail out.
+			if (entry)
+			{
+				++s_uFrameCacheHits;
+				if (g_in_info->prepare_frame(&entry->buf))
+				{
+					g_in_info->display_frame(&entry->buf);
+				}
+				s_bCachedFrameShown = VLDP_TRUE;
+				ivldp_set_status(STAT_PAUSED);
+			}
+			// else cache the frame once we've decoded it
+			else
+			{
+				++s_uFrameCacheMisses;
+				s_uFrameCacheStoreFrame = req_frame + 1;
+			}
+		}
+
 		ivldp_render();
 	} // end if the bounds check passed
 	else
 	{
 		fprintf(stderr, "SEARCH ERROR : frame %u was requested, but it is out of bounds\n", req_frame);
-		g_out_info.status = STAT_ERROR;
+		ivldp_set_status(STAT_ERROR);
 	}
 }
 
 
 
-// parses an mpeg video stream to get its frame offsets, or if the parsing had taken place earlier
-VLDP_BOOL ivldp_get_mpeg_frame_offsets(char *mpeg_name)
+// returns how many frames the frame cache is allowed to hold
+unsigned int ivldp_frame_cache_size()
 {
-	char datafilename[320] = { 0 };
-	VLDP_BOOL mpeg_datafile_good = VLDP_FALSE;
-	FILE *data_file = NULL;
-	VLDP_BOOL result = VLDP_TRUE;
-	unsigned int mpeg_size = 0;
-	struct dat_header header;
+	unsigned int uSize = g_in_info->uFrameCacheSize;
 
-	// GET LENGTH OF ACTUAL FILE
-	mpeg_size = io_length();
+	if (uSize > VLDP_FRAME_CACHE_MAX)
+	{
+		uSize = VLDP_FRAME_CACHE_MAX;
+	}
+
+	return uSize;
+}
 
-	// change extension of file to be dat instead of (presumably) m2v
-	SAFE_STRCPY(datafilename, mpeg_name, sizeof(datafilename));
-	strcpy(&datafilename[strlen(mpeg_name)-3], "dat");
+// returns the cache entry holding 'uFrame' or NULL if it isn't cached
+struct frame_cache_entry_s *ivldp_frame_cache_lookup(unsigned int uFrame)
+{
+	struct frame_cache_entry_s *result = NULL;
+	unsigned int u = 0;
 
-	// loop until we get a good datafile
-	// or until we get an error
-	while (!mpeg_datafile_good && result)
+	for (u = 0; u < ivldp_frame_cache_size(); u++)
 	{
-		data_file = fopen(datafilename, "rb");	// check to see if datafile exists
-
-		// If file cannot be opened, try to create it.
-		// Most likely the file cannot be opened because it doesn't
-		// exist.
-		if (!data_file)
+		if (s_sFrameCache[u].bValid && (s_sFrameCache[u].uFrame == uFrame))
 		{
-			result = ivldp_parse_mpeg_frame_offsets(datafilename, mpeg_size);
-			// we could open the file here, but there is no need to
-			// because we will loop back through and open the file anyway			
+			result = &s_sFrameCache[u];
+			result->uLastUsed = ++s_uFrameCacheClock;	// this entry is now the most recently used
+			break;
 		}
+	}
 
-		// else if the file has been opened
-		else
-		{
-			// now that file exists and we have it open, we have to read it
-
-			fseek(data_file, 0L, SEEK_SET);
-			fread(&header, sizeof(header), 1, data_file);	// read .DAT file header
+	return result;
+}
 
-			// if version, file size, or finished are wrong, the dat file is no good and has to be regenerated
-			if ((header.length != mpeg_size) || (header.version != DAT_VERSION) || (header.finished != 1))
-			{
-//				printf("*** Alleged mpeg size is %u, actual size is %u\n", header.length, mpeg_size);
-//				printf("Finished flag is %x\n", header.finished);
-//				printf("DAT version is %x\n", header.version);
-				printf("NOTICE : MPEG data file has to be created again!\n");
-				fclose(data_file);
-				data_file = NULL;
-				
-				// try to delete obsolete .DAT file so we can create a modern one
-				if (unlink(datafilename) == -1)
-				{
-					fprintf(stderr, "Couldn't delete obsolete .DAT file!\n");
-					result = VLDP_FALSE;
-				}
-			}
-			else
-			{
-				g_out_info.uses_fields = header.uses_fields;
-				mpeg_datafile_good = 1;	// escape the loop
-			}
-		} // end if mpeg parsing was not necessary
-	} // end while we don't have a good datafile and haven't gotten an error
-	
-	// if we didn't exit the loop because of an error, then we need to read the datafile
-	if (result && data_file)
-	{
-		g_totalframes = 0;
+// copies a frame that has just been displayed into the cache (as frame s_uFrameCacheStoreFrame - 1)
+// This is called from the video output driver.
+void ivldp_frame_cache_store(const struct yuv_buf *buf)
+{
+	struct frame_cache_entry_s *entry = NULL;
+	unsigned int uFrame = s_uFrameCacheStoreFrame - 1;
+	unsigned int u = 0;
 
-#ifdef VLDP_DEBUG
-//		unlink("frame_report.txt");
-#endif
+	s_uFrameCacheStoreFrame = 0;	// only the first frame displayed after the search is the one we want
 
-		// read all the frame positions
-		// if we don't read 4 bytes, it means we've hit the EOF and we're done
-		while (fread(&g_frame_position[g_totalframes], 4, 1, data_file) == 1)
+	// use an empty entry if we can find one, otherwise replace the least recently used entry
+	for (u = 0; u < ivldp_frame_cache_size(); u++)
+	{
+		if (!s_sFrameCache[u].bValid)
 		{
-#ifdef VLDP_DEBUG
-//			FILE *tmp_F = fopen("frame_report.txt", "ab");
-//			fprintf(tmp_F, "Frame %d has offset of %x\n", g_totalframes, g_frame_position[g_totalframes]);
-//			fclose(tmp_F);
-#endif
-			g_totalframes++;
-			
-			// safety check, it is possible to make mpegs with too many frames to fit onto one CAV laserdisc
-			// (in fact I did this, and it caused a lot of problems in the debug stages hehe)
-			if (g_totalframes >= MAX_LDP_FRAMES)
-			{
-				fprintf(stderr, "ERROR : current mpeg has too many frames, VLDP will ignore any frames above %u\n", MAX_LDP_FRAMES);
-				break;
-			}
+			entry = &s_sFrameCache[u];
+			break;
+		}
+		else if (!entry || (s_sFrameCache[u].uLastUsed < entry->uLastUsed))
+		{
+			entry = &s_sFrameCache[u];
 		}
-#ifdef VLDP_DEBUG
-		printf("*** g_totalframes is %u\n", g_totalframes);
-		printf("And frame 0's offset is %x\n", g_frame_position[0]);
-#endif
 	}
 
-	// close any files that are still open
-	if (data_file)
+	if (!entry)
 	{
-		fclose(data_file);
+		return;
 	}
-	
-	return result;
-}
-
-
-VLDP_BOOL ivldp_parse_mpeg_frame_offsets(char *datafilename, Uint32 mpeg_size)
-{
-	int result = VLDP_TRUE;
-	FILE *data_file = fopen(datafilename, "wb");	// create file
-	struct dat_header header;	// header to put inside .DAT file
 
-	// if we could create the file successfully, then we need to populate it
-	if (data_file)
+	// the first time an entry is used (or if the video size has changed), we need to allocate its buffers
+	if ((entry->buf.Y_size != buf->Y_size) || (entry->buf.UV_size != buf->UV_size))
 	{
-		Uint32 pos = 0;	// position in the file
-		int count = 0;
-		int parse_result = 0;
+		free(entry->buf.Y);
+		free(entry->buf.U);
+		free(entry->buf.V);
+		entry->buf.Y = malloc(buf->Y_size);
+		entry->buf.U = malloc(buf->UV_size);
+		entry->buf.V = malloc(buf->UV_size);
+		entry->buf.Y_size = buf->Y_size;
+		entry->buf.UV_size = buf->UV_size;
+	}
 
-		header.version = DAT_VERSION;
-		header.finished = 0;
-		header.uses_fields = 0;
-		header.length = mpeg_size;
-		fwrite(&header, sizeof(header), 1, data_file);
-		// first thing that goes in the file is the .DAT header
-		// That way we can re-use the file another time with confidence that it's
-		// the right one
+	if (entry->buf.Y && entry->buf.U && entry->buf.V)
+	{
+		memcpy(entry->buf.Y, buf->Y, buf->Y_size);
+		memcpy(entry->buf.U, buf->U, buf->UV_size);
+		memcpy(entry->buf.V, buf->V, buf->UV_size);
+		entry->uFrame = uFrame;
+		entry->uLastUsed = ++s_uFrameCacheClock;
+		entry->bValid = VLDP_TRUE;
+	}
+	else
+	{
+		fprintf(stderr, "VLDP : out of memory while caching frame %u\n", uFrame);
+		entry->bValid = VLDP_FALSE;
+	}
+}
 
-		init_mpegscan();
+// empties the frame cache.  If bFree is true, the memory used by the cache is freed too.
+void ivldp_frame_cache_clear(VLDP_BOOL bFree)
+{
+	unsigned int u = 0;
 
-		g_in_info->report_parse_progress(-1);	// notify other thread that we're starting
+	for (u = 0; u < VLDP_FRAME_CACHE_MAX; u++)
+	{
+		s_sFrameCache[u].bValid = VLDP_FALSE;
 
-		// keep reading the file while there is a file left to be read
-		do
+		if (bFree)
 		{
-#define PARSE_CHUNK 200000
+			// NOTE : it's ok to call free(NULL)
+			free(s_sFrameCache[u].buf.Y);
+			free(s_sFrameCache[u].buf.U);
+			free(s_sFrameCache[u].buf.V);
+			memset(&s_sFrameCache[u].buf, 0, sizeof(struct yuv_buf));
+		}
+	}
 
-			parse_result = parse_video_stream(data_file, PARSE_CHUNK);
-			pos += PARSE_CHUNK;
+	s_uFrameCacheStoreFrame = 0;
+	s_bCachedFrameShown = VLDP_FALSE;
+}
 
-			// we want to give the user updates but don't want to flood them
-			if (count > 10)
-			{
-				count = 0;
-				
-				// report progress to parent thread
-				g_in_info->report_parse_progress((double) pos / mpeg_size);
-			}
-			count++;
+// parses an mpeg video stream to get its frame offsets, or if the parsing had taken place earlier, reads them from the .dat file
+VLDP_BOOL ivldp_get_mpeg_frame_offsets(char *mpeg_name)
+{
+	char datafilename[STRSIZE] = { 0 };
+	VLDP_BOOL result = VLDP_FALSE;
+	unsigned int mpeg_size = 0;
+	unsigned int uFrames = 0;
+	Uint8 u8UsesFields = 0;
 
-		} while (parse_result == P_IN_PROGRESS);
+	// GET LENGTH OF ACTUAL FILE
+	mpeg_size = io_length();
 
-		g_in_info->report_parse_progress(1);	// notify other thread that we're done
+	mpegscan_dat_name(datafilename, sizeof(datafilename), mpeg_name);
 
-		// if parse finished, then we have to update the header
-		if (parse_result != P_ERROR)
-		{
-			header.finished = 1;
-			header.uses_fields = 0;
-			if (parse_result == P_FINISHED_FIELDS)
-			{
-				header.uses_fields = 1;
-			}
-			fseek(data_file, 0L, SEEK_SET);
-			fwrite(&header, sizeof(header), 1, data_file);	// save changes
-		}
+	result = mpegscan_read_index(datafilename, mpeg_size, g_frame_position, MAX_LDP_FRAMES, &uFrames, &u8UsesFields);
+
+	// if the .dat file doesn't exist, is from an older version, or is for a different mpeg, it needs to be created again
+	// (normally the parent thread has already built every index ahead of time, so this only happens for stragglers)
+	if (!result)
+	{
+		const char *names[1];
+		names[0] = mpeg_name;
 
-		// we have to close data file because it's write-only
-		// and it needs to be re-opened read-only
-		fclose(data_file);
-		data_file = NULL;
+		printf("NOTICE : MPEG data file has to be created!\n");
 
-		// if the mpeg did not finish parsing gracefully, we've got problems
-		// NOTE : I separated this from the other if above to guarantee that the file gets closed
-		if (parse_result == P_ERROR)
+		if (mpegscan_build_indexes(names, 1, g_in_info->report_parse_progress))
 		{
-			fprintf(stderr, "There was an error parsing the MPEG file.\n");
-			fprintf(stderr, "Either there is a bug in the parser or the MPEG file is corrupt.\n");
-			fprintf(stderr, "OR the user aborted the decoding process :)\n");
-			result = VLDP_FALSE;
-			unlink(datafilename);
+			result = mpegscan_read_index(datafilename, mpeg_size, g_frame_position, MAX_LDP_FRAMES, &uFrames, &u8UsesFields);
 		}
-	} // end if we could create the file successfully
+	}
 
-	// we couldn't create data file which means no write permission probably
-	// this is probably a good time to shut VLDP down =]
-	else
+	if (result)
 	{
-		fprintf(stderr, "Could not create file %s\n", datafilename);
-		fprintf(stderr, "This probably means you don't have permission to create the file\n");
-		result = VLDP_FALSE;
+		g_totalframes = (Uint16) uFrames;
+		g_out_info.uses_fields = u8UsesFields;
+#ifdef VLDP_DEBUG
+		printf("*** g_totalframes is %u\n", g_totalframes);
+		printf("And frame 0's offset is %x\n", g_frame_position[0]);
+#endif
 	}
 
 	return result;
@@ -1233,10 +2014,36 @@ VLDP_BOOL io_open(const char *cpszFilename)
 	VLDP_BOOL bResult = VLDP_FALSE;
 
 	// make sure everything is closed
-	if ((!s_bPreCacheEnabled) && (!g_mpeg_handle))
+	if (!io_is_open())
 	{
-		g_mpeg_handle = fopen(cpszFilename, "rb");
-		if (g_mpeg_handle) bResult = VLDP_TRUE;
+#ifdef VLDP_MMAP
+		// try to map the file first, if that fails we fall back to reading it the old fashioned way
+		int fd = open(cpszFilename, O_RDONLY);
+		if (fd != -1)
+		{
+			struct stat the_stat;
+
+			// mmap can't map empty files, and we can't address more than 4 gigs with our 32-bit positions anyway
+			if ((fstat(fd, &the_stat) == 0) && (the_stat.st_size > 0) && ((Uint64) the_stat.st_size <= 0xFFFFFFFF))
+			{
+				void *ptr = mmap(NULL, (size_t) the_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+				if (ptr != MAP_FAILED)
+				{
+					g_mmap_ptr = (Uint8 *) ptr;
+					g_mmap_length = (unsigned int) the_stat.st_size;
+					g_mmap_pos = 0;
+					bResult = VLDP_TRUE;
+				}
+			}
+			close(fd);	// the mapping stays valid after the file is closed
+		}
+
+		if (!bResult)
+#endif // VLDP_MMAP
+		{
+			g_mpeg_handle = fopen(cpszFilename, "rb");
+			if (g_mpeg_handle) bResult = VLDP_TRUE;
+		}
 	}
 	return bResult;
 }
@@ -1246,7 +2053,7 @@ VLDP_BOOL io_open_precached(unsigned int uIdx)
 	VLDP_BOOL bResult = VLDP_FALSE;
 
 	// make sure everything is closed
-	if ((!g_mpeg_handle) && (!s_bPreCacheEnabled))
+	if (!io_is_open())
 	{
 		// make sure index is within range ...
 		if (uIdx < s_uPreCacheIdxCount)
@@ -1270,6 +2077,49 @@ unsigned int io_read(void *buf, unsigned int uBytesToRead)
 	{
 		uBytesRead = (unsigned int) fread(buf, 1, uBytesToRead, g_mpeg_handle);
 	}
+	// else we're reading from a mapped or precached stream, both of which are already in memory
+	else
+	{
+		Uint8 *ptrSrc = NULL;
+		uBytesRead = io_read_ptr(&ptrSrc, uBytesToRead);
+		memcpy(buf, ptrSrc, uBytesRead);
+	}
+
+	return uBytesRead;
+}
+
+// Like io_read, except that instead of copying the data, *ppBuf is set to point to it.
+// If the stream is already in memory (mapped or precached), this doesn't copy anything,
+//  otherwise the data is read into g_buffer (so uBytesToRead can't be bigger than BUFFER_SIZE).
+// The pointer is only good until the next io_* call.
+unsigned int io_read_ptr(Uint8 **ppBuf, unsigned int uBytesToRead)
+{
+	unsigned int uBytesRead = 0;
+
+	if (g_mpeg_handle)
+	{
+		*ppBuf = g_buffer;
+		uBytesRead = (unsigned int) fread(g_buffer, 1, uBytesToRead, g_mpeg_handle);
+	}
+#ifdef VLDP_MMAP
+	else if (g_mmap_ptr)
+	{
+		unsigned int uBytesLeft = g_mmap_length - g_mmap_pos;
+
+		// if we're trying to read beyond our means ...
+		if (uBytesToRead > uBytesLeft)
+		{
+			uBytesToRead = uBytesLeft;
+		}
+
+		*ppBuf = g_mmap_ptr + g_mmap_pos;
+		uBytesRead = uBytesToRead;
+		g_mmap_pos += uBytesRead;
+
+		// we'll most likely need the next chunk too, so get the OS started on it
+		io_advise(g_mmap_pos, uBytesToRead);
+	}
+#endif // VLDP_MMAP
 	// else we're reading from a precache stream
 	else
 	{
@@ -1282,7 +2132,7 @@ unsigned int io_read(void *buf, unsigned int uBytesToRead)
 			uBytesToRead = uBytesLeft;
 		}
 
-		memcpy(buf, ((unsigned char *) entry->ptrBuf) + entry->uPos, uBytesToRead);
+		*ppBuf = ((Uint8 *) entry->ptrBuf) + entry->uPos;
 		uBytesRead = uBytesToRead;
 		entry->uPos += uBytesRead;
 	}
@@ -1290,6 +2140,28 @@ unsigned int io_read(void *buf, unsigned int uBytesToRead)
 	return uBytesRead;
 }
 
+// lets the OS know that we are going to be reading uLength bytes starting at uPos soon
+// (only does something if the file is memory mapped)
+void io_advise(unsigned int uPos, unsigned int uLength)
+{
+#ifdef VLDP_MMAP
+	if ((g_mmap_ptr) && (uPos < g_mmap_length))
+	{
+		// madvise needs a page aligned address
+		unsigned int uPageSize = (unsigned int) sysconf(_SC_PAGESIZE);
+		unsigned int uStart = uPos - (uPos % uPageSize);
+
+		if (uLength > (g_mmap_length - uPos))
+		{
+			uLength = g_mmap_length - uPos;
+		}
+
+		// it's only a hint, so we don't care if it fails
+		madvise(g_mmap_ptr + uStart, (uPos - uStart) + uLength, MADV_WILLNEED);
+	}
+#endif // VLDP_MMAP
+}
+
 VLDP_BOOL io_seek(unsigned int uPos)
 {
 	VLDP_BOOL bResult = VLDP_FALSE;
@@ -1301,6 +2173,17 @@ VLDP_BOOL io_seek(unsigned int uPos)
 			bResult = VLDP_TRUE;
 		}
 	}
+#ifdef VLDP_MMAP
+	else if (g_mmap_ptr)
+	{
+		// if we're seeking within bounds ...
+		if (uPos < g_mmap_length)
+		{
+			g_mmap_pos = uPos;
+			bResult = VLDP_TRUE;
+		}
+	}
+#endif // VLDP_MMAP
 	else
 	{
 		struct precache_entry_s *entry = &s_sPreCacheEntries[s_uCurPreCacheIdx];
@@ -1322,6 +2205,14 @@ void io_close()
 		fclose(g_mpeg_handle);
 		g_mpeg_handle = NULL;
 	}
+#ifdef VLDP_MMAP
+	else if (g_mmap_ptr)
+	{
+		munmap(g_mmap_ptr, g_mmap_length);
+		g_mmap_ptr = NULL;
+		g_mmap_length = g_mmap_pos = 0;
+	}
+#endif // VLDP_MMAP
 	else if (s_bPreCacheEnabled)
 	{
 		s_bPreCacheEnabled = VLDP_FALSE;
@@ -1336,6 +2227,12 @@ VLDP_BOOL io_is_open()
 	{
 		bResult = VLDP_TRUE;
 	}
+#ifdef VLDP_MMAP
+	else if (g_mmap_ptr)
+	{
+		bResult = VLDP_TRUE;
+	}
+#endif // VLDP_MMAP
 	return bResult;
 }
 
@@ -1349,6 +2246,12 @@ unsigned int io_length()
 		fstat(fileno(g_mpeg_handle), &the_stat);
 		uResult = the_stat.st_size;
 	}
+#ifdef VLDP_MMAP
+	else if (g_mmap_ptr)
+	{
+		uResult = g_mmap_length;
+	}
+#endif // VLDP_MMAP
 	else if (s_bPreCacheEnabled)
 	{
 		uResult = s_sPreCacheEntries[s_uCurPreCacheIdx].uLength;
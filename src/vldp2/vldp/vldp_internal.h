@@ -28,7 +28,9 @@
 #include "vldp.h"	// for the VLDP_BOOL definition and SDL.h
 
 // this is which version of the .dat file format we are using
-#define DAT_VERSION 2
+// Version 3 : the header is followed by the picture count, the I frame count, one flags byte per picture
+//  (see mpegscan.h), and then the position of each I frame.  Version 2 stored a position for every picture.
+#define DAT_VERSION 3
 
 // header for the .DAT files that are generated
 struct dat_header
@@ -46,11 +48,27 @@ struct precache_entry_s
 	unsigned int uPos;	// our current position within the stream
 };
 
+// a frame that was searched to, kept around in case it gets searched to again
+struct frame_cache_entry_s
+{
+	VLDP_BOOL bValid;	// whether this entry holds a frame
+	unsigned int uFrame;	// which frame (relative to the beginning of the mpeg) this is
+	Uint32 uLastUsed;	// when this entry was last used (compared against other entries to find the least recently used)
+	struct yuv_buf buf;	// the decoded frame
+};
+
 int idle_handler(void *surface);
 void blank_video();
 void erase_yuv_overlay(SDL_Overlay *dst);
 int ivldp_got_new_command();
+int ivldp_cur_cmd();
+const struct vldp_cmd_entry *ivldp_cur_req();
 void ivldp_ack_command();
+void ivldp_set_status(int stat);
+void ivldp_seek_done();
+void ivldp_seek_frame_shown();
+void ivldp_wait_for_command(Uint32 uMs);
+void ivldp_wait_for_ms_timer(Uint32 uMsTimer);
 void ivldp_lock_handler();
 void paused_handler();
 void play_handler();
@@ -58,19 +76,27 @@ void ivldp_set_framerate(Uint8 frame_rate_code);
 void vldp_process_sequence_header();
 void idle_handler_open();
 void idle_handler_precache();
+void idle_handler_build_index();
 void idle_handler_play();
 void ivldp_respond_req_play();
 void ivldp_respond_req_pause_or_step();
 void ivldp_respond_req_speedchange();
 void ivldp_render();
 void idle_handler_search(int skip);
+unsigned int ivldp_frame_cache_size();
+struct frame_cache_entry_s *ivldp_frame_cache_lookup(unsigned int uFrame);
+void ivldp_frame_cache_store(const struct yuv_buf *buf);
+void ivldp_frame_cache_clear(VLDP_BOOL bFree);
+VLDP_BOOL ivldp_ahead_queue_frame(const struct yuv_buf *buf, VLDP_BOOL bElided);
+void null_present_frame(struct yuv_buf *pBuf, VLDP_BOOL bElided);	// in video_out_null.c
 VLDP_BOOL ivldp_get_mpeg_frame_offsets(char *mpeg_name);
-VLDP_BOOL ivldp_parse_mpeg_frame_offsets(char *datafilename, Uint32 mpeg_size);
 void ivldp_update_progress_indicator(SDL_Surface *indicator, double percentage_completed);
 
 VLDP_BOOL io_open(const char *cpszFilename);
 VLDP_BOOL io_open_precached(unsigned int uIdx);
 unsigned int io_read(void *buf, unsigned int uBytesToRead);
+unsigned int io_read_ptr(Uint8 **ppBuf, unsigned int uBytesToRead);
+void io_advise(unsigned int uPos, unsigned int uLength);
 VLDP_BOOL io_seek(unsigned int uPos);
 void io_close();
 VLDP_BOOL io_is_open();
@@ -78,7 +104,6 @@ unsigned int io_length();
 
 ///////////////////////////////////////
 
-extern Uint8 s_old_req_cmdORcount;	// the last value of the command byte we received
 extern int s_paused;	// whether the video is to be paused
 extern int s_blanked;	// whether the mpeg video is to be blanked
 extern int s_frames_to_skip;	// how many frames to skip before rendering the next frame (used for P and B frames seeking)
@@ -98,6 +123,10 @@ extern unsigned int s_uPendingSkipFrame;
 extern SDL_Overlay *s_hw_overlay;	// if the game uses video overlay, we can't modify our buffers, so we have to
 							// copy to the extra overlay and let that get displayed
 
+extern unsigned int s_uFrameCacheStoreFrame;	// (frame # + 1) that the next displayed frame should be cached as, 0 if none
+
+extern VLDP_BOOL s_bFrameElided;	// whether the frame that the next draw would show was never decoded (so it can't be shown)
+
 extern unsigned int s_skip_per_frame;	// how many frames to skip per frame (for playing at 2X for example)
 extern unsigned int s_stall_per_frame;	// how many frames to stall per frame (for playing at 1/2X for example)
 